@@ -79,6 +79,7 @@
 #define NS_CONN_ZIPACCEPTED         0x10000u /* The request accepts zip compression */
 #define NS_CONN_BROTLIACCEPTED      0x20000u /* The request accept brotli compression */
 #define NS_CONN_CONTINUE            0x40000u /* The request got "Expect: 100-continue" */
+#define NS_CONN_ZSTDACCEPTED        0x80000u /* The request accepts zstd compression */
 #define NS_CONN_ENTITYTOOLARGE    0x0100000u /* The sent entity was too large */
 #define NS_CONN_REQUESTURITOOLONG 0x0200000u /* Request-URI too long */
 #define NS_CONN_LINETOOLONG       0x0400000u /* Request header line too long */
@@ -175,6 +176,9 @@ typedef enum {
 #define NS_DRIVER_UDP              0x08u /* UDP, can't use stream socket options */
 #define NS_DRIVER_CAN_USE_SENDFILE 0x10u /* Allow to send clear text via sendfile */
 #define NS_DRIVER_SNI              0x20u /* SNI - just used when NS_DRIVER_SSL is set as well */
+#define NS_DRIVER_SSL_CONFIG       0x40u /* Driver argument is an NsSSLConfig (nsssl) */
+#define NS_DRIVER_WRITER_SENDFILE  0x80u /* Writer passes file content to the sendFileProc */
+#define NS_DRIVER_WRITER_URING     0x100u /* Writer may send buffers unmodified via io_uring */
 
 #define NS_DRIVER_VERSION_1        1    /* Obsolete. */
 #define NS_DRIVER_VERSION_2        2    /* IPv4 only */
@@ -258,6 +262,13 @@ typedef struct Ns_CacheSearch {
 } Ns_CacheSearch;
 
 typedef struct Ns_Cache         Ns_Cache;
+
+typedef enum {
+    NS_CACHE_LRU =     0, /* Least recently used, the default.                */
+    NS_CACHE_CLOCK =   1, /* CLOCK (second chance), no relinking on hits.     */
+    NS_CACHE_TINYLFU = 2  /* LRU with a frequency based admission filter.     */
+} Ns_CachePolicy;
+
 typedef struct Ns_Entry         Ns_Entry;
 typedef uintptr_t               Ns_Cls;
 typedef uintptr_t               Ns_Sls;
@@ -1002,6 +1013,14 @@ NS_EXTERN TCL_SIZE_T
 Ns_CacheGetNrUncommittedEntries(const Ns_Cache *cache)
     NS_GNUC_NONNULL(1) NS_GNUC_PURE;
 
+NS_EXTERN void
+Ns_CacheSetPolicy(Ns_Cache *cache, Ns_CachePolicy policy)
+    NS_GNUC_NONNULL(1);
+
+NS_EXTERN Ns_CachePolicy
+Ns_CacheGetPolicy(const Ns_Cache *cache)
+    NS_GNUC_NONNULL(1) NS_GNUC_PURE;
+
 /*
  * callbacks.c:
  */
@@ -1025,12 +1044,22 @@ NS_EXTERN void Ns_ClsSet(const Ns_Cls *clsPtr, Ns_Conn *conn, void *value);
  * compress.c:
  */
 
+typedef enum {
+    NS_COMPRESS_GZIP =   0,
+    NS_COMPRESS_BROTLI = 1,
+    NS_COMPRESS_ZSTD =   2
+} Ns_CompressFormat;
+
+#define NS_COMPRESS_NR_FORMATS 3
+
 typedef struct Ns_CompressStream {
 
 #ifdef HAVE_ZLIB_H
     z_stream   z;
 #endif
     unsigned int flags;
+    Ns_CompressFormat format;   /* Codec used by Ns_CompressBufs() */
+    void        *codecState;    /* Encoder state of brotli and zstd streams */
 
 } Ns_CompressStream;
 
@@ -1052,6 +1081,27 @@ NS_EXTERN Ns_ReturnCode
 Ns_CompressGzip(const char *buf, int len, Tcl_DString *dsPtr, int level)
     NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(3);
 
+NS_EXTERN Ns_ReturnCode
+Ns_CompressSetFormat(Ns_CompressStream *cStream, Ns_CompressFormat format)
+    NS_GNUC_NONNULL(1);
+
+NS_EXTERN Ns_ReturnCode
+Ns_CompressBufs(Ns_CompressStream *cStream, struct iovec *bufs, int nbufs,
+                Ns_DString *dsPtr, int level, bool flush)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(4);
+
+NS_EXTERN bool
+Ns_CompressFormatSupported(Ns_CompressFormat format)
+    NS_GNUC_CONST;
+
+NS_EXTERN const char *
+Ns_CompressFormatName(Ns_CompressFormat format)
+    NS_GNUC_CONST NS_GNUC_RETURNS_NONNULL;
+
+NS_EXTERN Ns_ReturnCode
+Ns_CompressFormatFromName(const char *name, Ns_CompressFormat *formatPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+
 NS_EXTERN Ns_ReturnCode
 Ns_InflateInit(Ns_CompressStream *cStream)
     NS_GNUC_NONNULL(1);
@@ -1208,6 +1258,7 @@ NS_EXTERN ssize_t        Ns_ConnResponseLength(const Ns_Conn *conn) NS_GNUC_NONN
 NS_EXTERN int            Ns_ConnResponseStatus(const Ns_Conn *conn) NS_GNUC_NONNULL(1) NS_GNUC_PURE;
 NS_EXTERN const char *   Ns_ConnServer(const Ns_Conn *conn) NS_GNUC_NONNULL(1) NS_GNUC_PURE;
 NS_EXTERN void           Ns_ConnSetCompression(Ns_Conn *conn, int level) NS_GNUC_NONNULL(1);
+NS_EXTERN void           Ns_ConnSetCompressionCacheKey(Ns_Conn *conn, const char *key) NS_GNUC_NONNULL(1);
 NS_EXTERN void           Ns_ConnSetContentSent(Ns_Conn *conn, size_t length) NS_GNUC_NONNULL(1);
 NS_EXTERN void           Ns_ConnSetEncoding(Ns_Conn *conn, Tcl_Encoding encoding) NS_GNUC_NONNULL(1);
 NS_EXTERN const char *   Ns_ConnSetPeer(Ns_Conn *conn, const struct sockaddr *saPtr,
@@ -3742,6 +3793,10 @@ NS_EXTERN ssize_t
 Ns_SSLSendBufs2(SSL *ssl, const struct iovec *bufs, int nbufs)
     NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
 
+NS_EXTERN ssize_t
+Ns_SSLSendFile(SSL *ssl, int fd, off_t offset, size_t length)
+    NS_GNUC_NONNULL(1);
+
 NS_EXTERN const char *
 Ns_SSLSetErrorCode(Tcl_Interp *interp, unsigned long sslERRcode)
     NS_GNUC_NONNULL(1);
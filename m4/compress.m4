@@ -0,0 +1,149 @@
+#------------------------------------------------------------------------
+# AX_CHECK_BROTLI --
+#
+#       Check for the brotli encoder library used for on-the-fly
+#       compression of responses, possibly using a special directory.
+#       When not explicitly requested, the library is used when found.
+#
+# Arguments:
+#       none
+#
+# Results:
+#
+#       Adds the following arguments to configure:
+#               --with-brotli=[dir]
+#
+#       Defines the following vars:
+#               BROTLI_INCLUDES Full path to the directory containing
+#                               the brotli/encode.h file if a brotli
+#                               directory was specified.
+#               BROTLI_LIBS     Linker line for libbrotlienc.
+#------------------------------------------------------------------------
+
+AC_DEFUN([AX_CHECK_BROTLI], [
+AC_MSG_CHECKING([for brotli compression library])
+BROTLI_INCLUDES=""
+BROTLI_LIBS=""
+AC_ARG_WITH([brotli],
+  AS_HELP_STRING(--with-brotli=DIR,Build and link with the brotli encoder (default: when available)),
+  [
+    ac_brotli=$withval
+    if test "${ac_brotli}" != "no" ; then
+      if test -d "$withval" ; then
+        BROTLI_INCLUDES="-I$withval/include"
+        BROTLI_LIBS="-L$withval/lib"
+      fi
+      ac_brotli=yes
+    fi
+  ],
+  [
+    ac_brotli="auto"
+  ])
+AC_MSG_RESULT([$ac_brotli])
+
+if test "${ac_brotli}" != "no" ; then
+  save_CPPFLAGS="$CPPFLAGS"
+  save_LDFLAGS="$LDFLAGS"
+  CPPFLAGS="$BROTLI_INCLUDES $CPPFLAGS"
+  LDFLAGS="$BROTLI_LIBS $LDFLAGS"
+
+  AC_CHECK_HEADER([brotli/encode.h], [
+    AC_CHECK_LIB([brotlienc], [BrotliEncoderCompressStream], [
+      AC_DEFINE([HAVE_BROTLI_ENCODE_H], [1],
+                [Define to 1 if the brotli encoder library is available.])
+      BROTLI_LIBS="$BROTLI_LIBS -lbrotlienc"
+      ac_brotli=found
+    ])
+  ])
+
+  if test "${ac_brotli}" = "yes" ; then
+    AC_MSG_ERROR([brotli compression support requested but not available])
+  fi
+  if test "${ac_brotli}" != "found" ; then
+    BROTLI_INCLUDES=""
+    BROTLI_LIBS=""
+  fi
+
+  CPPFLAGS="$save_CPPFLAGS"
+  LDFLAGS="$save_LDFLAGS"
+fi
+
+AC_SUBST([BROTLI_INCLUDES])
+AC_SUBST([BROTLI_LIBS])
+
+])
+
+#------------------------------------------------------------------------
+# AX_CHECK_ZSTD --
+#
+#       Check for the Zstandard library used for on-the-fly compression
+#       of responses, possibly using a special directory. When not
+#       explicitly requested, the library is used when found.
+#
+# Arguments:
+#       none
+#
+# Results:
+#
+#       Adds the following arguments to configure:
+#               --with-zstd=[dir]
+#
+#       Defines the following vars:
+#               ZSTD_INCLUDES   Full path to the directory containing
+#                               the zstd.h file if a zstd directory
+#                               was specified.
+#               ZSTD_LIBS       Linker line for libzstd.
+#------------------------------------------------------------------------
+
+AC_DEFUN([AX_CHECK_ZSTD], [
+AC_MSG_CHECKING([for zstd compression library])
+ZSTD_INCLUDES=""
+ZSTD_LIBS=""
+AC_ARG_WITH([zstd],
+  AS_HELP_STRING(--with-zstd=DIR,Build and link with Zstandard (default: when available)),
+  [
+    ac_zstd=$withval
+    if test "${ac_zstd}" != "no" ; then
+      if test -d "$withval" ; then
+        ZSTD_INCLUDES="-I$withval/include"
+        ZSTD_LIBS="-L$withval/lib"
+      fi
+      ac_zstd=yes
+    fi
+  ],
+  [
+    ac_zstd="auto"
+  ])
+AC_MSG_RESULT([$ac_zstd])
+
+if test "${ac_zstd}" != "no" ; then
+  save_CPPFLAGS="$CPPFLAGS"
+  save_LDFLAGS="$LDFLAGS"
+  CPPFLAGS="$ZSTD_INCLUDES $CPPFLAGS"
+  LDFLAGS="$ZSTD_LIBS $LDFLAGS"
+
+  AC_CHECK_HEADER([zstd.h], [
+    AC_CHECK_LIB([zstd], [ZSTD_compressStream2], [
+      AC_DEFINE([HAVE_ZSTD_H], [1],
+                [Define to 1 if the Zstandard library is available.])
+      ZSTD_LIBS="$ZSTD_LIBS -lzstd"
+      ac_zstd=found
+    ])
+  ])
+
+  if test "${ac_zstd}" = "yes" ; then
+    AC_MSG_ERROR([zstd compression support requested but not available])
+  fi
+  if test "${ac_zstd}" != "found" ; then
+    ZSTD_INCLUDES=""
+    ZSTD_LIBS=""
+  fi
+
+  CPPFLAGS="$save_CPPFLAGS"
+  LDFLAGS="$save_LDFLAGS"
+fi
+
+AC_SUBST([ZSTD_INCLUDES])
+AC_SUBST([ZSTD_LIBS])
+
+])
@@ -11,6 +11,12 @@
 
 #include "ns.h"
 
+#ifndef _WIN32
+# include <sys/un.h>
+# include <poll.h>
+# define NS_CGI_FASTCGI 1
+#endif
+
 #define BUFSIZE          4096
 #define NDSTRINGS        5
 
@@ -19,6 +25,24 @@
 #define CGI_ECONTENT     0x04u
 #define CGI_SYSENV       0x08u
 #define CGI_ALLOW_STATIC 0x10u
+#define CGI_SPLICE       0x20u
+
+/*
+ * FastCGI protocol constants, see
+ * https://fastcgi-archives.github.io/FastCGI_Specification.html
+ */
+#define FCGI_HEADER_LEN        8
+#define FCGI_VERSION_1         1
+#define FCGI_BEGIN_REQUEST     1
+#define FCGI_END_REQUEST       3
+#define FCGI_PARAMS            4
+#define FCGI_STDIN             5
+#define FCGI_STDOUT            6
+#define FCGI_STDERR            7
+#define FCGI_RESPONDER         1
+#define FCGI_KEEP_CONN         1
+#define FCGI_REQUEST_COMPLETE  0
+#define FCGI_MAX_CONTENT       65535u
 
 /*
  * The following structure is allocated for each instance the module is
@@ -34,10 +58,57 @@ typedef struct Mod {
     int             maxCgi;
     int             maxWait;
     int             activeCgi;
+    Tcl_WideInt     spliceSize;
     Ns_Mutex        lock;
     Ns_Cond         cond;
+    int             minWorkers;    /* Defaults for FastCGI maps */
+    int             maxWorkers;
+    Ns_Time         idleTimeout;
+    const char     *socketDir;     /* Directory for the worker sockets */
+    uintptr_t       nextWorkerId;
+    struct Pool    *firstPoolPtr;  /* List of FastCGI worker pools */
+    Tcl_HashTable   pools;         /* Pools indexed by program */
+    bool            reaperScheduled;
 } Mod;
 
+/*
+ * The following structure defines a persistent FastCGI worker process,
+ * listening on a Unix domain socket of its own. The connection to the
+ * worker is kept open between requests.
+ */
+
+typedef struct Worker {
+    struct Worker  *nextPtr;       /* Next idle worker of the pool */
+    struct Pool    *poolPtr;
+    pid_t           pid;
+    NS_SOCKET       sock;          /* Connection to the worker */
+    char           *sockPath;
+    Ns_Time         lastUsed;
+    uintptr_t       nrequests;
+} Worker;
+
+/*
+ * The following structure defines a pool of FastCGI workers running the
+ * same program. Pools are created on demand for every program served via
+ * a FastCGI map and are protected by the lock of the module.
+ */
+
+typedef struct Pool {
+    struct Pool    *nextPtr;
+    Mod            *modPtr;
+    Worker         *firstPtr;      /* List of idle workers */
+    const char     *exec;
+    char           *dir;
+    char           *args;          /* Argument block for Ns_ExecProcess() */
+    Ns_Set         *env;           /* Environment of the worker processes */
+    int             nworkers;      /* Number of running (or starting) workers */
+    int             nidle;
+    int             minWorkers;
+    int             maxWorkers;
+    Ns_Time         idleTimeout;
+    Ns_Cond         cond;          /* Signaled when a worker becomes available */
+} Pool;
+
 /*
  * The following structure, allocated on the stack of CgiRequest, is used
  * to accumulate all the resources of a CGI.  CGI is a very messy interface
@@ -48,6 +119,7 @@ typedef struct Mod {
 
 typedef struct Cgi {
     Mod            *modPtr;
+    const struct Map *mapPtr;
     unsigned int    flags;
     pid_t           pid;
     Ns_Set         *env;
@@ -62,6 +134,13 @@ typedef struct Cgi {
     int             ofd;
     ssize_t         cnt;
     char           *ptr;
+    Pool           *poolPtr;       /* FastCGI pool, NULL for plain CGI */
+    Worker         *workerPtr;     /* FastCGI worker serving the request */
+    size_t          fcgiRemain;    /* Unread bytes of the current FCGI_STDOUT record */
+    size_t          fcgiPadding;   /* Padding following the current record */
+    int             fcgiAppStatus;
+    int             fcgiProtocolStatus;
+    bool            fcgiDone;      /* FCGI_END_REQUEST was received */
     int             nextds;
     Tcl_DString     ds[NDSTRINGS];
     char            buf[BUFSIZE];
@@ -76,6 +155,10 @@ typedef struct Map {
     Mod      *modPtr;
     char     *url;
     char     *path;
+    bool      fastcgi;      /* Serve via persistent FastCGI workers */
+    int       minWorkers;
+    int       maxWorkers;
+    Ns_Time   idleTimeout;
 } Map;
 
 /*
@@ -112,12 +195,44 @@ static Ns_ReturnCode CgiExec(Cgi *cgiPtr, Ns_Conn *conn)         NS_GNUC_NONNULL
 static Ns_ReturnCode CgiSpool(Cgi *cgiPtr, const Ns_Conn *conn)  NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
 static Ns_ReturnCode CgiCopy(Cgi *cgiPtr, Ns_Conn *conn)         NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
 static ssize_t       CgiRead(Cgi *cgiPtr)                        NS_GNUC_NONNULL(1);
+#ifdef SPLICE_F_MOVE
+static bool          CgiSpliceable(const Cgi *cgiPtr, const Ns_Conn *conn, Tcl_WideInt length)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+static Ns_ReturnCode CgiSplice(Cgi *cgiPtr, Ns_Conn *conn, size_t length) NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+#endif
 static ssize_t       CgiReadLine(Cgi *cgiPtr, Ns_DString *dsPtr) NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
 static char         *NextWord(char *s)                           NS_GNUC_NONNULL(1);
 static void          SetAppend(Ns_Set *set, int index, const char *sep, char *value)
     NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(3) NS_GNUC_NONNULL(4);
 static void          CgiRegisterFastUrl2File(const char *server, char *url, const char *path)
     NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(3);
+static Map          *CgiMapNew(Mod *modPtr, const char *url, const char *path)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_RETURNS_NONNULL;
+static Ns_ReturnCode CgiMapOptions(Map *mapPtr, const char *options)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+
+#ifdef NS_CGI_FASTCGI
+static Ns_SchedProc  FcgiReaper;
+static Ns_ShutdownProc FcgiShutdown;
+static Pool         *FcgiGetPool(Cgi *cgiPtr)                    NS_GNUC_NONNULL(1);
+static void          FcgiStartWorkers(Pool *poolPtr)             NS_GNUC_NONNULL(1);
+static Worker       *FcgiSpawnWorker(Pool *poolPtr)              NS_GNUC_NONNULL(1);
+static NS_SOCKET     FcgiConnect(const char *path)               NS_GNUC_NONNULL(1);
+static void          FcgiStopWorker(Worker *workerPtr)           NS_GNUC_NONNULL(1);
+static bool          FcgiCheckWorker(Worker *workerPtr)          NS_GNUC_NONNULL(1);
+static Worker       *FcgiGetWorker(Pool *poolPtr)                NS_GNUC_NONNULL(1);
+static void          FcgiReleaseWorker(Worker *workerPtr, bool reuse) NS_GNUC_NONNULL(1);
+static void          FcgiAppendParam(Ns_DString *dsPtr, const char *name, size_t nameLength,
+                                     const char *value, size_t valueLength)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(4);
+static Ns_ReturnCode FcgiSendRecord(NS_SOCKET sock, int type, const char *content, size_t length);
+static Ns_ReturnCode FcgiSendStream(NS_SOCKET sock, int type, const char *data, size_t length);
+static Ns_ReturnCode FcgiSendFile(NS_SOCKET sock, int fd, size_t length);
+static Ns_ReturnCode FcgiSendRequest(Cgi *cgiPtr, const Ns_Conn *conn) NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+static Ns_ReturnCode FcgiRecvAll(NS_SOCKET sock, void *buffer, size_t length) NS_GNUC_NONNULL(2);
+static ssize_t       FcgiRead(Cgi *cgiPtr)                       NS_GNUC_NONNULL(1);
+static Ns_ReturnCode FcgiFinish(Cgi *cgiPtr)                     NS_GNUC_NONNULL(1);
+#endif
 
 static TCL_OBJCMDPROC_T NsTclRegisterCGIObjCmd;
 
@@ -278,6 +393,27 @@ Ns_ModuleInit(const char *server, const char *module)
     if (Ns_ConfigBool(path, "allowstaticresources", NS_FALSE)) {
         modPtr->flags |= CGI_ALLOW_STATIC;
     }
+    if (Ns_ConfigBool(path, "splice", NS_FALSE)) {
+#ifdef SPLICE_F_MOVE
+        modPtr->flags |= CGI_SPLICE;
+#else
+        Ns_Log(Warning, "nscgi: splice() is not supported on this platform, parameter ignored");
+#endif
+    }
+    modPtr->spliceSize = Ns_ConfigMemUnitRange(path, "splicesize", "16KB", 16*1024, 0, LLONG_MAX);
+
+    /*
+     * Defaults for maps served by persistent FastCGI workers.
+     */
+    modPtr->minWorkers = Ns_ConfigIntRange(path, "minworkers", 0, 0, INT_MAX);
+    modPtr->maxWorkers = Ns_ConfigIntRange(path, "maxworkers", 4, 1, INT_MAX);
+    Ns_ConfigTimeUnitRange(path, "idletimeout", "5m", 0, 0, LONG_MAX, 0, &modPtr->idleTimeout);
+    modPtr->socketDir = Ns_ConfigString(path, "socketdir",
+                                        Ns_ConfigString("ns/parameters", "tmpdir", P_tmpdir));
+    Tcl_InitHashTable(&modPtr->pools, TCL_STRING_KEYS);
+#ifdef NS_CGI_FASTCGI
+    Ns_RegisterAtShutdown(FcgiShutdown, modPtr);
+#endif
 
     /*
      * Register all requested mappings.
@@ -385,6 +521,7 @@ CgiRequest(const void *arg, Ns_Conn *conn)
         goto done;
 
     } else if (conn->contentLength > 0u
+               && !mapPtr->fastcgi
                && (CgiSpool(&cgi, conn) != NS_OK)) {
         /*
          * Content length failure.
@@ -514,6 +651,7 @@ CgiInit(Cgi *cgiPtr, const Map *mapPtr, const Ns_Conn *conn)
     memset(cgiPtr, 0, (size_t)((char *)&cgiPtr->ds[0] - (char *)cgiPtr));
     cgiPtr->buf[0] = '\0';
     cgiPtr->modPtr = modPtr;
+    cgiPtr->mapPtr = mapPtr;
     cgiPtr->pid = NS_INVALID_PID;
     cgiPtr->ofd = cgiPtr->ifd = NS_INVALID_FD;
     cgiPtr->ptr = cgiPtr->buf;
@@ -767,6 +905,15 @@ CgiFree(Cgi *cgiPtr)
         Ns_SetFree(cgiPtr->env);
     }
 
+#ifdef NS_CGI_FASTCGI
+    /*
+     * Return the FastCGI worker to its pool.
+     */
+    if (cgiPtr->workerPtr != NULL) {
+        result = FcgiFinish(cgiPtr);
+    }
+#endif
+
     /*
      * Reap the process.
      */
@@ -881,6 +1028,16 @@ CgiExec(Cgi *cgiPtr, Ns_Conn *conn)
         }
     }
 
+#ifdef NS_CGI_FASTCGI
+    /*
+     * FastCGI workers are started with the environment built so far, the
+     * request specific variables below are passed as parameters.
+     */
+    if (cgiPtr->mapPtr->fastcgi) {
+        cgiPtr->poolPtr = FcgiGetPool(cgiPtr);
+    }
+#endif
+
     /*
      * Set all the CGI specified variables.
      */
@@ -1064,6 +1221,12 @@ CgiExec(Cgi *cgiPtr, Ns_Conn *conn)
         Ns_DStringSetLength(dsPtr, 5);
     }
 
+#ifdef NS_CGI_FASTCGI
+    if (cgiPtr->poolPtr != NULL) {
+        return FcgiSendRequest(cgiPtr, conn);
+    }
+#endif
+
     /*
      * Build up the argument block.
      */
@@ -1151,6 +1314,11 @@ CgiRead(Cgi *cgiPtr)
 
     NS_NONNULL_ASSERT(cgiPtr != NULL);
 
+#ifdef NS_CGI_FASTCGI
+    if (cgiPtr->workerPtr != NULL) {
+        return FcgiRead(cgiPtr);
+    }
+#endif
     cgiPtr->ptr = cgiPtr->buf;
     do {
         n = ns_read(cgiPtr->ofd, cgiPtr->buf, sizeof(cgiPtr->buf));
@@ -1326,17 +1494,41 @@ CgiCopy(Cgi *cgiPtr, Ns_Conn *conn)
          * Queue the headers and copy remaining content up to end of file.
          */
 
+        const char  *lengthString;
+        Tcl_WideInt  length = -1;
+
         Ns_ConnSetResponseStatus(conn, httpstatus);
-    copy:
-        do {
-            struct iovec vbuf;
 
-            vbuf.iov_base = cgiPtr->ptr;
-            vbuf.iov_len  = (size_t)cgiPtr->cnt;
-            status = Ns_ConnWriteVData(conn, &vbuf, 1, NS_CONN_STREAM);
-            //Ns_Log(Ns_LogCGIDebug, "=== content %ld\n%s", cgiPtr->cnt, (char*)cgiPtr->ptr);
+        /*
+         * When the CGI provides the content length, make it the
+         * response length, such that the content is not chunked.
+         */
+        lengthString = Ns_SetIGet(hdrs, "content-length");
+        if (lengthString != NULL
+            && Ns_StrToWideInt(lengthString, &length) == NS_OK
+            && length >= 0) {
+            Ns_ConnSetLengthHeader(conn, (size_t)length, NS_FALSE);
+        } else {
+            length = -1;
+        }
+
+#ifdef SPLICE_F_MOVE
+        if (CgiSpliceable(cgiPtr, conn, length)) {
+            status = CgiSplice(cgiPtr, conn, (size_t)length);
+        } else
+#endif
+        {
+        copy:
+            do {
+                struct iovec vbuf;
 
-        } while (status == NS_OK && CgiRead(cgiPtr) > 0);
+                vbuf.iov_base = cgiPtr->ptr;
+                vbuf.iov_len  = (size_t)cgiPtr->cnt;
+                status = Ns_ConnWriteVData(conn, &vbuf, 1, NS_CONN_STREAM);
+                //Ns_Log(Ns_LogCGIDebug, "=== content %ld\n%s", cgiPtr->cnt, (char*)cgiPtr->ptr);
+
+            } while (status == NS_OK && CgiRead(cgiPtr) > 0);
+        }
 #if 0
         /*
          * Close connection now so it will not linger on
@@ -1352,248 +1544,1623 @@ CgiCopy(Cgi *cgiPtr, Ns_Conn *conn)
 }
 
 
+#ifdef SPLICE_F_MOVE
+
 /*
  *----------------------------------------------------------------------
  *
- * NextWord -
+ * CgiSpliceable -
  *
- *      Locate next word in CGI mapping.
+ *      Check whether the remaining CGI output can be spliced from the
+ *      pipe directly to the client socket. This requires the "splice"
+ *      parameter, a plain (non-TLS) socket, and a response with a body
+ *      and a Content-Length provided by the CGI of at least
+ *      "splicesize" bytes, since otherwise the content is chunked.
  *
  * Results:
- *      Pointer to next word.
+ *      Boolean value.
  *
  * Side effects:
- *      String is modified in place.
+ *      None.
  *
  *----------------------------------------------------------------------
  */
 
-static char    *
-NextWord(char *s)
+static bool
+CgiSpliceable(const Cgi *cgiPtr, const Ns_Conn *conn, Tcl_WideInt length)
 {
-    NS_NONNULL_ASSERT(s != NULL);
+    const Ns_Sock *sockPtr;
 
-    while (*s != '\0' && CHARTYPE(space, *s) == 0) {
-        ++s;
-    }
-    if (*s != '\0') {
-        *s++ = '\0';
-        while (CHARTYPE(space, *s) != 0) {
-            ++s;
-        }
-    }
-    return s;
+    NS_NONNULL_ASSERT(cgiPtr != NULL);
+    NS_NONNULL_ASSERT(conn != NULL);
+
+    return ((cgiPtr->modPtr->flags & CGI_SPLICE) != 0u
+            && cgiPtr->ofd != NS_INVALID_FD
+            && length > 0
+            && length >= cgiPtr->modPtr->spliceSize
+            && (conn->flags & (NS_CONN_SKIPHDRS|NS_CONN_SKIPBODY)) == 0u
+            && (sockPtr = Ns_ConnSockPtr(conn)) != NULL
+            && STREQ(sockPtr->driver->type, "nssock"));
 }
 
-/*----------------------------------------------------------------------
+
+/*
+ *----------------------------------------------------------------------
  *
- * CgiRegisterFastUrl2File -
+ * CgiSplice -
  *
- *      Helper file for achieving consistent behavior when an FastUrl2File
- *      handler is registered via the configuration file or via
- *      NsTclRegisterCGIObjCmd (Tcl command "ns_register_cgi").
+ *      Send the response headers together with the already buffered
+ *      content and move the remainder of the content via splice() from
+ *      the CGI pipe to the client socket, without copying it through
+ *      user space.
  *
  * Results:
- *      None.
+ *      NaviServer request result.
  *
  * Side effects:
- *      May register or re-register a mapping.
+ *      Blocks until the CGI has delivered all announced content or
+ *      the client socket is not writable within the driver's
+ *      sendwait.
  *
  *----------------------------------------------------------------------
  */
-static void
-CgiRegisterFastUrl2File(const char *server, char *url, const char *path)
+
+static Ns_ReturnCode
+CgiSplice(Cgi *cgiPtr, Ns_Conn *conn, size_t length)
 {
-    char *tailSegment;
+    const Ns_Sock *sockPtr;
+    struct iovec   vbuf[2];
+    Ns_DString     ds;
+    size_t         toSend, leftover;
+    ssize_t        sent;
+    Ns_ReturnCode  status = NS_OK;
 
-    NS_NONNULL_ASSERT(server != NULL);
-    NS_NONNULL_ASSERT(url != NULL);
-    NS_NONNULL_ASSERT(path != NULL);
+    NS_NONNULL_ASSERT(cgiPtr != NULL);
+    NS_NONNULL_ASSERT(conn != NULL);
+
+    sockPtr = Ns_ConnSockPtr(conn);
 
-    tailSegment = strrchr(url, INTCHAR('/'));
     /*
-     * When there is a tail segment and it contains a wildchard character,
-     * strip it away for the mapping. This means, that all files in this
-     * folder are mapped.
+     * Send the headers and the buffered content directly to the
+     * socket. Ns_ConnWriteVData() might hand the socket over to a
+     * writer thread, leaving nothing to splice to.
      */
-    if (tailSegment != NULL && strchr(tailSegment, INTCHAR('*')) != NULL) {
-        *tailSegment = '\0';
-        Ns_RegisterFastUrl2File(server, url, path, 0u);
-        *tailSegment = '/';
+    Ns_DStringInit(&ds);
+    conn->flags |= NS_CONN_SENTHDRS;
+    (void) Ns_CompleteHeaders(conn, length, 0u, &ds);
+    leftover = MIN((size_t)cgiPtr->cnt, length);
+    (void) Ns_SetVec(vbuf, 0, ds.string, (size_t)ds.length);
+    (void) Ns_SetVec(vbuf, 1, cgiPtr->ptr, leftover);
+    sent = Ns_SockSendBufs((Ns_Sock *)sockPtr, vbuf, 2, &sockPtr->driver->sendwait, 0u);
+    if (sent != (ssize_t)((size_t)ds.length + leftover)) {
+        status = NS_ERROR;
     } else {
-        Ns_RegisterFastUrl2File(server, url, path, 0u);
+        Ns_ConnSetContentSent(conn, (size_t)sent);
+    }
+    Ns_DStringFree(&ds);
+    toSend = length - leftover;
+
+    Ns_Log(Ns_LogCGIDebug, "nscgi: splice %" PRIuz " of %" PRIuz " bytes from %s",
+           toSend, length, cgiPtr->exec);
+
+    while (status == NS_OK && toSend > 0u) {
+        ssize_t n = splice(cgiPtr->ofd, NULL, sockPtr->sock, NULL, toSend,
+                           SPLICE_F_MOVE|SPLICE_F_MORE);
+        if (n > 0) {
+            toSend -= (size_t)n;
+            Ns_ConnSetContentSent(conn, Ns_ConnContentSent(conn) + (size_t)n);
+
+        } else if (n == 0) {
+            Ns_Log(Warning, "nscgi: %s delivered %" PRIuz " bytes less than announced",
+                   cgiPtr->exec, toSend);
+            status = NS_ERROR;
+
+        } else if (errno == NS_EINTR) {
+            continue;
+
+        } else if (errno == NS_EAGAIN || errno == EWOULDBLOCK) {
+            if (Ns_SockTimedWait(sockPtr->sock, (unsigned int)NS_SOCK_WRITE,
+                                 &sockPtr->driver->sendwait) != NS_OK) {
+                status = NS_ERROR;
+            }
+
+        } else {
+            Ns_Log(Error, "nscgi: splice() from %s failed: %s",
+                   cgiPtr->exec, strerror(errno));
+            status = NS_ERROR;
+        }
+    }
+    if (status != NS_OK) {
+        /*
+         * The headers are already sent, so the client can only learn
+         * about the truncated content when the connection is shut down;
+         * keeping it alive would leave the client waiting for the
+         * missing bytes.
+         */
+        (void) shutdown(sockPtr->sock, SHUT_WR);
     }
+    return status;
 }
+#endif
+
+
+#ifdef NS_CGI_FASTCGI
 
-
 /*
  *----------------------------------------------------------------------
  *
- * CgiRegister -
+ * FcgiGetPool -
  *
- *      Register a CGI request mapping.
+ *      Return the FastCGI worker pool for the program of the CGI
+ *      context, creating it on first use. The pool inherits the worker
+ *      limits of the map and the environment without request specific
+ *      variables from the CGI context.
  *
  * Results:
- *      None.
+ *      Pool pointer.
  *
  * Side effects:
- *      May register or re-register a mapping.
+ *      May start the minimum number of workers for the pool and
+ *      schedule the idle worker reaper.
  *
  *----------------------------------------------------------------------
  */
 
-static void
-CgiRegister(Mod *modPtr, const char *map)
+static Pool *
+FcgiGetPool(Cgi *cgiPtr)
 {
-    char           *method;
-    char           *url;
-    const char     *path;
-    Ns_DString      ds1, ds2;
-    Map            *mapPtr;
+    Mod           *modPtr;
+    const Map     *mapPtr;
+    Pool          *poolPtr;
+    Tcl_HashEntry *hPtr;
+    Ns_DString     ds;
+    int            isNew;
 
-    NS_NONNULL_ASSERT(modPtr != NULL);
-    NS_NONNULL_ASSERT(map != NULL);
+    NS_NONNULL_ASSERT(cgiPtr != NULL);
 
-    Ns_DStringInit(&ds1);
-    Ns_DStringInit(&ds2);
+    modPtr = cgiPtr->modPtr;
+    mapPtr = cgiPtr->mapPtr;
 
-    Ns_DStringAppend(&ds1, map);
-    method = ds1.string;
-    url = NextWord(method);
-    if (*method == '\0' || *url == '\0') {
-        Ns_Log(Error, "nscgi: invalid mapping: %s", map);
-        goto done;
-    }
+    Ns_DStringInit(&ds);
+    Ns_DStringVarAppend(&ds, cgiPtr->exec, "\n", cgiPtr->path, (char *)0L);
 
-    path = NextWord(url);
-    if (*path == '\0') {
-        path = NULL;
+    Ns_MutexLock(&modPtr->lock);
+    hPtr = Tcl_CreateHashEntry(&modPtr->pools, ds.string, &isNew);
+    if (isNew == 0) {
+        poolPtr = Tcl_GetHashValue(hPtr);
     } else {
-        path = Ns_NormalizePath(&ds2, path);
-        if (Ns_PathIsAbsolute(path) == NS_FALSE || access(path, R_OK) != 0) {
-            Ns_Log(Error, "nscgi: invalid directory: %s", path);
-            goto done;
-        }
-    }
-
-    mapPtr = ns_malloc(sizeof(Map));
-    mapPtr->modPtr = modPtr;
-    mapPtr->url = ns_strdup(url);
-    mapPtr->path = ns_strcopy(path);
-    Ns_Log(Notice, "nscgi: %s %s%s%s", method, url,
-           (path != NULL) ? " -> " : NS_EMPTY_STRING,
-           (path != NULL) ? path : NS_EMPTY_STRING);
+        poolPtr = ns_calloc(1u, sizeof(Pool));
+        poolPtr->modPtr = modPtr;
+        poolPtr->exec = ns_strdup(cgiPtr->exec);
+        poolPtr->dir = ns_strdup(cgiPtr->dir);
+        poolPtr->env = Ns_SetCopy(cgiPtr->env);
+        poolPtr->minWorkers = mapPtr->minWorkers;
+        poolPtr->maxWorkers = mapPtr->maxWorkers;
+        poolPtr->idleTimeout = mapPtr->idleTimeout;
+        Ns_CondInit(&poolPtr->cond);
 
-    (void) Ns_RegisterRequest2(NULL, modPtr->server, method, url,
-                               CgiRequest, CgiFreeMap, mapPtr, NS_OP_SEGMENT_MATCH);
-    if (path != NULL) {
         /*
-         * When a path is provided, register it to the Url2File
-         * mappings. These are used for determining the source locations for
-         * static files and CGI programs.
+         * The argument block contains the interpreter (if any) and the
+         * program, each terminated by a null byte, plus a final null
+         * byte.
          */
-        CgiRegisterFastUrl2File(modPtr->server, url, mapPtr->path);
+        Ns_DStringSetLength(&ds, 0);
+        if (cgiPtr->interp != NULL) {
+            Ns_DStringAppendArg(&ds, cgiPtr->interp);
+        }
+        Ns_DStringAppendArg(&ds, cgiPtr->path);
+        poolPtr->args = ns_malloc((size_t)ds.length + 1u);
+        memcpy(poolPtr->args, ds.string, (size_t)ds.length + 1u);
+
+        poolPtr->nextPtr = modPtr->firstPoolPtr;
+        modPtr->firstPoolPtr = poolPtr;
+        Tcl_SetHashValue(hPtr, poolPtr);
+
+        if (!modPtr->reaperScheduled) {
+            Ns_Time interval = {1, 0};
+
+            (void) Ns_ScheduleProcEx(FcgiReaper, modPtr, NS_SCHED_THREAD, &interval, NULL);
+            modPtr->reaperScheduled = NS_TRUE;
+        }
     }
+    Ns_MutexUnlock(&modPtr->lock);
+    Ns_DStringFree(&ds);
 
-done:
-    Ns_DStringFree(&ds1);
-    Ns_DStringFree(&ds2);
+    if (isNew != 0) {
+        Ns_Log(Notice, "nscgi: FastCGI pool for %s (workers %d..%d, idletimeout " NS_TIME_FMT ")",
+               cgiPtr->path, poolPtr->minWorkers, poolPtr->maxWorkers,
+               (int64_t)poolPtr->idleTimeout.sec, poolPtr->idleTimeout.usec);
+        FcgiStartWorkers(poolPtr);
+    }
+    return poolPtr;
 }
 
-
+
 /*
  *----------------------------------------------------------------------
  *
- * CgiFreeMap -
+ * FcgiStartWorkers -
  *
- *      Free a request mapping context.
+ *      Start workers until the pool has its minimum number of workers.
  *
  * Results:
  *      None.
  *
  * Side effects:
- *      None.
+ *      May start processes.
  *
  *----------------------------------------------------------------------
  */
 
 static void
-CgiFreeMap(void *arg)
+FcgiStartWorkers(Pool *poolPtr)
 {
-    Map  *mapPtr = (Map *) arg;
+    Mod *modPtr;
+    int  n;
 
-    ns_free(mapPtr->url);
-    ns_free(mapPtr->path);
-    ns_free(mapPtr);
+    NS_NONNULL_ASSERT(poolPtr != NULL);
+
+    modPtr = poolPtr->modPtr;
+
+    Ns_MutexLock(&modPtr->lock);
+    n = poolPtr->minWorkers - poolPtr->nworkers;
+    if (n > 0) {
+        poolPtr->nworkers += n;
+    }
+    Ns_MutexUnlock(&modPtr->lock);
+
+    while (n-- > 0) {
+        Worker *workerPtr = FcgiSpawnWorker(poolPtr);
+
+        if (workerPtr != NULL) {
+            FcgiReleaseWorker(workerPtr, NS_TRUE);
+        } else {
+            Ns_MutexLock(&modPtr->lock);
+            poolPtr->nworkers--;
+            Ns_MutexUnlock(&modPtr->lock);
+        }
+    }
 }
 
-
+
 /*
  *----------------------------------------------------------------------
  *
- * SetAppend -
+ * FcgiSpawnWorker -
  *
- *      Append data to an existing Ns_Set value.
+ *      Start a new worker process for the pool. As defined by the
+ *      FastCGI specification, the worker receives a listening socket as
+ *      its standard input, on which it accepts connections.
  *
  * Results:
- *      None.
+ *      Connected worker or NULL on error.
  *
  * Side effects:
- *      None.
+ *      Creates a Unix domain socket and starts a process.
  *
  *----------------------------------------------------------------------
  */
 
-static void
-SetAppend(Ns_Set *set, int index, const char *sep, char *value)
+static Worker *
+FcgiSpawnWorker(Pool *poolPtr)
 {
+    Mod       *modPtr;
+    Worker    *workerPtr = NULL;
     Ns_DString ds;
+    NS_SOCKET  lsock;
+    uintptr_t  id;
 
-    NS_NONNULL_ASSERT(set != NULL);
-    NS_NONNULL_ASSERT(sep != NULL);
-    NS_NONNULL_ASSERT(value != NULL);
+    NS_NONNULL_ASSERT(poolPtr != NULL);
+
+    modPtr = poolPtr->modPtr;
+
+    Ns_MutexLock(&modPtr->lock);
+    id = modPtr->nextWorkerId++;
+    Ns_MutexUnlock(&modPtr->lock);
 
     Ns_DStringInit(&ds);
-    Ns_DStringVarAppend(&ds, Ns_SetValue(set, index),
-                        sep, value, (char *)0L);
-    Ns_SetPutValueSz(set, (size_t)index, ds.string, ds.length);
+    Ns_DStringPrintf(&ds, "%s/nscgi-%ld-%" PRIuPTR ".sock",
+                     modPtr->socketDir, (long)getpid(), id);
+
+    lsock = Ns_SockListenUnix(ds.string, 16, 0600u);
+    if (lsock == NS_INVALID_SOCKET) {
+        Ns_Log(Error, "nscgi: cannot listen on %s: %s", ds.string, strerror(errno));
+    } else {
+        pid_t pid;
+
+        pid = Ns_ExecProcess(poolPtr->exec, poolPtr->dir, (int)lsock, devNull,
+                             poolPtr->args, poolPtr->env);
+        (void) ns_sockclose(lsock);
+
+        if (pid == NS_INVALID_PID) {
+            Ns_Log(Error, "nscgi: cannot start FastCGI worker %s", poolPtr->exec);
+            (void) unlink(ds.string);
+        } else {
+            workerPtr = ns_calloc(1u, sizeof(Worker));
+            workerPtr->poolPtr = poolPtr;
+            workerPtr->pid = pid;
+            workerPtr->sockPath = ns_strdup(ds.string);
+            workerPtr->sock = FcgiConnect(workerPtr->sockPath);
+            if (workerPtr->sock == NS_INVALID_SOCKET) {
+                FcgiStopWorker(workerPtr);
+                workerPtr = NULL;
+            } else {
+                Ns_Log(Notice, "nscgi: started FastCGI worker %ld on %s",
+                       (long)pid, ds.string);
+            }
+        }
+    }
     Ns_DStringFree(&ds);
+
+    return workerPtr;
 }
 
 
-/*----------------------------------------------------------------------
+/*
+ *----------------------------------------------------------------------
  *
- * NsTclRegisterCGIObjCmd --
+ * FcgiConnect -
  *
- *      Implements "ns_register_cgi".
+ *      Connect to the Unix domain socket of a worker.
  *
  * Results:
- *      Return TCL_OK upon success and TCL_ERROR otherwise.
+ *      Connected socket or NS_INVALID_SOCKET on error.
  *
  * Side effects:
- *      Might register CGI handlers.
+ *      None.
  *
  *----------------------------------------------------------------------
  */
-static int
-NsTclRegisterCGIObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc, Tcl_Obj *const* objv)
+
+static NS_SOCKET
+FcgiConnect(const char *path)
 {
-    char       *method, *url, *path = NULL;
-    int         noinherit = 0, matchsegments = 0, result = TCL_OK;
-    Ns_ObjvSpec opts[] = {
-        {"-noinherit",     Ns_ObjvBool,   &noinherit,     INT2PTR(NS_OP_NOINHERIT)},
-        {"-matchsegments", Ns_ObjvBool,   &matchsegments, INT2PTR(NS_OP_NOINHERIT)},
-        {"-path",          Ns_ObjvString, &path,          NULL},
-        {"--",             Ns_ObjvBreak,  NULL,           NULL},
-        {NULL, NULL, NULL, NULL}
-    };
-    Ns_ObjvSpec args[] = {
-        {"method",     Ns_ObjvString, &method, NULL},
-        {"url",        Ns_ObjvString, &url,    NULL},
-        {NULL, NULL, NULL, NULL}
-    };
+    struct sockaddr_un addr;
+    NS_SOCKET          sock;
 
-    if (Ns_ParseObjv(opts, args, interp, 1, objc, objv) != NS_OK) {
+    NS_NONNULL_ASSERT(path != NULL);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1u);
+
+    sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock == NS_INVALID_SOCKET) {
+        Ns_Log(Error, "nscgi: socket() failed: %s", strerror(errno));
+    } else {
+        int rc;
+
+        (void) Ns_CloseOnExec((int)sock);
+        do {
+            rc = connect(sock, (struct sockaddr *)&addr, sizeof(addr));
+        } while (rc != 0 && errno == NS_EINTR);
+
+        if (rc != 0) {
+            Ns_Log(Error, "nscgi: connect to %s failed: %s", path, strerror(errno));
+            (void) ns_sockclose(sock);
+            sock = NS_INVALID_SOCKET;
+        }
+    }
+    return sock;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FcgiStopWorker -
+ *
+ *      Terminate a worker process and free its resources. Workers not
+ *      terminating within one second after SIGTERM are killed.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Process is terminated and reaped, socket file is removed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+FcgiStopWorker(Worker *workerPtr)
+{
+    NS_NONNULL_ASSERT(workerPtr != NULL);
+
+    if (workerPtr->sock != NS_INVALID_SOCKET) {
+        (void) ns_sockclose(workerPtr->sock);
+    }
+    if (workerPtr->pid != NS_INVALID_PID) {
+        pid_t rc;
+        int   i = 0;
+
+        (void) kill(workerPtr->pid, SIGTERM);
+        while ((rc = waitpid(workerPtr->pid, NULL, WNOHANG)) == 0 && i++ < 20) {
+            (void) poll(NULL, 0u, 50);
+        }
+        if (rc == 0) {
+            Ns_Log(Warning, "nscgi: FastCGI worker %ld does not terminate, killing it",
+                   (long)workerPtr->pid);
+            (void) kill(workerPtr->pid, SIGKILL);
+            (void) Ns_WaitForProcessStatus(workerPtr->pid, NULL, NULL);
+        }
+    }
+    (void) unlink(workerPtr->sockPath);
+    ns_free(workerPtr->sockPath);
+    ns_free(workerPtr);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FcgiCheckWorker -
+ *
+ *      Check, whether an idle worker can be used for the next
+ *      request. When the worker closed the connection (e.g. because it
+ *      ignores FCGI_KEEP_CONN), connect again.
+ *
+ * Results:
+ *      Boolean value.
+ *
+ * Side effects:
+ *      May reap the process or reconnect.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static bool
+FcgiCheckWorker(Worker *workerPtr)
+{
+    struct pollfd pfd;
+    bool          success = NS_TRUE;
+
+    NS_NONNULL_ASSERT(workerPtr != NULL);
+
+    if (waitpid(workerPtr->pid, NULL, WNOHANG) != 0) {
+        /*
+         * The process has terminated and is now reaped.
+         */
+        workerPtr->pid = NS_INVALID_PID;
+        success = NS_FALSE;
+    } else {
+        pfd.fd = workerPtr->sock;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1u, 0) != 0) {
+            /*
+             * An idle connection is readable only on EOF or error.
+             */
+            (void) ns_sockclose(workerPtr->sock);
+            workerPtr->sock = FcgiConnect(workerPtr->sockPath);
+            success = (workerPtr->sock != NS_INVALID_SOCKET);
+        }
+    }
+    return success;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FcgiGetWorker -
+ *
+ *      Obtain a worker from the pool. When no idle worker is available,
+ *      start a new one, or, when the maximum number of workers is
+ *      reached, wait up to "maxwait" seconds for a worker to become
+ *      available.
+ *
+ * Results:
+ *      Worker or NULL on timeout or error.
+ *
+ * Side effects:
+ *      May start a process.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Worker *
+FcgiGetWorker(Pool *poolPtr)
+{
+    Mod          *modPtr;
+    Worker       *workerPtr = NULL;
+    Ns_Time       timeout;
+    Ns_ReturnCode wait = NS_OK;
+    bool          spawn = NS_FALSE;
+
+    NS_NONNULL_ASSERT(poolPtr != NULL);
+
+    modPtr = poolPtr->modPtr;
+    Ns_GetTime(&timeout);
+    Ns_IncrTime(&timeout, modPtr->maxWait, 0);
+
+    Ns_MutexLock(&modPtr->lock);
+    while (wait == NS_OK
+           && poolPtr->firstPtr == NULL
+           && poolPtr->nworkers >= poolPtr->maxWorkers) {
+        wait = Ns_CondTimedWait(&poolPtr->cond, &modPtr->lock, &timeout);
+    }
+    if (poolPtr->firstPtr != NULL) {
+        workerPtr = poolPtr->firstPtr;
+        poolPtr->firstPtr = workerPtr->nextPtr;
+        poolPtr->nidle--;
+    } else if (poolPtr->nworkers < poolPtr->maxWorkers) {
+        poolPtr->nworkers++;
+        spawn = NS_TRUE;
+    }
+    Ns_MutexUnlock(&modPtr->lock);
+
+    if (workerPtr != NULL && !FcgiCheckWorker(workerPtr)) {
+        /*
+         * Replace the unusable worker.
+         */
+        Ns_Log(Notice, "nscgi: FastCGI worker %ld is gone, starting a new one",
+               (long)workerPtr->pid);
+        FcgiStopWorker(workerPtr);
+        workerPtr = NULL;
+        spawn = NS_TRUE;
+    }
+    if (spawn) {
+        workerPtr = FcgiSpawnWorker(poolPtr);
+        if (workerPtr == NULL) {
+            Ns_MutexLock(&modPtr->lock);
+            poolPtr->nworkers--;
+            Ns_CondSignal(&poolPtr->cond);
+            Ns_MutexUnlock(&modPtr->lock);
+        }
+    } else if (workerPtr == NULL) {
+        Ns_Log(Warning, "nscgi: timeout while waiting for a FastCGI worker for %s",
+               poolPtr->exec);
+    }
+    return workerPtr;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FcgiReleaseWorker -
+ *
+ *      Return a worker to its pool, or stop it when it should not be
+ *      reused.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Wakes up a thread waiting for a worker. After shutdown has
+ *      started, workers are always stopped.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+FcgiReleaseWorker(Worker *workerPtr, bool reuse)
+{
+    Pool *poolPtr;
+    Mod  *modPtr;
+
+    NS_NONNULL_ASSERT(workerPtr != NULL);
+
+    poolPtr = workerPtr->poolPtr;
+    modPtr = poolPtr->modPtr;
+
+    Ns_MutexLock(&modPtr->lock);
+    if (reuse && poolPtr->maxWorkers > 0) {
+        /*
+         * Push the worker to the front, such that busy workers are
+         * reused and surplus workers run into the idle timeout.
+         */
+        Ns_GetTime(&workerPtr->lastUsed);
+        workerPtr->nextPtr = poolPtr->firstPtr;
+        poolPtr->firstPtr = workerPtr;
+        poolPtr->nidle++;
+        reuse = NS_TRUE;
+    } else {
+        poolPtr->nworkers--;
+        reuse = NS_FALSE;
+    }
+    Ns_CondSignal(&poolPtr->cond);
+    Ns_MutexUnlock(&modPtr->lock);
+
+    if (!reuse) {
+        FcgiStopWorker(workerPtr);
+    }
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FcgiReaper -
+ *
+ *      Scheduled procedure to stop workers idle for longer than the
+ *      idle timeout of their pool and to restart workers until the
+ *      minimum number of workers is running again.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      May stop and start processes.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+FcgiReaper(void *arg, int UNUSED(id))
+{
+    Mod    *modPtr = arg;
+    Pool   *poolPtr, *firstPoolPtr;
+    Worker *stopPtr = NULL;
+    Ns_Time now;
+
+    Ns_GetTime(&now);
+
+    Ns_MutexLock(&modPtr->lock);
+    firstPoolPtr = modPtr->firstPoolPtr;
+    for (poolPtr = firstPoolPtr; poolPtr != NULL; poolPtr = poolPtr->nextPtr) {
+        Worker **nextPtrPtr = &poolPtr->firstPtr;
+
+        while (*nextPtrPtr != NULL && poolPtr->nworkers > poolPtr->minWorkers) {
+            Worker *workerPtr = *nextPtrPtr;
+            Ns_Time expire = workerPtr->lastUsed;
+
+            Ns_IncrTime(&expire, poolPtr->idleTimeout.sec, poolPtr->idleTimeout.usec);
+            if (Ns_DiffTime(&expire, &now, NULL) <= 0) {
+                *nextPtrPtr = workerPtr->nextPtr;
+                poolPtr->nidle--;
+                poolPtr->nworkers--;
+                workerPtr->nextPtr = stopPtr;
+                stopPtr = workerPtr;
+            } else {
+                nextPtrPtr = &workerPtr->nextPtr;
+            }
+        }
+    }
+    Ns_MutexUnlock(&modPtr->lock);
+
+    while (stopPtr != NULL) {
+        Worker *nextPtr = stopPtr->nextPtr;
+
+        Ns_Log(Notice, "nscgi: stopping idle FastCGI worker %ld", (long)stopPtr->pid);
+        FcgiStopWorker(stopPtr);
+        stopPtr = nextPtr;
+    }
+
+    /*
+     * Pools are never removed, so the list can be traversed without
+     * holding the lock.
+     */
+    for (poolPtr = firstPoolPtr; poolPtr != NULL; poolPtr = poolPtr->nextPtr) {
+        FcgiStartWorkers(poolPtr);
+    }
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FcgiShutdown -
+ *
+ *      Stop all idle FastCGI workers on server shutdown.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Processes are terminated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+FcgiShutdown(const Ns_Time *toPtr, void *arg)
+{
+    if (toPtr == NULL) {
+        Mod    *modPtr = arg;
+        Pool   *poolPtr;
+        Worker *stopPtr = NULL;
+
+        Ns_MutexLock(&modPtr->lock);
+        for (poolPtr = modPtr->firstPoolPtr; poolPtr != NULL; poolPtr = poolPtr->nextPtr) {
+            poolPtr->minWorkers = 0;
+            poolPtr->maxWorkers = 0;
+            while (poolPtr->firstPtr != NULL) {
+                Worker *workerPtr = poolPtr->firstPtr;
+
+                poolPtr->firstPtr = workerPtr->nextPtr;
+                poolPtr->nidle--;
+                poolPtr->nworkers--;
+                workerPtr->nextPtr = stopPtr;
+                stopPtr = workerPtr;
+            }
+        }
+        Ns_MutexUnlock(&modPtr->lock);
+
+        while (stopPtr != NULL) {
+            Worker *nextPtr = stopPtr->nextPtr;
+
+            FcgiStopWorker(stopPtr);
+            stopPtr = nextPtr;
+        }
+    }
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FcgiAppendParam -
+ *
+ *      Append a FastCGI name-value pair to the provided DString.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+FcgiAppendParam(Ns_DString *dsPtr, const char *name, size_t nameLength,
+                const char *value, size_t valueLength)
+{
+    const size_t lengths[2] = {nameLength, valueLength};
+    size_t       i;
+
+    NS_NONNULL_ASSERT(dsPtr != NULL);
+    NS_NONNULL_ASSERT(name != NULL);
+    NS_NONNULL_ASSERT(value != NULL);
+
+    for (i = 0u; i < 2u; i++) {
+        unsigned char buf[4];
+
+        if (lengths[i] < 128u) {
+            buf[0] = (unsigned char)lengths[i];
+            Ns_DStringNAppend(dsPtr, (char *)buf, 1);
+        } else {
+            buf[0] = (unsigned char)(((lengths[i] >> 24) & 0x7fu) | 0x80u);
+            buf[1] = (unsigned char)((lengths[i] >> 16) & 0xffu);
+            buf[2] = (unsigned char)((lengths[i] >> 8) & 0xffu);
+            buf[3] = (unsigned char)(lengths[i] & 0xffu);
+            Ns_DStringNAppend(dsPtr, (char *)buf, 4);
+        }
+    }
+    Ns_DStringNAppend(dsPtr, name, (TCL_SIZE_T)nameLength);
+    Ns_DStringNAppend(dsPtr, value, (TCL_SIZE_T)valueLength);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FcgiSendRecord -
+ *
+ *      Send a single FastCGI record for request id 1 to the worker.
+ *
+ * Results:
+ *      NS_OK or NS_ERROR.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Ns_ReturnCode
+FcgiSendRecord(NS_SOCKET sock, int type, const char *content, size_t length)
+{
+    unsigned char header[FCGI_HEADER_LEN];
+    struct iovec  iov[2];
+    int           nbufs;
+    size_t        toSend;
+    Ns_ReturnCode status = NS_OK;
+
+    assert(length <= FCGI_MAX_CONTENT);
+
+    header[0] = FCGI_VERSION_1;
+    header[1] = (unsigned char)type;
+    header[2] = 0u;
+    header[3] = 1u;
+    header[4] = (unsigned char)((length >> 8) & 0xffu);
+    header[5] = (unsigned char)(length & 0xffu);
+    header[6] = 0u;
+    header[7] = 0u;
+
+    (void) Ns_SetVec(iov, 0, header, sizeof(header));
+    (void) Ns_SetVec(iov, 1, content, length);
+    nbufs = (length > 0u) ? 2 : 1;
+    toSend = sizeof(header) + length;
+
+    while (toSend > 0u) {
+        int     i;
+        ssize_t n = writev(sock, iov, nbufs);
+
+        if (n < 0) {
+            if (errno == NS_EINTR) {
+                continue;
+            }
+            status = NS_ERROR;
+            break;
+        }
+        toSend -= (size_t)n;
+        i = Ns_ResetVec(iov, nbufs, (size_t)n);
+        if (i > 0) {
+            memmove(iov, iov + i, (size_t)(nbufs - i) * sizeof(struct iovec));
+            nbufs -= i;
+        }
+    }
+    return status;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FcgiSendStream -
+ *
+ *      Send data as a FastCGI stream, split into records and terminated
+ *      by an empty record.
+ *
+ * Results:
+ *      NS_OK or NS_ERROR.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Ns_ReturnCode
+FcgiSendStream(NS_SOCKET sock, int type, const char *data, size_t length)
+{
+    Ns_ReturnCode status = NS_OK;
+    size_t        offset = 0u;
+
+    while (status == NS_OK && offset < length) {
+        size_t chunk = MIN(length - offset, 32768u);
+
+        status = FcgiSendRecord(sock, type, data + offset, chunk);
+        offset += chunk;
+    }
+    if (status == NS_OK) {
+        status = FcgiSendRecord(sock, type, NULL, 0u);
+    }
+    return status;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FcgiSendFile -
+ *
+ *      Send the content of a spooled file as FCGI_STDIN stream.
+ *
+ * Results:
+ *      NS_OK or NS_ERROR.
+ *
+ * Side effects:
+ *      Changes the file offset.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Ns_ReturnCode
+FcgiSendFile(NS_SOCKET sock, int fd, size_t length)
+{
+    char          buffer[32768];
+    Ns_ReturnCode status = NS_OK;
+
+    if (ns_lseek(fd, 0, SEEK_SET) != 0) {
+        status = NS_ERROR;
+    }
+    while (status == NS_OK && length > 0u) {
+        ssize_t n = ns_read(fd, buffer, MIN(length, sizeof(buffer)));
+
+        if (n < 0 && errno == NS_EINTR) {
+            continue;
+        } else if (n <= 0) {
+            status = NS_ERROR;
+        } else {
+            status = FcgiSendRecord(sock, FCGI_STDIN, buffer, (size_t)n);
+            length -= (size_t)n;
+        }
+    }
+    if (status == NS_OK) {
+        status = FcgiSendRecord(sock, FCGI_STDIN, NULL, 0u);
+    }
+    return status;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FcgiSendRequest -
+ *
+ *      Obtain a worker and send the request with the CGI environment as
+ *      parameters and the request content as standard input.
+ *
+ * Results:
+ *      NS_OK or NS_ERROR.
+ *
+ * Side effects:
+ *      The worker is kept in the CGI context until FcgiFinish().
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Ns_ReturnCode
+FcgiSendRequest(Cgi *cgiPtr, const Ns_Conn *conn)
+{
+    static const char begin[8] = {0, FCGI_RESPONDER, FCGI_KEEP_CONN, 0, 0, 0, 0, 0};
+    Ns_ReturnCode     status = NS_ERROR;
+    Ns_DString        ds;
+    const char       *content;
+    size_t            i, contentLength;
+    int               attempt;
+
+    NS_NONNULL_ASSERT(cgiPtr != NULL);
+    NS_NONNULL_ASSERT(conn != NULL);
+
+    /*
+     * The content is either in memory or spooled to a file.
+     */
+    contentLength = conn->contentLength;
+    content = (contentLength > 0u) ? Ns_ConnContent(conn) : NS_EMPTY_STRING;
+    if (content == NULL && Ns_ConnContentFd(conn) < 0) {
+        Ns_Log(Error, "nscgi: request content is not available for %s", cgiPtr->path);
+        return NS_ERROR;
+    }
+
+    Ns_DStringInit(&ds);
+    for (i = 0u; i < Ns_SetSize(cgiPtr->env); ++i) {
+        const char *key = Ns_SetKey(cgiPtr->env, i), *value = Ns_SetValue(cgiPtr->env, i);
+
+        if (value == NULL) {
+            value = NS_EMPTY_STRING;
+        }
+        FcgiAppendParam(&ds, key, strlen(key), value, strlen(value));
+    }
+
+    /*
+     * An idle connection might turn out to be broken only when sending,
+     * so try a second worker before giving up.
+     */
+    for (attempt = 0; attempt < 2 && status != NS_OK; attempt++) {
+        Worker *workerPtr = FcgiGetWorker(cgiPtr->poolPtr);
+
+        if (workerPtr == NULL) {
+            break;
+        }
+        status = FcgiSendRecord(workerPtr->sock, FCGI_BEGIN_REQUEST, begin, sizeof(begin));
+        if (status == NS_OK) {
+            status = FcgiSendStream(workerPtr->sock, FCGI_PARAMS, ds.string, (size_t)ds.length);
+        }
+        if (status == NS_OK) {
+            if (content != NULL) {
+                status = FcgiSendStream(workerPtr->sock, FCGI_STDIN, content, contentLength);
+            } else {
+                status = FcgiSendFile(workerPtr->sock, Ns_ConnContentFd(conn), contentLength);
+            }
+        }
+        if (status == NS_OK) {
+            workerPtr->nrequests++;
+            cgiPtr->workerPtr = workerPtr;
+        } else {
+            Ns_Log(Warning, "nscgi: sending request to FastCGI worker %ld failed: %s",
+                   (long)workerPtr->pid, strerror(errno));
+            FcgiReleaseWorker(workerPtr, NS_FALSE);
+        }
+    }
+    Ns_DStringFree(&ds);
+
+    return status;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FcgiRecvAll -
+ *
+ *      Receive exactly the requested number of bytes from the worker.
+ *
+ * Results:
+ *      NS_OK or NS_ERROR (including EOF).
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Ns_ReturnCode
+FcgiRecvAll(NS_SOCKET sock, void *buffer, size_t length)
+{
+    char         *p = buffer;
+    Ns_ReturnCode status = NS_OK;
+
+    while (length > 0u) {
+        ssize_t n = ns_recv(sock, p, length, 0);
+
+        if (n > 0) {
+            p += n;
+            length -= (size_t)n;
+        } else if (n < 0 && errno == NS_EINTR) {
+            continue;
+        } else {
+            status = NS_ERROR;
+            break;
+        }
+    }
+    return status;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FcgiRead -
+ *
+ *      Read the next chunk of FCGI_STDOUT content from the worker into
+ *      the CGI buffer. Content of FCGI_STDERR records is written to the
+ *      system log.
+ *
+ * Results:
+ *      Number of bytes read, 0 after FCGI_END_REQUEST or -1 on error.
+ *
+ * Side effects:
+ *      Updates the FastCGI record state of the CGI context.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static ssize_t
+FcgiRead(Cgi *cgiPtr)
+{
+    NS_SOCKET sock;
+    char      padding[256];
+    ssize_t   n = 0;
+
+    NS_NONNULL_ASSERT(cgiPtr != NULL);
+
+    sock = cgiPtr->workerPtr->sock;
+
+    for (;;) {
+        unsigned char header[FCGI_HEADER_LEN];
+        size_t        length, paddingLength;
+
+        if (cgiPtr->fcgiRemain > 0u) {
+            do {
+                n = ns_recv(sock, cgiPtr->buf, MIN(cgiPtr->fcgiRemain, sizeof(cgiPtr->buf)), 0);
+            } while (n < 0 && errno == NS_EINTR);
+
+            if (n <= 0) {
+                n = -1;
+            } else {
+                cgiPtr->ptr = cgiPtr->buf;
+                cgiPtr->cnt = n;
+                cgiPtr->fcgiRemain -= (size_t)n;
+                if (cgiPtr->fcgiRemain == 0u
+                    && FcgiRecvAll(sock, padding, cgiPtr->fcgiPadding) != NS_OK) {
+                    n = -1;
+                }
+            }
+            break;
+        }
+        if (cgiPtr->fcgiDone) {
+            n = 0;
+            break;
+        }
+        if (FcgiRecvAll(sock, header, sizeof(header)) != NS_OK) {
+            n = -1;
+            break;
+        }
+        length = ((size_t)header[4] << 8) | (size_t)header[5];
+        paddingLength = (size_t)header[6];
+
+        if (header[1] == FCGI_STDOUT) {
+            cgiPtr->fcgiRemain = length;
+            cgiPtr->fcgiPadding = paddingLength;
+            if (length == 0u && FcgiRecvAll(sock, padding, paddingLength) != NS_OK) {
+                n = -1;
+                break;
+            }
+
+        } else if (header[1] == FCGI_END_REQUEST && length >= 8u) {
+            unsigned char body[8];
+
+            if (FcgiRecvAll(sock, body, sizeof(body)) != NS_OK
+                || FcgiRecvAll(sock, padding, length - 8u + paddingLength) != NS_OK) {
+                n = -1;
+                break;
+            }
+            cgiPtr->fcgiAppStatus = (int)(((unsigned)body[0] << 24) | ((unsigned)body[1] << 16)
+                                          | ((unsigned)body[2] << 8) | (unsigned)body[3]);
+            cgiPtr->fcgiProtocolStatus = (int)body[4];
+            cgiPtr->fcgiDone = NS_TRUE;
+
+        } else {
+            Ns_DString ds;
+
+            /*
+             * Log FCGI_STDERR content, skip unknown records.
+             */
+            Ns_DStringInit(&ds);
+            Ns_DStringSetLength(&ds, (TCL_SIZE_T)(length + paddingLength));
+            if (FcgiRecvAll(sock, ds.string, length + paddingLength) != NS_OK) {
+                n = -1;
+            } else if (header[1] == FCGI_STDERR && length > 0u) {
+                while (length > 0u && CHARTYPE(space, ds.string[length - 1u]) != 0) {
+                    length--;
+                }
+                Ns_Log(Warning, "nscgi: %s: %.*s", cgiPtr->path, (int)length, ds.string);
+            }
+            Ns_DStringFree(&ds);
+            if (n < 0) {
+                break;
+            }
+        }
+    }
+    if (n < 0) {
+        Ns_Log(Error, "nscgi: reading from FastCGI worker %ld failed",
+               (long)cgiPtr->workerPtr->pid);
+    }
+    return n;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FcgiFinish -
+ *
+ *      Finish the request on the FastCGI worker and return the worker
+ *      to the pool. Output not consumed (e.g. when sending to the
+ *      client failed) is read and discarded, such that the worker can
+ *      be reused.
+ *
+ * Results:
+ *      NS_OK when the worker completed the request with application
+ *      status 0, NS_ERROR otherwise.
+ *
+ * Side effects:
+ *      Worker is released or stopped.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Ns_ReturnCode
+FcgiFinish(Cgi *cgiPtr)
+{
+    Ns_ReturnCode result = NS_OK;
+
+    NS_NONNULL_ASSERT(cgiPtr != NULL);
+
+    while (!cgiPtr->fcgiDone && FcgiRead(cgiPtr) >= 0) {
+        ;
+    }
+    if (!cgiPtr->fcgiDone || cgiPtr->fcgiProtocolStatus != FCGI_REQUEST_COMPLETE) {
+        Ns_Log(Warning, "nscgi: FastCGI worker %ld did not complete the request (protocol status %d)",
+               (long)cgiPtr->workerPtr->pid, cgiPtr->fcgiProtocolStatus);
+        FcgiReleaseWorker(cgiPtr->workerPtr, NS_FALSE);
+        result = NS_ERROR;
+    } else {
+        Ns_Log(Ns_LogCGIDebug, "nscgi: FastCGI worker %ld app status %d",
+               (long)cgiPtr->workerPtr->pid, cgiPtr->fcgiAppStatus);
+        FcgiReleaseWorker(cgiPtr->workerPtr, NS_TRUE);
+        if (cgiPtr->fcgiAppStatus != 0) {
+            result = NS_ERROR;
+        }
+    }
+    cgiPtr->workerPtr = NULL;
+
+    return result;
+}
+#endif
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NextWord -
+ *
+ *      Locate next word in CGI mapping.
+ *
+ * Results:
+ *      Pointer to next word.
+ *
+ * Side effects:
+ *      String is modified in place.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static char    *
+NextWord(char *s)
+{
+    NS_NONNULL_ASSERT(s != NULL);
+
+    while (*s != '\0' && CHARTYPE(space, *s) == 0) {
+        ++s;
+    }
+    if (*s != '\0') {
+        *s++ = '\0';
+        while (CHARTYPE(space, *s) != 0) {
+            ++s;
+        }
+    }
+    return s;
+}
+
+/*----------------------------------------------------------------------
+ *
+ * CgiRegisterFastUrl2File -
+ *
+ *      Helper file for achieving consistent behavior when an FastUrl2File
+ *      handler is registered via the configuration file or via
+ *      NsTclRegisterCGIObjCmd (Tcl command "ns_register_cgi").
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      May register or re-register a mapping.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+CgiRegisterFastUrl2File(const char *server, char *url, const char *path)
+{
+    char *tailSegment;
+
+    NS_NONNULL_ASSERT(server != NULL);
+    NS_NONNULL_ASSERT(url != NULL);
+    NS_NONNULL_ASSERT(path != NULL);
+
+    tailSegment = strrchr(url, INTCHAR('/'));
+    /*
+     * When there is a tail segment and it contains a wildchard character,
+     * strip it away for the mapping. This means, that all files in this
+     * folder are mapped.
+     */
+    if (tailSegment != NULL && strchr(tailSegment, INTCHAR('*')) != NULL) {
+        *tailSegment = '\0';
+        Ns_RegisterFastUrl2File(server, url, path, 0u);
+        *tailSegment = '/';
+    } else {
+        Ns_RegisterFastUrl2File(server, url, path, 0u);
+    }
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CgiRegister -
+ *
+ *      Register a CGI request mapping of the form "method url ?path?
+ *      ?options?".
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      May register or re-register a mapping.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+CgiRegister(Mod *modPtr, const char *map)
+{
+    char           *method;
+    char           *url, *options;
+    const char     *path;
+    Ns_DString      ds1, ds2;
+    Map            *mapPtr;
+
+    NS_NONNULL_ASSERT(modPtr != NULL);
+    NS_NONNULL_ASSERT(map != NULL);
+
+    Ns_DStringInit(&ds1);
+    Ns_DStringInit(&ds2);
+
+    Ns_DStringAppend(&ds1, map);
+    method = ds1.string;
+    url = NextWord(method);
+    if (*method == '\0' || *url == '\0') {
+        Ns_Log(Error, "nscgi: invalid mapping: %s", map);
+        goto done;
+    }
+
+    /*
+     * The optional path might be followed by options, starting with a
+     * dash.
+     */
+    path = NextWord(url);
+    if (*path == '-') {
+        options = (char *)path;
+        path = NS_EMPTY_STRING;
+    } else {
+        options = strstr(path, " -");
+        if (options != NULL) {
+            char *end = options;
+
+            /*
+             * Terminate the path before the whitespace preceding the
+             * options, "options" keeps pointing to the dash.
+             */
+            while (end > path && CHARTYPE(space, *(end - 1)) != 0) {
+                end--;
+            }
+            *end = '\0';
+            options++;
+        }
+    }
+    if (*path == '\0') {
+        path = NULL;
+    } else {
+        path = Ns_NormalizePath(&ds2, path);
+        if (Ns_PathIsAbsolute(path) == NS_FALSE || access(path, R_OK) != 0) {
+            Ns_Log(Error, "nscgi: invalid directory: %s", path);
+            goto done;
+        }
+    }
+
+    mapPtr = CgiMapNew(modPtr, url, path);
+    if (options != NULL && CgiMapOptions(mapPtr, options) != NS_OK) {
+        Ns_Log(Error, "nscgi: invalid mapping options: %s", map);
+        CgiFreeMap(mapPtr);
+        goto done;
+    }
+    Ns_Log(Notice, "nscgi: %s %s%s%s%s", method, url,
+           (path != NULL) ? " -> " : NS_EMPTY_STRING,
+           (path != NULL) ? path : NS_EMPTY_STRING,
+           mapPtr->fastcgi ? " (FastCGI)" : NS_EMPTY_STRING);
+
+    (void) Ns_RegisterRequest2(NULL, modPtr->server, method, url,
+                               CgiRequest, CgiFreeMap, mapPtr, NS_OP_SEGMENT_MATCH);
+    if (path != NULL) {
+        /*
+         * When a path is provided, register it to the Url2File
+         * mappings. These are used for determining the source locations for
+         * static files and CGI programs.
+         */
+        CgiRegisterFastUrl2File(modPtr->server, url, mapPtr->path);
+    }
+
+done:
+    Ns_DStringFree(&ds1);
+    Ns_DStringFree(&ds2);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CgiMapNew -
+ *
+ *      Create a request mapping context with the FastCGI worker
+ *      defaults of the module.
+ *
+ * Results:
+ *      Map pointer.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Map *
+CgiMapNew(Mod *modPtr, const char *url, const char *path)
+{
+    Map *mapPtr;
+
+    NS_NONNULL_ASSERT(modPtr != NULL);
+    NS_NONNULL_ASSERT(url != NULL);
+
+    mapPtr = ns_malloc(sizeof(Map));
+    mapPtr->modPtr = modPtr;
+    mapPtr->url = ns_strdup(url);
+    mapPtr->path = ns_strcopy(path);
+    mapPtr->fastcgi = NS_FALSE;
+    mapPtr->minWorkers = MIN(modPtr->minWorkers, modPtr->maxWorkers);
+    mapPtr->maxWorkers = modPtr->maxWorkers;
+    mapPtr->idleTimeout = modPtr->idleTimeout;
+
+    return mapPtr;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CgiMapOptions -
+ *
+ *      Parse the options of a configured mapping. Supported options are
+ *      "-fastcgi", "-minworkers N", "-maxworkers N" and "-idletimeout
+ *      T", where the latter imply "-fastcgi".
+ *
+ * Results:
+ *      NS_OK or NS_ERROR.
+ *
+ * Side effects:
+ *      Updates the mapping context.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Ns_ReturnCode
+CgiMapOptions(Map *mapPtr, const char *options)
+{
+    TCL_SIZE_T    objc, i;
+    const char  **argv;
+    Ns_ReturnCode status = NS_OK;
+    bool          fastcgi = NS_FALSE;
+
+    NS_NONNULL_ASSERT(mapPtr != NULL);
+    NS_NONNULL_ASSERT(options != NULL);
+
+    if (Tcl_SplitList(NULL, options, &objc, &argv) != TCL_OK) {
+        return NS_ERROR;
+    }
+    for (i = 0; i < objc && status == NS_OK; i++) {
+        const char *option = argv[i], *value = (i + 1 < objc) ? argv[i + 1] : NULL;
+        int         n;
+
+        if (STREQ(option, "-fastcgi")) {
+            fastcgi = NS_TRUE;
+        } else if (value == NULL) {
+            status = NS_ERROR;
+        } else if (STREQ(option, "-minworkers")) {
+            if (Tcl_GetInt(NULL, value, &n) != TCL_OK || n < 0) {
+                status = NS_ERROR;
+            } else {
+                mapPtr->minWorkers = n;
+            }
+            fastcgi = NS_TRUE;
+            i++;
+        } else if (STREQ(option, "-maxworkers")) {
+            if (Tcl_GetInt(NULL, value, &n) != TCL_OK || n < 1) {
+                status = NS_ERROR;
+            } else {
+                mapPtr->maxWorkers = n;
+            }
+            fastcgi = NS_TRUE;
+            i++;
+        } else if (STREQ(option, "-idletimeout")) {
+            if (Ns_GetTimeFromString(NULL, value, &mapPtr->idleTimeout) != TCL_OK) {
+                status = NS_ERROR;
+            }
+            fastcgi = NS_TRUE;
+            i++;
+        } else {
+            status = NS_ERROR;
+        }
+    }
+    Tcl_Free((char *)argv);
+
+    if (mapPtr->minWorkers > mapPtr->maxWorkers) {
+        mapPtr->minWorkers = mapPtr->maxWorkers;
+    }
+    if (fastcgi) {
+#ifdef NS_CGI_FASTCGI
+        mapPtr->fastcgi = NS_TRUE;
+#else
+        Ns_Log(Warning, "nscgi: FastCGI workers are not supported on this platform");
+#endif
+    }
+    return status;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CgiFreeMap -
+ *
+ *      Free a request mapping context.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+CgiFreeMap(void *arg)
+{
+    Map  *mapPtr = (Map *) arg;
+
+    ns_free(mapPtr->url);
+    ns_free(mapPtr->path);
+    ns_free(mapPtr);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SetAppend -
+ *
+ *      Append data to an existing Ns_Set value.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+SetAppend(Ns_Set *set, int index, const char *sep, char *value)
+{
+    Ns_DString ds;
+
+    NS_NONNULL_ASSERT(set != NULL);
+    NS_NONNULL_ASSERT(sep != NULL);
+    NS_NONNULL_ASSERT(value != NULL);
+
+    Ns_DStringInit(&ds);
+    Ns_DStringVarAppend(&ds, Ns_SetValue(set, index),
+                        sep, value, (char *)0L);
+    Ns_SetPutValueSz(set, (size_t)index, ds.string, ds.length);
+    Ns_DStringFree(&ds);
+}
+
+
+/*----------------------------------------------------------------------
+ *
+ * NsTclRegisterCGIObjCmd --
+ *
+ *      Implements "ns_register_cgi".
+ *
+ * Results:
+ *      Return TCL_OK upon success and TCL_ERROR otherwise.
+ *
+ * Side effects:
+ *      Might register CGI handlers.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+NsTclRegisterCGIObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc, Tcl_Obj *const* objv)
+{
+    char       *method, *url, *path = NULL;
+    int         noinherit = 0, matchsegments = 0, fastcgi = 0,
+                minWorkers = -1, maxWorkers = -1, result = TCL_OK;
+    Ns_Time    *idleTimeoutPtr = NULL;
+    Ns_ObjvValueRange minRange = {0, INT_MAX}, maxRange = {1, INT_MAX};
+    Ns_ObjvSpec opts[] = {
+        {"-fastcgi",       Ns_ObjvBool,   &fastcgi,       INT2PTR(NS_TRUE)},
+        {"-idletimeout",   Ns_ObjvTime,   &idleTimeoutPtr, NULL},
+        {"-maxworkers",    Ns_ObjvInt,    &maxWorkers,    &maxRange},
+        {"-minworkers",    Ns_ObjvInt,    &minWorkers,    &minRange},
+        {"-noinherit",     Ns_ObjvBool,   &noinherit,     INT2PTR(NS_OP_NOINHERIT)},
+        {"-matchsegments", Ns_ObjvBool,   &matchsegments, INT2PTR(NS_OP_NOINHERIT)},
+        {"-path",          Ns_ObjvString, &path,          NULL},
+        {"--",             Ns_ObjvBreak,  NULL,           NULL},
+        {NULL, NULL, NULL, NULL}
+    };
+    Ns_ObjvSpec args[] = {
+        {"method",     Ns_ObjvString, &method, NULL},
+        {"url",        Ns_ObjvString, &url,    NULL},
+        {NULL, NULL, NULL, NULL}
+    };
+
+    if (Ns_ParseObjv(opts, args, interp, 1, objc, objv) != NS_OK) {
         result = TCL_ERROR;
     } else {
         Map            *mapPtr;
@@ -1607,13 +3174,30 @@ NsTclRegisterCGIObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T obj
             flags |= NS_OP_SEGMENT_MATCH;
         }
 
-        mapPtr = ns_malloc(sizeof(Map));
-        mapPtr->modPtr = modPtr;
-        mapPtr->url = ns_strdup(url);
-        mapPtr->path = ns_strcopy(path);
-        Ns_Log(Notice, "nscgi: %s %s%s%s", method, url,
+        mapPtr = CgiMapNew(modPtr, url, path);
+        if (fastcgi != 0 || minWorkers >= 0 || maxWorkers > 0 || idleTimeoutPtr != NULL) {
+#ifdef NS_CGI_FASTCGI
+            mapPtr->fastcgi = NS_TRUE;
+#else
+            Ns_Log(Warning, "nscgi: FastCGI workers are not supported on this platform");
+#endif
+        }
+        if (minWorkers >= 0) {
+            mapPtr->minWorkers = minWorkers;
+        }
+        if (maxWorkers > 0) {
+            mapPtr->maxWorkers = maxWorkers;
+        }
+        if (idleTimeoutPtr != NULL) {
+            mapPtr->idleTimeout = *idleTimeoutPtr;
+        }
+        if (mapPtr->minWorkers > mapPtr->maxWorkers) {
+            mapPtr->minWorkers = mapPtr->maxWorkers;
+        }
+        Ns_Log(Notice, "nscgi: %s %s%s%s%s", method, url,
                (path != NULL) ? " -> " : NS_EMPTY_STRING,
-               (path != NULL) ? path : NS_EMPTY_STRING);
+               (path != NULL) ? path : NS_EMPTY_STRING,
+               mapPtr->fastcgi ? " (FastCGI)" : NS_EMPTY_STRING);
 
         result = Ns_RegisterRequest2(interp, modPtr->server, method, url,
                                      CgiRequest, CgiFreeMap, mapPtr, flags);
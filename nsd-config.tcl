@@ -195,6 +195,9 @@ ns_section ns/fastpath {
     ns_param    brotli_refresh      true       ;# refresh stale .br files on the fly using ::ns_brotlifile
     ns_param    brotli_cmd          "/usr/bin/brotli -f -Z"  ;# use for re-compressing
     #ns_param   brotli_cmd          "/opt/local/bin/brotli -f -Z"  ;# use for re-compressing (macOS + ports)
+    #ns_param   refresh_async       true       ;# refresh stale files in the background; default: false
+    #ns_param   compress_queuesize  100        ;# max. files waiting for background compression; default: 100
+    #ns_param   compress_threads    2          ;# max. background compression threads; default: 2
 }
 
 ns_section ns/servers {
@@ -331,6 +334,10 @@ if {[info exists httpsport] && $httpsport ne ""} {
         #
         # SSL/TLS parameters
         #
+        #ns_param ktls          true    ;# false; kernel TLS offload, file delivery via SSL_sendfile() (Linux "tls" module, OpenSSL 3)
+        #ns_param ticketkeyfile   /usr/local/ns/etc/ticket.key  ;# session ticket keys (80 bytes each), shared between processes
+        #ns_param ticketkeyrotate 1h      ;# 1h; interval for reloading the ticket keys and purging the session cache
+        #ns_param sessioncachedir /dev/shm/ns-tls-sessions      ;# external session cache, shared between processes
         ns_param ciphers	"ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256:ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384:ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-CHACHA20-POLY1305:DHE-RSA-AES128-GCM-SHA256:DHE-RSA-AES256-GCM-SHA384:DHE-RSA-CHACHA20-POLY1305"
         #ns_param ciphersuites  "TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384:TLS_CHACHA20_POLY1305_SHA256"
         ns_param protocols	"!SSLv2:!SSLv3:!TLSv1.0:!TLSv1.1"
@@ -392,6 +399,13 @@ ns_section ns/server/default {
     #ns_param    connectionratelimit 200  ;# 0; limit rate per connection to this amount (KB/s); 0 means unlimited
     #ns_param    poolratelimit       200  ;# 0; limit rate for pool to this amount (KB/s); 0 means unlimited
 
+    # On-the-fly compression of responses (ns_return, ADP, streaming)
+    #ns_param   compressenable      on    ;# default: false; use "ns_conn compress" to override
+    #ns_param   compressformats     {br zstd gzip} ;# default: gzip; in order of preference, when compiled in
+    #ns_param   compressbrotlilevel 4     ;# default: 4; 1-11
+    #ns_param   compresszstdlevel   3     ;# default: 3; 1-19
+    #ns_param   compresscachesize   10MB  ;# default: 0; cache compressed variants of responses with strong ETag or cache key
+
     # Extra server-specific response header fields
     #ns_param   extraheaders  {Referrer-Policy "strict-origin"}
 }
@@ -410,6 +424,8 @@ ns_section ns/server/default/fastpath {
     #ns_param   directoryproc       _ns_dirlist
     ns_param    directorylisting    fancy    ;# default: simple; parameter for _ns_dirlist
     #ns_param   hidedotfiles        true     ;# default: false; parameter for _ns_dirlist
+    #ns_param   precompress         true     ;# default: false; compress pagedir files at startup
+    #ns_param   precompress_extensions ".html .htm .css .js .mjs .json .svg .txt .xml"
 }
 
 ns_section ns/server/default/vhost {
@@ -448,6 +464,10 @@ ns_section ns/server/default/module/nscgi {
     ns_param    map                 "POST /cgi-bin $home/cgi-bin"
     ns_param    interps              CGIinterps
     #ns_param   allowstaticresources true    ;# default false; serve static resources from cgi directories
+    #ns_param   splice               true    ;# default false; splice large CGI output to the socket (Linux)
+    #ns_param   maxworkers           4       ;# default 4; max. persistent FastCGI workers per program
+    #ns_param   idletimeout          5m      ;# default 5m; stop idle FastCGI workers after this time
+    #ns_param   map                 "GET /fcgi/*.php -fastcgi -maxworkers 8" ;# serve via persistent FastCGI workers
 }
 
 ns_section ns/interps/CGIinterps {
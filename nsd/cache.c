@@ -20,6 +20,16 @@
 
 struct Cache;
 
+/*
+ * Depth of the count-min sketch used by the TinyLFU admission filter, the
+ * initial and maximum number of counters per row and the saturation value
+ * of a single counter.
+ */
+#define SKETCH_DEPTH      4
+#define SKETCH_MIN_WIDTH  1024u
+#define SKETCH_MAX_WIDTH  (1u << 20)
+#define SKETCH_MAX_COUNT  15u
+
 /*
  * An Entry is a node in a linked list as well as being a
  * hash table entry. The linked list is there to keep track of
@@ -35,6 +45,8 @@ typedef struct Entry {
     size_t          size;
     int             cost;             /* cost to compute a single entry */
     size_t          count;            /* reuse count of this entry */
+    bool            referenced;       /* CLOCK reference bit */
+    bool            rejected;         /* TinyLFU: entry was not admitted */
     void           *value;            /* Will appear NULL for concurrent updates. */
     void           *uncommittedValue; /* Used for transactional mode */
     uintptr_t       transactionEpoch; /* Used for identifying transaction */
@@ -56,6 +68,12 @@ typedef struct Cache {
     Tcl_HashTable  entriesTable;
     uintptr_t      transactionEpoch;
     Tcl_HashTable  uncommittedTable;
+    Ns_CachePolicy policy;
+    struct {
+        uint8_t        *counters;  /* SKETCH_DEPTH rows of width counters. */
+        size_t          width;     /* Number of counters per row, power of 2. */
+        size_t          samples;   /* Increments since the last aging. */
+    } sketch;
     struct {
         unsigned long   nhit;      /* Successful gets. */
         unsigned long   nmiss;     /* Unsuccessful gets. */
@@ -64,6 +82,9 @@ typedef struct Cache {
         unsigned long   npruned;   /* Evictions due to size constraint. */
         unsigned long   ncommit;   /* number of commits. */
         unsigned long   nrollback; /* number of rollback operations. */
+        unsigned long   nreprieved;/* CLOCK: second chances given during eviction. */
+        unsigned long   nadmitted; /* TinyLFU: new entries admitted by evicting others. */
+        unsigned long   nrejected; /* TinyLFU: new entries rejected by the filter. */
     } stats;
 
     char name[1];
@@ -84,6 +105,29 @@ static void Remove(Entry *ePtr)
 static void Push(Entry *ePtr)
     NS_GNUC_NONNULL(1);
 
+static void Append(Entry *ePtr)
+    NS_GNUC_NONNULL(1);
+
+static void Touch(Entry *ePtr)
+    NS_GNUC_NONNULL(1);
+
+static Entry *CreateEntry(Cache *cachePtr, const char *key, int *newPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(3);
+
+static bool Prune(Cache *cachePtr, Entry *ePtr, size_t maxSize)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+
+static uint32_t KeyHash(const Cache *cachePtr, const char *key)
+    NS_GNUC_NONNULL(1) NS_GNUC_PURE;
+
+static void SketchIncrement(Cache *cachePtr, uint32_t hash)
+    NS_GNUC_NONNULL(1);
+
+static unsigned int SketchFrequency(const Cache *cachePtr, uint32_t hash)
+    NS_GNUC_NONNULL(1) NS_GNUC_PURE;
+
+static const char *const policyNames[] = {"lru", "clock", "tinylfu"};
+
 static unsigned long
 CacheTransaction(Cache *cachePtr, uintptr_t epoch, bool commit)
     NS_GNUC_NONNULL(1);
@@ -129,6 +173,7 @@ Ns_CacheCreateSz(const char *name, int keys, size_t maxSize, Ns_FreeProc *freePr
     cachePtr->stats.npruned   = 0u;
     cachePtr->stats.ncommit   = 0u;
     cachePtr->stats.nrollback = 0u;
+    cachePtr->policy          = NS_CACHE_LRU;
 
     Ns_MutexInit(&cachePtr->lock);
     Ns_MutexSetName2(&cachePtr->lock, "ns:cache", name);
@@ -169,6 +214,9 @@ Ns_CacheDestroy(Ns_Cache *cache)
     Ns_CondDestroy(&cachePtr->cond);
     Tcl_DeleteHashTable(&cachePtr->entriesTable);
     Tcl_DeleteHashTable(&cachePtr->uncommittedTable);
+    if (cachePtr->sketch.counters != NULL) {
+        ns_free(cachePtr->sketch.counters);
+    }
     ns_free(cachePtr);
 }
 
@@ -185,7 +233,8 @@ Ns_CacheDestroy(Ns_Cache *cache)
  *      not exist or the entry has expired.
  *
  * Side effects:
- *      A valid entry will move to the top of the LRU list.
+ *      A valid entry will move to the top of the LRU list (or gets its
+ *      reference bit set for CLOCK caches).
  *
  *----------------------------------------------------------------------
  */
@@ -246,10 +295,17 @@ Ns_CacheFindEntryT(Ns_Cache *cache, const char *key, const Ns_CacheTransactionSt
                  * Entry is valid.
                  */
                 ++cachePtr->stats.nhit;
-                Remove(ePtr);
                 ePtr->count ++;
-                Push(ePtr);
+                Touch(ePtr);
                 result = (Ns_Entry *) ePtr;
+                if (cachePtr->policy == NS_CACHE_TINYLFU) {
+                    /*
+                     * Misses are recorded when the entry is created,
+                     * such that a lookup followed by the creation of
+                     * the entry counts as a single access.
+                     */
+                    SketchIncrement(cachePtr, KeyHash(cachePtr, key));
+                }
             }
         }
     }
@@ -260,10 +316,11 @@ Ns_CacheFindEntryT(Ns_Cache *cache, const char *key, const Ns_CacheTransactionSt
 /*
  *----------------------------------------------------------------------
  *
- * Ns_CacheCreateEntry --
+ * Ns_CacheCreateEntry, CreateEntry --
  *
  *      Create a new cache entry or return an existing one with the
- *      given key.
+ *      given key. For TinyLFU caches, Ns_CacheCreateEntry() records
+ *      the access in the frequency sketch, CreateEntry() does not.
  *
  * Results:
  *      A pointer to a cache entry.
@@ -277,12 +334,34 @@ Ns_CacheFindEntryT(Ns_Cache *cache, const char *key, const Ns_CacheTransactionSt
 Ns_Entry *
 Ns_CacheCreateEntry(Ns_Cache *cache, const char *key, int *newPtr)
 {
-    Cache         *cachePtr = (Cache *) cache;
+    Cache *cachePtr = (Cache *) cache;
+    Entry *ePtr;
+
+    NS_NONNULL_ASSERT(cache != NULL);
+    NS_NONNULL_ASSERT(key != NULL);
+    NS_NONNULL_ASSERT(newPtr != NULL);
+
+    ePtr = CreateEntry(cachePtr, key, newPtr);
+    if (cachePtr->policy == NS_CACHE_TINYLFU
+        && (*newPtr != 0 || ePtr->value != NULL)) {
+        /*
+         * Entries without a value are being created by another call,
+         * which has recorded the access already.
+         */
+        SketchIncrement(cachePtr, KeyHash(cachePtr, key));
+    }
+
+    return (Ns_Entry *) ePtr;
+}
+
+static Entry *
+CreateEntry(Cache *cachePtr, const char *key, int *newPtr)
+{
     Tcl_HashEntry *hPtr;
     Entry         *ePtr;
     int            isNew;
 
-    NS_NONNULL_ASSERT(cache != NULL);
+    NS_NONNULL_ASSERT(cachePtr != NULL);
     NS_NONNULL_ASSERT(key != NULL);
     NS_NONNULL_ASSERT(newPtr != NULL);
 
@@ -294,22 +373,25 @@ Ns_CacheCreateEntry(Ns_Cache *cache, const char *key, int *newPtr)
         Tcl_SetHashValue(hPtr, ePtr);
         cachePtr->currentSize += (sizeof(Entry) + sizeof(Tcl_HashEntry) + strlen(key));
         ++cachePtr->stats.nmiss;
+        Push(ePtr);
     } else {
         ePtr = Tcl_GetHashValue(hPtr);
         if (Expired(ePtr, NULL)) {
             ++cachePtr->stats.nexpired;
             Ns_CacheUnsetValue((Ns_Entry *) ePtr);
             isNew = 1;
+            ePtr->referenced = NS_FALSE;
+            Remove(ePtr);
+            Push(ePtr);
         } else {
             ePtr->count ++;
             ++cachePtr->stats.nhit;
+            Touch(ePtr);
         }
-        Remove(ePtr);
     }
-    Push(ePtr);
     *newPtr = isNew;
 
-    return (Ns_Entry *) ePtr;
+    return ePtr;
 }
 
 
@@ -341,6 +423,7 @@ Ns_Entry *
 Ns_CacheWaitCreateEntryT(Ns_Cache *cache, const char *key, int *newPtr,
                         const Ns_Time *timeoutPtr, const Ns_CacheTransactionStack *transactionStackPtr)
 {
+    Cache         *cachePtr = (Cache *) cache;
     Ns_Entry      *entry;
     int            isNew;
     Ns_ReturnCode  status = NS_OK;
@@ -349,7 +432,13 @@ Ns_CacheWaitCreateEntryT(Ns_Cache *cache, const char *key, int *newPtr,
     NS_NONNULL_ASSERT(key != NULL);
     NS_NONNULL_ASSERT(newPtr != NULL);
 
-    entry = Ns_CacheCreateEntry(cache, key, &isNew);
+    if (cachePtr->policy == NS_CACHE_TINYLFU) {
+        /*
+         * Record the access once, independent of the number of retries.
+         */
+        SketchIncrement(cachePtr, KeyHash(cachePtr, key));
+    }
+    entry = (Ns_Entry *) CreateEntry(cachePtr, key, &isNew);
 
     if (isNew == 0 && Ns_CacheGetValueT(entry, transactionStackPtr) == NULL) {
         /*
@@ -359,18 +448,18 @@ Ns_CacheWaitCreateEntryT(Ns_Cache *cache, const char *key, int *newPtr,
         do {
             if (timeoutPtr == NULL) {
                 Ns_Log(Notice, "ns_cache create entry collision cache %s key '%s', no timeout",
-                       ((Cache*)cache)->name, key);
+                       cachePtr->name, key);
             } else {
                 Ns_Time  relTime, *relTimePtr;
 
                 relTimePtr =  Ns_RelativeTime(&relTime, (Ns_Time *)timeoutPtr);
                 Ns_Log(Notice, "ns_cache create entry collision cache %s key '%s', timeout " NS_TIME_FMT,
-                       ((Cache*)cache)->name, key,
+                       cachePtr->name, key,
                        (int64_t)relTimePtr->sec, relTimePtr->usec);
             }
             status = Ns_CacheTimedWait(cache, timeoutPtr);
 
-            entry = Ns_CacheCreateEntry(cache, key, &isNew);
+            entry = (Ns_Entry *) CreateEntry(cachePtr, key, &isNew);
         } while (status == NS_OK
                  && isNew == 0
                  && Ns_CacheGetValueT(entry, transactionStackPtr) == NULL);
@@ -582,7 +671,9 @@ Ns_CacheGetNrUncommittedEntries(const Ns_Cache *cache)
  *      None.
  *
  * Side effects:
- *      Cache pruning and freeing of old contents may occur.
+ *      Cache pruning and freeing of old contents may occur. For TinyLFU
+ *      caches, an entry rejected by the admission filter is deleted,
+ *      such that the entry must not be used after the call.
  *
  *----------------------------------------------------------------------
  */
@@ -639,6 +730,7 @@ Ns_CacheSetValueExpires(Ns_Entry *entry, void *value, size_t size,
     ePtr->size = size;
     ePtr->cost = cost;
     ePtr->count = 1;
+    ePtr->referenced = NS_FALSE;
 
     if (timeoutPtr != NULL) {
         ePtr->expires = *timeoutPtr;
@@ -657,21 +749,17 @@ Ns_CacheSetValueExpires(Ns_Entry *entry, void *value, size_t size,
         cachePtr->maxSize = maxSize;
     }
 
-    if (maxSize > 0u) {
+    if (maxSize > 0u
+        && cachePtr->currentSize > maxSize
+        && !Prune(cachePtr, ePtr, maxSize)
+        && transactionEpoch == 0u) {
         /*
-         * Make space for the new entry, but don't delete the current
-         * entry, and don't delete other newborn entries (with a value
-         * of NULL) of some other threads which are concurrently
-         * created.  There might be concurrent updates, since
-         * e.g. nscache_eval releases its mutex.
+         * The TinyLFU admission filter rejected the new entry. Evict it
+         * right away instead of keeping the cache above its maximum
+         * size. Uncommitted entries are kept until the transaction
+         * ends and are evicted by the next pruning.
          */
-        while (cachePtr->currentSize > maxSize
-               && cachePtr->lastEntryPtr != ePtr
-               && cachePtr->lastEntryPtr->value != NULL
-               ) {
-            Ns_CacheDeleteEntry((Ns_Entry *) cachePtr->lastEntryPtr);
-            ++cachePtr->stats.npruned;
-        }
+        Ns_CacheDeleteEntry(entry);
     }
     return result;
 }
@@ -1231,38 +1319,100 @@ Ns_CacheBroadcast(Ns_Cache *cache)
 char *
 Ns_CacheStats(Ns_Cache *cache, Ns_DString *dest)
 {
-    const Cache    *cachePtr;
-    unsigned long   count;
-    const Entry    *ePtr;
-    Ns_CacheSearch  search;
-    double          savedCost = 0.0, hitrate;
-
     NS_NONNULL_ASSERT(cache != NULL);
     NS_NONNULL_ASSERT(dest != NULL);
 
-    cachePtr = (Cache *)cache;
-    count = cachePtr->stats.nhit + cachePtr->stats.nmiss;
-    hitrate = ((count != 0u) ? ((double)cachePtr->stats.nhit * 100.0) / (double)count : 0.0);
+    return NsCacheStats(&cache, 1, dest);
+}
 
-    ePtr = (Entry *)Ns_CacheFirstEntry(cache, &search);
-    while (ePtr != NULL) {
-        savedCost += ((double)ePtr->count * (double)ePtr->cost) / 1000000.0;
-        ePtr = (Entry *)Ns_CacheNextEntry(&search);
-    }
 
-    return Ns_DStringPrintf(dest, "maxsize %lu size %lu entries %" PRITcl_Size
-               " flushed %lu hits %lu missed %lu hitrate %.2f"
-               " expired %lu pruned %lu commit %lu rollback %lu saved %.6f",
-               (unsigned long) cachePtr->maxSize,
-               (unsigned long) cachePtr->currentSize,
-               cachePtr->entriesTable.numEntries, cachePtr->stats.nflushed,
-               cachePtr->stats.nhit, cachePtr->stats.nmiss, hitrate,
-                            cachePtr->stats.nexpired, cachePtr->stats.npruned,
-                            cachePtr->stats.ncommit, cachePtr->stats.nrollback,
-                            savedCost);
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsCacheStats --
+ *
+ *      Append the accumulated statistics of several caches (e.g. the shards
+ *      of a sharded Tcl cache) to Tcl_DString. All caches have to be locked
+ *      by the caller.
+ *
+ * Results:
+ *      Pointer to current string value.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+char *
+NsCacheStats(Ns_Cache *const* caches, int nCaches, Ns_DString *dest)
+{
+    unsigned long   count, nhit = 0u, nmiss = 0u, nexpired = 0u, nflushed = 0u,
+                    npruned = 0u, ncommit = 0u, nrollback = 0u,
+                    nreprieved = 0u, nadmitted = 0u, nrejected = 0u;
+    size_t          maxSize = 0u, currentSize = 0u;
+    TCL_SIZE_T      nEntries = 0;
+    double          savedCost = 0.0, hitrate;
+    int             i;
+    Ns_CachePolicy  policy;
+
+    NS_NONNULL_ASSERT(caches != NULL);
+    NS_NONNULL_ASSERT(dest != NULL);
+
+    policy = (nCaches > 0) ? ((const Cache *)caches[0])->policy : NS_CACHE_LRU;
+
+    for (i = 0; i < nCaches; i++) {
+        const Cache    *cachePtr = (const Cache *)caches[i];
+        const Entry    *ePtr;
+        Ns_CacheSearch  search;
+
+        maxSize     += cachePtr->maxSize;
+        currentSize += cachePtr->currentSize;
+        nEntries    += cachePtr->entriesTable.numEntries;
+        nhit        += cachePtr->stats.nhit;
+        nmiss       += cachePtr->stats.nmiss;
+        nexpired    += cachePtr->stats.nexpired;
+        nflushed    += cachePtr->stats.nflushed;
+        npruned     += cachePtr->stats.npruned;
+        ncommit     += cachePtr->stats.ncommit;
+        nrollback   += cachePtr->stats.nrollback;
+        nreprieved  += cachePtr->stats.nreprieved;
+        nadmitted   += cachePtr->stats.nadmitted;
+        nrejected   += cachePtr->stats.nrejected;
+
+        ePtr = (Entry *)Ns_CacheFirstEntry(caches[i], &search);
+        while (ePtr != NULL) {
+            savedCost += ((double)ePtr->count * (double)ePtr->cost) / 1000000.0;
+            ePtr = (Entry *)Ns_CacheNextEntry(&search);
+        }
+    }
+    count = nhit + nmiss;
+    hitrate = ((count != 0u) ? ((double)nhit * 100.0) / (double)count : 0.0);
+
+    Ns_DStringPrintf(dest, "maxsize %lu size %lu entries %" PRITcl_Size
+                     " flushed %lu hits %lu missed %lu hitrate %.2f"
+                     " expired %lu pruned %lu commit %lu rollback %lu saved %.6f"
+                     " policy %s",
+                     (unsigned long) maxSize,
+                     (unsigned long) currentSize,
+                     nEntries, nflushed,
+                     nhit, nmiss, hitrate,
+                     nexpired, npruned,
+                     ncommit, nrollback,
+                     savedCost,
+                     policyNames[policy]);
+    /*
+     * Add the counters specific to the eviction policy.
+     */
+    if (policy == NS_CACHE_CLOCK) {
+        Ns_DStringPrintf(dest, " reprieved %lu", nreprieved);
+    } else if (policy == NS_CACHE_TINYLFU) {
+        Ns_DStringPrintf(dest, " admitted %lu rejected %lu", nadmitted, nrejected);
+    }
+    return dest->string;
 }
 
-
+
 /*
  *----------------------------------------------------------------------
  *
@@ -1322,6 +1472,56 @@ Ns_CacheGetMaxSize(const Ns_Cache *cache)
 }
 
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * Ns_CacheSetPolicy, Ns_CacheGetPolicy --
+ *
+ *      Set/get the eviction policy of the specified cache. The policy can
+ *      be changed at any time, the existing entries are kept. Changing to
+ *      NS_CACHE_TINYLFU starts with an empty frequency sketch.
+ *
+ * Results:
+ *      Ns_CacheGetPolicy() returns the policy.
+ *
+ * Side effects:
+ *      Allocates or frees the frequency sketch of the TinyLFU admission
+ *      filter.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+Ns_CacheSetPolicy(Ns_Cache *cache, Ns_CachePolicy policy)
+{
+    Cache *cachePtr = (Cache *) cache;
+
+    NS_NONNULL_ASSERT(cache != NULL);
+
+    if (policy != cachePtr->policy) {
+        if (policy == NS_CACHE_TINYLFU) {
+            cachePtr->sketch.width = SKETCH_MIN_WIDTH;
+            cachePtr->sketch.samples = 0u;
+            cachePtr->sketch.counters = ns_calloc(SKETCH_DEPTH * cachePtr->sketch.width,
+                                                  sizeof(uint8_t));
+        } else if (cachePtr->sketch.counters != NULL) {
+            ns_free(cachePtr->sketch.counters);
+            cachePtr->sketch.counters = NULL;
+            cachePtr->sketch.width = 0u;
+        }
+        cachePtr->policy = policy;
+    }
+}
+
+Ns_CachePolicy
+Ns_CacheGetPolicy(const Ns_Cache *cache)
+{
+    NS_NONNULL_ASSERT(cache != NULL);
+
+    return ((const Cache *) cache)->policy;
+}
+
+
 
 /*
  *----------------------------------------------------------------------
@@ -1431,6 +1631,303 @@ Push(Entry *ePtr)
 }
 
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * Append --
+ *
+ *      Append an entry to the end of the linked list of entries, making
+ *      it the next candidate for eviction.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+Append(Entry *ePtr)
+{
+    NS_NONNULL_ASSERT(ePtr != NULL);
+
+    if (likely(ePtr->cachePtr->lastEntryPtr != NULL)) {
+        ePtr->cachePtr->lastEntryPtr->nextPtr = ePtr;
+    }
+    ePtr->nextPtr = NULL;
+    ePtr->prevPtr = ePtr->cachePtr->lastEntryPtr;
+    ePtr->cachePtr->lastEntryPtr = ePtr;
+    if (unlikely(ePtr->cachePtr->firstEntryPtr == NULL)) {
+        ePtr->cachePtr->firstEntryPtr = ePtr;
+    }
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Touch --
+ *
+ *      Record a hit on an entry according to the eviction policy of the
+ *      cache. For CLOCK caches, just the reference bit is set, avoiding
+ *      the relinking of the entry in the list.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Entry might be moved to the top of the list.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+Touch(Entry *ePtr)
+{
+    NS_NONNULL_ASSERT(ePtr != NULL);
+
+    ePtr->rejected = NS_FALSE;
+    if (ePtr->cachePtr->policy == NS_CACHE_CLOCK) {
+        ePtr->referenced = NS_TRUE;
+    } else if (ePtr->cachePtr->firstEntryPtr != ePtr) {
+        Remove(ePtr);
+        Push(ePtr);
+    }
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Prune --
+ *
+ *      Evict entries from the end of the list until the cache is below
+ *      maxSize. The current entry (ePtr) and other newborn entries (with
+ *      a value of NULL) of other threads, which are concurrently created,
+ *      are not deleted. There might be concurrent updates, since
+ *      e.g. ns_cache_eval releases its mutex.
+ *
+ *      For CLOCK caches, entries with the reference bit set get a second
+ *      chance and are moved to the top of the list. For TinyLFU caches,
+ *      the new entry is admitted only when its estimated access frequency
+ *      is higher than the one of the eviction victim. Otherwise, the new
+ *      entry is moved to the end of the list and marked as rejected, such
+ *      that it will be evicted without further checks on the next
+ *      pruning, unless the caller evicts it right away.
+ *
+ * Results:
+ *      NS_FALSE, when the new entry was rejected, NS_TRUE otherwise.
+ *
+ * Side effects:
+ *      Entries are deleted, the cache might remain above maxSize when
+ *      the new entry was rejected.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static bool
+Prune(Cache *cachePtr, Entry *ePtr, size_t maxSize)
+{
+    unsigned int candidateFrequency = 0u;
+    bool         admitted = NS_FALSE, rejected = NS_FALSE;
+
+    NS_NONNULL_ASSERT(cachePtr != NULL);
+    NS_NONNULL_ASSERT(ePtr != NULL);
+
+    if (cachePtr->policy == NS_CACHE_TINYLFU) {
+        candidateFrequency = SketchFrequency(cachePtr, KeyHash(cachePtr, Ns_CacheKey((Ns_Entry *)ePtr)));
+    }
+
+    while (cachePtr->currentSize > maxSize) {
+        Entry *victimPtr = cachePtr->lastEntryPtr;
+
+        if (victimPtr == ePtr
+            && cachePtr->policy == NS_CACHE_CLOCK
+            && ePtr->prevPtr != NULL) {
+            /*
+             * All older entries got a second chance, continue behind the
+             * new entry.
+             */
+            Remove(ePtr);
+            Push(ePtr);
+            victimPtr = cachePtr->lastEntryPtr;
+        }
+        if (victimPtr == ePtr || victimPtr->value == NULL) {
+            break;
+        }
+
+        if (cachePtr->policy == NS_CACHE_CLOCK && victimPtr->referenced) {
+            victimPtr->referenced = NS_FALSE;
+            Remove(victimPtr);
+            Push(victimPtr);
+            ++cachePtr->stats.nreprieved;
+            continue;
+
+        } else if (cachePtr->policy == NS_CACHE_TINYLFU && !victimPtr->rejected) {
+            unsigned int victimFrequency;
+
+            victimFrequency = SketchFrequency(cachePtr,
+                                              KeyHash(cachePtr, Ns_CacheKey((Ns_Entry *)victimPtr)));
+            if (candidateFrequency <= victimFrequency) {
+                ePtr->rejected = NS_TRUE;
+                Remove(ePtr);
+                Append(ePtr);
+                ++cachePtr->stats.nrejected;
+                rejected = NS_TRUE;
+                break;
+            }
+            if (!admitted) {
+                admitted = NS_TRUE;
+                ++cachePtr->stats.nadmitted;
+            }
+        }
+        Ns_CacheDeleteEntry((Ns_Entry *) victimPtr);
+        ++cachePtr->stats.npruned;
+    }
+    return !rejected;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * KeyHash --
+ *
+ *      Compute a 32-bit hash value (FNV-1a) of a cache key for the
+ *      frequency sketch. The key representation depends on the key type
+ *      of the cache, as for Tcl hash tables.
+ *
+ * Results:
+ *      Hash value.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static uint32_t
+KeyHash(const Cache *cachePtr, const char *key)
+{
+    uint32_t hash = 2166136261u;
+
+    NS_NONNULL_ASSERT(cachePtr != NULL);
+    NS_NONNULL_ASSERT(key != NULL);
+
+    if (cachePtr->keys == TCL_STRING_KEYS) {
+        while (*key != '\0') {
+            hash ^= (uint32_t)UCHAR(*key++);
+            hash *= 16777619u;
+        }
+    } else {
+        const unsigned char *p;
+        size_t               i, length;
+        uintptr_t            word;
+
+        if (cachePtr->keys == TCL_ONE_WORD_KEYS) {
+            word = (uintptr_t)key;
+            p = (const unsigned char *)&word;
+            length = sizeof(word);
+        } else {
+            p = (const unsigned char *)key;
+            length = (size_t)cachePtr->keys * sizeof(int);
+        }
+        for (i = 0u; i < length; i++) {
+            hash ^= (uint32_t)p[i];
+            hash *= 16777619u;
+        }
+    }
+    return hash;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SketchIncrement, SketchFrequency --
+ *
+ *      Maintain the count-min sketch of the TinyLFU admission filter.
+ *      SketchIncrement() records an access of the key with the provided
+ *      hash value, SketchFrequency() returns the estimated number of
+ *      accesses (0..SKETCH_MAX_COUNT).
+ *
+ *      The sketch is aged by halving all counters, whenever the number of
+ *      recorded accesses reaches 10 times the width of the sketch, such
+ *      that the frequencies reflect recent history. The width grows with
+ *      the number of cache entries (which resets the history).
+ *
+ * Results:
+ *      SketchFrequency() returns the estimated frequency.
+ *
+ * Side effects:
+ *      Counters are updated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+SketchIncrement(Cache *cachePtr, uint32_t hash)
+{
+    uint32_t h2;
+    size_t   mask;
+    int      i;
+
+    NS_NONNULL_ASSERT(cachePtr != NULL);
+
+    if ((size_t)cachePtr->entriesTable.numEntries > cachePtr->sketch.width
+        && cachePtr->sketch.width < SKETCH_MAX_WIDTH) {
+        ns_free(cachePtr->sketch.counters);
+        cachePtr->sketch.width *= 2u;
+        cachePtr->sketch.samples = 0u;
+        cachePtr->sketch.counters = ns_calloc(SKETCH_DEPTH * cachePtr->sketch.width,
+                                              sizeof(uint8_t));
+    }
+
+    mask = cachePtr->sketch.width - 1u;
+    h2 = (hash >> 17) | (hash << 15) | 1u;
+    for (i = 0; i < SKETCH_DEPTH; i++) {
+        uint8_t *counterPtr = &cachePtr->sketch.counters[(size_t)i * cachePtr->sketch.width
+                                                         + ((hash + (uint32_t)i * h2) & mask)];
+        if (*counterPtr < SKETCH_MAX_COUNT) {
+            (*counterPtr)++;
+        }
+    }
+
+    if (++cachePtr->sketch.samples >= 10u * cachePtr->sketch.width) {
+        size_t j;
+
+        for (j = 0u; j < SKETCH_DEPTH * cachePtr->sketch.width; j++) {
+            cachePtr->sketch.counters[j] >>= 1;
+        }
+        cachePtr->sketch.samples /= 2u;
+    }
+}
+
+static unsigned int
+SketchFrequency(const Cache *cachePtr, uint32_t hash)
+{
+    uint32_t     h2;
+    size_t       mask;
+    unsigned int frequency = SKETCH_MAX_COUNT;
+    int          i;
+
+    NS_NONNULL_ASSERT(cachePtr != NULL);
+
+    mask = cachePtr->sketch.width - 1u;
+    h2 = (hash >> 17) | (hash << 15) | 1u;
+    for (i = 0; i < SKETCH_DEPTH; i++) {
+        unsigned int count = cachePtr->sketch.counters[(size_t)i * cachePtr->sketch.width
+                                                       + ((hash + (uint32_t)i * h2) & mask)];
+        if (count < frequency) {
+            frequency = count;
+        }
+    }
+    return frequency;
+}
+
+
 /*
  * Local Variables:
  * mode: c
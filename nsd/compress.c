@@ -12,20 +12,52 @@
 /*
  * compress.c --
  *
- *      Support for gzip compression using Zlib.
+ *      Support for gzip compression using Zlib and, when available, for
+ *      brotli and Zstandard compression of response streams.
  */
 
 #include "nsd.h"
 
-#ifdef HAVE_ZLIB_H
+#ifdef HAVE_BROTLI_ENCODE_H
+# include <brotli/encode.h>
+#endif
+#ifdef HAVE_ZSTD_H
+# include <zstd.h>
+#endif
 
-# define COMPRESS_SENT_HEADER 0x01u
+#define COMPRESS_SENT_HEADER 0x01u
 
+/*
+ * Content-coding tokens of the supported formats, indexed by
+ * Ns_CompressFormat.
+ */
+static const char *const compressFormatNames[NS_COMPRESS_NR_FORMATS] = {
+    "gzip", "br", "zstd"
+};
 
 /*
  * Static functions defined in this file.
  */
 
+static void CodecStateFree(Ns_CompressStream *cStream)
+    NS_GNUC_NONNULL(1);
+
+#ifdef HAVE_BROTLI_ENCODE_H
+static Ns_ReturnCode CompressBufsBrotli(Ns_CompressStream *cStream, struct iovec *bufs, int nbufs,
+                                        Ns_DString *dsPtr, int level, bool flush)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(4);
+static void *BrotliAlloc(void *UNUSED(opaque), size_t size);
+static void BrotliFree(void *UNUSED(opaque), void *address);
+#endif
+
+#ifdef HAVE_ZSTD_H
+static Ns_ReturnCode CompressBufsZstd(Ns_CompressStream *cStream, struct iovec *bufs, int nbufs,
+                                      Ns_DString *dsPtr, int level, bool flush)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(4);
+#endif
+
+#ifdef HAVE_ZLIB_H
+
 static void DeflateOrAbort(z_stream *z, int flushFlags);
 static voidpf ZAlloc(voidpf UNUSED(arg), uInt items, uInt size);
 static void ZFree(voidpf UNUSED(arg), voidpf address);
@@ -55,6 +87,8 @@ Ns_CompressInit(Ns_CompressStream *cStream)
     Ns_ReturnCode status = NS_OK;
 
     cStream->flags = 0u;
+    cStream->format = NS_COMPRESS_GZIP;
+    cStream->codecState = NULL;
     z->zalloc = ZAlloc;
     z->zfree = ZFree;
     z->opaque = Z_NULL;
@@ -103,6 +137,7 @@ Ns_CompressFree(Ns_CompressStream *cStream)
                    status, zError(status), (z->msg != NULL) ? z->msg : "(unknown)");
         }
     }
+    CodecStateFree(cStream);
 }
 
 /*
@@ -396,15 +431,18 @@ ZFree(voidpf UNUSED(arg), voidpf address)
 #else /* ! HAVE_ZLIB_H */
 
 Ns_ReturnCode
-Ns_CompressInit(Ns_CompressStream *UNUSED(cStream))
+Ns_CompressInit(Ns_CompressStream *cStream)
 {
+    cStream->flags = 0u;
+    cStream->format = NS_COMPRESS_GZIP;
+    cStream->codecState = NULL;
     return NS_ERROR;
 }
 
 void
-Ns_CompressFree(Ns_CompressStream *UNUSED(cStream))
+Ns_CompressFree(Ns_CompressStream *cStream)
 {
-    return;
+    CodecStateFree(cStream);
 }
 
 Ns_ReturnCode
@@ -446,6 +484,458 @@ Ns_InflateEnd(Ns_CompressStream *UNUSED(cStream))
 
 #endif
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * Ns_CompressFormatSupported, Ns_CompressFormatName,
+ * Ns_CompressFormatFromName --
+ *
+ *      Map compression formats to their content-coding tokens as used in
+ *      the "Accept-Encoding" and "Content-Encoding" header fields and
+ *      check, whether a format was compiled in. Ns_CompressFormatFromName()
+ *      accepts "brotli" as an alias for "br".
+ *
+ * Results:
+ *      Boolean, token or Ns_ReturnCode.
+ *
+ * Side effects:
+ *      Ns_CompressFormatFromName() returns the format in its last argument.
+ *
+ *----------------------------------------------------------------------
+ */
+
+bool
+Ns_CompressFormatSupported(Ns_CompressFormat format)
+{
+    bool result;
+
+    switch (format) {
+    case NS_COMPRESS_GZIP:
+#ifdef HAVE_ZLIB_H
+        result = NS_TRUE;
+#else
+        result = NS_FALSE;
+#endif
+        break;
+    case NS_COMPRESS_BROTLI:
+#ifdef HAVE_BROTLI_ENCODE_H
+        result = NS_TRUE;
+#else
+        result = NS_FALSE;
+#endif
+        break;
+    case NS_COMPRESS_ZSTD:
+#ifdef HAVE_ZSTD_H
+        result = NS_TRUE;
+#else
+        result = NS_FALSE;
+#endif
+        break;
+    default:
+        result = NS_FALSE;
+        break;
+    }
+    return result;
+}
+
+const char *
+Ns_CompressFormatName(Ns_CompressFormat format)
+{
+    return ((unsigned int)format < NS_COMPRESS_NR_FORMATS)
+        ? compressFormatNames[format]
+        : "identity";
+}
+
+Ns_ReturnCode
+Ns_CompressFormatFromName(const char *name, Ns_CompressFormat *formatPtr)
+{
+    Ns_ReturnCode status = NS_ERROR;
+    unsigned int  i;
+
+    NS_NONNULL_ASSERT(name != NULL);
+    NS_NONNULL_ASSERT(formatPtr != NULL);
+
+    if (strcmp(name, "brotli") == 0) {
+        name = "br";
+    }
+    for (i = 0u; i < NS_COMPRESS_NR_FORMATS; i++) {
+        if (strcmp(name, compressFormatNames[i]) == 0) {
+            *formatPtr = (Ns_CompressFormat)i;
+            status = NS_OK;
+            break;
+        }
+    }
+    return status;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Ns_CompressSetFormat --
+ *
+ *      Select the codec used by Ns_CompressBufs() for the next compressed
+ *      response. The state of a stream that was not terminated (e.g. by an
+ *      aborted streaming response) is discarded, so the next call of
+ *      Ns_CompressBufs() starts a fresh stream.
+ *
+ * Results:
+ *      NS_OK, or NS_ERROR when the format is not compiled in.
+ *
+ * Side effects:
+ *      Might release or reset encoder state.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Ns_ReturnCode
+Ns_CompressSetFormat(Ns_CompressStream *cStream, Ns_CompressFormat format)
+{
+    Ns_ReturnCode status = NS_OK;
+
+    NS_NONNULL_ASSERT(cStream != NULL);
+
+    if (!Ns_CompressFormatSupported(format)) {
+        status = NS_ERROR;
+
+    } else {
+        if ((cStream->flags & COMPRESS_SENT_HEADER) != 0u) {
+#ifdef HAVE_ZLIB_H
+            if (cStream->format == NS_COMPRESS_GZIP && cStream->z.zalloc != NULL) {
+                (void) deflateReset(&cStream->z);
+            }
+#endif
+            cStream->flags = 0u;
+        }
+        if (cStream->format != format || cStream->format == NS_COMPRESS_BROTLI) {
+            /*
+             * A zstd context can be reused for the next stream of the same
+             * format, a brotli encoder is used once.
+             */
+            CodecStateFree(cStream);
+        }
+#ifdef HAVE_ZSTD_H
+        else if (cStream->codecState != NULL) {
+            (void) ZSTD_CCtx_reset(cStream->codecState, ZSTD_reset_session_only);
+        }
+#endif
+        cStream->format = format;
+    }
+    return status;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Ns_CompressBufs --
+ *
+ *      Compress a vector of bufs with the format selected via
+ *      Ns_CompressSetFormat() and append the result to the dstring. The
+ *      function can be called any number of times for a stream; when
+ *      "flush" is false, the output is flushed such that the client can
+ *      decode all data sent so far (streaming). When "flush" is true, the
+ *      stream is terminated, and the next call starts a new stream.
+ *
+ *      The level is interpreted by the codec: 1-9 for gzip, 0-11 for brotli
+ *      and 1-22 for zstd.
+ *
+ * Results:
+ *      Ns_ReturnCode.
+ *
+ * Side effects:
+ *      Allocates encoder state on first use.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Ns_ReturnCode
+Ns_CompressBufs(Ns_CompressStream *cStream, struct iovec *bufs, int nbufs,
+                Ns_DString *dsPtr, int level, bool flush)
+{
+    Ns_ReturnCode status;
+
+    NS_NONNULL_ASSERT(cStream != NULL);
+    NS_NONNULL_ASSERT(dsPtr != NULL);
+
+    switch (cStream->format) {
+#ifdef HAVE_BROTLI_ENCODE_H
+    case NS_COMPRESS_BROTLI:
+        status = CompressBufsBrotli(cStream, bufs, nbufs, dsPtr, level, flush);
+        break;
+#endif
+#ifdef HAVE_ZSTD_H
+    case NS_COMPRESS_ZSTD:
+        status = CompressBufsZstd(cStream, bufs, nbufs, dsPtr, level, flush);
+        break;
+#endif
+    case NS_COMPRESS_GZIP:
+        status = Ns_CompressBufsGzip(cStream, bufs, nbufs, dsPtr, level, flush);
+        break;
+    default:
+        status = NS_ERROR;
+        break;
+    }
+    return status;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CodecStateFree --
+ *
+ *      Release the encoder state of a brotli or zstd stream.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Frees memory.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+CodecStateFree(Ns_CompressStream *cStream)
+{
+    if (cStream->codecState != NULL) {
+        switch (cStream->format) {
+#ifdef HAVE_BROTLI_ENCODE_H
+        case NS_COMPRESS_BROTLI:
+            BrotliEncoderDestroyInstance(cStream->codecState);
+            break;
+#endif
+#ifdef HAVE_ZSTD_H
+        case NS_COMPRESS_ZSTD:
+            (void) ZSTD_freeCCtx(cStream->codecState);
+            break;
+#endif
+        case NS_COMPRESS_GZIP: NS_FALL_THROUGH; /* fall through */
+        default:
+            break;
+        }
+        cStream->codecState = NULL;
+    }
+}
+
+#ifdef HAVE_BROTLI_ENCODE_H
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CompressBufsBrotli --
+ *
+ *      Brotli implementation of Ns_CompressBufs(). The encoder state is
+ *      created on the first call of a stream and released when the stream
+ *      is finished.
+ *
+ * Results:
+ *      NS_OK.
+ *
+ * Side effects:
+ *      Aborts on error (which should not happen).
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Ns_ReturnCode
+CompressBufsBrotli(Ns_CompressStream *cStream, struct iovec *bufs, int nbufs,
+                   Ns_DString *dsPtr, int level, bool flush)
+{
+    BrotliEncoderState *state = cStream->codecState;
+    int                 i = 0;
+
+    if (state == NULL) {
+        state = BrotliEncoderCreateInstance(BrotliAlloc, BrotliFree, NULL);
+        if (state == NULL) {
+            Ns_Fatal("Ns_CompressBufs: cannot create brotli encoder");
+        }
+        (void) BrotliEncoderSetParameter(state, BROTLI_PARAM_QUALITY,
+                                         (uint32_t)MIN(MAX(level, BROTLI_MIN_QUALITY),
+                                                       BROTLI_MAX_QUALITY));
+        if (flush && nbufs > 0) {
+            /*
+             * The full content is provided in one call.
+             */
+            (void) BrotliEncoderSetParameter(state, BROTLI_PARAM_SIZE_HINT,
+                                             (uint32_t)MIN(Ns_SumVec(bufs, nbufs), UINT32_MAX));
+        }
+        cStream->codecState = state;
+        cStream->flags |= COMPRESS_SENT_HEADER;
+    }
+
+    /*
+     * Process all buffers; the last one (or an empty call) is flushed or
+     * finishes the stream. Since no output buffer is provided, the output
+     * is collected via BrotliEncoderTakeOutput().
+     */
+    do {
+        const uint8_t          *nextIn = NULL;
+        size_t                  availIn = 0u;
+        BrotliEncoderOperation  op;
+
+        if (i < nbufs) {
+            nextIn = (const uint8_t *)bufs[i].iov_base;
+            availIn = bufs[i].iov_len;
+        }
+        if (i < nbufs - 1) {
+            op = BROTLI_OPERATION_PROCESS;
+        } else {
+            op = flush ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_FLUSH;
+        }
+
+        for (;;) {
+            size_t availOut = 0u;
+
+            if (BrotliEncoderCompressStream(state, op, &availIn, &nextIn,
+                                            &availOut, NULL, NULL) == BROTLI_FALSE) {
+                Ns_Fatal("Ns_CompressBufs: brotli encoder error");
+            }
+            while (BrotliEncoderHasMoreOutput(state) == BROTLI_TRUE) {
+                size_t         outSize = 0u;
+                const uint8_t *out = BrotliEncoderTakeOutput(state, &outSize);
+
+                Tcl_DStringAppend(dsPtr, (const char *)out, (TCL_SIZE_T)outSize);
+            }
+            if (availIn == 0u
+                && (op != BROTLI_OPERATION_FINISH || BrotliEncoderIsFinished(state) == BROTLI_TRUE)) {
+                break;
+            }
+        }
+        i++;
+    } while (i < nbufs);
+
+    if (flush) {
+        BrotliEncoderDestroyInstance(state);
+        cStream->codecState = NULL;
+        cStream->flags = 0u;
+    }
+
+    return NS_OK;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * BrotliAlloc, BrotliFree --
+ *
+ *      Memory callbacks for the brotli library.
+ *
+ * Results:
+ *      Memory/None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void *
+BrotliAlloc(void *UNUSED(opaque), size_t size)
+{
+    return ns_malloc(size);
+}
+
+static void
+BrotliFree(void *UNUSED(opaque), void *address)
+{
+    ns_free(address);
+}
+#endif /* HAVE_BROTLI_ENCODE_H */
+
+#ifdef HAVE_ZSTD_H
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CompressBufsZstd --
+ *
+ *      Zstandard implementation of Ns_CompressBufs(). The compression
+ *      context is kept in the stream and reused for subsequent streams.
+ *
+ * Results:
+ *      NS_OK.
+ *
+ * Side effects:
+ *      Aborts on error (which should not happen).
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Ns_ReturnCode
+CompressBufsZstd(Ns_CompressStream *cStream, struct iovec *bufs, int nbufs,
+                 Ns_DString *dsPtr, int level, bool flush)
+{
+    ZSTD_CCtx *cctx = cStream->codecState;
+    int        i = 0;
+
+    if (cctx == NULL) {
+        cctx = ZSTD_createCCtx();
+        if (cctx == NULL) {
+            Ns_Fatal("Ns_CompressBufs: cannot create zstd context");
+        }
+        cStream->codecState = cctx;
+    }
+    if ((cStream->flags & COMPRESS_SENT_HEADER) == 0u) {
+        cStream->flags |= COMPRESS_SENT_HEADER;
+        (void) ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel,
+                                      MIN(MAX(level, 1), ZSTD_maxCLevel()));
+        if (flush && nbufs > 0) {
+            /*
+             * The full content is provided in one call.
+             */
+            (void) ZSTD_CCtx_setPledgedSrcSize(cctx, (unsigned long long)Ns_SumVec(bufs, nbufs));
+        }
+    }
+
+    do {
+        ZSTD_inBuffer     input = {NULL, 0u, 0u};
+        ZSTD_EndDirective mode;
+        bool              done;
+
+        if (i < nbufs) {
+            input.src = bufs[i].iov_base;
+            input.size = bufs[i].iov_len;
+        }
+        if (i < nbufs - 1) {
+            mode = ZSTD_e_continue;
+        } else {
+            mode = flush ? ZSTD_e_end : ZSTD_e_flush;
+        }
+
+        do {
+            TCL_SIZE_T     offset = dsPtr->length;
+            size_t         remaining;
+            ZSTD_outBuffer output;
+
+            output.size = MAX(ZSTD_compressBound(input.size - input.pos), 4096u);
+            Ns_DStringSetLength(dsPtr, offset + (TCL_SIZE_T)output.size);
+            output.dst = dsPtr->string + offset;
+            output.pos = 0u;
+
+            remaining = ZSTD_compressStream2(cctx, &output, &input, mode);
+            if (ZSTD_isError(remaining) != 0u) {
+                Ns_Fatal("Ns_CompressBufs: zstd error: %s", ZSTD_getErrorName(remaining));
+            }
+            Ns_DStringSetLength(dsPtr, offset + (TCL_SIZE_T)output.pos);
+
+            done = (mode == ZSTD_e_continue)
+                ? (input.pos == input.size)
+                : (remaining == 0u);
+        } while (!done);
+        i++;
+    } while (i < nbufs);
+
+    if (flush) {
+        (void) ZSTD_CCtx_reset(cctx, ZSTD_reset_session_only);
+        cStream->flags = 0u;
+    }
+
+    return NS_OK;
+}
+#endif /* HAVE_ZSTD_H */
+
 /*
  * Local Variables:
  * mode: c
@@ -1517,6 +1517,39 @@ Ns_ConnSetCompression(Ns_Conn *conn, int level)
 #endif
 }
 
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Ns_ConnSetCompressionCacheKey --
+ *
+ *      Set the key under which the compressed variants of the response
+ *      body are stored in the compressed-variant cache of the server
+ *      ("compresscachesize"). The key has to identify the uncompressed
+ *      body; when the body changes, the key has to change as well.
+ *      Without explicit key, a strong "ETag" of the response is used.
+ *      Passing NULL clears the key.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+Ns_ConnSetCompressionCacheKey(Ns_Conn *conn, const char *key)
+{
+    Conn *connPtr = (Conn *) conn;
+
+    NS_NONNULL_ASSERT(conn != NULL);
+
+    ns_free(connPtr->compressCacheKey);
+    connPtr->compressCacheKey = (key != NULL) ? ns_strdup(key) : NULL;
+}
+
 
 /*
  *----------------------------------------------------------------------
@@ -1739,15 +1772,28 @@ NsTclConnObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc, Tcl_
     case CCompressIdx:
         if (objc > 2) {
             Ns_ObjvValueRange compressRange = {0, 9};
-            TCL_SIZE_T        oc = 1;
-            int               level = 0;
-            Ns_ObjvSpec       spec = {"?level", Ns_ObjvInt, &level, &compressRange};
+            int               level = -1;
+            char             *cacheKey = NULL;
+            Ns_ObjvSpec       lopts[] = {
+                {"-cachekey", Ns_ObjvString, &cacheKey, NULL},
+                {"--",        Ns_ObjvBreak,  NULL,      NULL},
+                {NULL, NULL, NULL, NULL}
+            };
+            Ns_ObjvSpec       largs[] = {
+                {"?level", Ns_ObjvInt, &level, &compressRange},
+                {NULL, NULL, NULL, NULL}
+            };
 
-            if (Ns_ObjvInt(&spec, interp, &oc, &objv[2]) != TCL_OK) {
+            if (Ns_ParseObjv(lopts, largs, interp, 2, objc, objv) != NS_OK) {
                 result = TCL_ERROR;
 
             } else {
-                Ns_ConnSetCompression(conn, level);
+                if (level != -1) {
+                    Ns_ConnSetCompression(conn, level);
+                }
+                if (cacheKey != NULL) {
+                    Ns_ConnSetCompressionCacheKey(conn, cacheKey);
+                }
             }
         }
         if (result == TCL_OK) {
@@ -2442,6 +2488,9 @@ NsTclConnObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc, Tcl_
             if ((connPtr->flags & NS_CONN_BROTLIACCEPTED) != 0u) {
                 Tcl_ListObjAppendElement(interp, listObj, Tcl_NewStringObj("brotli", 6));
             }
+            if ((connPtr->flags & NS_CONN_ZSTDACCEPTED) != 0u) {
+                Tcl_ListObjAppendElement(interp, listObj, Tcl_NewStringObj("zstd", 4));
+            }
             if ((connPtr->flags & NS_CONN_ZIPACCEPTED) != 0u) {
                 Tcl_ListObjAppendElement(interp, listObj, Tcl_NewStringObj("gzip", 4));
             }
@@ -33,6 +33,23 @@
  */
 #define MAX_CHARS_CHUNK_HEADER 12
 
+/*
+ * The following structure is the value of an entry in the compressed-variant
+ * cache: the compressed response body.
+ */
+typedef struct CompressedVariant {
+    size_t length;
+    char   data[1];
+} CompressedVariant;
+
+/*
+ * Connection flags indicating that the client accepts a compression format,
+ * indexed by Ns_CompressFormat.
+ */
+static const unsigned int compressAcceptFlags[NS_COMPRESS_NR_FORMATS] = {
+    NS_CONN_ZIPACCEPTED, NS_CONN_BROTLIACCEPTED, NS_CONN_ZSTDACCEPTED
+};
+
 
 /*
  * Local functions defined in this file
@@ -49,9 +66,18 @@ static Ns_ReturnCode ConnCopy(const Ns_Conn *conn, size_t toCopy, Tcl_Channel ch
 static bool CheckKeep(const Conn *connPtr)
     NS_GNUC_NONNULL(1);
 
-static int CheckCompress(const Conn *connPtr, const struct iovec *bufs, int nbufs, unsigned int ioflags)
+static int CheckCompress(Conn *connPtr, const struct iovec *bufs, int nbufs, unsigned int ioflags)
     NS_GNUC_NONNULL(1);
 
+static bool CompressCacheKey(const Conn *connPtr, size_t length, Tcl_DString *keyDsPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(3);
+
+static bool CompressCacheGet(Ns_Cache *cache, const char *key, Tcl_DString *dsPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(3);
+
+static void CompressCachePut(Ns_Cache *cache, const Tcl_DString *keyDsPtr, const char *data, size_t length)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(3);
+
 static bool HdrEq(const Ns_Set *set, const char *name, const char *value)
     NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(3);
 
@@ -136,15 +162,41 @@ Ns_ConnWriteVChars(Ns_Conn *conn, struct iovec *bufs, int nbufs, unsigned int fl
     if (connPtr->compress > 0
         && (nbufs > 0 || (flags & NS_CONN_STREAM_CLOSE) != 0u)
         ) {
-        bool flush = ((flags & NS_CONN_STREAM) == 0u);
+        bool         flush = ((flags & NS_CONN_STREAM) == 0u);
+        Ns_Cache    *cache = connPtr->poolPtr->servPtr->compress.cache;
+        Tcl_DString  keyDs;
+        bool         cacheable = NS_FALSE;
 
-        if (Ns_CompressBufsGzip(&connPtr->cStream, bufs, nbufs, &gzDs,
-                                connPtr->compress, flush) == NS_OK) {
+        Tcl_DStringInit(&keyDs);
+
+        /*
+         * A non-streaming response is compressed in a single call. When the
+         * body is identified by a cache key, reuse a previously compressed
+         * variant.
+         */
+        if (cache != NULL && flush && nbufs > 0) {
+            size_t length = Ns_SumVec(bufs, nbufs);
+
+            cacheable = (length <= Ns_CacheGetMaxSize(cache)
+                         && CompressCacheKey(connPtr, length, &keyDs));
+        }
+
+        if (cacheable && CompressCacheGet(cache, keyDs.string, &gzDs)) {
+            (void)Ns_SetVec(&iov, 0, gzDs.string, (size_t)gzDs.length);
+            bufs = &iov;
+            nbufs = 1;
+
+        } else if (Ns_CompressBufs(&connPtr->cStream, bufs, nbufs, &gzDs,
+                                   connPtr->compress, flush) == NS_OK) {
             /* NB: Compression will always succeed. */
+            if (cacheable) {
+                CompressCachePut(cache, &keyDs, gzDs.string, (size_t)gzDs.length);
+            }
             (void)Ns_SetVec(&iov, 0, gzDs.string, (size_t)gzDs.length);
             bufs = &iov;
             nbufs = 1;
         }
+        Tcl_DStringFree(&keyDs);
     }
 
     status = Ns_ConnWriteVData(conn, bufs, nbufs, flags);
@@ -162,19 +214,22 @@ Ns_ConnWriteVChars(Ns_Conn *conn, struct iovec *bufs, int nbufs, unsigned int fl
  *
  * CheckCompress --
  *
- *      Is compression enabled, and at what level.
+ *      Is compression enabled, and at what level. The compression format
+ *      is the first of the configured "compressformats" accepted by the
+ *      client.
  *
  * Results:
- *      compress level 0-9
+ *      Compress level of the chosen format, 0 for no compression.
  *
  * Side effects:
- *      May set the Content-Encoding and Vary headers.
+ *      May set the Content-Encoding and Vary headers and the format of the
+ *      compression stream of the connection.
  *
  *----------------------------------------------------------------------
  */
 
 static int
-CheckCompress(const Conn *connPtr, const struct iovec *bufs, int nbufs, unsigned int ioflags)
+CheckCompress(Conn *connPtr, const struct iovec *bufs, int nbufs, unsigned int ioflags)
 {
     const Ns_Conn  *conn = (Ns_Conn *) connPtr;
     const NsServer *servPtr;
@@ -202,11 +257,29 @@ CheckCompress(const Conn *connPtr, const struct iovec *bufs, int nbufs, unsigned
              */
             if (((connPtr->flags & NS_CONN_SENTHDRS) == 0u)
                 && ((connPtr->flags & NS_CONN_SKIPBODY) == 0u)) {
+                int i;
+
                 Ns_ConnSetHeaders(conn, "Vary", "Accept-Encoding");
 
-                if ((connPtr->flags & NS_CONN_ZIPACCEPTED) != 0u) {
-                    Ns_ConnSetHeaders(conn, "Content-Encoding", "gzip");
-                    compressionLevel = configuredCompressionLevel;
+                for (i = 0; i < servPtr->compress.nformats; i++) {
+                    Ns_CompressFormat format = servPtr->compress.formats[i];
+
+                    if ((connPtr->flags & compressAcceptFlags[format]) != 0u
+                        && Ns_CompressSetFormat(&connPtr->cStream, format) == NS_OK) {
+                        Ns_ConnSetHeaders(conn, "Content-Encoding", Ns_CompressFormatName(format));
+                        /*
+                         * The level of "ns_conn compress" applies to
+                         * gzip; brotli and zstd have their own scales.
+                         */
+                        if (format == NS_COMPRESS_BROTLI) {
+                            compressionLevel = servPtr->compress.brotlilevel;
+                        } else if (format == NS_COMPRESS_ZSTD) {
+                            compressionLevel = servPtr->compress.zstdlevel;
+                        } else {
+                            compressionLevel = configuredCompressionLevel;
+                        }
+                        break;
+                    }
                 }
             }
         }
@@ -215,6 +288,131 @@ CheckCompress(const Conn *connPtr, const struct iovec *bufs, int nbufs, unsigned
 }
 
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * CompressCacheKey --
+ *
+ *      Compute the key of the compressed variant of the response body in
+ *      the compressed-variant cache. The body is identified either by the
+ *      explicit key set via Ns_ConnSetCompressionCacheKey() or by a strong
+ *      "ETag" of the response together with the URL and the query. The
+ *      key contains as well the compression format, level, the body
+ *      length and the requested host, such that virtual hosts do not
+ *      share entries.
+ *
+ * Results:
+ *      Boolean value indicating whether the response is cacheable.
+ *
+ * Side effects:
+ *      Key is returned in keyDsPtr.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static bool
+CompressCacheKey(const Conn *connPtr, size_t length, Tcl_DString *keyDsPtr)
+{
+    const char *etag = NULL;
+    bool        success = NS_TRUE;
+
+    if (connPtr->compressCacheKey == NULL) {
+        etag = Ns_SetIGet(connPtr->outputheaders, "etag");
+        if (etag == NULL || *etag != '"') {
+            /*
+             * No ETag, or a weak one, which does not identify the bytes.
+             */
+            success = NS_FALSE;
+        }
+    }
+    if (success) {
+        const char *host = Ns_SetIGet(connPtr->headers, "host");
+        TCL_SIZE_T  hostOffset;
+
+        Ns_DStringPrintf(keyDsPtr, "%s %d %" PRIuz " ",
+                         Ns_CompressFormatName(connPtr->cStream.format),
+                         connPtr->compress, length);
+        hostOffset = keyDsPtr->length;
+        Ns_DStringVarAppend(keyDsPtr, host != NULL ? host : NS_EMPTY_STRING, " ", (char *)0L);
+        Ns_StrToLower(keyDsPtr->string + hostOffset);
+        if (etag != NULL) {
+            /*
+             * An entity tag identifies a representation only within the
+             * target resource, which includes the query.
+             */
+            Ns_DStringVarAppend(keyDsPtr, "etag ", connPtr->request.url, (char *)0L);
+            if (connPtr->request.query != NULL) {
+                Ns_DStringVarAppend(keyDsPtr, "?", connPtr->request.query, (char *)0L);
+            }
+            Ns_DStringVarAppend(keyDsPtr, " ", etag, (char *)0L);
+        } else {
+            Ns_DStringVarAppend(keyDsPtr, "key ", connPtr->compressCacheKey, (char *)0L);
+        }
+    }
+    return success;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CompressCacheGet, CompressCachePut --
+ *
+ *      Lookup or store a compressed variant of a response body in the
+ *      compressed-variant cache.
+ *
+ * Results:
+ *      CompressCacheGet() returns NS_TRUE on a cache hit.
+ *
+ * Side effects:
+ *      CompressCacheGet() appends the compressed body to dsPtr,
+ *      CompressCachePut() might prune other entries from the cache.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static bool
+CompressCacheGet(Ns_Cache *cache, const char *key, Tcl_DString *dsPtr)
+{
+    const Ns_Entry *entry;
+    bool            success = NS_FALSE;
+
+    Ns_CacheLock(cache);
+    entry = Ns_CacheFindEntry(cache, key);
+    if (entry != NULL) {
+        const CompressedVariant *variantPtr = Ns_CacheGetValue(entry);
+
+        Tcl_DStringAppend(dsPtr, variantPtr->data, (TCL_SIZE_T)variantPtr->length);
+        success = NS_TRUE;
+    }
+    Ns_CacheUnlock(cache);
+
+    return success;
+}
+
+static void
+CompressCachePut(Ns_Cache *cache, const Tcl_DString *keyDsPtr, const char *data, size_t length)
+{
+    CompressedVariant *variantPtr;
+    Ns_Entry          *entry;
+    int                isNew;
+
+    variantPtr = ns_malloc(sizeof(CompressedVariant) + length);
+    variantPtr->length = length;
+    memcpy(variantPtr->data, data, length);
+
+    Ns_CacheLock(cache);
+    entry = Ns_CacheCreateEntry(cache, keyDsPtr->string, &isNew);
+    if (isNew != 0) {
+        Ns_CacheSetValueSz(entry, variantPtr,
+                           sizeof(CompressedVariant) + length + (size_t)keyDsPtr->length);
+    } else {
+        ns_free(variantPtr);
+    }
+    Ns_CacheUnlock(cache);
+}
+
+
 /*
  *----------------------------------------------------------------------
  *
@@ -796,7 +994,7 @@ Ns_ConnClose(Ns_Conn *conn)
             /*
              * Streaming:
              *   In chunked mode, write the end-of-content trailer.
-             *   If compressing, write the gzip footer.
+             *   If compressing, terminate the compressed stream.
              */
             (void) Ns_ConnWriteVChars(conn, NULL, 0, NS_CONN_STREAM_CLOSE);
         }
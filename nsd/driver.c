@@ -20,6 +20,10 @@
 #include "nsd.h"
 NS_EXPORT Ns_LogSeverity Ns_LogAccessDebug;
 
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
+
 /*
  * The following are valid driver state flags.
  */
@@ -50,7 +54,8 @@ typedef enum {
     SOCK_ENTITYTOOLARGE =     -10,
     SOCK_BADHEADER =          -11,
     SOCK_TOOMANYHEADERS =     -12,
-    SOCK_QUEUEFULL =          -13
+    SOCK_QUEUEFULL =          -13,
+    SOCK_HTTP2PREFACE =       -14
 } SockState;
 
 /*
@@ -91,15 +96,63 @@ static const SpoolerStateMap spoolerStateMap[] = {
 /*
  * The following structure manages polling.  The PollIn macro is
  * used for the common case of checking for readability.
+ *
+ * The sockets to be monitored are collected on every spin via PollSet() in
+ * the "pfds" array. The event backend determines, how the kernel is asked
+ * for the ready sockets. The "poll" backend passes the full array on every
+ * call to ns_poll(). The "epoll" backend keeps the sockets registered in
+ * the kernel across spins and updates only the changes, such that the
+ * syscall costs depend on the number of ready sockets, and not on the
+ * number of (idle) monitored sockets.
  */
 
+typedef struct PollFdState {
+    unsigned int   round;       /* Last spin this fd was requested. */
+    unsigned int   token;       /* Token of the registered fd incarnation. */
+    unsigned int   index;       /* Index in pfds in the current spin. */
+    short          events;      /* Registered events. */
+    bool           registered;  /* Registered in the kernel. */
+} PollFdState;
+
 typedef struct PollData {
-    unsigned int   nfds;       /* Number of fds being monitored. */
-    unsigned int   maxfds;     /* Max fds (will grow as needed). */
+    unsigned int   nfds;        /* Number of fds being monitored. */
+    unsigned int   maxfds;      /* Max fds (will grow as needed). */
     struct pollfd *pfds;        /* Dynamic array of poll structs. */
+    unsigned int  *tokens;      /* Fd incarnation tokens parallel to pfds. */
     Ns_Time        timeout;     /* Min timeout, if any, for next spin. */
+    const struct PollBackend *backendPtr;
+
+    /*
+     * State of persistent backends.
+     */
+    int            efd;         /* Kernel event queue. */
+    unsigned int   round;       /* Current spin. */
+    PollFdState   *fdState;     /* Registration state indexed by fd. */
+    size_t         nfdState;    /* Size of fdState array. */
+    NS_SOCKET     *regFds;      /* Fds registered in the last spin. */
+    unsigned int   nregFds;
+    void          *events;      /* Backend-specific result array. */
+    unsigned int   maxevents;
 } PollData;
 
+/*
+ * Event backends are defined via the following structure.
+ */
+typedef struct PollBackend {
+    const char *name;
+    void (*initProc)(PollData *pdata);
+    void (*freeProc)(PollData *pdata);
+    int  (*waitProc)(PollData *pdata, int timeout);
+} PollBackend;
+
+#define NS_EVENT_BACKEND_POLL  0
+#define NS_EVENT_BACKEND_EPOLL 1
+
+/*
+ * Number of submission queue entries of the io_uring of a writer thread.
+ */
+#define NS_WRITER_URING_ENTRIES 256u
+
 #define PollIn(ppd, i)           (((ppd)->pfds[(i)].revents & POLLIN)  == POLLIN )
 #define PollOut(ppd, i)          (((ppd)->pfds[(i)].revents & POLLOUT) == POLLOUT)
 #define PollHup(ppd, i)          (((ppd)->pfds[(i)].revents & POLLHUP) == POLLHUP)
@@ -163,6 +216,11 @@ typedef struct WriterSock {
     int                rateLimit;
     int                currentRate;
     ConnPoolInfo      *infoPtr;
+    struct iovec       vbuf;                  /* single buffer for file based sends */
+#ifdef HAVE_LINUX_IO_URING_H
+    struct msghdr      uringMsg;              /* message header of queued io_uring send */
+    size_t             uringToWrite;          /* bytes to write in queued io_uring send */
+#endif
     bool               keep;
 
 } WriterSock;
@@ -255,6 +313,8 @@ static void  SockRelease(Sock *sockPtr, SockState reason, int err)
 
 static void  SockError(Sock *sockPtr, SockState reason, int err)
     NS_GNUC_NONNULL(1);
+static void  SockSendHttp2GoAway(Sock *sockPtr)
+    NS_GNUC_NONNULL(1);
 static void  SockSendResponse(Sock *sockPtr, int statusCode, const char *errMsg, const char *headers)
     NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(3);
 static void  SockTrigger(NS_SOCKET sock);
@@ -274,7 +334,7 @@ static void SpoolerQueueStart(SpoolerQueue *queuePtr, Ns_ThreadProc *proc)
     NS_GNUC_NONNULL(2);
 static void SpoolerQueueStop(SpoolerQueue *queuePtr, const Ns_Time *timeoutPtr, const char *name)
     NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(3);
-static void PollCreate(PollData *pdata)
+static void PollCreate(PollData *pdata, int backend)
     NS_GNUC_NONNULL(1);
 static void PollFree(PollData *pdata)
     NS_GNUC_NONNULL(1);
@@ -282,7 +342,21 @@ static void PollReset(PollData *pdata)
     NS_GNUC_NONNULL(1);
 static NS_POLL_NFDS_TYPE PollSet(PollData *pdata, NS_SOCKET sock, short type, const Ns_Time *timeoutPtr)
     NS_GNUC_NONNULL(1);
-static int PollWait(const PollData *pdata, int timeout)
+static int PollWait(PollData *pdata, int timeout)
+    NS_GNUC_NONNULL(1);
+static int PollWaitPoll(PollData *pdata, int timeout)
+    NS_GNUC_NONNULL(1);
+#ifdef HAVE_SYS_EPOLL_H
+static void EpollInit(PollData *pdata)
+    NS_GNUC_NONNULL(1);
+static void EpollFree(PollData *pdata)
+    NS_GNUC_NONNULL(1);
+static int EpollWait(PollData *pdata, int timeout)
+    NS_GNUC_NONNULL(1);
+static void EpollCtl(const PollData *pdata, int op, NS_SOCKET sock, short type)
+    NS_GNUC_NONNULL(1);
+#endif
+static int EventBackendGet(const char *path)
     NS_GNUC_NONNULL(1);
 static SockState ChunkedDecode(Request *reqPtr, bool update)
     NS_GNUC_NONNULL(1);
@@ -294,6 +368,19 @@ static SpoolerState WriterReadFromSpool(WriterSock *curPtr)
     NS_GNUC_NONNULL(1);
 static SpoolerState WriterSend(WriterSock *curPtr, int *err)
     NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+static SpoolerState WriterSendFile(WriterSock *curPtr, int *err)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+static size_t WriterSendPrepare(WriterSock *curPtr, const struct iovec **bufsPtr, int *nbufsPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(3);
+static SpoolerState WriterSendDone(WriterSock *curPtr, ssize_t n, size_t toWrite)
+    NS_GNUC_NONNULL(1);
+#ifdef HAVE_LINUX_IO_URING_H
+static bool WriterSendUring(WriterSock *curPtr, NsUring *ringPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+#endif
+static void WriterSockFinish(SpoolerQueue *queuePtr, WriterSock *curPtr, SpoolerState spoolerState,
+                             int err, NsWriterStreamState doStream, WriterSock **writePtrPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(6);
 
 static Ns_ReturnCode WriterSetupStreamingMode(Conn *connPtr, const struct iovec *bufs, int nbufs, int *fdPtr)
     NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(4);
@@ -357,6 +444,17 @@ static Driver          *firstDrvPtr = NULL; /* First in list of all drivers */
 
 #define Push(x, xs) ((x)->nextPtr = (xs), (xs) = (x))
 
+/*
+ * Available event backends, indexed by NS_EVENT_BACKEND_*.
+ */
+static const PollBackend pollBackends[] = {
+    {"poll",  NULL,      NULL,      PollWaitPoll},
+#ifdef HAVE_SYS_EPOLL_H
+    {"epoll", EpollInit, EpollFree, EpollWait},
+#endif
+    {NULL,    NULL,      NULL,      NULL}
+};
+
 
 /*
  *----------------------------------------------------------------------
@@ -420,6 +518,7 @@ GetSockStateName(SockState sockState)
         "SOCK_BADHEADER",
         "SOCK_TOOMANYHEADERS",
         "SOCK_QUEUEFULL",
+        "SOCK_HTTP2PREFACE",
         NULL
     };
 
@@ -1289,6 +1388,7 @@ DriverInit(const char *server, const char *moduleName, const char *threadName,
     drvPtr->reuseport      = Ns_ConfigBool(path,     "reuseport",       NS_FALSE);
     drvPtr->acceptsize     = Ns_ConfigIntRange(path, "acceptsize",      drvPtr->backlog, 1, INT_MAX);
     drvPtr->sockacceptlog  = Ns_ConfigIntRange(path, "sockacceptlog",   nsconf.sockacceptlog, 2, drvPtr->backlog);
+    drvPtr->eventBackend   = EventBackendGet(path);
 
     drvPtr->keepmaxuploadsize   = (size_t)Ns_ConfigMemUnitRange(path, "keepalivemaxuploadsize",
                                                                 "0MB", 0, 0, INT_MAX);
@@ -1391,6 +1491,7 @@ DriverInit(const char *server, const char *moduleName, const char *threadName,
             Ns_MutexSetName2(&queuePtr->lock, buffer, "queue");
             Ns_CondInit(&queuePtr->cond);
             queuePtr->id = i;
+            queuePtr->eventBackend = drvPtr->eventBackend;
             Push(queuePtr, spPtr->firstPtr);
         }
     } else {
@@ -1413,6 +1514,12 @@ DriverInit(const char *server, const char *moduleName, const char *threadName,
         wrPtr->rateLimit = Ns_ConfigIntRange(path, "writerratelimit", 0, 0, INT_MAX);
         wrPtr->doStream = Ns_ConfigBool(path, "writerstreaming", NS_FALSE)
             ? NS_WRITER_STREAM_ACTIVE : NS_WRITER_STREAM_NONE;
+        wrPtr->uring = Ns_ConfigBool(path, "writeriouring", NS_FALSE);
+        if (wrPtr->uring && (drvPtr->opts & NS_DRIVER_WRITER_URING) == 0u) {
+            Ns_Log(Warning, "%s: parameter writeriouring ignored, driver does not support io_uring sends",
+                   threadName);
+            wrPtr->uring = NS_FALSE;
+        }
         Ns_Log(Notice, "%s: enable %d writer thread(s) "
                "for downloads >= %" PRIdz " bytes, bufsize=%" PRIdz " bytes, HTML streaming %d",
                threadName, wrPtr->threads, wrPtr->writersize, wrPtr->bufsize, wrPtr->doStream);
@@ -1425,6 +1532,8 @@ DriverInit(const char *server, const char *moduleName, const char *threadName,
             Ns_MutexSetName2(&queuePtr->lock, buffer, "queue");
             Ns_CondInit(&queuePtr->cond);
             queuePtr->id = i;
+            queuePtr->eventBackend = drvPtr->eventBackend;
+            queuePtr->uring = wrPtr->uring;
             Push(queuePtr, wrPtr->firstPtr);
         }
     } else {
@@ -1647,6 +1756,10 @@ DriverInfoObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp, TCL_OBJC_T o
                 } else {
                     Tcl_ListObjAppendElement(interp, listObj, Tcl_NewStringObj(NS_EMPTY_STRING, 0));
                 }
+                Tcl_ListObjAppendElement(interp, listObj, Tcl_NewStringObj("eventbackend", 12));
+                Tcl_ListObjAppendElement(interp, listObj,
+                                         Tcl_NewStringObj(pollBackends[drvPtr->eventBackend].name, TCL_INDEX_NONE));
+
                 Tcl_ListObjAppendElement(interp, listObj, Tcl_NewStringObj("libraryversion", 14));
                 if (drvPtr->libraryVersion != NULL) {
                     Tcl_ListObjAppendElement(interp, listObj, Tcl_NewStringObj(drvPtr->libraryVersion, TCL_INDEX_NONE));
@@ -1721,6 +1834,37 @@ DriverStatsObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp, TCL_OBJC_T
             Tcl_ListObjAppendElement(interp, listObj, Tcl_NewStringObj("errors", 6));
             Tcl_ListObjAppendElement(interp, listObj, Tcl_NewWideIntObj(drvPtr->stats.errors));
 
+            if (drvPtr->writer.uring) {
+                const SpoolerQueue *queuePtr;
+                Tcl_WideInt         sends = 0, fallbacks = 0;
+                bool                active = NS_FALSE;
+
+                /*
+                 * Batched io_uring send operations of the writer threads
+                 * (dirty reads).
+                 */
+                for (queuePtr = drvPtr->writer.firstPtr; queuePtr != NULL; queuePtr = queuePtr->nextPtr) {
+                    active |= queuePtr->uringActive;
+                    sends += queuePtr->uringSends;
+                    fallbacks += queuePtr->uringFallbacks;
+                }
+                if (active) {
+                    Tcl_ListObjAppendElement(interp, listObj, Tcl_NewStringObj("uringsends", 10));
+                    Tcl_ListObjAppendElement(interp, listObj, Tcl_NewWideIntObj(sends));
+                    Tcl_ListObjAppendElement(interp, listObj, Tcl_NewStringObj("uringfallbacks", 14));
+                    Tcl_ListObjAppendElement(interp, listObj, Tcl_NewWideIntObj(fallbacks));
+                }
+            }
+
+            if ((drvPtr->opts & NS_DRIVER_SSL_CONFIG) != 0u && drvPtr->arg != NULL) {
+                /*
+                 * TLS drivers based on the NsSSLConfig (flagged by
+                 * NS_DRIVER_SSL_CONFIG) report their kernel TLS
+                 * counters as well.
+                 */
+                NsSSLDriverStats(drvPtr->arg, listObj);
+            }
+
             Tcl_ListObjAppendElement(interp, resultObj, listObj);
         }
         Tcl_SetObjResult(interp, resultObj);
@@ -2413,7 +2557,7 @@ DriverThread(void *arg)
      * connections are complete and gracefully closed.
      */
 
-    PollCreate(&pdata);
+    PollCreate(&pdata, drvPtr->eventBackend);
     Ns_GetTime(&now);
     stopping = ((flags & DRIVER_SHUTDOWN) != 0u);
 
@@ -2631,6 +2775,7 @@ DriverThread(void *arg)
                     case SOCK_BADHEADER:       NS_FALL_THROUGH; /* fall through */
                     case SOCK_TOOMANYHEADERS:  NS_FALL_THROUGH; /* fall through */
                     case SOCK_QUEUEFULL:       NS_FALL_THROUGH; /* fall through */
+                    case SOCK_HTTP2PREFACE:    NS_FALL_THROUGH; /* fall through */
                     case SOCK_CLOSE:
                         SockRelease(sockPtr, s, errno);
                         break;
@@ -2771,6 +2916,7 @@ DriverThread(void *arg)
                         case SOCK_TOOMANYHEADERS: NS_FALL_THROUGH; /* fall through */
                         case SOCK_WRITEERROR:     NS_FALL_THROUGH; /* fall through */
                         case SOCK_QUEUEFULL:      NS_FALL_THROUGH; /* fall through */
+                        case SOCK_HTTP2PREFACE:   NS_FALL_THROUGH; /* fall through */
                         case SOCK_WRITETIMEOUT:
                             /*
                              * These cases should never be returned by SockAccept()
@@ -2908,18 +3054,79 @@ DriverThread(void *arg)
     Ns_MutexUnlock(&drvPtr->lock);
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * EventBackendGet --
+ *
+ *      Determine the event backend from the "eventbackend" parameter of
+ *      the driver configuration section. When the parameter is not
+ *      specified, the most efficient backend available on this platform is
+ *      used.
+ *
+ * Results:
+ *      Index in pollBackends.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+EventBackendGet(const char *path)
+{
+    const char *value;
+    int         result;
+
+    NS_NONNULL_ASSERT(path != NULL);
+
+#ifdef HAVE_SYS_EPOLL_H
+    result = NS_EVENT_BACKEND_EPOLL;
+#else
+    result = NS_EVENT_BACKEND_POLL;
+#endif
+    value = Ns_ConfigString(path, "eventbackend", pollBackends[result].name);
+
+    if (value != NULL) {
+        int i;
+
+        for (i = 0; pollBackends[i].name != NULL; i++) {
+            if (strcmp(pollBackends[i].name, value) == 0) {
+                break;
+            }
+        }
+        if (pollBackends[i].name != NULL) {
+            result = i;
+        } else {
+            Ns_Log(Warning, "%s: eventbackend '%s' is not supported on this platform, using '%s'",
+                   path, value, pollBackends[result].name);
+        }
+    }
+
+    return result;
+}
+
 static void
-PollCreate(PollData *pdata)
+PollCreate(PollData *pdata, int backend)
 {
     NS_NONNULL_ASSERT(pdata != NULL);
     memset(pdata, 0, sizeof(PollData));
+    pdata->backendPtr = &pollBackends[backend];
+    if (pdata->backendPtr->initProc != NULL) {
+        (*pdata->backendPtr->initProc)(pdata);
+    }
 }
 
 static void
 PollFree(PollData *pdata)
 {
     NS_NONNULL_ASSERT(pdata != NULL);
+    if (pdata->backendPtr->freeProc != NULL) {
+        (*pdata->backendPtr->freeProc)(pdata);
+    }
     ns_free(pdata->pfds);
+    ns_free(pdata->tokens);
     memset(pdata, 0, sizeof(PollData));
 }
 
@@ -2943,6 +3150,7 @@ PollSet(PollData *pdata, NS_SOCKET sock, short type, const Ns_Time *timeoutPtr)
     if (unlikely(pdata->nfds >= pdata->maxfds)) {
         pdata->maxfds += 100u;
         pdata->pfds = ns_realloc(pdata->pfds, pdata->maxfds * sizeof(struct pollfd));
+        pdata->tokens = ns_realloc(pdata->tokens, pdata->maxfds * sizeof(unsigned int));
     }
 
     /*
@@ -2952,6 +3160,7 @@ PollSet(PollData *pdata, NS_SOCKET sock, short type, const Ns_Time *timeoutPtr)
     pdata->pfds[pdata->nfds].fd = sock;
     pdata->pfds[pdata->nfds].events = type;
     pdata->pfds[pdata->nfds].revents = 0;
+    pdata->tokens[pdata->nfds] = 0u;
 
     /*
      * Check for new minimum timeout.
@@ -2965,7 +3174,15 @@ PollSet(PollData *pdata, NS_SOCKET sock, short type, const Ns_Time *timeoutPtr)
 }
 
 static int
-PollWait(const PollData *pdata, int timeout)
+PollWait(PollData *pdata, int timeout)
+{
+    NS_NONNULL_ASSERT(pdata != NULL);
+
+    return (*pdata->backendPtr->waitProc)(pdata, timeout);
+}
+
+static int
+PollWaitPoll(PollData *pdata, int timeout)
 {
     int n;
 
@@ -2981,6 +3198,223 @@ PollWait(const PollData *pdata, int timeout)
     return n;
 }
 
+#ifdef HAVE_SYS_EPOLL_H
+/*
+ *----------------------------------------------------------------------
+ *
+ * EpollInit, EpollFree, EpollWait --
+ *
+ *      Level-triggered epoll() event backend. The sockets collected via
+ *      PollSet() are compared with the registrations of the last spin;
+ *      only new, changed and no longer monitored sockets cause
+ *      epoll_ctl() calls. The results are mapped back to the revents of
+ *      the pfds array, such that the PollIn(), PollOut() and PollHup()
+ *      macros work unchanged.
+ *
+ *      Since a closed fd number might be reused by a newly accepted
+ *      socket, every accepted Sock receives a new pollToken, which forces
+ *      a fresh registration for the new incarnation of the fd.
+ *
+ * Results:
+ *      EpollWait returns the number of ready sockets.
+ *
+ * Side effects:
+ *      Manages the kernel registrations.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+EpollInit(PollData *pdata)
+{
+    NS_NONNULL_ASSERT(pdata != NULL);
+
+    pdata->efd = epoll_create1(EPOLL_CLOEXEC);
+    if (pdata->efd < 0) {
+        Ns_Fatal("PollCreate: epoll_create1() failed: %s", strerror(errno));
+    }
+}
+
+static void
+EpollFree(PollData *pdata)
+{
+    NS_NONNULL_ASSERT(pdata != NULL);
+
+    if (pdata->efd >= 0) {
+        (void) close(pdata->efd);
+    }
+    ns_free(pdata->fdState);
+    ns_free(pdata->regFds);
+    ns_free(pdata->events);
+}
+
+static void
+EpollCtl(const PollData *pdata, int op, NS_SOCKET sock, short type)
+{
+    struct epoll_event ev;
+    int                result;
+
+    NS_NONNULL_ASSERT(pdata != NULL);
+
+    ev.events = 0u;
+    if ((type & POLLIN) != 0) {
+        ev.events |= (uint32_t)EPOLLIN;
+    }
+    if ((type & POLLOUT) != 0) {
+        ev.events |= (uint32_t)EPOLLOUT;
+    }
+    ev.data.u64 = 0u;
+    ev.data.fd = sock;
+
+    result = epoll_ctl(pdata->efd, op, sock, &ev);
+    if (result != 0) {
+        /*
+         * A closed fd is implicitly removed from the interest list, while
+         * the registration of an fd might be still in place, although the
+         * token has changed. Retry with the complementary operation.
+         */
+        if (op == EPOLL_CTL_MOD && errno == ENOENT) {
+            op = EPOLL_CTL_ADD;
+            result = epoll_ctl(pdata->efd, op, sock, &ev);
+        } else if (op == EPOLL_CTL_ADD && errno == EEXIST) {
+            op = EPOLL_CTL_MOD;
+            result = epoll_ctl(pdata->efd, op, sock, &ev);
+        }
+        if (result != 0) {
+            Ns_Log(Warning, "PollWait: epoll_ctl() op %d on fd %d failed: %s",
+                   op, sock, strerror(errno));
+        }
+    }
+}
+
+static int
+EpollWait(PollData *pdata, int timeout)
+{
+    struct epoll_event *events;
+    unsigned int        i, round;
+    int                 n;
+
+    NS_NONNULL_ASSERT(pdata != NULL);
+
+    round = ++pdata->round;
+
+    if (pdata->maxevents < pdata->maxfds) {
+        pdata->maxevents = pdata->maxfds;
+        pdata->events = ns_realloc(pdata->events, pdata->maxevents * sizeof(struct epoll_event));
+        pdata->regFds = ns_realloc(pdata->regFds, pdata->maxevents * sizeof(NS_SOCKET) * 2u);
+    }
+
+    /*
+     * Register new and changed sockets. The new set of registered fds is
+     * collected in the second half of the regFds array.
+     */
+    {
+        NS_SOCKET *newFds = pdata->regFds + pdata->maxevents;
+        unsigned int nNewFds = 0u;
+
+        for (i = 0u; i < pdata->nfds; i++) {
+            NS_SOCKET    sock = pdata->pfds[i].fd;
+            short        type = pdata->pfds[i].events;
+            PollFdState *statePtr;
+
+            if (unlikely(sock == NS_INVALID_SOCKET)) {
+                /*
+                 * Like poll(), ignore invalid fds.
+                 */
+                continue;
+            }
+            if ((size_t)sock >= pdata->nfdState) {
+                size_t oldSize = pdata->nfdState;
+
+                pdata->nfdState = MAX((size_t)sock + 1u, oldSize * 2u);
+                pdata->fdState = ns_realloc(pdata->fdState, pdata->nfdState * sizeof(PollFdState));
+                memset(pdata->fdState + oldSize, 0, (pdata->nfdState - oldSize) * sizeof(PollFdState));
+            }
+            statePtr = &pdata->fdState[sock];
+
+            if (unlikely(statePtr->round == round)) {
+                /*
+                 * Same fd requested twice in this spin; merge the events.
+                 */
+                if ((statePtr->events | type) != statePtr->events) {
+                    statePtr->events |= type;
+                    EpollCtl(pdata, EPOLL_CTL_MOD, sock, statePtr->events);
+                }
+                continue;
+            }
+            statePtr->round = round;
+            statePtr->index = i;
+
+            if (!statePtr->registered) {
+                EpollCtl(pdata, EPOLL_CTL_ADD, sock, type);
+            } else if (statePtr->events != type || statePtr->token != pdata->tokens[i]) {
+                EpollCtl(pdata, EPOLL_CTL_MOD, sock, type);
+            }
+            statePtr->registered = NS_TRUE;
+            statePtr->events = type;
+            statePtr->token = pdata->tokens[i];
+            newFds[nNewFds++] = sock;
+        }
+
+        /*
+         * Remove the sockets not requested anymore.
+         */
+        for (i = 0u; i < pdata->nregFds; i++) {
+            PollFdState *statePtr = &pdata->fdState[pdata->regFds[i]];
+
+            if (statePtr->round != round && statePtr->registered) {
+                statePtr->registered = NS_FALSE;
+                if (epoll_ctl(pdata->efd, EPOLL_CTL_DEL, pdata->regFds[i], NULL) != 0
+                    && errno != ENOENT && errno != EBADF) {
+                    Ns_Log(Warning, "PollWait: epoll_ctl() delete of fd %d failed: %s",
+                           pdata->regFds[i], strerror(errno));
+                }
+            }
+        }
+        memcpy(pdata->regFds, newFds, nNewFds * sizeof(NS_SOCKET));
+        pdata->nregFds = nNewFds;
+    }
+
+    events = pdata->events;
+    do {
+        n = epoll_wait(pdata->efd, events, (int)MAX(pdata->maxevents, 1u), timeout);
+    } while (n < 0  && errno == NS_EINTR);
+
+    if (n < 0) {
+        Ns_Fatal("PollWait: epoll_wait() failed: %s", strerror(errno));
+    }
+
+    for (i = 0u; i < (unsigned int)n; i++) {
+        const PollFdState *statePtr;
+        short              revents = 0;
+
+        if (unlikely((size_t)events[i].data.fd >= pdata->nfdState)) {
+            continue;
+        }
+        statePtr = &pdata->fdState[events[i].data.fd];
+        if (unlikely(statePtr->round != round)) {
+            continue;
+        }
+
+        if ((events[i].events & (uint32_t)EPOLLIN) != 0u) {
+            revents |= POLLIN;
+        }
+        if ((events[i].events & (uint32_t)EPOLLOUT) != 0u) {
+            revents |= POLLOUT;
+        }
+        if ((events[i].events & (uint32_t)EPOLLHUP) != 0u) {
+            revents |= POLLHUP;
+        }
+        if ((events[i].events & (uint32_t)EPOLLERR) != 0u) {
+            revents |= POLLERR;
+        }
+        pdata->pfds[statePtr->index].revents = revents;
+    }
+
+    return n;
+}
+#endif
+
 /*
  *----------------------------------------------------------------------
  *
@@ -3250,6 +3684,7 @@ SockPoll(Sock *sockPtr, short type, PollData *pdata)
     NS_NONNULL_ASSERT(pdata != NULL);
 
     sockPtr->pidx = PollSet(pdata, sockPtr->sock, type, &sockPtr->timeout);
+    pdata->tokens[sockPtr->pidx] = sockPtr->pollToken;
 }
 
 /*
@@ -3331,6 +3766,7 @@ SockAccept(Driver *drvPtr, NS_SOCKET sock, Sock **sockPtrPtr, const Ns_Time *now
 
     } else {
         sockPtr->acceptTime = *nowPtr;
+        sockPtr->pollToken = ++drvPtr->pollTokens;
         drvPtr->queuesize++;
 
         if (status == NS_DRIVER_ACCEPT_DATA) {
@@ -3598,6 +4034,11 @@ SockError(Sock *sockPtr, SockState reason, int err)
             SockSendResponse(sockPtr, 503, errMsg, NULL);
         }
         break;
+
+    case SOCK_HTTP2PREFACE:
+        errMsg = "HTTP/2 Not Supported";
+        SockSendHttp2GoAway(sockPtr);
+        break;
     }
 
     if (errMsg != NULL) {
@@ -3859,6 +4300,57 @@ SockSendResponse(Sock *sockPtr, int statusCode, const char *errMsg, const char *
     }
 }
 
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SockSendHttp2GoAway --
+ *
+ *      Reject an HTTP/2 connection preface. HTTP/2 is not implemented by
+ *      the driver (only ALPN negotiation of HTTP/1.x is), so send the
+ *      mandatory (empty) server SETTINGS frame followed by a GOAWAY frame
+ *      with the error code HTTP_1_1_REQUIRED (RFC 9113, section 7) before
+ *      the connection is closed. The request fails, but the client gets
+ *      an error it can report instead of waiting for a timeout or trying
+ *      to parse an HTTP/1.1 error response. Whether it retries via
+ *      HTTP/1.1 on a new connection is up to the client.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Writes to the client socket.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+SockSendHttp2GoAway(Sock *sockPtr)
+{
+    static const unsigned char frames[] = {
+        /* SETTINGS: length 0, type 0x4, flags 0, stream 0 */
+        0x00u, 0x00u, 0x00u, 0x04u, 0x00u, 0x00u, 0x00u, 0x00u, 0x00u,
+        /* GOAWAY: length 8, type 0x7, flags 0, stream 0 */
+        0x00u, 0x00u, 0x08u, 0x07u, 0x00u, 0x00u, 0x00u, 0x00u, 0x00u,
+        /* last stream id 0, error code HTTP_1_1_REQUIRED (0xd) */
+        0x00u, 0x00u, 0x00u, 0x00u, 0x00u, 0x00u, 0x00u, 0x0du
+    };
+    struct iovec iov[1];
+    ssize_t      sent;
+
+    NS_NONNULL_ASSERT(sockPtr != NULL);
+
+    NsAddNslogEntry(sockPtr, 505, NULL, NULL);
+
+    iov[0].iov_base = (void *)frames;
+    iov[0].iov_len  = sizeof(frames);
+    sent = NsDriverSend(sockPtr, iov, 1, 0u);
+    if (sent < (ssize_t)sizeof(frames)) {
+        Ns_Log(Warning, "Driver: partial write while sending HTTP/2 GOAWAY;"
+               " %" PRIdz " < %" PRIuz, sent, sizeof(frames));
+    }
+}
+
 
 /*
  *----------------------------------------------------------------------
@@ -4456,29 +4948,20 @@ EndOfHeader(Sock *sockPtr)
      *
      * Clear compression accepted flag
      */
-    sockPtr->flags &= ~(NS_CONN_ZIPACCEPTED|NS_CONN_BROTLIACCEPTED);
+    sockPtr->flags &= ~(NS_CONN_ZIPACCEPTED|NS_CONN_BROTLIACCEPTED|NS_CONN_ZSTDACCEPTED);
 
     s = Ns_SetIGet(reqPtr->headers, "Accept-Encoding");
     if (s != NULL) {
-        bool gzipAccept, brotliAccept;
-
         /*
          * Get allowed compression formats from "accept-encoding" headers.
          */
-        NsParseAcceptEncoding(reqPtr->request.version, s, &gzipAccept, &brotliAccept);
-        if (gzipAccept || brotliAccept) {
-            /*
-             * Don't allow compression formats for Range requests.
-             */
-            s = Ns_SetIGet(reqPtr->headers, "Range");
-            if (s == NULL) {
-                if (gzipAccept) {
-                    sockPtr->flags |= NS_CONN_ZIPACCEPTED;
-                }
-                if (brotliAccept) {
-                    sockPtr->flags |= NS_CONN_BROTLIACCEPTED;
-                }
-            }
+        unsigned int acceptFlags = NsParseAcceptEncoding(reqPtr->request.version, s);
+
+        /*
+         * Don't allow compression formats for Range requests.
+         */
+        if (acceptFlags != 0u && Ns_SetIGet(reqPtr->headers, "Range") == NULL) {
+            sockPtr->flags |= acceptFlags;
         }
     }
 
@@ -4842,6 +5325,20 @@ SockParse(Sock *sockPtr)
                  */
                 Ns_Log(DriverDebug, "SockParse (%d): parse request line <%s>", sockPtr->sock, s);
 
+                if (unlikely(*s == 'P')
+                    && (e - s) == 14
+                    && memcmp(s, "PRI * HTTP/2.0", 14u) == 0
+                    ) {
+                    /*
+                     * HTTP/2 connection preface (prior knowledge, RFC
+                     * 9113 section 3.3). Such a client cannot parse an
+                     * HTTP/1.1 error response, so the connection is
+                     * rejected with an HTTP/2 GOAWAY frame.
+                     */
+                    *e = save;
+                    return SOCK_HTTP2PREFACE;
+                }
+
                 if (Ns_ParseRequest(&reqPtr->request, s, (size_t)(e-s)) == NS_ERROR) {
                     /*
                      * Invalid request.
@@ -5559,7 +6056,7 @@ SpoolerThread(void *arg)
 
     Ns_Log(Notice, "spooler%d: accepting connections", queuePtr->id);
 
-    PollCreate(&pdata);
+    PollCreate(&pdata, queuePtr->eventBackend);
     Ns_GetTime(&now);
 
     while (!stopping) {
@@ -5652,6 +6149,7 @@ SpoolerThread(void *arg)
                 case SOCK_TOOMANYHEADERS: NS_FALL_THROUGH; /* fall through */
                 case SOCK_WRITEERROR:     NS_FALL_THROUGH; /* fall through */
                 case SOCK_QUEUEFULL:      NS_FALL_THROUGH; /* fall through */
+                case SOCK_HTTP2PREFACE:   NS_FALL_THROUGH; /* fall through */
                 case SOCK_WRITETIMEOUT:
                     SockRelease(sockPtr, n, errno);
                     queuePtr->queuesize--;
@@ -6216,36 +6714,32 @@ WriterReadFromSpool(WriterSock *curPtr) {
 /*
  *----------------------------------------------------------------------
  *
- * WriterSend --
+ * WriterSendPrepare --
  *
- *      Utility function of the WriterThread to send content to the client. It
- *      handles partial write operations from the lower level driver
- *      infrastructure.
+ *      Utility function of the WriterThread to determine the buffers for
+ *      the next send operation. For file based sends, the single buffer
+ *      refers to curPtr->c.file.buf, for memory based sends, the scratch
+ *      buffers are filled up from the source buffers.
  *
  * Results:
- *      either NS_OK or SOCK_ERROR;
+ *      Number of bytes to be written, buffers and number of buffers in
+ *      the last two arguments.
  *
  * Side effects:
- *      Sends data, might reshuffle iovec.
+ *      Might reshuffle iovec.
  *
  *----------------------------------------------------------------------
  */
 
-static SpoolerState
-WriterSend(WriterSock *curPtr, int *err) {
-    const struct iovec *bufs;
-    struct iovec        vbuf;
-    int                 nbufs;
-    SpoolerState        status = SPOOLER_OK;
-    size_t              toWrite;
-    ssize_t             n;
+static size_t
+WriterSendPrepare(WriterSock *curPtr, const struct iovec **bufsPtr, int *nbufsPtr)
+{
+    size_t toWrite;
 
     NS_NONNULL_ASSERT(curPtr != NULL);
-    NS_NONNULL_ASSERT(err != NULL);
+    NS_NONNULL_ASSERT(bufsPtr != NULL);
+    NS_NONNULL_ASSERT(nbufsPtr != NULL);
 
-    /*
-     * Prepare send operation
-     */
     if (curPtr->fd != NS_INVALID_FD) {
         /*
          * We have a valid file descriptor, send data from file.
@@ -6253,10 +6747,10 @@ WriterSend(WriterSock *curPtr, int *err) {
          * Prepare sending a single buffer with curPtr->c.file.bufsize bytes
          * from the curPtr->c.file.buf to the client.
          */
-        vbuf.iov_len = curPtr->c.file.bufsize;
-        vbuf.iov_base = (void *)curPtr->c.file.buf;
-        bufs = &vbuf;
-        nbufs = 1;
+        curPtr->vbuf.iov_len = curPtr->c.file.bufsize;
+        curPtr->vbuf.iov_base = (void *)curPtr->c.file.buf;
+        *bufsPtr = &curPtr->vbuf;
+        *nbufsPtr = 1;
         toWrite = curPtr->c.file.bufsize;
     } else {
         int i;
@@ -6293,19 +6787,42 @@ WriterSend(WriterSock *curPtr, int *err) {
             curPtr->c.mem.bufIdx++;
         }
 
-        bufs  = curPtr->c.mem.sbufs;
-        nbufs = curPtr->c.mem.nsbufs;
+        *bufsPtr  = curPtr->c.mem.sbufs;
+        *nbufsPtr = curPtr->c.mem.nsbufs;
         Ns_Log(DriverDebug, "### Writer wants to send %d bufs size %" PRIdz,
-               nbufs, toWrite);
+               *nbufsPtr, toWrite);
     }
 
-    /*
-     * Perform the actual send operation.
-     */
-    n = NsDriverSend(curPtr->sockPtr, bufs, nbufs, 0u);
+    return toWrite;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * WriterSendDone --
+ *
+ *      Utility function of the WriterThread to update the state of the
+ *      WriterSock after a send operation of "n" bytes out of "toWrite"
+ *      bytes. It handles partial write operations from the lower level
+ *      driver infrastructure.
+ *
+ * Results:
+ *      either SPOOLER_OK or SPOOLER_WRITEERROR;
+ *
+ * Side effects:
+ *      Might reshuffle iovec.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static SpoolerState
+WriterSendDone(WriterSock *curPtr, ssize_t n, size_t toWrite)
+{
+    SpoolerState status = SPOOLER_OK;
+
+    NS_NONNULL_ASSERT(curPtr != NULL);
 
     if (n == -1) {
-        *err = ns_sockerrno;
         status = SPOOLER_WRITEERROR;
     } else {
         /*
@@ -6351,6 +6868,185 @@ WriterSend(WriterSock *curPtr, int *err) {
     return status;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * WriterSend --
+ *
+ *      Utility function of the WriterThread to send content to the client
+ *      via the driver's send callback.
+ *
+ * Results:
+ *      either NS_OK or SOCK_ERROR;
+ *
+ * Side effects:
+ *      Sends data, might reshuffle iovec.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static SpoolerState
+WriterSend(WriterSock *curPtr, int *err) {
+    const struct iovec *bufs;
+    int                 nbufs;
+    size_t              toWrite;
+    ssize_t             n;
+
+    NS_NONNULL_ASSERT(curPtr != NULL);
+    NS_NONNULL_ASSERT(err != NULL);
+
+    /*
+     * Prepare send operation
+     */
+    toWrite = WriterSendPrepare(curPtr, &bufs, &nbufs);
+
+    /*
+     * Perform the actual send operation.
+     */
+    n = NsDriverSend(curPtr->sockPtr, bufs, nbufs, 0u);
+    if (n == -1) {
+        *err = ns_sockerrno;
+    }
+
+    return WriterSendDone(curPtr, n, toWrite);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * WriterSendFile --
+ *
+ *      Utility function of the WriterThread to send file content
+ *      directly via the driver's sendFileProc instead of reading it
+ *      into the writer buffer first. This is used for drivers flagged
+ *      with NS_DRIVER_WRITER_SENDFILE (e.g., TLS drivers with kernel
+ *      TLS offload, where SSL_sendfile() avoids the user-space copy).
+ *      The caller has to make sure that there is no leftover in
+ *      curPtr->c.file.buf and that the request is not streaming.
+ *
+ * Results:
+ *      either SPOOLER_OK or SPOOLER_WRITEERROR;
+ *
+ * Side effects:
+ *      Sends data, advances the file position and might switch to the
+ *      next file of an Ns_FileVec.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static SpoolerState
+WriterSendFile(WriterSock *curPtr, int *err) {
+    Ns_FileVec  vec;
+    size_t      toSend;
+    off_t       offset;
+    ssize_t     n;
+
+    NS_NONNULL_ASSERT(curPtr != NULL);
+    NS_NONNULL_ASSERT(err != NULL);
+
+    toSend = curPtr->c.file.toRead;
+    if (curPtr->c.file.nbufs > 0
+        && toSend > curPtr->c.file.bufs[curPtr->c.file.currentbuf].length) {
+        toSend = curPtr->c.file.bufs[curPtr->c.file.currentbuf].length;
+    }
+    if (toSend > curPtr->c.file.maxsize) {
+        /*
+         * Send at most a writer buffer per round to keep the writer
+         * fair between its sockets.
+         */
+        toSend = curPtr->c.file.maxsize;
+    }
+
+    offset = ns_lseek(curPtr->fd, 0, SEEK_CUR);
+    if (offset == -1) {
+        *err = errno;
+        return SPOOLER_WRITEERROR;
+    }
+    (void) Ns_SetFileVec(&vec, 0, curPtr->fd, NULL, offset, toSend);
+
+    n = NsDriverSendFile(curPtr->sockPtr, &vec, 1, 0u);
+    if (n == -1) {
+        *err = ns_sockerrno;
+        return SPOOLER_WRITEERROR;
+    }
+
+    if (n > 0) {
+        (void) ns_lseek(curPtr->fd, offset + (off_t)n, SEEK_SET);
+        curPtr->c.file.toRead -= (size_t)n;
+        curPtr->size -= (size_t)n;
+        curPtr->nsent += n;
+        curPtr->sockPtr->timeout.sec = 0;
+
+        if (curPtr->c.file.nbufs > 0) {
+            TCL_SIZE_T currentbuf = curPtr->c.file.currentbuf;
+
+            curPtr->c.file.bufs[currentbuf].length -= (size_t)n;
+            if (curPtr->c.file.bufs[currentbuf].length == 0u
+                && currentbuf < curPtr->c.file.nbufs - 1) {
+                /*
+                 * All sent from this segment, setup next one.
+                 */
+                ns_close(curPtr->fd);
+                curPtr->c.file.bufs[currentbuf].fd = NS_INVALID_FD;
+
+                curPtr->c.file.currentbuf ++;
+                curPtr->fd = curPtr->c.file.bufs[curPtr->c.file.currentbuf].fd;
+            }
+        }
+    }
+
+    return SPOOLER_OK;
+}
+
+#ifdef HAVE_LINUX_IO_URING_H
+/*
+ *----------------------------------------------------------------------
+ *
+ * WriterSendUring --
+ *
+ *      Utility function of the WriterThread to queue the next send
+ *      operation in the io_uring of the writer thread. The result is
+ *      processed via WriterSendDone() after the ring was submitted.
+ *      This is only possible for drivers allowing the writer to send
+ *      the buffers unmodified (NS_DRIVER_WRITER_URING). The sendProc
+ *      of the driver is still used for all other send operations.
+ *
+ * Results:
+ *      NS_TRUE, when the send operation was queued, NS_FALSE when the
+ *      ring is full.
+ *
+ * Side effects:
+ *      Might reshuffle iovec.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static bool
+WriterSendUring(WriterSock *curPtr, NsUring *ringPtr) {
+    const struct iovec *bufs;
+    int                 nbufs;
+    bool                success;
+
+    NS_NONNULL_ASSERT(curPtr != NULL);
+    NS_NONNULL_ASSERT(ringPtr != NULL);
+
+    curPtr->uringToWrite = WriterSendPrepare(curPtr, &bufs, &nbufs);
+
+    memset(&curPtr->uringMsg, 0, sizeof(curPtr->uringMsg));
+    curPtr->uringMsg.msg_iov = (struct iovec *)bufs;
+    curPtr->uringMsg.msg_iovlen = (NS_MSG_IOVLEN_T)nbufs;
+
+    /*
+     * When the ring is full, the caller falls back to WriterSend(). Since
+     * WriterSendPrepare() only fills up the scratch buffers, calling it
+     * again is harmless.
+     */
+    success = NsUringPrepSendmsg(ringPtr, curPtr->sockPtr->sock, &curPtr->uringMsg, curPtr);
+
+    return success;
+}
+#endif
+
 /*
  *----------------------------------------------------------------------
  *
@@ -6527,6 +7223,59 @@ WriterPerPoolRates(WriterSock *writePtr, Tcl_HashTable *pools)
     }
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * WriterSockFinish --
+ *
+ *      Check result status of a send operation of the WriterThread. Keep
+ *      the WriterSock in the list of active writers when there is more to
+ *      send, otherwise release it (on completion, timeout or error).
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Updates the list of active writers, might release the WriterSock.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+WriterSockFinish(SpoolerQueue *queuePtr, WriterSock *curPtr, SpoolerState spoolerState,
+                 int err, NsWriterStreamState doStream, WriterSock **writePtrPtr)
+{
+    NS_NONNULL_ASSERT(queuePtr != NULL);
+    NS_NONNULL_ASSERT(curPtr != NULL);
+    NS_NONNULL_ASSERT(writePtrPtr != NULL);
+
+    Ns_MutexLock(&queuePtr->lock);
+    if (spoolerState == SPOOLER_OK) {
+        if (curPtr->size > 0u || doStream == NS_WRITER_STREAM_ACTIVE) {
+            Ns_Log(DriverDebug,
+                   "Writer %p continue OK (size %" PRIdz ") => PUSH",
+                   (void *)curPtr, curPtr->size);
+            Push(curPtr, *writePtrPtr);
+        } else {
+            Ns_Log(DriverDebug,
+                   "Writer %p done OK (size %" PRIdz ") => RELEASE",
+                   (void *)curPtr, curPtr->size);
+            WriterSockRelease(curPtr);
+        }
+    } else {
+        /*
+         * spoolerState might be SPOOLER_CLOSE or SPOOLER_*TIMEOUT, or SPOOLER_*ERROR
+         */
+        Ns_Log(DriverDebug,
+               "Writer %p fd %d release, not OK (status %d) => RELEASE",
+               (void *)curPtr, curPtr->sockPtr->sock, (int)spoolerState);
+        curPtr->status = spoolerState;
+        curPtr->err    = err;
+        WriterSockRelease(curPtr);
+    }
+    Ns_MutexUnlock(&queuePtr->lock);
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -6556,6 +7305,8 @@ WriterThread(void *arg)
     WriterSock     *curPtr, *nextPtr, *writePtr = NULL;
     PollData        pdata;
     Tcl_HashTable   pools;     /* used for accumulating bandwidth per pool */
+    NsUring        *ringPtr = NULL;
+    NsUringResult  *uringResults = NULL;
 
     Ns_ThreadSetName("-writer%d-", queuePtr->id);
     queuePtr->threadName = Ns_ThreadGetName();
@@ -6569,10 +7320,23 @@ WriterThread(void *arg)
 
     Ns_Log(Notice, "writer%d: accepting connections", queuePtr->id);
 
-    PollCreate(&pdata);
+    PollCreate(&pdata, queuePtr->eventBackend);
+
+    if (queuePtr->uring) {
+        ringPtr = NsUringCreate(NS_WRITER_URING_ENTRIES);
+        if (ringPtr != NULL) {
+            uringResults = ns_malloc(NS_WRITER_URING_ENTRIES * sizeof(NsUringResult));
+            queuePtr->uringActive = NS_TRUE;
+            Ns_Log(Notice, "writer%d: using io_uring for batched send operations", queuePtr->id);
+        } else {
+            Ns_Log(Warning, "writer%d: io_uring not available, using regular send operations",
+                   queuePtr->id);
+        }
+    }
 
     while (!stopping) {
         char charBuffer[1];
+        int  uringQueued = 0;
 
         /*
          * If there are any write sockets, set the bits.
@@ -6774,11 +7538,36 @@ WriterThread(void *arg)
                      * If we are spooling from a file, read some data
                      * from the (spool) file and place it into curPtr->c.file.buf.
                      */
-                    if (curPtr->fd != NS_INVALID_FD) {
+                    bool sendFile = (curPtr->fd != NS_INVALID_FD
+                                     && doStream == NS_WRITER_STREAM_NONE
+                                     && curPtr->c.file.bufsize == 0u
+                                     && (sockPtr->drvPtr->opts & NS_DRIVER_WRITER_SENDFILE) != 0u);
+                    if (sendFile) {
+                        /*
+                         * No leftover is pending in the buffer, let the
+                         * driver send the file content directly.
+                         */
+                        spoolerState = WriterSendFile(curPtr, &err);
+
+                    } else if (curPtr->fd != NS_INVALID_FD) {
                         spoolerState = WriterReadFromSpool(curPtr);
                     }
 
-                    if (spoolerState == SPOOLER_OK) {
+                    if (spoolerState == SPOOLER_OK && !sendFile) {
+#ifdef HAVE_LINUX_IO_URING_H
+                        if (ringPtr != NULL
+                            && (sockPtr->drvPtr->opts & NS_DRIVER_WRITER_URING) != 0u
+                            && WriterSendUring(curPtr, ringPtr)) {
+                            /*
+                             * The send operation is queued in the ring, the
+                             * result is processed after the ring was
+                             * submitted below.
+                             */
+                            uringQueued++;
+                            curPtr = nextPtr;
+                            continue;
+                        }
+#endif
                         spoolerState = WriterSend(curPtr, &err);
                     }
                 }
@@ -6801,38 +7590,51 @@ WriterThread(void *arg)
                 }
             }
 
-            /*
-             * Check result status and close the socket in case of
-             * timeout or completion
-             */
+            WriterSockFinish(queuePtr, curPtr, spoolerState, err, doStream, &writePtr);
+            curPtr = nextPtr;
+        }
 
-            Ns_MutexLock(&queuePtr->lock);
-            if (spoolerState == SPOOLER_OK) {
-                if (curPtr->size > 0u || doStream == NS_WRITER_STREAM_ACTIVE) {
-                    Ns_Log(DriverDebug,
-                           "Writer %p continue OK (size %" PRIdz ") => PUSH",
-                           (void *)curPtr, curPtr->size);
-                    Push(curPtr, writePtr);
+#ifdef HAVE_LINUX_IO_URING_H
+        /*
+         * Submit all queued send operations with a single system call and
+         * process the results.
+         */
+        if (uringQueued > 0) {
+            int i, nrResults;
+
+            nrResults = NsUringSubmit(ringPtr, uringResults, NS_WRITER_URING_ENTRIES);
+            Ns_Log(DriverDebug, "### Writer submitted %d send operations via io_uring, got %d results",
+                   uringQueued, nrResults);
+
+            for (i = 0; i < nrResults; i++) {
+                ssize_t      n = (ssize_t)uringResults[i].result;
+                SpoolerState spoolerState;
+
+                curPtr = (WriterSock *)uringResults[i].userData;
+                err = 0;
+                if (!uringResults[i].submitted) {
+                    /*
+                     * The ring refused the operation, fall back to the
+                     * regular send operation.
+                     */
+                    queuePtr->uringFallbacks++;
+                    spoolerState = WriterSend(curPtr, &err);
                 } else {
-                    Ns_Log(DriverDebug,
-                           "Writer %p done OK (size %" PRIdz ") => RELEASE",
-                           (void *)curPtr, curPtr->size);
-                    WriterSockRelease(curPtr);
+                    queuePtr->uringSends++;
+                    if (n < 0) {
+                        if (n == -EAGAIN || n == -EINTR) {
+                            n = 0;
+                        } else {
+                            err = (int)-n;
+                            n = -1;
+                        }
+                    }
+                    spoolerState = WriterSendDone(curPtr, n, curPtr->uringToWrite);
                 }
-            } else {
-                /*
-                 * spoolerState might be SPOOLER_CLOSE or SPOOLER_*TIMEOUT, or SPOOLER_*ERROR
-                 */
-                Ns_Log(DriverDebug,
-                       "Writer %p fd %d release, not OK (status %d) => RELEASE",
-                       (void *)curPtr, curPtr->sockPtr->sock, (int)spoolerState);
-                curPtr->status = spoolerState;
-                curPtr->err    = err;
-                WriterSockRelease(curPtr);
+                WriterSockFinish(queuePtr, curPtr, spoolerState, err, curPtr->doStream, &writePtr);
             }
-            Ns_MutexUnlock(&queuePtr->lock);
-            curPtr = nextPtr;
         }
+#endif
 
         /*
          * Add more sockets to the writer queue
@@ -6863,6 +7665,10 @@ WriterThread(void *arg)
         stopping = queuePtr->shutdown;
     }
     PollFree(&pdata);
+    if (ringPtr != NULL) {
+        NsUringFree(ringPtr);
+        ns_free(uringResults);
+    }
 
     {
         /*
@@ -8549,7 +9355,7 @@ AsyncWriterThread(void *arg)
      * Allocate and initialize controlling variables
      */
 
-    PollCreate(&pdata);
+    PollCreate(&pdata, NS_EVENT_BACKEND_POLL);
 
     /*
      * Loop forever until signaled to shutdown and all
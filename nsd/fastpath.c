@@ -37,6 +37,32 @@ typedef struct {
     char   bytes[1];  /* Grown to actual file size. */
 } File;
 
+/*
+ * The following structure defines a job of the background compression
+ * queue: produce the compressed file "target" from the file "source" via
+ * the Tcl command "cmdName" (e.g. "::ns_gzipfile").
+ */
+
+typedef struct CompressJob {
+    struct CompressJob *nextPtr;
+    const char         *server;
+    const char         *cmdName;
+    char               *source;
+    char               *target;
+} CompressJob;
+
+/*
+ * The following structure defines the arguments for pre-compressing the
+ * pageroot of a server at startup.
+ */
+
+typedef struct PrecompressInfo {
+    const char  *server;
+    const char  *pageroot;
+    TCL_SIZE_T   extc;
+    const char **extv;
+} PrecompressInfo;
+
 
 /*
  * Local functions defined in this file
@@ -60,6 +86,22 @@ static int  CompressExternalFile(Tcl_Interp *interp, const char *cmdName, const
 static void NormalizePath(const char **pathPtr)
     NS_GNUC_NONNULL(1);
 
+static bool CompressedFileOutdated(const char *source, const char *target)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+
+static bool CompressQueueAdd(const char *server, const char *cmdName,
+                             const char *source, const char *target, bool wait)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(3) NS_GNUC_NONNULL(4);
+
+static void CompressJobRun(const CompressJob *jobPtr)
+    NS_GNUC_NONNULL(1);
+
+static void CompressJobFree(CompressJob *jobPtr)
+    NS_GNUC_NONNULL(1);
+
+static int PrecompressDirectory(const PrecompressInfo *infoPtr, Tcl_DString *dsPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+
 static const char *
 CheckStaticCompressedDelivery(
     Ns_Conn *conn,
@@ -74,6 +116,10 @@ CheckStaticCompressedDelivery(
 
 static Ns_Callback FreeEntry;
 static Ns_ServerInitProc ConfigServerFastpath;
+static Ns_ThreadProc CompressThread;
+static Ns_ThreadProc PrecompressThread;
+static Ns_Callback PrecompressStart;
+static Ns_ShutdownProc CompressQueueShutdown;
 
 
 /*
@@ -87,6 +133,31 @@ static bool      useGzip = NS_FALSE;          /* Use gzip delivery if possible
 static bool      useGzipRefresh = NS_FALSE;   /* Update outdated gzip files automatically via ::ns_gzipfile */
 static bool      useBrotli = NS_FALSE;        /* Use brotli delivery if possible                      */
 static bool      useBrotliRefresh = NS_FALSE; /* Update outdated brotli files automatically via ::ns_brotlifile */
+static bool      useRefreshAsync = NS_FALSE;  /* Refresh outdated compressed files in background threads */
+static bool      haveGzipCmd = NS_FALSE;      /* Parameter "gzip_cmd" is configured */
+static bool      haveBrotliCmd = NS_FALSE;    /* Parameter "brotli_cmd" is configured */
+
+/*
+ * Background compression queue, shared by all servers. The hash table
+ * "pending" contains the names of all target files which are either
+ * queued or currently being compressed, such that every file is
+ * compressed at most once at a time.
+ */
+
+static struct {
+    Ns_Mutex       lock;
+    Ns_Cond        cond;
+    CompressJob   *firstPtr;
+    CompressJob   *lastPtr;
+    Tcl_HashTable  pending;
+    int            size;        /* Number of queued jobs */
+    int            maxSize;     /* Maximum number of queued jobs */
+    int            maxThreads;  /* Maximum number of compress threads */
+    int            nThreads;    /* Number of running compress threads */
+    int            nIdle;       /* Number of idle compress threads */
+    int            nWalkers;    /* Number of running precompress threads */
+    bool           shutdown;
+} compressQueue;
 
 
 
@@ -117,6 +188,21 @@ NsConfigFastpath(void)
     useGzipRefresh = Ns_ConfigBool(path, "gzip_refresh", NS_FALSE);
     useBrotli = Ns_ConfigBool(path, "brotli_static", NS_FALSE);
     useBrotliRefresh = Ns_ConfigBool(path, "brotli_refresh", NS_FALSE);
+    useRefreshAsync = Ns_ConfigBool(path, "refresh_async", NS_FALSE);
+    haveGzipCmd = (*Ns_ConfigString(path, "gzip_cmd", NS_EMPTY_STRING) != '\0');
+    haveBrotliCmd = (*Ns_ConfigString(path, "brotli_cmd", NS_EMPTY_STRING) != '\0');
+
+    /*
+     * Background compression queue, used for refreshing outdated
+     * compressed files and for pre-compressing pageroots.
+     */
+    compressQueue.maxSize = Ns_ConfigIntRange(path, "compress_queuesize", 100, 1, INT_MAX);
+    compressQueue.maxThreads = Ns_ConfigIntRange(path, "compress_threads", 2, 1, 64);
+    Ns_MutexInit(&compressQueue.lock);
+    Ns_MutexSetName(&compressQueue.lock, "ns:fastpath:compress");
+    Ns_CondInit(&compressQueue.cond);
+    Tcl_InitHashTable(&compressQueue.pending, TCL_STRING_KEYS);
+    (void)Ns_RegisterAtShutdown(CompressQueueShutdown, NULL);
 
     if (Ns_ConfigBool(path, "cache", NS_FALSE)) {
         size_t size = (size_t)Ns_ConfigMemUnitRange(path, "cachemaxsize", "10MB",
@@ -253,6 +339,21 @@ ConfigServerFastpath(const char *server)
         servPtr->fastpath.dirproc = ns_strcopy(Ns_ConfigString(path, "directoryproc", "_ns_dirlist"));
         servPtr->fastpath.diradp  = ns_strcopy(Ns_ConfigString(path, "directoryadp", NULL));
 
+        if (Ns_ConfigBool(path, "precompress", NS_FALSE)) {
+            PrecompressInfo *infoPtr = ns_calloc(1u, sizeof(PrecompressInfo));
+
+            infoPtr->server = servPtr->server;
+            infoPtr->pageroot = servPtr->fastpath.pageroot;
+            p = Ns_ConfigString(path, "precompress_extensions",
+                                ".html .htm .css .js .mjs .json .svg .txt .xml");
+            if (Tcl_SplitList(NULL, p, &infoPtr->extc, &infoPtr->extv) != TCL_OK) {
+                Ns_Log(Error, "fastpath[%s]: precompress_extensions is not a list: %s", server, p);
+                ns_free(infoPtr);
+            } else {
+                (void)Ns_RegisterAtStartup(PrecompressStart, infoPtr);
+            }
+        }
+
         Ns_RegisterRequest(server, "GET", "/",  Ns_FastPathProc, NULL, NULL, 0u);
         Ns_RegisterRequest(server, "HEAD", "/", Ns_FastPathProc, NULL, NULL, 0u);
         Ns_RegisterRequest(server, "POST", "/", Ns_FastPathProc, NULL, NULL, 0u);
@@ -568,6 +669,453 @@ CompressExternalFile(Tcl_Interp *interp, const char *cmdName, const char *fileNa
 }
 
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * CompressedFileOutdated --
+ *
+ *      Check, whether the compressed file "target" has to be produced
+ *      from the file "source", i.e., the target does not exist or is
+ *      older than the source.
+ *
+ * Results:
+ *      Boolean value.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+static bool
+CompressedFileOutdated(const char *source, const char *target)
+{
+    struct stat sourceStat, targetStat;
+
+    NS_NONNULL_ASSERT(source != NULL);
+    NS_NONNULL_ASSERT(target != NULL);
+
+    return (Ns_Stat(source, &sourceStat)
+            && (!Ns_Stat(target, &targetStat)
+                || targetStat.st_mtime < sourceStat.st_mtime));
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CompressQueueAdd --
+ *
+ *      Add a job for producing the compressed file "target" to the
+ *      background compression queue, unless the target is already
+ *      queued or being compressed. When the queue is full, the job is
+ *      dropped, unless "wait" is true, where the function waits until
+ *      there is space in the queue. Compress threads are created on
+ *      demand up to the configured maximum.
+ *
+ * Results:
+ *      NS_TRUE, when the job was added to the queue.
+ *
+ * Side effects:
+ *      Might create a compress thread.
+ *
+ *----------------------------------------------------------------------
+ */
+static bool
+CompressQueueAdd(const char *server, const char *cmdName,
+                 const char *source, const char *target, bool wait)
+{
+    bool added = NS_FALSE;
+
+    NS_NONNULL_ASSERT(server != NULL);
+    NS_NONNULL_ASSERT(cmdName != NULL);
+    NS_NONNULL_ASSERT(source != NULL);
+    NS_NONNULL_ASSERT(target != NULL);
+
+    Ns_MutexLock(&compressQueue.lock);
+    while (wait
+           && !compressQueue.shutdown
+           && compressQueue.size >= compressQueue.maxSize) {
+        Ns_CondWait(&compressQueue.cond, &compressQueue.lock);
+    }
+    if (!compressQueue.shutdown && compressQueue.size < compressQueue.maxSize) {
+        int isNew;
+
+        (void) Tcl_CreateHashEntry(&compressQueue.pending, target, &isNew);
+        if (isNew != 0) {
+            CompressJob *jobPtr = ns_malloc(sizeof(CompressJob));
+
+            jobPtr->nextPtr = NULL;
+            jobPtr->server = server;
+            jobPtr->cmdName = cmdName;
+            jobPtr->source = ns_strdup(source);
+            jobPtr->target = ns_strdup(target);
+
+            if (compressQueue.lastPtr == NULL) {
+                compressQueue.firstPtr = jobPtr;
+            } else {
+                compressQueue.lastPtr->nextPtr = jobPtr;
+            }
+            compressQueue.lastPtr = jobPtr;
+            compressQueue.size++;
+
+            if (compressQueue.nIdle == 0
+                && compressQueue.nThreads < compressQueue.maxThreads) {
+                compressQueue.nThreads++;
+                Ns_ThreadCreate(CompressThread, INT2PTR(compressQueue.nThreads), 0, NULL);
+            }
+            Ns_CondBroadcast(&compressQueue.cond);
+            added = NS_TRUE;
+        }
+    } else if (!compressQueue.shutdown) {
+        Ns_Log(Debug, "fastpath: compress queue full, skip %s", target);
+    }
+    Ns_MutexUnlock(&compressQueue.lock);
+
+    return added;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CompressJobRun, CompressJobFree --
+ *
+ *      Run a job of the compression queue in an interpreter of the
+ *      server, and free a job. The compressed file is written first
+ *      to a temporary file and renamed afterwards, such that
+ *      concurrent requests never see a partially written file.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Compressed file in the same directory.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+CompressJobRun(const CompressJob *jobPtr)
+{
+    NS_NONNULL_ASSERT(jobPtr != NULL);
+
+    if (CompressedFileOutdated(jobPtr->source, jobPtr->target)) {
+        Tcl_Interp *interp = Ns_TclAllocateInterp(jobPtr->server);
+
+        if (interp != NULL) {
+            Tcl_DString tmpDs;
+
+            Tcl_DStringInit(&tmpDs);
+            Ns_DStringPrintf(&tmpDs, "%s.%d.%" PRIxPTR, jobPtr->target,
+                             (int)nsconf.pid, Ns_ThreadId());
+            if (CompressExternalFile(interp, jobPtr->cmdName,
+                                     jobPtr->source, tmpDs.string) != TCL_OK) {
+                (void) unlink(tmpDs.string);
+            } else if (rename(tmpDs.string, jobPtr->target) != 0) {
+                Ns_Log(Warning, "fastpath: rename(%s,%s) failed: '%s'",
+                       tmpDs.string, jobPtr->target, strerror(errno));
+                (void) unlink(tmpDs.string);
+            } else {
+                Ns_Log(Notice, "fastpath: compressed %s", jobPtr->target);
+            }
+            Tcl_DStringFree(&tmpDs);
+            Ns_TclDeAllocateInterp(interp);
+        }
+    }
+}
+
+static void
+CompressJobFree(CompressJob *jobPtr)
+{
+    NS_NONNULL_ASSERT(jobPtr != NULL);
+
+    ns_free(jobPtr->source);
+    ns_free(jobPtr->target);
+    ns_free(jobPtr);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CompressThread --
+ *
+ *      Thread processing the jobs of the background compression
+ *      queue until shutdown.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      See CompressJobRun().
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+CompressThread(void *arg)
+{
+    Ns_ThreadSetName("-fastpath:compress%" PRIuPTR "-", (uintptr_t)arg);
+    Ns_Log(Notice, "fastpath: compress thread started");
+
+    Ns_MutexLock(&compressQueue.lock);
+    while (!compressQueue.shutdown) {
+        CompressJob *jobPtr = compressQueue.firstPtr;
+
+        if (jobPtr == NULL) {
+            compressQueue.nIdle++;
+            Ns_CondWait(&compressQueue.cond, &compressQueue.lock);
+            compressQueue.nIdle--;
+
+        } else {
+            Tcl_HashEntry *hPtr;
+
+            compressQueue.firstPtr = jobPtr->nextPtr;
+            if (compressQueue.firstPtr == NULL) {
+                compressQueue.lastPtr = NULL;
+            }
+            compressQueue.size--;
+            /*
+             * Notify waiting precompress threads about the free slot.
+             */
+            Ns_CondBroadcast(&compressQueue.cond);
+            Ns_MutexUnlock(&compressQueue.lock);
+
+            CompressJobRun(jobPtr);
+
+            Ns_MutexLock(&compressQueue.lock);
+            hPtr = Tcl_FindHashEntry(&compressQueue.pending, jobPtr->target);
+            if (hPtr != NULL) {
+                Tcl_DeleteHashEntry(hPtr);
+            }
+            CompressJobFree(jobPtr);
+        }
+    }
+    compressQueue.nThreads--;
+    Ns_CondBroadcast(&compressQueue.cond);
+    Ns_MutexUnlock(&compressQueue.lock);
+
+    Ns_Log(Notice, "fastpath: compress thread exiting");
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CompressQueueShutdown --
+ *
+ *      Shutdown callback of the background compression queue. The
+ *      first call (with toPtr NULL) signals the compress and
+ *      precompress threads to exit and drops the queued jobs, the
+ *      second call waits for the threads until the timeout expires.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Threads exit.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+CompressQueueShutdown(const Ns_Time *toPtr, void *UNUSED(arg))
+{
+    Ns_MutexLock(&compressQueue.lock);
+    if (toPtr == NULL) {
+        CompressJob *jobPtr;
+
+        compressQueue.shutdown = NS_TRUE;
+        while ((jobPtr = compressQueue.firstPtr) != NULL) {
+            compressQueue.firstPtr = jobPtr->nextPtr;
+            CompressJobFree(jobPtr);
+        }
+        compressQueue.lastPtr = NULL;
+        compressQueue.size = 0;
+        Ns_CondBroadcast(&compressQueue.cond);
+        Ns_MutexUnlock(&compressQueue.lock);
+
+    } else {
+        Ns_ReturnCode status = NS_OK;
+
+        while (status == NS_OK
+               && (compressQueue.nThreads > 0 || compressQueue.nWalkers > 0)) {
+            status = Ns_CondTimedWait(&compressQueue.cond, &compressQueue.lock, toPtr);
+        }
+        Ns_MutexUnlock(&compressQueue.lock);
+        if (status != NS_OK) {
+            Ns_Log(Warning, "fastpath: timeout waiting for compress threads to exit");
+        }
+    }
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * PrecompressStart, PrecompressThread --
+ *
+ *      Startup callback launching a thread, which walks the pageroot
+ *      of a server and queues all files with a configured extension,
+ *      for which the compressed variants (for "gzip_static" and
+ *      "brotli_static", when the respective command is configured)
+ *      are missing or outdated. The queued files are compressed in
+ *      parallel by the compress threads.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Compressed files in the pageroot.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+PrecompressStart(void *arg)
+{
+    const PrecompressInfo *infoPtr = arg;
+
+    if ((useGzip && haveGzipCmd) || (useBrotli && haveBrotliCmd)) {
+        Ns_MutexLock(&compressQueue.lock);
+        compressQueue.nWalkers++;
+        Ns_MutexUnlock(&compressQueue.lock);
+        Ns_ThreadCreate(PrecompressThread, arg, 0, NULL);
+    } else {
+        Ns_Log(Warning, "fastpath[%s]: precompress requires gzip_static with gzip_cmd"
+               " or brotli_static with brotli_cmd", infoPtr->server);
+    }
+}
+
+static void
+PrecompressThread(void *arg)
+{
+    const PrecompressInfo *infoPtr = arg;
+    Tcl_DString            ds;
+    int                    nQueued;
+
+    Ns_ThreadSetName("-fastpath:precompress-");
+    Ns_Log(Notice, "fastpath[%s]: precompress files in %s", infoPtr->server, infoPtr->pageroot);
+
+    Tcl_DStringInit(&ds);
+    Tcl_DStringAppend(&ds, infoPtr->pageroot, TCL_INDEX_NONE);
+    nQueued = PrecompressDirectory(infoPtr, &ds);
+    Tcl_DStringFree(&ds);
+
+    Ns_Log(Notice, "fastpath[%s]: precompress queued %d files", infoPtr->server, nQueued);
+
+    Ns_MutexLock(&compressQueue.lock);
+    compressQueue.nWalkers--;
+    Ns_CondBroadcast(&compressQueue.cond);
+    Ns_MutexUnlock(&compressQueue.lock);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * PrecompressDirectory --
+ *
+ *      Recursively walk the directory in dsPtr and queue compress
+ *      jobs for the files with a configured extension. Hidden files
+ *      and directories are skipped, symbolic links are not followed.
+ *
+ * Results:
+ *      Number of queued compress jobs.
+ *
+ * Side effects:
+ *      Might block when the compression queue is full.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+PrecompressDirectory(const PrecompressInfo *infoPtr, Tcl_DString *dsPtr)
+{
+    DIR                 *dp;
+    const struct dirent *ent;
+    TCL_SIZE_T           length;
+    int                  nQueued = 0;
+
+    NS_NONNULL_ASSERT(infoPtr != NULL);
+    NS_NONNULL_ASSERT(dsPtr != NULL);
+
+    dp = opendir(dsPtr->string);
+    if (dp == NULL) {
+        Ns_Log(Warning, "fastpath: precompress could not open directory %s: %s",
+               dsPtr->string, strerror(errno));
+        return 0;
+    }
+    length = dsPtr->length;
+
+    while ((ent = ns_readdir(dp)) != NULL) {
+        struct stat st;
+        int         statResult;
+        bool        shutdown;
+
+        Ns_MutexLock(&compressQueue.lock);
+        shutdown = compressQueue.shutdown;
+        Ns_MutexUnlock(&compressQueue.lock);
+        if (shutdown) {
+            break;
+        }
+        if (ent->d_name[0] == '.') {
+            continue;
+        }
+        Tcl_DStringSetLength(dsPtr, length);
+        Tcl_DStringAppend(dsPtr, "/", 1);
+        Tcl_DStringAppend(dsPtr, ent->d_name, TCL_INDEX_NONE);
+#ifdef _WIN32
+        statResult = stat(dsPtr->string, &st);
+#else
+        statResult = lstat(dsPtr->string, &st);
+#endif
+        if (statResult != 0) {
+            continue;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            nQueued += PrecompressDirectory(infoPtr, dsPtr);
+
+        } else if (S_ISREG(st.st_mode) && st.st_size > 0) {
+            size_t     nameLength = strlen(ent->d_name);
+            TCL_SIZE_T i;
+
+            for (i = 0; i < infoPtr->extc; i++) {
+                size_t extLength = strlen(infoPtr->extv[i]);
+
+                if (nameLength > extLength
+                    && strcmp(ent->d_name + nameLength - extLength, infoPtr->extv[i]) == 0) {
+                    break;
+                }
+            }
+            if (i < infoPtr->extc) {
+                Tcl_DString targetDs;
+
+                Tcl_DStringInit(&targetDs);
+                if (useBrotli && haveBrotliCmd) {
+                    Tcl_DStringAppend(&targetDs, dsPtr->string, dsPtr->length);
+                    Tcl_DStringAppend(&targetDs, ".br", 3);
+                    if (CompressedFileOutdated(dsPtr->string, targetDs.string)
+                        && CompressQueueAdd(infoPtr->server, "::ns_brotlifile",
+                                            dsPtr->string, targetDs.string, NS_TRUE)) {
+                        nQueued++;
+                    }
+                    Tcl_DStringSetLength(&targetDs, 0);
+                }
+                if (useGzip && haveGzipCmd) {
+                    Tcl_DStringAppend(&targetDs, dsPtr->string, dsPtr->length);
+                    Tcl_DStringAppend(&targetDs, ".gz", 3);
+                    if (CompressedFileOutdated(dsPtr->string, targetDs.string)
+                        && CompressQueueAdd(infoPtr->server, "::ns_gzipfile",
+                                            dsPtr->string, targetDs.string, NS_TRUE)) {
+                        nQueued++;
+                    }
+                }
+                Tcl_DStringFree(&targetDs);
+            }
+        }
+    }
+    (void)closedir(dp);
+
+    return nQueued;
+}
+
+
 /*
  *----------------------------------------------------------------------
  *
@@ -630,8 +1178,16 @@ CheckStaticCompressedDelivery(
              * than the modification time of the source, and the
              * configuration file indicates the we have to try to refresh the
              * compressed file (e.g. rezip the source).
+             *
+             * In the asynchronous case, the refresh is performed by the
+             * background compression queue, and the current request is
+             * served uncompressed.
              */
-            if (CompressExternalFile(Ns_GetConnInterp(conn), cmdName, fileName, compressedFileName) == TCL_OK) {
+            if (useRefreshAsync) {
+                if (CompressQueueAdd(connPtr->server, cmdName, fileName, compressedFileName, NS_FALSE)) {
+                    Ns_Log(Notice, "fastpath: queued refresh of outdated file %s", compressedFileName);
+                }
+            } else if (CompressExternalFile(Ns_GetConnInterp(conn), cmdName, fileName, compressedFileName) == TCL_OK) {
                 (void)Ns_Stat(compressedFileName, &gzStat);
             }
         }
@@ -643,7 +1199,7 @@ CheckStaticCompressedDelivery(
             connPtr->fileInfo = gzStat;
             result = compressedFileName;
             Ns_ConnCondSetHeaders(conn, "Content-Encoding", encoding);
-        } else {
+        } else if (!doRefresh || !useRefreshAsync) {
             Ns_Log(Warning, "gzip: the gzip file %s is older than the uncompressed file",
                    compressedFileName);
         }
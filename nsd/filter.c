@@ -37,6 +37,35 @@ typedef struct Trace {
     void            *arg;
 } Trace;
 
+/*
+ * The following structures are a read-only snapshot of the filter chain,
+ * rebuilt whenever a filter is registered. For every filter stage, the
+ * snapshot lists the filters of this stage in chain order together with
+ * the index of their (method, url) pattern pair. Filters sharing a
+ * pattern pair are therefore matched only once per request. The match
+ * results of the first FILTER_MATCH_MAX pattern pairs of a stage are
+ * memorized, further pairs are matched per filter.
+ */
+
+#define FILTER_STAGES    4
+#define FILTER_MATCH_MAX 64
+
+typedef struct FilterPattern {
+    const char *method;         /* NULL, when matching every method */
+    const char *url;            /* NULL, when matching every URL */
+} FilterPattern;
+
+typedef struct FilterStage {
+    size_t          nfilters;
+    const Filter  **filters;    /* filters of the stage in chain order */
+    size_t         *patternIdx; /* pattern pair of every filter */
+    FilterPattern  *patterns;   /* distinct pattern pairs of the stage */
+} FilterStage;
+
+typedef struct FilterSnapshot {
+    FilterStage stages[FILTER_STAGES];
+} FilterSnapshot;
+
 static Trace *NewTrace(Ns_TraceProc *proc, void *arg)
     NS_GNUC_NONNULL(1);
 
@@ -55,6 +84,17 @@ static void FilterLock(NsServer *servPtr, NS_RW rw)
 static void FilterUnlock(NsServer *servPtr)
     NS_GNUC_NONNULL(1);
 
+static int FilterStageIndex(Ns_FilterType why);
+
+static void FilterSnapshotBuild(NsServer *servPtr)
+    NS_GNUC_NONNULL(1);
+
+static void FilterSnapshotFree(FilterSnapshot *snapPtr)
+    NS_GNUC_NONNULL(1);
+
+static bool FilterPatternMatch(const FilterPattern *patternPtr, const Ns_Conn *conn)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+
 /*
  *----------------------------------------------------------------------
  * FilterLock --
@@ -107,7 +147,171 @@ FilterUnlock(NsServer *servPtr) {
         Ns_MutexUnlock(&servPtr->filter.lock.mlock);
     }
 }
-
+
+/*
+ *----------------------------------------------------------------------
+ * FilterStageIndex --
+ *
+ *      Map a filter stage to its slot in the filter snapshot.
+ *
+ * Results:
+ *      Index of the stage, or -1 for values not denoting a single stage.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+FilterStageIndex(Ns_FilterType why)
+{
+    int result;
+
+    switch (why) {
+    case NS_FILTER_PRE_AUTH:   result = 0; break;
+    case NS_FILTER_POST_AUTH:  result = 1; break;
+    case NS_FILTER_TRACE:      result = 2; break;
+    case NS_FILTER_VOID_TRACE: result = 3; break;
+    default:                   result = -1; break;
+    }
+    return result;
+}
+
+/*
+ *----------------------------------------------------------------------
+ * FilterSnapshotFree --
+ *
+ *      Free a filter snapshot. The filters themselves are not touched.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Memory is freed.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+FilterSnapshotFree(FilterSnapshot *snapPtr)
+{
+    int i;
+
+    for (i = 0; i < FILTER_STAGES; i++) {
+        ns_free((void *)snapPtr->stages[i].filters);
+        ns_free(snapPtr->stages[i].patternIdx);
+        ns_free(snapPtr->stages[i].patterns);
+    }
+    ns_free(snapPtr);
+}
+
+/*
+ *----------------------------------------------------------------------
+ * FilterSnapshotBuild --
+ *
+ *      Rebuild the filter snapshot of the server from the filter
+ *      chain. Must be called with the filter lock held for writing,
+ *      such that no connection thread uses the old snapshot, which is
+ *      freed.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Replaces servPtr->filter.snapshot.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+FilterSnapshotBuild(NsServer *servPtr)
+{
+    FilterSnapshot *snapPtr;
+    const Filter   *fPtr;
+    size_t          counts[FILTER_STAGES] = {0u, 0u, 0u, 0u};
+    int             i;
+
+    for (fPtr = servPtr->filter.firstFilterPtr; fPtr != NULL; fPtr = fPtr->nextPtr) {
+        i = FilterStageIndex(fPtr->when);
+        if (i >= 0) {
+            counts[i]++;
+        }
+    }
+
+    snapPtr = ns_calloc(1u, sizeof(FilterSnapshot));
+    for (i = 0; i < FILTER_STAGES; i++) {
+        FilterStage   *stagePtr = &snapPtr->stages[i];
+        Tcl_HashTable  patterns;
+        Tcl_DString    ds;
+        size_t         npatterns = 0u;
+
+        if (counts[i] == 0u) {
+            continue;
+        }
+        stagePtr->filters = ns_malloc(counts[i] * sizeof(Filter *));
+        stagePtr->patternIdx = ns_malloc(counts[i] * sizeof(size_t));
+        stagePtr->patterns = ns_malloc(counts[i] * sizeof(FilterPattern));
+
+        /*
+         * The length of the method pattern makes the key of the
+         * pattern pair unambiguous.
+         */
+        Tcl_InitHashTable(&patterns, TCL_STRING_KEYS);
+        Tcl_DStringInit(&ds);
+        for (fPtr = servPtr->filter.firstFilterPtr; fPtr != NULL; fPtr = fPtr->nextPtr) {
+            Tcl_HashEntry *hPtr;
+            int            isNew;
+
+            if (FilterStageIndex(fPtr->when) != i) {
+                continue;
+            }
+            Tcl_DStringSetLength(&ds, 0);
+            Ns_DStringPrintf(&ds, "%" PRIuz ":%s%s", strlen(fPtr->method), fPtr->method, fPtr->url);
+            hPtr = Tcl_CreateHashEntry(&patterns, ds.string, &isNew);
+            if (isNew != 0) {
+                FilterPattern *patternPtr = &stagePtr->patterns[npatterns];
+
+                patternPtr->method = STREQ(fPtr->method, "*") ? NULL : fPtr->method;
+                patternPtr->url = STREQ(fPtr->url, "*") ? NULL : fPtr->url;
+                Tcl_SetHashValue(hPtr, INT2PTR(npatterns));
+                npatterns++;
+            }
+            stagePtr->filters[stagePtr->nfilters] = fPtr;
+            stagePtr->patternIdx[stagePtr->nfilters] = (size_t)PTR2UINT(Tcl_GetHashValue(hPtr));
+            stagePtr->nfilters++;
+        }
+        Tcl_DStringFree(&ds);
+        Tcl_DeleteHashTable(&patterns);
+    }
+
+    if (servPtr->filter.snapshot != NULL) {
+        FilterSnapshotFree(servPtr->filter.snapshot);
+    }
+    servPtr->filter.snapshot = snapPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ * FilterPatternMatch --
+ *
+ *      Check, whether the method and URL of the request match the
+ *      pattern pair.
+ *
+ * Results:
+ *      Boolean value.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+static bool
+FilterPatternMatch(const FilterPattern *patternPtr, const Ns_Conn *conn)
+{
+    return ((patternPtr->method == NULL
+             || Tcl_StringMatch(conn->request.method, patternPtr->method) != 0)
+            && (patternPtr->url == NULL
+                || Tcl_StringMatch(conn->request.url, patternPtr->url) != 0));
+}
+
 /*
  *----------------------------------------------------------------------
  * Ns_RegisterFilter --
@@ -165,6 +369,7 @@ Ns_RegisterFilter(const char *server, const char *method, const char *url,
         }
         *fPtrPtr = fPtr;
     }
+    FilterSnapshotBuild(servPtr);
     FilterUnlock(servPtr);
 
     return (void *) fPtr;
@@ -198,17 +403,39 @@ NsRunFilters(Ns_Conn *conn, Ns_FilterType why)
 
     status = NS_OK;
     if ((conn->request.method != NULL) && (conn->request.url != NULL)) {
-        Ns_ReturnCode filter_status = NS_OK;
+        Ns_ReturnCode         filter_status = NS_OK;
+        const FilterSnapshot *snapPtr;
+        int                   stage = FilterStageIndex(why);
 
         FilterLock(servPtr, NS_READ);
-        fPtr = servPtr->filter.firstFilterPtr;
-        while (fPtr != NULL && filter_status == NS_OK) {
-            if (unlikely(fPtr->when == why)
-                && (Tcl_StringMatch(conn->request.method, fPtr->method) != 0)
-                && (Tcl_StringMatch(conn->request.url, fPtr->url) != 0)) {
-                filter_status = (*fPtr->proc)(fPtr->arg, conn, why);
+        snapPtr = servPtr->filter.snapshot;
+        if (snapPtr != NULL && stage >= 0) {
+            const FilterStage *stagePtr = &snapPtr->stages[stage];
+            signed char        matched[FILTER_MATCH_MAX];
+            size_t             i;
+
+            /*
+             * matched[] holds per pattern pair 0 (not yet matched),
+             * 1 (matching) or -1 (not matching).
+             */
+            memset(matched, 0, sizeof(matched));
+            for (i = 0u; i < stagePtr->nfilters && filter_status == NS_OK; i++) {
+                size_t idx = stagePtr->patternIdx[i];
+                bool   match;
+
+                if (idx < FILTER_MATCH_MAX) {
+                    if (matched[idx] == 0) {
+                        matched[idx] = FilterPatternMatch(&stagePtr->patterns[idx], conn) ? 1 : -1;
+                    }
+                    match = (matched[idx] > 0);
+                } else {
+                    match = FilterPatternMatch(&stagePtr->patterns[idx], conn);
+                }
+                if (match) {
+                    fPtr = stagePtr->filters[i];
+                    filter_status = (*fPtr->proc)(fPtr->arg, conn, why);
+                }
             }
-            fPtr = fPtr->nextPtr;
         }
         FilterUnlock(servPtr);
         if (filter_status == NS_FILTER_BREAK ||
@@ -653,8 +653,8 @@ NsTclInfoObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc, Tcl_
                                      &opt) != TCL_OK)) {
         return TCL_ERROR;
     }
-    if ((opt != IMeminfoIdx && objc != 2)
-        || (opt == IMeminfoIdx && (objc < 2 || objc > 3))) {
+    if ((opt != IMeminfoIdx && opt != IScheduledIdx && objc != 2)
+        || ((opt == IMeminfoIdx || opt == IScheduledIdx) && (objc < 2 || objc > 3))) {
         Tcl_WrongNumArgs(interp, 1, objv, "option");
         return TCL_ERROR;
     }
@@ -696,10 +696,25 @@ NsTclInfoObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc, Tcl_
         Tcl_DStringResult(interp, &ds);
         break;
 
-    case IScheduledIdx:
-        NsGetScheduled(&ds);
-        Tcl_DStringResult(interp, &ds);
+    case IScheduledIdx: {
+        int         wheels = 0;
+        Ns_ObjvSpec flags[] = {
+            {"-wheels", Ns_ObjvBool, &wheels, INT2PTR(NS_TRUE)},
+            {NULL,      NULL,        NULL,    NULL}
+        };
+
+        if (Ns_ParseObjv(flags, NULL, interp, 2, objc, objv) != NS_OK) {
+            result = TCL_ERROR;
+        } else {
+            if (wheels != 0) {
+                NsGetSchedulerWheels(&ds);
+            } else {
+                NsGetScheduled(&ds);
+            }
+            Tcl_DStringResult(interp, &ds);
+        }
         break;
+    }
 
     case ILocksIdx:
         Ns_MutexList(&ds);
@@ -871,6 +886,22 @@ NsTclInfoObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc, Tcl_
             Tcl_DictObjPut(NULL, dictObj,
                            Tcl_NewStringObj("tcl", 3),
                            Tcl_NewStringObj(TCL_PATCH_LEVEL, -1));
+            /*
+             * Compression formats available for on-the-fly compression.
+             */
+            {
+                Tcl_Obj     *listObj = Tcl_NewListObj(0, NULL);
+                unsigned int i;
+
+                for (i = 0u; i < NS_COMPRESS_NR_FORMATS; i++) {
+                    if (Ns_CompressFormatSupported((Ns_CompressFormat)i)) {
+                        Tcl_ListObjAppendElement(NULL, listObj,
+                                                 Tcl_NewStringObj(Ns_CompressFormatName((Ns_CompressFormat)i),
+                                                                  TCL_INDEX_NONE));
+                    }
+                }
+                Tcl_DictObjPut(NULL, dictObj, Tcl_NewStringObj("compression", 11), listObj);
+            }
 
             Tcl_SetObjResult(interp, dictObj);
             Tcl_DStringFree(&ds);
@@ -239,11 +239,29 @@ typedef struct SpoolerQueue {
     int                  id;          /* Queue id */
     int                  queuesize;   /* Number of active sockets in the queue */
     const char          *threadName;  /* Name of the thread working on this queue */
+    int                  eventBackend;/* Event backend used by the queue thread */
+    bool                 uring;       /* Use io_uring for batched sends (writer only) */
+    bool                 uringActive; /* The io_uring was set up by the writer thread */
+    Tcl_WideInt          uringSends;  /* Send operations completed via io_uring */
+    Tcl_WideInt          uringFallbacks; /* Send operations refused by io_uring */
     bool                 stopped;     /* Flag to indicate thread stopped */
     bool                 shutdown;    /* Flag to indicate shutdown */
 } SpoolerQueue;
 
 
+/*
+ * The following structures are used for batched I/O via io_uring (see
+ * uring.c). The ring itself is opaque.
+ */
+
+typedef struct NsUring NsUring;
+
+typedef struct NsUringResult {
+    void *userData;               /* Client data provided on submission */
+    int   result;                 /* Bytes transferred or negative errno */
+    bool  submitted;              /* Operation was performed by the kernel */
+} NsUringResult;
+
 /*
  * The following structure maintains an ADP call frame.
  */
@@ -359,6 +377,7 @@ typedef struct {
     int                 threads;        /* Number of writer threads to run */
     int                 rateLimit;      /* Limit transmission rate in KB/s for a writer job */
     NsWriterStreamState doStream;       /* Activate writer for HTML streaming */
+    bool                uring;          /* Batch send operations via io_uring */
 } DrvWriter;
 
 /*
@@ -430,6 +449,8 @@ typedef struct Driver {
     int acceptsize;                     /* Number requests to accept at once */
     int sockacceptlog;                  /* Report, when more than this sockets are received in one step */
     int driverthreads;                  /* Number of identical driver threads to be created */
+    int eventBackend;                   /* Event backend (poll, epoll) for driver, spooler and writer */
+    unsigned int pollTokens;            /* Counter for Sock.pollToken, incremented by the driver thread */
     unsigned int loggingFlags;          /* Logging control flags */
 
     unsigned int flags;                 /* Driver state flags. */
@@ -487,6 +508,7 @@ typedef struct Sock {
 
     const char         *location;
     NS_POLL_NFDS_TYPE   pidx;            /* poll() index */
+    unsigned int        pollToken;       /* Identifies the fd incarnation for persistent event backends */
     unsigned int        flags;           /* State flags used by driver */
     Ns_Time             timeout;
     Request            *reqPtr;
@@ -588,6 +610,7 @@ typedef struct Conn {
     struct Request  *reqPtr;
     struct ConnPool *poolPtr;
     struct Driver   *drvPtr;
+    int              queueShard; /* Home shard in the wait queue of the pool */
 
     uintptr_t id;
     char idstr[TCL_INTEGER_SPACE + 4];
@@ -623,6 +646,7 @@ typedef struct Conn {
     Ns_CompressStream cStream;
     int requestCompress;
     int compress;
+    char *compressCacheKey;  /* Explicit key for the compressed-variant cache */
 
     Ns_Set *query;
     Ns_Set *formData;
@@ -658,6 +682,23 @@ typedef struct ConnThreadArg {
     ConnThreadState       state;
 } ConnThreadArg;
 
+/*
+ * The following structure maintains a shard of the wait queue of a
+ * connection pool. Every shard has its own free conn list and list of
+ * waiting connections, protected by its own lock, such that producers
+ * (driver and spooler threads) and consumers (connection threads) working
+ * on different shards do not contend.
+ */
+typedef struct ConnQueueShard {
+    Ns_Mutex lock;
+    struct Conn *freePtr;
+    struct {
+        struct Conn *firstPtr;
+        struct Conn *lastPtr;
+        int          num;
+    } wait;
+} ConnQueueShard;
+
 /*
  * The following structure maintains a connection thread pool.
  */
@@ -668,23 +709,16 @@ typedef struct ConnPool {
     struct NsServer *servPtr;
 
     /*
-     * The following struct maintains the active and waiting connection
-     * queues, the free conn list, the next conn id, and the number
-     * of waiting connects.
+     * The following struct maintains the waiting connection queues and the
+     * free conn lists, partitioned into "nshards" shards.
      */
 
     struct {
-        Conn *freePtr;
-        int maxconns;
-
-        struct {
-            Conn *firstPtr;
-            Conn *lastPtr;
-            int   num;
-        } wait;
+        ConnQueueShard *shards;
+        int             nshards;
+        int             maxconns;
 
         Ns_Cond  cond;
-        Ns_Mutex lock;
         int      lowwatermark;
         int      highwatermark;
         Ns_Time  retryafter;
@@ -856,6 +890,7 @@ typedef struct NsServer {
             Ns_Mutex mlock;
         } lock;
         bool rwlocks;
+        struct FilterSnapshot *snapshot; /* filters per stage, rebuilt on registration */
     } filter;
 
     /*
@@ -864,7 +899,7 @@ typedef struct NsServer {
 
     struct {
         struct Junction *junction[MAX_URLSPACES];
-        Ns_Mutex lock;
+        Ns_RWLock lock;     /* Protects the pool mappings (and id allocation) */
         Ns_RWLock idlocks[MAX_URLSPACES];
     } urlspace;
 
@@ -933,6 +968,11 @@ typedef struct NsServer {
         int  minsize;   /* min size of response to compress, in bytes */
         bool enable;    /* on/off */
         bool preinit;   /* initialize the compression stream buffers in advance */
+        int  brotlilevel; /* 1-11 */
+        int  zstdlevel;   /* 1-19 */
+        int  nformats;    /* number of entries in formats */
+        Ns_CompressFormat formats[NS_COMPRESS_NR_FORMATS]; /* in order of preference */
+        Ns_Cache *cache;  /* compressed variants of responses, or NULL */
     } compress;
 
     /*
@@ -1521,6 +1561,28 @@ NS_EXTERN ssize_t NsDriverSend(Sock *sockPtr, const struct iovec *bufs, int nbuf
     NS_GNUC_NONNULL(1);
 NS_EXTERN ssize_t NsDriverSendFile(Sock *sockPtr, Ns_FileVec *bufs, int nbufs, unsigned int flags)
     NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+NS_EXTERN void NsSSLDriverStats(void *arg, Tcl_Obj *listObj)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+
+/*
+ * cache.c
+ */
+NS_EXTERN char *NsCacheStats(Ns_Cache *const* caches, int nCaches, Ns_DString *dest)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(3);
+
+/*
+ * uring.c
+ */
+struct msghdr;
+
+NS_EXTERN NsUring *NsUringCreate(unsigned int entries);
+NS_EXTERN void NsUringFree(NsUring *ringPtr)
+    NS_GNUC_NONNULL(1);
+NS_EXTERN bool NsUringPrepSendmsg(NsUring *ringPtr, NS_SOCKET sock, const struct msghdr *msgPtr, void *userData)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(3);
+NS_EXTERN int NsUringSubmit(NsUring *ringPtr, NsUringResult *resultsPtr, int maxResults)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+
 NS_EXTERN int NSDriverClientOpen(Tcl_Interp *interp, const char *driverName,
                                  const char *url, const char *httpMethod, const char *version,
                                  const Ns_Time *timeoutPtr, Tcl_DString *dsPtr,
@@ -1612,6 +1674,7 @@ NS_EXTERN Ns_ArgProc NsMountUrl2FileArgProc;
 NS_EXTERN void NsGetCallbacks(Tcl_DString *dsPtr) NS_GNUC_NONNULL(1);
 NS_EXTERN void NsGetSockCallbacks(Tcl_DString *dsPtr) NS_GNUC_NONNULL(1);
 NS_EXTERN void NsGetScheduled(Tcl_DString *dsPtr) NS_GNUC_NONNULL(1);
+NS_EXTERN void NsGetSchedulerWheels(Tcl_DString *dsPtr) NS_GNUC_NONNULL(1);
 NS_EXTERN void NsGetMimeTypes(Tcl_DString *dsPtr) NS_GNUC_NONNULL(1);
 NS_EXTERN void NsGetTraces(Tcl_DString *dsPtr, const char *server) NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
 NS_EXTERN void NsGetFilters(Tcl_DString *dsPtr, const char *server) NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
@@ -1743,8 +1806,8 @@ NS_EXTERN Ns_ReturnCode NsConnRequire(Tcl_Interp *interp, unsigned int flags, Ns
 /*
  * request parsing
  */
-NS_EXTERN void NsParseAcceptEncoding(double version, const char *hdr, bool *gzipAcceptPtr, bool *brotliAcceptPtr)
-    NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(3) NS_GNUC_NONNULL(4);
+NS_EXTERN unsigned int NsParseAcceptEncoding(double version, const char *hdr)
+    NS_GNUC_NONNULL(2) NS_GNUC_PURE;
 
 /*
  * encoding.c
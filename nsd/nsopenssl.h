@@ -75,6 +75,14 @@
 # include <openssl/ssl.h>
 # include <openssl/err.h>
 
+/*
+ * Kernel TLS offload (SSL_sendfile(), BIO_get_ktls_send()) is available
+ * since OpenSSL 3.0, when the library was built with KTLS support.
+ */
+# if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS) && !defined(LIBRESSL_VERSION_NUMBER)
+#  define HAVE_OPENSSL_KTLS 1
+# endif
+
 typedef struct NsSSLConfig {
     SSL_CTX  *ctx;
     Ns_Mutex  lock;
@@ -84,6 +92,17 @@ typedef struct NsSSLConfig {
     DH       *dhKey512;     /* Fallback Diffie Hellman keys of length 512 */
     DH       *dhKey1024;    /* Fallback Diffie Hellman keys of length 1024 */
     DH       *dhKey2048;    /* Fallback Diffie Hellman keys of length 2048 */
+    unsigned char *alpn;    /* ALPN protocol list in wire format */
+    unsigned int   alpnLength;
+    int       ktls;         /* Request kernel TLS offload (SSL_OP_ENABLE_KTLS). */
+    Tcl_WideInt ktlsBytes;  /* File bytes sent via SSL_sendfile(), protected by lock. */
+    Tcl_WideInt ktlsFallbackBytes; /* File bytes sent via user-space copies, protected by lock. */
+    int       sessionTickets;   /* Issue TLS session tickets */
+    char     *ticketKeyFile;    /* File with session ticket keys (80 bytes per key) */
+    unsigned char *ticketKeys;  /* Loaded session ticket keys, protected by lock */
+    int       nTicketKeys;
+    char     *sessionCacheDir;  /* Directory of the external session cache */
+    Ns_Time   rotateInterval;   /* Interval for reloading keys and purging the cache */
 } NsSSLConfig;
 
 NS_EXTERN NsSSLConfig *NsSSLConfigNew(const char *path)
@@ -33,9 +33,20 @@ static void AppendConn(Tcl_DString *dsPtr, const Conn *connPtr, const char *stat
 static void AppendConnList(Tcl_DString *dsPtr, const Conn *firstPtr, const char *state, bool checkforproxy)
     NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(3);
 
-static bool neededAdditionalConnectionThreads(const ConnPool *poolPtr)
+static bool neededAdditionalConnectionThreads(const ConnPool *poolPtr, int waiting)
     NS_GNUC_NONNULL(1);
 
+static Conn *ConnQueueGetFree(ConnPool *poolPtr, int shard)
+    NS_GNUC_NONNULL(1);
+static void ConnQueuePushFree(ConnPool *poolPtr, Conn *connPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+static int ConnQueueAppend(ConnPool *poolPtr, Conn *connPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+static Conn *ConnQueuePop(ConnPool *poolPtr, int shard)
+    NS_GNUC_NONNULL(1);
+static int ConnQueueWaiting(const ConnPool *poolPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_PURE;
+
 static void WakeupConnThreads(ConnPool *poolPtr)
     NS_GNUC_NONNULL(1);
 
@@ -342,14 +353,202 @@ NsPoolAddBytesSent(ConnPool *poolPtr, Tcl_WideInt bytesSent)
 
 
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * ConnQueueGetFree --
+ *
+ *      Get a free connection structure from the wait queue of the pool.
+ *      Start with the provided shard and try the other shards, when this
+ *      shard is exhausted, such that the pool can run out of free
+ *      connections only when all shards are exhausted (maxconns).
+ *
+ * Results:
+ *      Conn or NULL, when no free connection is available.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+static Conn *
+ConnQueueGetFree(ConnPool *poolPtr, int shard)
+{
+    Conn *connPtr = NULL;
+    int   i;
+
+    NS_NONNULL_ASSERT(poolPtr != NULL);
+
+    for (i = 0; i < poolPtr->wqueue.nshards && connPtr == NULL; i++) {
+        ConnQueueShard *shardPtr = &poolPtr->wqueue.shards[(shard + i) % poolPtr->wqueue.nshards];
+
+        if (shardPtr->freePtr != NULL) {
+            Ns_MutexLock(&shardPtr->lock);
+            if (shardPtr->freePtr != NULL) {
+                connPtr = shardPtr->freePtr;
+                shardPtr->freePtr = connPtr->nextPtr;
+                connPtr->nextPtr = NULL;
+            }
+            Ns_MutexUnlock(&shardPtr->lock);
+        }
+    }
+    return connPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ConnQueuePushFree --
+ *
+ *      Return a connection structure to the free list of its home shard.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+ConnQueuePushFree(ConnPool *poolPtr, Conn *connPtr)
+{
+    ConnQueueShard *shardPtr;
+
+    NS_NONNULL_ASSERT(poolPtr != NULL);
+    NS_NONNULL_ASSERT(connPtr != NULL);
+
+    shardPtr = &poolPtr->wqueue.shards[connPtr->queueShard];
+    Ns_MutexLock(&shardPtr->lock);
+    connPtr->nextPtr = shardPtr->freePtr;
+    shardPtr->freePtr = connPtr;
+    Ns_MutexUnlock(&shardPtr->lock);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ConnQueueAppend --
+ *
+ *      Append a connection to the list of waiting connections in its
+ *      home shard.
+ *
+ * Results:
+ *      Total number of waiting connections of the pool.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+ConnQueueAppend(ConnPool *poolPtr, Conn *connPtr)
+{
+    ConnQueueShard *shardPtr;
+
+    NS_NONNULL_ASSERT(poolPtr != NULL);
+    NS_NONNULL_ASSERT(connPtr != NULL);
+
+    shardPtr = &poolPtr->wqueue.shards[connPtr->queueShard];
+    Ns_MutexLock(&shardPtr->lock);
+    if (shardPtr->wait.firstPtr == NULL) {
+        shardPtr->wait.firstPtr = connPtr;
+    } else {
+        shardPtr->wait.lastPtr->nextPtr = connPtr;
+    }
+    shardPtr->wait.lastPtr = connPtr;
+    shardPtr->wait.num ++;
+    Ns_MutexUnlock(&shardPtr->lock);
+
+    return ConnQueueWaiting(poolPtr);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ConnQueuePop --
+ *
+ *      Dequeue the first waiting connection, starting with the provided
+ *      shard. When this shard has no waiting connections, steal from the
+ *      other shards. Within a shard, the connections are processed in
+ *      FIFO order.
+ *
+ * Results:
+ *      Conn or NULL, when no connection is waiting.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+static Conn *
+ConnQueuePop(ConnPool *poolPtr, int shard)
+{
+    Conn *connPtr = NULL;
+    int   i;
+
+    NS_NONNULL_ASSERT(poolPtr != NULL);
+
+    for (i = 0; i < poolPtr->wqueue.nshards && connPtr == NULL; i++) {
+        ConnQueueShard *shardPtr = &poolPtr->wqueue.shards[(shard + i) % poolPtr->wqueue.nshards];
+
+        if (shardPtr->wait.firstPtr != NULL) {
+            Ns_MutexLock(&shardPtr->lock);
+            if (shardPtr->wait.firstPtr != NULL) {
+                connPtr = shardPtr->wait.firstPtr;
+                shardPtr->wait.firstPtr = connPtr->nextPtr;
+                if (shardPtr->wait.lastPtr == connPtr) {
+                    shardPtr->wait.lastPtr = NULL;
+                }
+                connPtr->nextPtr = NULL;
+                shardPtr->wait.num --;
+            }
+            Ns_MutexUnlock(&shardPtr->lock);
+        }
+    }
+    return connPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ConnQueueWaiting --
+ *
+ *      Return the number of waiting connections of the pool, summed up
+ *      over all shards. The shards are not locked, so the result is a
+ *      snapshot, which is sufficient for the watermark computations.
+ *
+ * Results:
+ *      Number of waiting connections.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+ConnQueueWaiting(const ConnPool *poolPtr)
+{
+    int i, waiting = 0;
+
+    NS_NONNULL_ASSERT(poolPtr != NULL);
+
+    for (i = 0; i < poolPtr->wqueue.nshards; i++) {
+        waiting += poolPtr->wqueue.shards[i].wait.num;
+    }
+    return waiting;
+}
+
+
 /*
  *----------------------------------------------------------------------
  *
  * neededAdditionalConnectionThreads --
  *
  *      Compute the number additional connection threads we should
- *      create. This function has to be called under a lock for the
- *      provided queue (such as &poolPtr->wqueue.lock).
+ *      create. This function has to be called under the threads lock
+ *      of the pool, "waiting" is the current number of waiting
+ *      connections.
  *
  * Results:
  *      Number of needed additional connection threads.
@@ -360,7 +559,7 @@ NsPoolAddBytesSent(ConnPool *poolPtr, Tcl_WideInt bytesSent)
  *----------------------------------------------------------------------
  */
 static bool
-neededAdditionalConnectionThreads(const ConnPool *poolPtr) {
+neededAdditionalConnectionThreads(const ConnPool *poolPtr, int waiting) {
     bool wantCreate;
 
     NS_NONNULL_ASSERT(poolPtr != NULL);
@@ -379,10 +578,10 @@ neededAdditionalConnectionThreads(const ConnPool *poolPtr) {
      *
      */
     if ( (poolPtr->threads.creating == 0
-          || poolPtr->wqueue.wait.num > poolPtr->wqueue.highwatermark
+          || waiting > poolPtr->wqueue.highwatermark
           )
          && (poolPtr->threads.current < poolPtr->threads.min
-             || (poolPtr->wqueue.wait.num > poolPtr->wqueue.lowwatermark)
+             || (waiting > poolPtr->wqueue.lowwatermark)
              )
          && poolPtr->threads.current < poolPtr->threads.max
          ) {
@@ -397,7 +596,7 @@ neededAdditionalConnectionThreads(const ConnPool *poolPtr) {
              poolPtr->threads.creating,
              poolPtr->threads.current,
              poolPtr->threads.idle,
-             poolPtr->wqueue.wait.num
+             waiting
              );*/
     } else {
         wantCreate = NS_FALSE;
@@ -409,7 +608,7 @@ neededAdditionalConnectionThreads(const ConnPool *poolPtr) {
                poolPtr->threads.min,
                poolPtr->threads.current,
                poolPtr->threads.max,
-               poolPtr->wqueue.wait.num);*/
+               waiting);*/
 
     }
 
@@ -452,18 +651,15 @@ NsEnsureRunningConnectionThreads(const NsServer *servPtr, ConnPool *poolPtr) {
         poolPtr = servPtr->pools.defaultPtr;
     }
 
-    Ns_MutexLock(&poolPtr->wqueue.lock);
+    waitnum = ConnQueueWaiting(poolPtr);
     Ns_MutexLock(&poolPtr->threads.lock);
-    create = neededAdditionalConnectionThreads(poolPtr);
+    create = neededAdditionalConnectionThreads(poolPtr, waitnum);
 
     if (create) {
         poolPtr->threads.current ++;
         poolPtr->threads.creating ++;
     }
-    waitnum = poolPtr->wqueue.wait.num;
-
     Ns_MutexUnlock(&poolPtr->threads.lock);
-    Ns_MutexUnlock(&poolPtr->wqueue.lock);
 
     if (create) {
         Ns_Log(Notice, "NsEnsureRunningConnectionThreads wantCreate %d waiting %d idle %d current %d",
@@ -502,7 +698,7 @@ NsQueueConn(Sock *sockPtr, const Ns_Time *nowPtr)
     ConnPool      *poolPtr = NULL;
     Conn          *connPtr = NULL;
     bool           create = NS_FALSE;
-    int            queued = NS_OK;
+    int            queued = NS_OK, waiting = 0;
 
     NS_NONNULL_ASSERT(sockPtr != NULL);
     NS_NONNULL_ASSERT(nowPtr != NULL);
@@ -538,13 +734,20 @@ NsQueueConn(Sock *sockPtr, const Ns_Time *nowPtr)
 
         /*
          * Here we could fit-in the peer addr, when behindproxy is true.
+         *
+         * The pool mappings can be modified at runtime via "ns_server
+         * map|unmap", which discards the compiled representation of the
+         * junction. Therefore, the lookup is performed under the read
+         * lock of the mappings.
          */
+        Ns_RWLockRdLock(&servPtr->urlspace.lock);
         poolPtr = NsUrlSpecificGet(servPtr,
                                    sockPtr->reqPtr->request.method,
                                    sockPtr->reqPtr->request.url,
                                    poolid, 0u, NS_URLSPACE_DEFAULT,
                                    NULL,
                                    NsUrlSpaceContextFilter, &ctx);
+        Ns_RWLockUnlock(&servPtr->urlspace.lock);
         sockPtr->poolPtr = poolPtr;
     } else if (sockPtr->poolPtr != NULL) {
         poolPtr = sockPtr->poolPtr;
@@ -559,14 +762,11 @@ NsQueueConn(Sock *sockPtr, const Ns_Time *nowPtr)
     * We know the pool. Try to add connection into the queue of this pool
     * (either into a free slot or into its waiting list, or, when everything
     * fails signal an error or timeout (for retry attempts) to the caller.
+    *
+    * The shard of the wait queue is selected via the socket, such that
+    * concurrent driver and spooler threads are spread over the shards.
     */
-    Ns_MutexLock(&poolPtr->wqueue.lock);
-    if (poolPtr->wqueue.freePtr != NULL) {
-        connPtr = poolPtr->wqueue.freePtr;
-        poolPtr->wqueue.freePtr = connPtr->nextPtr;
-        connPtr->nextPtr = NULL;
-    }
-    Ns_MutexUnlock(&poolPtr->wqueue.lock);
+    connPtr = ConnQueueGetFree(poolPtr, (int)((size_t)sockPtr->sock % (size_t)poolPtr->wqueue.nshards));
 
     if (likely(connPtr != NULL)) {
         /*
@@ -625,30 +825,21 @@ NsQueueConn(Sock *sockPtr, const Ns_Time *nowPtr)
             assert(argPtr->state == connThread_idle);
             argPtr->connPtr = connPtr;
 
-            Ns_MutexLock(&poolPtr->wqueue.lock);
+            waiting = ConnQueueWaiting(poolPtr);
             Ns_MutexLock(&poolPtr->threads.lock);
-            create = neededAdditionalConnectionThreads(poolPtr);
+            create = neededAdditionalConnectionThreads(poolPtr, waiting);
             Ns_MutexUnlock(&poolPtr->threads.lock);
-            Ns_MutexUnlock(&poolPtr->wqueue.lock);
 
         } else {
             /*
              * There is no connection thread ready, so we add the
              * connection to the waiting queue.
              */
-            Ns_MutexLock(&poolPtr->wqueue.lock);
-            if (poolPtr->wqueue.wait.firstPtr == NULL) {
-                poolPtr->wqueue.wait.firstPtr = connPtr;
-            } else {
-                poolPtr->wqueue.wait.lastPtr->nextPtr = connPtr;
-            }
-            poolPtr->wqueue.wait.lastPtr = connPtr;
-            poolPtr->wqueue.wait.num ++;
+            waiting = ConnQueueAppend(poolPtr, connPtr);
             Ns_MutexLock(&poolPtr->threads.lock);
             poolPtr->stats.queued++;
-            create = neededAdditionalConnectionThreads(poolPtr);
+            create = neededAdditionalConnectionThreads(poolPtr, waiting);
             Ns_MutexUnlock(&poolPtr->threads.lock);
-            Ns_MutexUnlock(&poolPtr->wqueue.lock);
         }
     }
 
@@ -671,7 +862,7 @@ NsQueueConn(Sock *sockPtr, const Ns_Time *nowPtr)
             Ns_Log(Notice, "[%s pool %s] All available connections are used, waiting %d idle %d current %d",
                    poolPtr->servPtr->server,
                    poolPtr->pool,
-                   poolPtr->wqueue.wait.num,
+                   ConnQueueWaiting(poolPtr),
                    poolPtr->threads.idle,
                    poolPtr->threads.current);
 
@@ -710,7 +901,7 @@ NsQueueConn(Sock *sockPtr, const Ns_Time *nowPtr)
     } else {
         if (Ns_LogSeverityEnabled(Debug)) {
             Ns_Log(Debug, "add waiting connPtr %p => waiting %d create %d",
-                   (void *)connPtr, poolPtr->wqueue.wait.num, (int)create);
+                   (void *)connPtr, waiting, (int)create);
         }
     }
 
@@ -726,7 +917,7 @@ NsQueueConn(Sock *sockPtr, const Ns_Time *nowPtr)
 
         Ns_Log(Notice, "NsQueueConn wantCreate %d waiting %d idle %d current %d",
                (int)create,
-               poolPtr->wqueue.wait.num,
+               waiting,
                idle,
                current);
 
@@ -1039,9 +1230,9 @@ ServerMapObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp, TCL_OBJC_T ob
                 flags |= NS_OP_NOINHERIT;
             }
 
-            Ns_MutexLock(&servPtr->urlspace.lock);
+            Ns_RWLockWrLock(&servPtr->urlspace.lock);
             Ns_UrlSpecificSet2(servPtr->server, method, url, poolid, poolPtr, flags, NULL, specPtr);
-            Ns_MutexUnlock(&servPtr->urlspace.lock);
+            Ns_RWLockUnlock(&servPtr->urlspace.lock);
 
             Tcl_DStringInit(&ds);
             Ns_Log(Notice, "pool[%s]: mapped %s %s%s -> %s",
@@ -1062,9 +1253,9 @@ ServerMapObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp, TCL_OBJC_T ob
          */
         Ns_DStringInit(dsPtr);
 
-        Ns_MutexLock(&servPtr->urlspace.lock);
+        Ns_RWLockRdLock(&servPtr->urlspace.lock);
         Ns_UrlSpecificWalk(poolid, servPtr->server, WalkCallback, dsPtr);
-        Ns_MutexUnlock(&servPtr->urlspace.lock);
+        Ns_RWLockUnlock(&servPtr->urlspace.lock);
 
         /*
          * Convert the Tcl_Dstring into a list, and filter the elements
@@ -1193,10 +1384,10 @@ ServerMappedObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp, TCL_OBJC_T
             op = NS_URLSPACE_DEFAULT;
         }
 
-        Ns_MutexLock(&servPtr->urlspace.lock);
+        Ns_RWLockRdLock(&servPtr->urlspace.lock);
         mappedPoolPtr = (ConnPool *)NsUrlSpecificGet(servPtr,  method, url, poolid, flags, op,
                                                      NULL, NULL, NULL);
-        Ns_MutexUnlock(&servPtr->urlspace.lock);
+        Ns_RWLockUnlock(&servPtr->urlspace.lock);
         if (mappedPoolPtr == NULL) {
             mappedPoolPtr = servPtr->pools.defaultPtr;
         }
@@ -1282,9 +1473,9 @@ ServerUnmapObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp, TCL_OBJC_T
         // TODO: for the time being
         flags |= NS_OP_ALLFILTERS;
 
-        Ns_MutexLock(&servPtr->urlspace.lock);
+        Ns_RWLockWrLock(&servPtr->urlspace.lock);
         data = Ns_UrlSpecificDestroy(servPtr->server,  method, url, poolid, flags);
-        Ns_MutexUnlock(&servPtr->urlspace.lock);
+        Ns_RWLockUnlock(&servPtr->urlspace.lock);
 
         success = (data != NULL);
         // TODO: data is no good indicator when (all) context constraints are deleted.
@@ -1339,12 +1530,18 @@ ServerListActive(Tcl_DString *dsPtr, ConnPool *poolPtr, bool checkforproxy)
 static void
 ServerListQueued(Tcl_DString *dsPtr, ConnPool *poolPtr)
 {
+    int i;
+
     NS_NONNULL_ASSERT(dsPtr != NULL);
     NS_NONNULL_ASSERT(poolPtr != NULL);
 
-    Ns_MutexLock(&poolPtr->wqueue.lock);
-    AppendConnList(dsPtr, poolPtr->wqueue.wait.firstPtr, "queued", NS_FALSE);
-    Ns_MutexUnlock(&poolPtr->wqueue.lock);
+    for (i = 0; i < poolPtr->wqueue.nshards; i++) {
+        ConnQueueShard *shardPtr = &poolPtr->wqueue.shards[i];
+
+        Ns_MutexLock(&shardPtr->lock);
+        AppendConnList(dsPtr, shardPtr->wait.firstPtr, "queued", NS_FALSE);
+        Ns_MutexUnlock(&shardPtr->lock);
+    }
 }
 
 
@@ -1654,7 +1851,7 @@ NsTclServerObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc, Tc
          */
 
     case SWaitingIdx:
-        Tcl_SetObjResult(interp, Tcl_NewIntObj(poolPtr->wqueue.wait.num));
+        Tcl_SetObjResult(interp, Tcl_NewIntObj(ConnQueueWaiting(poolPtr)));
         break;
 
     case SKeepaliveIdx:
@@ -1892,7 +2089,7 @@ NsWaitServer(NsServer *servPtr, const Ns_Time *toPtr)
     Ns_MutexLock(&servPtr->pools.lock);
     while (poolPtr != NULL && status == NS_OK) {
         while (status == NS_OK &&
-               (poolPtr->wqueue.wait.firstPtr != NULL
+               (ConnQueueWaiting(poolPtr) > 0
                 || poolPtr->threads.current > 0)) {
             status = Ns_CondTimedWait(&poolPtr->wqueue.cond,
                                       &servPtr->pools.lock, toPtr);
@@ -2008,7 +2205,8 @@ NsConnThread(void *arg)
     Ns_Time        timeout;
     const char    *exitMsg;
     Ns_Thread      joinThread;
-    Ns_Mutex      *threadsLockPtr, *tqueueLockPtr, *wqueueLockPtr;
+    int            shard;
+    Ns_Mutex      *threadsLockPtr, *tqueueLockPtr;
 
     NS_NONNULL_ASSERT(arg != NULL);
 
@@ -2063,7 +2261,11 @@ NsConnThread(void *arg)
         argPtr->state = connThread_ready;
     }
 
-    wqueueLockPtr  = &poolPtr->wqueue.lock;
+    /*
+     * The home shard of this thread in the wait queue. Connections from
+     * other shards are processed when the home shard is empty.
+     */
+    shard = ThreadNr(poolPtr, argPtr) % poolPtr->wqueue.nshards;
 
     /*
      * Start handling connections.
@@ -2079,29 +2281,12 @@ NsConnThread(void *arg)
         assert(argPtr->connPtr == NULL);
         assert(argPtr->state == connThread_ready);
 
-        if (poolPtr->wqueue.wait.firstPtr != NULL) {
-            connPtr = NULL;
-            Ns_MutexLock(wqueueLockPtr);
-            if (poolPtr->wqueue.wait.firstPtr != NULL) {
-                /*
-                 * There are waiting requests.  Pull the first connection of
-                 * the waiting list and assign it to the ConnThreadArg.
-                 */
-                connPtr = poolPtr->wqueue.wait.firstPtr;
-                poolPtr->wqueue.wait.firstPtr = connPtr->nextPtr;
-                if (poolPtr->wqueue.wait.lastPtr == connPtr) {
-                    poolPtr->wqueue.wait.lastPtr = NULL;
-                }
-                connPtr->nextPtr = NULL;
-                poolPtr->wqueue.wait.num --;
-            }
-            Ns_MutexUnlock(wqueueLockPtr);
-
-            argPtr->connPtr = connPtr;
-            fromQueue = NS_TRUE;
-        } else {
-            fromQueue = NS_FALSE;
-        }
+        /*
+         * When there are waiting requests, pull the first connection of
+         * the waiting list and assign it to the ConnThreadArg.
+         */
+        argPtr->connPtr = ConnQueuePop(poolPtr, shard);
+        fromQueue = (argPtr->connPtr != NULL);
 
         if (argPtr->connPtr == NULL) {
             /*
@@ -2287,10 +2472,7 @@ NsConnThread(void *arg)
         }
         connPtr->prevPtr = NULL;
 
-        Ns_MutexLock(wqueueLockPtr);
-        connPtr->nextPtr = poolPtr->wqueue.freePtr;
-        poolPtr->wqueue.freePtr = connPtr;
-        Ns_MutexUnlock(wqueueLockPtr);
+        ConnQueuePushFree(poolPtr, connPtr);
 
         if (cpt != 0) {
             int waiting, idle, lowwater;
@@ -2300,14 +2482,12 @@ NsConnThread(void *arg)
             /*
              * Get a consistent snapshot of the controlling variables.
              */
-            Ns_MutexLock(wqueueLockPtr);
-            Ns_MutexLock(threadsLockPtr);
-            waiting  = poolPtr->wqueue.wait.num;
+            waiting  = ConnQueueWaiting(poolPtr);
             lowwater = poolPtr->wqueue.lowwatermark;
+            Ns_MutexLock(threadsLockPtr);
             idle     = poolPtr->threads.idle;
             current  = poolPtr->threads.current;
             Ns_MutexUnlock(threadsLockPtr);
-            Ns_MutexUnlock(wqueueLockPtr);
 
             if (Ns_LogSeverityEnabled(Debug)) {
                 Ns_Time now, acceptTime, queueTime, filterTime, netRunTime, runTime, fullTime;
@@ -2768,6 +2948,10 @@ ConnRun(Conn *connPtr)
         ns_free(connPtr->clientData);
         connPtr->clientData = NULL;
     }
+    if (connPtr->compressCacheKey != NULL) {
+        ns_free(connPtr->compressCacheKey);
+        connPtr->compressCacheKey = NULL;
+    }
 
     NsConnTimeStatsFinalize(conn);
 
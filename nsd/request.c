@@ -1014,38 +1014,47 @@ CompressAllow(double compressQvalue, double identityQvalue, double starQvalue)
  *
  * NsParseAcceptEncoding --
  *
- *      Parse the accept-encoding line and return whether gzip
- *      encoding is accepted or not.
+ *      Parse the accept-encoding line and return which of the supported
+ *      compression formats (gzip, brotli, zstd) are accepted.
  *
  * Results:
- *      The result is passed back in the last two arguments.
+ *      Bitmask of NS_CONN_ZIPACCEPTED, NS_CONN_BROTLIACCEPTED and
+ *      NS_CONN_ZSTDACCEPTED.
  *
  * Side effects:
  *      None.
  *
  *----------------------------------------------------------------------
  */
-void
-NsParseAcceptEncoding(double version, const char *hdr, bool *gzipAcceptPtr, bool *brotliAcceptPtr)
+unsigned int
+NsParseAcceptEncoding(double version, const char *hdr)
 {
-    double      gzipQvalue = -1.0, brotliQvalue = -1, starQvalue = -1.0, identityQvalue = -1.0;
-    bool        gzipAccept, brotliAccept;
-    const char *gzipFormat, *brotliFormat, *starFormat;
+    double       gzipQvalue = -1.0, brotliQvalue = -1.0, zstdQvalue = -1.0,
+                 starQvalue = -1.0, identityQvalue = -1.0;
+    unsigned int flags = 0u;
+    const char  *gzipFormat, *brotliFormat, *zstdFormat, *starFormat;
 
     NS_NONNULL_ASSERT(hdr != NULL);
-    NS_NONNULL_ASSERT(gzipAcceptPtr != NULL);
-    NS_NONNULL_ASSERT(brotliAcceptPtr != NULL);
 
     gzipFormat    = GetEncodingFormat(hdr, "gzip", &gzipQvalue);
     brotliFormat  = GetEncodingFormat(hdr, "br", &brotliQvalue);
+    zstdFormat    = GetEncodingFormat(hdr, "zstd", &zstdQvalue);
     starFormat    = GetEncodingFormat(hdr, "*", &starQvalue);
     (void)GetEncodingFormat(hdr, "identity", &identityQvalue);
 
-    //fprintf(stderr, "hdr line <%s> gzipFormat <%s> brotliFormat <%s>\n", hdr, gzipFormat, brotliFormat);
-    if ((gzipFormat != NULL) || (brotliFormat != NULL)) {
-        gzipAccept   = CompressAllow(gzipQvalue, identityQvalue, starQvalue);
-        brotliAccept = CompressAllow(brotliQvalue, identityQvalue, starQvalue);
+    if ((gzipFormat != NULL) || (brotliFormat != NULL) || (zstdFormat != NULL)) {
+        if (CompressAllow(gzipQvalue, identityQvalue, starQvalue)) {
+            flags |= NS_CONN_ZIPACCEPTED;
+        }
+        if (CompressAllow(brotliQvalue, identityQvalue, starQvalue)) {
+            flags |= NS_CONN_BROTLIACCEPTED;
+        }
+        if (CompressAllow(zstdQvalue, identityQvalue, starQvalue)) {
+            flags |= NS_CONN_ZSTDACCEPTED;
+        }
     } else if (starFormat != NULL) {
+        bool starAccept;
+
         /*
          * No compress format was specified, star matches everything, so as
          * well the compression formats.
@@ -1054,30 +1063,28 @@ NsParseAcceptEncoding(double version, const char *hdr, bool *gzipAcceptPtr, bool
             /*
              * The low "*" qvalue forbids the compression formats.
              */
-            gzipAccept = NS_FALSE;
+            starAccept = NS_FALSE;
         } else if (identityQvalue >= -1) {
             /*
-             * Star qvalue allows gzip in HTTP/1.1, when it is larger
+             * Star qvalue allows compression in HTTP/1.1, when it is larger
              * than identity.
              */
-            gzipAccept = (starQvalue >= identityQvalue) && (version >= 1.1);
+            starAccept = (starQvalue >= identityQvalue) && (version >= 1.1);
         } else {
             /*
              * No identity was specified, assume compression format is matched
              * with "*" in HTTP/1.1
              */
-            gzipAccept = (version >= 1.1);
+            starAccept = (version >= 1.1);
         }
         /*
-         * The implicit rules are the same for gzip and brotli.
+         * The implicit rules are the same for all compression formats.
          */
-        brotliAccept = gzipAccept;
-    } else {
-        gzipAccept   = NS_FALSE;
-        brotliAccept = NS_FALSE;
+        if (starAccept) {
+            flags |= (NS_CONN_ZIPACCEPTED|NS_CONN_BROTLIACCEPTED|NS_CONN_ZSTDACCEPTED);
+        }
     }
-    *gzipAcceptPtr   = gzipAccept;
-    *brotliAcceptPtr = brotliAccept;
+    return flags;
 }
 
 /*
@@ -27,6 +27,20 @@
  *       in C, 3rd Edition", Addison-Wesley, 1998.
  *
  *       https://algs4.cs.princeton.edu/24pq/
+ *
+ *  Short one-shot events (e.g. from Ns_After) are not kept in the heap but
+ *  in a hierarchical timing wheel with WHEEL_LEVELS levels of WHEEL_SIZE
+ *  slots each, where a slot of level L covers WHEEL_SIZE^L ticks of
+ *  WHEEL_TICK_USEC microseconds. Insertion and cancellation are O(1);
+ *  events of higher levels are cascaded to lower levels when their slot
+ *  becomes current. Events beyond the horizon of the wheel as well as
+ *  repeating, daily and weekly events are kept in the heap.
+ *
+ *  The timing wheel follows the classical design of:
+ *
+ *      G. Varghese and T. Lauck, "Hashed and Hierarchical Timing Wheels:
+ *      Data Structures for the Efficient Implementation of a Timer
+ *      Facility", SOSP 1987.
  */
 
 #include "nsd.h"
@@ -59,8 +73,25 @@ typedef struct Event {
     Ns_SchedProc   *deleteProc; /* Procedure to cleanup when done (if any). */
     unsigned int    flags;      /* One or more of NS_SCHED_ONCE, NS_SCHED_THREAD,
                                  * NS_SCHED_DAILY, or NS_SCHED_WEEKLY. */
+    struct Event   *wheelNextPtr; /* Next event in the same wheel slot. */
+    struct Event   *wheelPrevPtr; /* Previous event in the same wheel slot. */
+    uint64_t        wheelTick;  /* Expiry tick when kept in the timing wheel. */
+    int             wheelSlot;  /* Index in wheel.slots or -1 when not in wheel. */
 } Event;
 
+/*
+ * The following defines the geometry of the timing wheel. With 4 levels of
+ * 64 slots and a resolution of 1ms, the wheel covers about 4.6 hours.
+ */
+
+#define WHEEL_LEVELS    4
+#define WHEEL_BITS      6
+#define WHEEL_SIZE      (1 << WHEEL_BITS)
+#define WHEEL_MASK      ((uint64_t)WHEEL_SIZE - 1u)
+#define WHEEL_TICK_USEC 1000
+
+#define WheelLevelMask(level) ((1ull << ((level) * WHEEL_BITS)) - 1u)
+
 /*
  * Local functions defined in this file.
  */
@@ -75,6 +106,17 @@ static void QueueEvent(Event *ePtr)     /* Queue event on heap. */
 static void Exchange(int i, int j);     /* Exchange elements in the global queue */
 static bool Larger(int j, int k);       /* Function defining the sorting
                                            criterium of the binary heap */
+static bool WheelInsert(Event *ePtr)    /* Add event to timing wheel. */
+    NS_GNUC_NONNULL(1);
+static bool WheelLink(Event *ePtr, uint64_t tick) /* Link event into wheel slot. */
+    NS_GNUC_NONNULL(1);
+static void WheelRemove(Event *ePtr)    /* Remove event from timing wheel. */
+    NS_GNUC_NONNULL(1);
+static Event *WheelExpire(const Ns_Time *nowPtr) /* Collect due wheel events. */
+    NS_GNUC_NONNULL(1);
+static uint64_t WheelNextTick(void);    /* Next tick requiring processing. */
+static void EventReady(Event *ePtr, const Ns_Time *nowPtr, Event **readyPtrPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(3);
 
 
 /*
@@ -90,6 +132,14 @@ static Event *firstEventPtr = NULL; /* Pointer to the first event */
 static int nqueue = 0;              /* Number of events in queue. */
 static int maxqueue = 0;            /* Max queue events (dynamically re-sized). */
 
+static struct {
+    Event   *slots[WHEEL_LEVELS * WHEEL_SIZE]; /* Slot lists, level by level. */
+    uint64_t occupied[WHEEL_LEVELS];           /* Bitmaps of non-empty slots. */
+    int      nevents[WHEEL_LEVELS];            /* Number of events per level. */
+    int      count;                            /* Total number of events. */
+    uint64_t tick;                             /* Next tick to be processed. */
+} wheel;
+
 static int nThreads = 0;            /* Total number of running threads */
 static int nIdleThreads = 0;        /* Number of idle threads */
 
@@ -337,6 +387,8 @@ Ns_ScheduleProcEx(Ns_SchedProc *proc, void *clientData, unsigned int flags,
         ePtr->proc = proc;
         ePtr->deleteProc = cleanupProc;
         ePtr->arg = clientData;
+        ePtr->qid = 0;
+        ePtr->wheelSlot = -1;
 
         Ns_MutexLock(&lock);
         if (shutdownPending) {
@@ -404,6 +456,9 @@ Ns_Cancel(int id)
             if (ePtr->qid > 0) {
                 (void) DeQueueEvent(ePtr->qid);
                 cancelled = NS_TRUE;
+            } else if (ePtr->wheelSlot >= 0) {
+                WheelRemove(ePtr);
+                cancelled = NS_TRUE;
             }
         }
     }
@@ -448,6 +503,8 @@ Ns_Pause(int id)
                 ePtr->flags |= NS_SCHED_PAUSED;
                 if (ePtr->qid > 0) {
                     (void) DeQueueEvent(ePtr->qid);
+                } else if (ePtr->wheelSlot >= 0) {
+                    WheelRemove(ePtr);
                 }
                 paused = NS_TRUE;
             }
@@ -709,43 +766,54 @@ QueueEvent(Event *ePtr)
             }
         }
 
-        ePtr->qid = ++nqueue;
-        /*
-         * The queue array is extended if necessary.
-         */
-        if (maxqueue <= nqueue) {
-            maxqueue += 25;
-            queue = ns_realloc(queue, sizeof(Event *) * ((size_t)maxqueue + 1u));
-        }
-        /*
-         * Place the new event at the end of the queue array.
-         */
-        queue[nqueue] = ePtr;
+        if ((ePtr->flags & NS_SCHED_ONCE) != 0u
+            && (ePtr->flags & (NS_SCHED_DAILY | NS_SCHED_WEEKLY)) == 0u
+            && WheelInsert(ePtr)) {
+            /*
+             * Short one-shot event, kept in the timing wheel.
+             */
+            Ns_Log(Debug, "QueueEvent (id %d wheel slot %d " NS_TIME_FMT ")",
+                   ePtr->id, ePtr->wheelSlot,
+                   (int64_t)ePtr->nextqueue.sec, ePtr->nextqueue.usec);
+        } else {
+            ePtr->qid = ++nqueue;
+            /*
+             * The queue array is extended if necessary.
+             */
+            if (maxqueue <= nqueue) {
+                maxqueue += 25;
+                queue = ns_realloc(queue, sizeof(Event *) * ((size_t)maxqueue + 1u));
+            }
+            /*
+             * Place the new event at the end of the queue array.
+             */
+            queue[nqueue] = ePtr;
 
-        if (nqueue > 1) {
-            int j, k;
+            if (nqueue > 1) {
+                int j, k;
 
-            QueueConsistencyCheck("Queue event", nqueue - 1, NS_FALSE);
+                QueueConsistencyCheck("Queue event", nqueue - 1, NS_FALSE);
 
-            /*
-             * Bottom-up reheapify: swim up" in the heap.  When a node is
-             * larger than its parent, then the nodes have to swapped.
-             *
-             * In the implementation below, "j" is always k/2 and represents
-             * the parent node in the binary tree.
-             */
-            k = nqueue;
-            j = k / 2;
-            while (k > 1 && Larger(j, k)) {
-                Exchange(j, k);
-                k = j;
+                /*
+                 * Bottom-up reheapify: swim up" in the heap.  When a node is
+                 * larger than its parent, then the nodes have to swapped.
+                 *
+                 * In the implementation below, "j" is always k/2 and represents
+                 * the parent node in the binary tree.
+                 */
+                k = nqueue;
                 j = k / 2;
+                while (k > 1 && Larger(j, k)) {
+                    Exchange(j, k);
+                    k = j;
+                    j = k / 2;
+                }
+                QueueConsistencyCheck("Queue event end", nqueue, NS_TRUE);
             }
-            QueueConsistencyCheck("Queue event end", nqueue, NS_TRUE);
+            Ns_Log(Debug, "QueueEvent (id %d qid %d " NS_TIME_FMT ")",
+                   ePtr->id, ePtr->qid,
+                   (int64_t)ePtr->nextqueue.sec, ePtr->nextqueue.usec);
         }
-        Ns_Log(Debug, "QueueEvent (id %d qid %d " NS_TIME_FMT ")",
-               ePtr->id, ePtr->qid,
-               (int64_t)ePtr->nextqueue.sec, ePtr->nextqueue.usec);
 
         /*
          * Signal or create the SchedThread if necessary.
@@ -822,6 +890,339 @@ DeQueueEvent(int k)
     return ePtr;
 }
 
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TimeToTick, TickToTime, SlotDistance --
+ *
+ *  Helper functions for the timing wheel. TimeToTick() converts a time
+ *  into wheel ticks (rounding up, when requested, such that events are
+ *  never fired early), TickToTime() converts ticks back. SlotDistance()
+ *  returns the distance from slot "from" to the next occupied slot in the
+ *  provided bitmap, wrapping around.
+ *
+ * Results:
+ *  Tick, time, or slot distance.
+ *
+ * Side effects:
+ *  None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static uint64_t
+TimeToTick(const Ns_Time *timePtr, bool roundUp)
+{
+    uint64_t tick = (uint64_t)timePtr->sec * (1000000u / WHEEL_TICK_USEC)
+        + (uint64_t)timePtr->usec / WHEEL_TICK_USEC;
+
+    if (roundUp && (timePtr->usec % WHEEL_TICK_USEC) != 0) {
+        tick++;
+    }
+    return tick;
+}
+
+static void
+TickToTime(uint64_t tick, Ns_Time *timePtr)
+{
+    timePtr->sec = (time_t)(tick / (1000000u / WHEEL_TICK_USEC));
+    timePtr->usec = (long)(tick % (1000000u / WHEEL_TICK_USEC)) * WHEEL_TICK_USEC;
+}
+
+static unsigned int
+SlotDistance(uint64_t bitmap, unsigned int from)
+{
+    uint64_t     rotated = (from == 0u) ? bitmap : ((bitmap >> from) | (bitmap << (WHEEL_SIZE - from)));
+    unsigned int distance;
+
+    assert(bitmap != 0u);
+#if defined(__GNUC__) || defined(__clang__)
+    distance = (unsigned int)__builtin_ctzll(rotated);
+#else
+    for (distance = 0u; (rotated & 1u) == 0u; distance++) {
+        rotated >>= 1;
+    }
+#endif
+    return distance;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * WheelInsert, WheelLink --
+ *
+ *  Add an event to the timing wheel based on its nextqueue time
+ *  (WheelInsert) or on the provided expiry tick (WheelLink, used as well
+ *  for cascading). The level is determined by the distance of the expiry
+ *  tick from the current tick of the wheel, the slot by the expiry tick
+ *  itself.
+ *
+ * Results:
+ *  NS_TRUE when the event was added, NS_FALSE when the event is beyond
+ *  the horizon of the wheel.
+ *
+ * Side effects:
+ *  None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static bool
+WheelInsert(Event *ePtr)
+{
+    if (wheel.count == 0) {
+        Ns_Time now;
+
+        Ns_GetTime(&now);
+        wheel.tick = TimeToTick(&now, NS_FALSE);
+    }
+    return WheelLink(ePtr, TimeToTick(&ePtr->nextqueue, NS_TRUE));
+}
+
+static bool
+WheelLink(Event *ePtr, uint64_t tick)
+{
+    uint64_t delta;
+    int      level;
+
+    if (tick < wheel.tick) {
+        tick = wheel.tick;
+    }
+    delta = tick - wheel.tick;
+
+    for (level = 0; level < WHEEL_LEVELS; level++) {
+        if (delta < (1ull << ((level + 1) * WHEEL_BITS))) {
+            unsigned int slot = (unsigned int)((tick >> (level * WHEEL_BITS)) & WHEEL_MASK);
+            Event      **headPtrPtr = &wheel.slots[level * WHEEL_SIZE + (int)slot];
+
+            ePtr->wheelTick = tick;
+            ePtr->wheelSlot = level * WHEEL_SIZE + (int)slot;
+            ePtr->wheelPrevPtr = NULL;
+            ePtr->wheelNextPtr = *headPtrPtr;
+            if (*headPtrPtr != NULL) {
+                (*headPtrPtr)->wheelPrevPtr = ePtr;
+            }
+            *headPtrPtr = ePtr;
+            wheel.occupied[level] |= (1ull << slot);
+            wheel.nevents[level]++;
+            wheel.count++;
+            return NS_TRUE;
+        }
+    }
+    return NS_FALSE;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * WheelRemove --
+ *
+ *  Remove an event from the timing wheel.
+ *
+ * Results:
+ *  None.
+ *
+ * Side effects:
+ *  None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+WheelRemove(Event *ePtr)
+{
+    int level = ePtr->wheelSlot / WHEEL_SIZE;
+
+    assert(ePtr->wheelSlot >= 0);
+
+    if (ePtr->wheelPrevPtr != NULL) {
+        ePtr->wheelPrevPtr->wheelNextPtr = ePtr->wheelNextPtr;
+    } else {
+        wheel.slots[ePtr->wheelSlot] = ePtr->wheelNextPtr;
+    }
+    if (ePtr->wheelNextPtr != NULL) {
+        ePtr->wheelNextPtr->wheelPrevPtr = ePtr->wheelPrevPtr;
+    }
+    if (wheel.slots[ePtr->wheelSlot] == NULL) {
+        wheel.occupied[level] &= ~(1ull << (ePtr->wheelSlot % WHEEL_SIZE));
+    }
+    wheel.nevents[level]--;
+    wheel.count--;
+    ePtr->wheelSlot = -1;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * WheelNextTick --
+ *
+ *  Determine the next tick at which the timing wheel has work to do,
+ *  i.e. either events of level 0 to fire or a slot of a higher level to
+ *  be cascaded. The wheel must not be empty.
+ *
+ * Results:
+ *  Tick, never smaller than the current tick of the wheel.
+ *
+ * Side effects:
+ *  None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static uint64_t
+WheelNextTick(void)
+{
+    uint64_t next = UINT64_MAX;
+    int      level;
+
+    assert(wheel.count > 0);
+
+    for (level = 0; level < WHEEL_LEVELS; level++) {
+        if (wheel.occupied[level] != 0u) {
+            uint64_t     current = wheel.tick >> (level * WHEEL_BITS), candidate;
+            unsigned int distance = SlotDistance(wheel.occupied[level],
+                                                 (unsigned int)(current & WHEEL_MASK));
+            if (level == 0) {
+                candidate = wheel.tick + distance;
+            } else if (distance > 0u) {
+                candidate = (current + distance) << (level * WHEEL_BITS);
+            } else if ((wheel.tick & WheelLevelMask(level)) == 0u) {
+                /*
+                 * The current slot was not cascaded yet.
+                 */
+                candidate = wheel.tick;
+            } else {
+                /*
+                 * The current slot was already cascaded, so it contains
+                 * events for the next round of this level.
+                 */
+                candidate = (current + WHEEL_SIZE) << (level * WHEEL_BITS);
+            }
+            if (candidate < next) {
+                next = candidate;
+            }
+        }
+    }
+    return next;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * WheelExpire --
+ *
+ *  Advance the timing wheel up to the provided time, cascading events
+ *  from higher levels and collecting the events which are due. Ticks
+ *  without work are skipped.
+ *
+ * Results:
+ *  List of due events (linked via nextPtr) in the order of expiry.
+ *
+ * Side effects:
+ *  Due events are removed from the wheel.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Event *
+WheelExpire(const Ns_Time *nowPtr)
+{
+    uint64_t now = TimeToTick(nowPtr, NS_FALSE);
+    Event   *firstPtr = NULL, **lastPtrPtr = &firstPtr;
+
+    while (wheel.count > 0 && wheel.tick <= now) {
+        uint64_t tick = WheelNextTick();
+        Event   *ePtr, *tailPtr;
+        int      level;
+
+        if (tick > now) {
+            break;
+        }
+        wheel.tick = tick;
+
+        /*
+         * Cascade the current slots of higher levels when the tick is at
+         * their boundary.
+         */
+        for (level = 1; level < WHEEL_LEVELS && (tick & WheelLevelMask(level)) == 0u; level++) {
+            int slot = level * WHEEL_SIZE + (int)((tick >> (level * WHEEL_BITS)) & WHEEL_MASK);
+
+            while ((ePtr = wheel.slots[slot]) != NULL) {
+                WheelRemove(ePtr);
+                (void) WheelLink(ePtr, ePtr->wheelTick);
+            }
+        }
+
+        /*
+         * Collect the events of the current slot of level 0. Events were
+         * prepended to the slot, so collect them from the tail to preserve
+         * the order of insertion.
+         */
+        tailPtr = wheel.slots[tick & WHEEL_MASK];
+        while (tailPtr != NULL && tailPtr->wheelNextPtr != NULL) {
+            tailPtr = tailPtr->wheelNextPtr;
+        }
+        while ((ePtr = tailPtr) != NULL) {
+            tailPtr = ePtr->wheelPrevPtr;
+            assert(ePtr->wheelTick == tick);
+            WheelRemove(ePtr);
+            ePtr->nextPtr = NULL;
+            *lastPtrPtr = ePtr;
+            lastPtrPtr = &ePtr->nextPtr;
+        }
+        wheel.tick = tick + 1u;
+    }
+    return firstPtr;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * EventReady --
+ *
+ *  Prepare a due event for execution: detached thread events are added
+ *  to the list of the EventThread()s, others to the provided list of
+ *  synchronous events.
+ *
+ * Results:
+ *  None.
+ *
+ * Side effects:
+ *  One-shot events are removed from the events table.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+EventReady(Event *ePtr, const Ns_Time *nowPtr, Event **readyPtrPtr)
+{
+#ifdef NS_SCHED_TRACE_EVENTS
+    Ns_Log(Notice, "... dequeue event (id %d) " NS_TIME_FMT,
+           ePtr->id,
+           (int64_t)ePtr->nextqueue.sec, ePtr->nextqueue.usec);
+#endif
+    if ((ePtr->flags & NS_SCHED_ONCE) != 0u) {
+        Tcl_DeleteHashEntry(ePtr->hPtr);
+        ePtr->hPtr = NULL;
+    }
+    ePtr->lastqueue = *nowPtr;
+    if ((ePtr->flags & NS_SCHED_THREAD) != 0u) {
+        ePtr->flags |= NS_SCHED_RUNNING;
+        ePtr->laststart = *nowPtr;
+        ePtr->nextPtr = firstEventPtr;
+        firstEventPtr = ePtr;
+    } else {
+        ePtr->nextPtr = *readyPtrPtr;
+        *readyPtrPtr = ePtr;
+    }
+}
+
 
 /*
  *----------------------------------------------------------------------
@@ -975,25 +1376,14 @@ SchedThread(void *UNUSED(arg))
         Ns_GetTime(&now);
         while (nqueue > 0 && Ns_DiffTime(&queue[1]->nextqueue, &now, NULL) <= 0) {
             ePtr = DeQueueEvent(1);
+            EventReady(ePtr, &now, &readyPtr);
+        }
+        if (wheel.count > 0) {
+            Event *expiredPtr = WheelExpire(&now);
 
-#ifdef NS_SCHED_TRACE_EVENTS
-            Ns_Log(Notice, "... dequeue event (id %d) " NS_TIME_FMT,
-                   ePtr->id,
-                   (int64_t)ePtr->nextqueue.sec, ePtr->nextqueue.usec);
-#endif
-            if ((ePtr->flags & NS_SCHED_ONCE) != 0u) {
-                Tcl_DeleteHashEntry(ePtr->hPtr);
-                ePtr->hPtr = NULL;
-            }
-            ePtr->lastqueue = now;
-            if ((ePtr->flags & NS_SCHED_THREAD) != 0u) {
-                ePtr->flags |= NS_SCHED_RUNNING;
-                ePtr->laststart = now;
-                ePtr->nextPtr = firstEventPtr;
-                firstEventPtr = ePtr;
-            } else {
-                ePtr->nextPtr = readyPtr;
-                readyPtr = ePtr;
+            while ((ePtr = expiredPtr) != NULL) {
+                expiredPtr = ePtr->nextPtr;
+                EventReady(ePtr, &now, &readyPtr);
             }
         }
 
@@ -1060,10 +1450,17 @@ SchedThread(void *UNUSED(arg))
         /*
          * Wait for the next ready event.
          */
-        if (nqueue == 0) {
+        if (nqueue == 0 && wheel.count == 0) {
             Ns_CondWait(&schedcond, &lock);
         } else if (!shutdownPending) {
-            timeout = queue[1]->nextqueue;
+            if (wheel.count > 0) {
+                TickToTime(WheelNextTick(), &timeout);
+                if (nqueue > 0 && Ns_DiffTime(&queue[1]->nextqueue, &timeout, NULL) < 0) {
+                    timeout = queue[1]->nextqueue;
+                }
+            } else {
+                timeout = queue[1]->nextqueue;
+            }
             (void) Ns_CondTimedWait(&schedcond, &lock, &timeout);
         }
 
@@ -1089,6 +1486,18 @@ SchedThread(void *UNUSED(arg))
         FreeEvent(queue[nqueue--]);
     }
     ns_free(queue);
+    {
+        int slot;
+
+        for (slot = 0; slot < WHEEL_LEVELS * WHEEL_SIZE; slot++) {
+            Event *ePtr;
+
+            while ((ePtr = wheel.slots[slot]) != NULL) {
+                WheelRemove(ePtr);
+                FreeEvent(ePtr);
+            }
+        }
+    }
     Tcl_DeleteHashTable(&eventsTable);
     Ns_Log(Notice, "sched: shutdown complete");
 
@@ -1099,6 +1508,58 @@ SchedThread(void *UNUSED(arg))
 }
 
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsGetScheduled, NsGetSchedulerWheels --
+ *
+ *  Append information about the scheduled events (NsGetScheduled) or
+ *  about the occupancy of the heap and the levels of the timing wheel
+ *  (NsGetSchedulerWheels) to the provided Tcl_DString.
+ *
+ * Results:
+ *  None.
+ *
+ * Side effects:
+ *  None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+NsGetSchedulerWheels(Tcl_DString *dsPtr)
+{
+    int level;
+
+    NS_NONNULL_ASSERT(dsPtr != NULL);
+
+    Ns_MutexLock(&lock);
+    Ns_DStringPrintf(dsPtr, "heap %d wheel {", nqueue);
+    for (level = 0; level < WHEEL_LEVELS; level++) {
+        Ns_Time  resolution, span;
+        uint64_t ticks = 1ull << (level * WHEEL_BITS);
+        int      nslots = 0, slot;
+
+        for (slot = 0; slot < WHEEL_SIZE; slot++) {
+            if ((wheel.occupied[level] & (1ull << slot)) != 0u) {
+                nslots++;
+            }
+        }
+        TickToTime(ticks, &resolution);
+        TickToTime(ticks * WHEEL_SIZE, &span);
+
+        Tcl_DStringStartSublist(dsPtr);
+        Ns_DStringPrintf(dsPtr, "level %d resolution ", level);
+        Ns_DStringAppendTime(dsPtr, &resolution);
+        Tcl_DStringAppend(dsPtr, " span ", 6);
+        Ns_DStringAppendTime(dsPtr, &span);
+        Ns_DStringPrintf(dsPtr, " events %d slots %d", wheel.nevents[level], nslots);
+        Tcl_DStringEndSublist(dsPtr);
+    }
+    Tcl_DStringAppend(dsPtr, "}", 1);
+    Ns_MutexUnlock(&lock);
+}
+
 void
 NsGetScheduled(Tcl_DString *dsPtr)
 {
@@ -35,6 +35,9 @@ typedef struct ServerInit {
 static void CreatePool(NsServer *servPtr, const char *pool)
     NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
 
+static void ConfigCompressFormats(NsServer *servPtr, const char *server, const char *formats)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(3);
+
 
 /*
  * Static variables defined in this file.
@@ -317,6 +320,22 @@ NsInitServer(const char *server, Ns_ServerInitProc *initProc)
     servPtr->compress.level = Ns_ConfigIntRange(path, "compresslevel", 4, 1, 9);
     servPtr->compress.minsize = (int)Ns_ConfigMemUnitRange(path, "compressminsize", NULL, 512, 0, INT_MAX);
     servPtr->compress.preinit = Ns_ConfigBool(path, "compresspreinit", NS_FALSE);
+    servPtr->compress.brotlilevel = Ns_ConfigIntRange(path, "compressbrotlilevel", 4, 1, 11);
+    servPtr->compress.zstdlevel = Ns_ConfigIntRange(path, "compresszstdlevel", 3, 1, 19);
+    ConfigCompressFormats(servPtr, server, Ns_ConfigString(path, "compressformats", "gzip"));
+    {
+        size_t compressCacheSize = (size_t)Ns_ConfigMemUnitRange(path, "compresscachesize", NULL,
+                                                                 0, 0, INT_MAX);
+        if (compressCacheSize > 0u) {
+            Tcl_DString ds;
+
+            Tcl_DStringInit(&ds);
+            Ns_DStringPrintf(&ds, "ns:compress:%s", server);
+            servPtr->compress.cache = Ns_CacheCreateSz(ds.string, TCL_STRING_KEYS,
+                                                       compressCacheSize, ns_free);
+            Tcl_DStringFree(&ds);
+        }
+    }
 
     /*
      * Call the static server init proc, if any, which may register
@@ -345,8 +364,8 @@ NsInitServer(const char *server, Ns_ServerInitProc *initProc)
     Ns_MutexInit(&servPtr->tcl.synch.lock);
     Ns_MutexSetName2(&servPtr->tcl.synch.lock, "nsd:tcl:synch", server);
 
-    Ns_MutexInit(&servPtr->urlspace.lock);
-    Ns_MutexSetName2(&servPtr->urlspace.lock, "nsd:urlspace", server);
+    Ns_RWLockInit(&servPtr->urlspace.lock);
+    Ns_RWLockSetName2(&servPtr->urlspace.lock, "nsd:urlspace", server);
 
     /*
      * Load modules and initialize Tcl.  The order is significant.
@@ -507,9 +526,24 @@ CreatePool(NsServer *servPtr, const char *pool)
     if (poolPtr->rate.poolLimit != -1) {
         NsWriterBandwidthManagement = NS_TRUE;
     }
-    for (n = 0; n < maxconns - 1; ++n) {
+    /*
+     * The wait queue is partitioned into "queueshards" shards. Each shard
+     * receives an equal part of the preallocated connection structures.
+     */
+    poolPtr->wqueue.nshards = Ns_ConfigIntRange(section, "queueshards", 1, 1, 64);
+    if (poolPtr->wqueue.nshards > maxconns) {
+        poolPtr->wqueue.nshards = maxconns;
+    }
+    poolPtr->wqueue.shards = ns_calloc((size_t)poolPtr->wqueue.nshards, sizeof(ConnQueueShard));
+
+    for (n = maxconns - 1; n >= 0; --n) {
+        ConnQueueShard *shardPtr;
+
         connPtr = &connBufPtr[n];
-        connPtr->nextPtr = &connBufPtr[n+1];
+        connPtr->queueShard = n % poolPtr->wqueue.nshards;
+        shardPtr = &poolPtr->wqueue.shards[connPtr->queueShard];
+        connPtr->nextPtr = shardPtr->freePtr;
+        shardPtr->freePtr = connPtr;
         if (servPtr->compress.enable
             && servPtr->compress.preinit) {
             (void) Ns_CompressInit(&connPtr->cStream);
@@ -517,9 +551,6 @@ CreatePool(NsServer *servPtr, const char *pool)
         connPtr->rateLimit = poolPtr->rate.defaultConnectionLimit;
     }
 
-    connBufPtr[n].nextPtr = NULL;
-    poolPtr->wqueue.freePtr = &connBufPtr[0];
-
     queueLength = maxconns - poolPtr->threads.max;
 
     highwatermark = Ns_ConfigIntRange(section, "highwatermark", 80, 0, 100);
@@ -567,8 +598,13 @@ CreatePool(NsServer *servPtr, const char *pool)
         Ns_MutexInit(&poolPtr->tqueue.lock);
         Ns_MutexSetName2(&poolPtr->tqueue.lock, ds.string, "tqueue");
 
-        Ns_MutexInit(&poolPtr->wqueue.lock);
-        Ns_MutexSetName2(&poolPtr->wqueue.lock, ds.string, "wqueue");
+        for (j = 0; j < poolPtr->wqueue.nshards; j++) {
+            char suffix[64];
+
+            snprintf(suffix, 64u, "wqueue:%d", j);
+            Ns_MutexInit(&poolPtr->wqueue.shards[j].lock);
+            Ns_MutexSetName2(&poolPtr->wqueue.shards[j].lock, ds.string, suffix);
+        }
         Ns_CondInit(&poolPtr->wqueue.cond);
 
         Ns_MutexInit(&poolPtr->threads.lock);
@@ -581,6 +617,69 @@ CreatePool(NsServer *servPtr, const char *pool)
     }
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * ConfigCompressFormats --
+ *
+ *      Set the compression formats used for on-the-fly compression from
+ *      the "compressformats" parameter. The list is in order of server
+ *      preference; for every response, the first format accepted by the
+ *      client is used. Formats not compiled in are skipped with a warning.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Updates servPtr->compress.formats.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ConfigCompressFormats(NsServer *servPtr, const char *server, const char *formats)
+{
+    Tcl_Obj   *listObj, **objv;
+    TCL_SIZE_T objc, i;
+
+    servPtr->compress.nformats = 0;
+    listObj = Tcl_NewStringObj(formats, TCL_INDEX_NONE);
+    Tcl_IncrRefCount(listObj);
+
+    if (Tcl_ListObjGetElements(NULL, listObj, &objc, &objv) != TCL_OK) {
+        Ns_Log(Warning, "init server %s: invalid list of compressformats: '%s'",
+               server, formats);
+        objc = 0;
+    }
+    for (i = 0; i < objc; i++) {
+        const char       *name = Tcl_GetString(objv[i]);
+        Ns_CompressFormat format;
+        int               j;
+        bool              duplicate = NS_FALSE;
+
+        if (Ns_CompressFormatFromName(name, &format) != NS_OK) {
+            Ns_Log(Warning, "init server %s: ignore unknown compress format '%s'",
+                   server, name);
+            continue;
+        }
+        if (!Ns_CompressFormatSupported(format)) {
+            Ns_Log(Warning, "init server %s: compress format '%s' is not supported by this build",
+                   server, name);
+            continue;
+        }
+        for (j = 0; j < servPtr->compress.nformats; j++) {
+            if (servPtr->compress.formats[j] == format) {
+                duplicate = NS_TRUE;
+                break;
+            }
+        }
+        if (!duplicate) {
+            servPtr->compress.formats[servPtr->compress.nformats++] = format;
+        }
+    }
+    Tcl_DecrRefCount(listObj);
+}
+
 /*
  * Local Variables:
  * mode: c
@@ -23,7 +23,9 @@
  */
 
 typedef struct TclCache {
-    Ns_Cache   *cache;
+    Ns_Cache   *cache;    /* First (or only) shard of the cache. */
+    Ns_Cache  **shards;   /* Independently locked shards. */
+    int         nshards;  /* Number of shards, 1 for unsharded caches. */
     Ns_Time     timeout;  /* Default timeout for concurrent updates. */
     Ns_Time     expires;  /* Default time-to-live for cache entries. */
     size_t      maxEntry; /* Maximum size of a single entry in the cache. */
@@ -37,9 +39,9 @@ typedef struct TclCache {
 
 static int CacheAppendObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc, Tcl_Obj *const* objv, bool append);
 
-static Ns_Entry *CreateEntry(const NsInterp *itPtr, TclCache *cPtr, const char *key,
+static Ns_Entry *CreateEntry(const NsInterp *itPtr, TclCache *cPtr, Ns_Cache *cache, const char *key,
                              int *newPtr, Ns_Time *timeoutPtr, const Ns_CacheTransactionStack *transactionStackPtr)
-    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(3) NS_GNUC_NONNULL(4);
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(3) NS_GNUC_NONNULL(4) NS_GNUC_NONNULL(5);
 
 static void SetEntry(NsInterp *itPtr, TclCache *cPtr, Ns_Entry *entry, Tcl_Obj *valObj, Ns_Time *expPtr, int cost)
     NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(3) NS_GNUC_NONNULL(4);
@@ -48,9 +50,16 @@ static bool noGlobChars(const char *pattern)
     NS_GNUC_NONNULL(1) NS_GNUC_PURE;
 
 static TclCache *TclCacheCreate(const char *name, size_t maxEntry, size_t maxSize,
-                                const Ns_Time *timeoutPtr, const Ns_Time *expPtr)
+                                const Ns_Time *timeoutPtr, const Ns_Time *expPtr, int nshards,
+                                Ns_CachePolicy policy)
     NS_GNUC_NONNULL(1) NS_GNUC_RETURNS_NONNULL;
 
+static Ns_Cache *TclCacheShard(const TclCache *cPtr, const char *key)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_PURE;
+
+static size_t TclCacheShardSize(const TclCache *cPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_PURE;
+
 static Tcl_Obj*GetCacheNames(NsServer *servPtr, bool withUncommittedEntries)
     NS_GNUC_NONNULL(1) NS_GNUC_RETURNS_NONNULL;
 
@@ -69,6 +78,13 @@ static int CacheEval(Tcl_Interp *interp, TCL_SIZE_T nargs, TCL_OBJC_T objc, Tcl_
 
 static Ns_ObjvProc ObjvCache;
 
+static Ns_ObjvTable policies[] = {
+    {"lru",     (unsigned int)NS_CACHE_LRU},
+    {"clock",   (unsigned int)NS_CACHE_CLOCK},
+    {"tinylfu", (unsigned int)NS_CACHE_TINYLFU},
+    {NULL,      0u}
+};
+
 
 
 /*
@@ -104,8 +120,13 @@ GetCacheNames(NsServer *servPtr, bool withUncommittedEntries) {
 
         if (withUncommittedEntries) {
             const TclCache *cPtr = Tcl_GetHashValue(hPtr);
+            TCL_SIZE_T      uncommitted = 0;
+            int             i;
 
-            if (Ns_CacheGetNrUncommittedEntries(cPtr->cache) > 0) {
+            for (i = 0; i < cPtr->nshards; i++) {
+                uncommitted += Ns_CacheGetNrUncommittedEntries(cPtr->shards[i]);
+            }
+            if (uncommitted > 0) {
                 Tcl_ListObjAppendElement(NULL, listObj, Tcl_NewStringObj(key, TCL_INDEX_NONE));
             }
         } else {
@@ -123,7 +144,11 @@ GetCacheNames(NsServer *servPtr, bool withUncommittedEntries) {
  *
  * TclCacheCreate --
  *
- *      Create a new Tcl cache.
+ *      Create a new Tcl cache. When nshards is larger than 1, the cache is
+ *      split into nshards independent Ns_Caches named "name:0",
+ *      "name:1", ..., each with its own lock and LRU list and an equal
+ *      share of maxSize. Keys are distributed over the shards by hash
+ *      value. All shards use the provided eviction policy.
  *
  * Results:
  *      TclCache *
@@ -136,16 +161,41 @@ GetCacheNames(NsServer *servPtr, bool withUncommittedEntries) {
 
 static TclCache *
 TclCacheCreate(const char *name, size_t maxEntry, size_t maxSize,
-               const Ns_Time *timeoutPtr, const Ns_Time *expPtr)
+               const Ns_Time *timeoutPtr, const Ns_Time *expPtr, int nshards,
+               Ns_CachePolicy policy)
 {
     TclCache *cPtr;
+    int       i;
 
     NS_NONNULL_ASSERT(name != NULL);
 
+    if (nshards < 1) {
+        nshards = 1;
+    }
     cPtr = ns_calloc(1u, sizeof(TclCache));
-    cPtr->cache = Ns_CacheCreateSz(name, TCL_STRING_KEYS, maxSize, ns_free);
     cPtr->maxEntry = maxEntry;
     cPtr->maxSize  = maxSize;
+    cPtr->nshards  = nshards;
+    cPtr->shards   = ns_calloc((size_t)nshards, sizeof(Ns_Cache *));
+
+    if (nshards == 1) {
+        cPtr->shards[0] = Ns_CacheCreateSz(name, TCL_STRING_KEYS, maxSize, ns_free);
+    } else {
+        Tcl_DString ds;
+
+        Tcl_DStringInit(&ds);
+        for (i = 0; i < nshards; i++) {
+            Ns_DStringPrintf(&ds, "%s:%d", name, i);
+            cPtr->shards[i] = Ns_CacheCreateSz(ds.string, TCL_STRING_KEYS,
+                                               TclCacheShardSize(cPtr), ns_free);
+            Tcl_DStringSetLength(&ds, 0);
+        }
+        Tcl_DStringFree(&ds);
+    }
+    cPtr->cache = cPtr->shards[0];
+    for (i = 0; i < nshards; i++) {
+        Ns_CacheSetPolicy(cPtr->shards[i], policy);
+    }
     if (timeoutPtr != NULL) {
         cPtr->timeout = *timeoutPtr;
     }
@@ -156,6 +206,85 @@ TclCacheCreate(const char *name, size_t maxEntry, size_t maxSize,
     return cPtr;
 }
 
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclCacheShard --
+ *
+ *      Return the shard of the Tcl cache responsible for the provided key.
+ *
+ * Results:
+ *      Ns_Cache *
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Ns_Cache *
+TclCacheShard(const TclCache *cPtr, const char *key)
+{
+    Ns_Cache *cache;
+
+    NS_NONNULL_ASSERT(cPtr != NULL);
+    NS_NONNULL_ASSERT(key != NULL);
+
+    if (cPtr->nshards == 1) {
+        cache = cPtr->cache;
+    } else {
+        /*
+         * FNV-1a, spreads keys with common prefixes well over a small
+         * number of shards.
+         */
+        uint32_t hash = 2166136261u;
+
+        while (*key != '\0') {
+            hash ^= (uint32_t)UCHAR(*key++);
+            hash *= 16777619u;
+        }
+        cache = cPtr->shards[hash % (uint32_t)cPtr->nshards];
+    }
+    return cache;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclCacheShardSize --
+ *
+ *      Return the maximum size of a single shard of the Tcl cache.
+ *
+ * Results:
+ *      Size in bytes, 0 means unlimited.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static size_t
+TclCacheShardSize(const TclCache *cPtr)
+{
+    size_t size;
+
+    NS_NONNULL_ASSERT(cPtr != NULL);
+
+    if (cPtr->maxSize == 0u || cPtr->nshards == 1) {
+        size = cPtr->maxSize;
+    } else {
+        size = cPtr->maxSize / (size_t)cPtr->nshards;
+        if (size == 0u) {
+            size = 1u;
+        }
+    }
+    return size;
+}
+
+
 
 /*
  *----------------------------------------------------------------------
@@ -177,14 +306,17 @@ int
 NsTclCacheCreateObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc, Tcl_Obj *const* objv)
 {
     char        *name = NULL;
-    int         result = TCL_OK;
+    int         result = TCL_OK, nshards = 1, policy = (int)NS_CACHE_LRU;
     Tcl_WideInt maxSize = 0, maxEntry = 0;
     Ns_Time    *timeoutPtr = NULL, *expPtr = NULL;
+    Ns_ObjvValueRange shardsRange = {1, 1024};
 
     Ns_ObjvSpec opts[] = {
         {"-timeout",  Ns_ObjvTime,    &timeoutPtr, NULL},
         {"-expires",  Ns_ObjvTime,    &expPtr,     NULL},
         {"-maxentry", Ns_ObjvMemUnit, &maxEntry,   NULL},
+        {"-shards",   Ns_ObjvInt,     &nshards,    &shardsRange},
+        {"-policy",   Ns_ObjvIndex,   &policy,     policies},
         {"--",        Ns_ObjvBreak,   NULL,        NULL},
         {NULL, NULL,  NULL, NULL}
     };
@@ -209,7 +341,9 @@ NsTclCacheCreateObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T obj
         Ns_RWLockWrLock(&servPtr->tcl.cachelock);
         hPtr = Tcl_CreateHashEntry(&servPtr->tcl.caches, name, &isNew);
         if (isNew != 0) {
-            TclCache *cPtr = TclCacheCreate(name, (size_t)maxEntry, (size_t)maxSize, timeoutPtr, expPtr);
+            TclCache *cPtr = TclCacheCreate(name, (size_t)maxEntry, (size_t)maxSize,
+                                            timeoutPtr, expPtr, nshards,
+                                            (Ns_CachePolicy)policy);
             Tcl_SetHashValue(hPtr, cPtr);
         }
         Ns_RWLockUnlock(&servPtr->tcl.cachelock);
@@ -480,6 +614,7 @@ NsTclCacheEvalObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc,
         Ns_Entry                 *entry;
         NsInterp                 *itPtr;
         Ns_CacheTransactionStack *transactionStackPtr;
+        Ns_Cache                 *cache;
         int                       isNew;
 
         assert(clientData != NULL);
@@ -488,6 +623,7 @@ NsTclCacheEvalObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc,
 
         itPtr = clientData;
         transactionStackPtr = &itPtr->cacheTransactionStack;
+        cache = TclCacheShard(cPtr, key);
 
         /*
          * CreateEntry waits for ongoing transactions. If it succeeds, it
@@ -495,7 +631,7 @@ NsTclCacheEvalObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc,
          * provided cache value (isNew == 0) ... which might be from the
          * current transaction.
          */
-        entry = CreateEntry(itPtr, cPtr, key, &isNew, timeoutPtr, transactionStackPtr);
+        entry = CreateEntry(itPtr, cPtr, cache, key, &isNew, timeoutPtr, transactionStackPtr);
 
         if (unlikely(entry == NULL)) {
             status = TCL_ERROR;
@@ -507,7 +643,7 @@ NsTclCacheEvalObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc,
             /*
              * We have a value for the cache entry, return it.
              */
-            Ns_CacheUnlock(cPtr->cache);
+            Ns_CacheUnlock(cache);
             Tcl_SetObjResult(interp, resultObj);
             status = TCL_OK;
 
@@ -527,7 +663,7 @@ NsTclCacheEvalObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc,
             /*
              * Evaluate the cmd to obtain the cache value.
              */
-            Ns_CacheUnlock(cPtr->cache);
+            Ns_CacheUnlock(cache);
 
             Ns_GetTime(&start);
             status = CacheEval(interp, nargs, objc, objv);
@@ -535,7 +671,7 @@ NsTclCacheEvalObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc,
 
             (void)Ns_DiffTime(&end, &start, &diff);
 
-            Ns_CacheLock(cPtr->cache);
+            Ns_CacheLock(cache);
             {
                 /*
                  * This is just a sanity check, hopefully transitional code.
@@ -543,11 +679,11 @@ NsTclCacheEvalObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc,
                 Ns_Entry *entry2;
                 int isNew2 = 0;
 
-                entry2 = Ns_CacheCreateEntry(cPtr->cache, key, &isNew2);
+                entry2 = Ns_CacheCreateEntry(cache, key, &isNew2);
                 if (isNew2 != 0) {
                     Ns_Log(Warning, "==== cache %s key %s old entry %p"
                            " different from re-fetched entry %p",
-                           Ns_CacheName(cPtr->cache),
+                           Ns_CacheName(cache),
                            key, (void*)entry, (void*)entry2);
                 }
             }
@@ -585,8 +721,8 @@ NsTclCacheEvalObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc,
                 SetEntry(itPtr, cPtr, entry, resultObj, expPtr,
                          (int)(diff.sec * 1000000 + diff.usec));
             }
-            Ns_CacheBroadcast(cPtr->cache);
-            Ns_CacheUnlock(cPtr->cache);
+            Ns_CacheBroadcast(cache);
+            Ns_CacheUnlock(cache);
         }
     }
     return status;
@@ -639,21 +775,22 @@ NsTclCacheIncrObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc,
         result = TCL_ERROR;
     } else {
         Ns_CacheTransactionStack *transactionStackPtr = &itPtr->cacheTransactionStack;
-        Ns_Entry   *entry = CreateEntry(itPtr, cPtr, key, &isNew, timeoutPtr, transactionStackPtr);
+        Ns_Cache   *cache = TclCacheShard(cPtr, key);
+        Ns_Entry   *entry = CreateEntry(itPtr, cPtr, cache, key, &isNew, timeoutPtr, transactionStackPtr);
         int         cur = 0;
 
         if (entry == NULL) {
             result = TCL_ERROR;
         } else if ((isNew == 0)
                    && (Tcl_GetInt(interp, Ns_CacheGetValueT(entry, transactionStackPtr), &cur) != TCL_OK)) {
-            Ns_CacheUnlock(cPtr->cache);
+            Ns_CacheUnlock(cache);
             result = TCL_ERROR;
         } else {
             Tcl_Obj *valObj = Tcl_NewIntObj(cur + incr);
 
             SetEntry(itPtr, cPtr, entry, valObj, expPtr, 0);
             Tcl_SetObjResult(interp, valObj);
-            Ns_CacheUnlock(cPtr->cache);
+            Ns_CacheUnlock(cache);
             result = TCL_OK;
         }
     }
@@ -721,12 +858,14 @@ CacheAppendObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc, Tc
     } else {
         int                             isNew;
         Ns_Entry                       *entry;
+        Ns_Cache                       *cache;
         const Ns_CacheTransactionStack *transactionStackPtr = &itPtr->cacheTransactionStack;
 
         assert(cPtr != NULL);
         assert(key != NULL);
 
-        entry = CreateEntry(itPtr, cPtr, key, &isNew, timeoutPtr, transactionStackPtr);
+        cache = TclCacheShard(cPtr, key);
+        entry = CreateEntry(itPtr, cPtr, cache, key, &isNew, timeoutPtr, transactionStackPtr);
         if (entry == NULL) {
             result = TCL_ERROR;
         } else {
@@ -749,7 +888,7 @@ CacheAppendObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc, Tc
                 SetEntry(itPtr, cPtr, entry, valObj, expPtr, 0);
                 Tcl_SetObjResult(interp, valObj);
             }
-            Ns_CacheUnlock(cPtr->cache);
+            Ns_CacheUnlock(cache);
         }
     }
     return result;
@@ -853,36 +992,44 @@ NsTclCacheKeysObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc,
          * cases, or when the option "-exact" is specified, a single hash
          * lookup is sufficient.
          */
+        Ns_Cache *cache;
+
         assert(cPtr != NULL);
-        Ns_CacheLock(cPtr->cache);
-        entry = Ns_CacheFindEntryT(cPtr->cache, pattern, transactionStackPtr);
+        cache = TclCacheShard(cPtr, pattern);
+        Ns_CacheLock(cache);
+        entry = Ns_CacheFindEntryT(cache, pattern, transactionStackPtr);
         if (entry != NULL && Ns_CacheGetValueT(entry, transactionStackPtr) != NULL) {
             Tcl_ListObjAppendElement(interp, listObj, Tcl_NewStringObj(pattern, TCL_INDEX_NONE));
         }
-        Ns_CacheUnlock(cPtr->cache);
+        Ns_CacheUnlock(cache);
         Tcl_SetObjResult(interp, listObj);
 
     } else {
         Ns_CacheSearch  search;
         Tcl_Obj        *listObj = Tcl_NewListObj(0, NULL);
+        int             i;
 
         /*
          * We have either no pattern or the pattern contains meta
-         * characters. We need to iterate over all entries, which can
-         * take a while for large caches.
+         * characters. We need to iterate over all entries of all shards,
+         * which can take a while for large caches.
          */
         assert(cPtr != NULL);
-        Ns_CacheLock(cPtr->cache);
-        entry = Ns_CacheFirstEntryT(cPtr->cache, &search, transactionStackPtr);
-        while (entry != NULL) {
-            const char *key = Ns_CacheKey(entry);
+        for (i = 0; i < cPtr->nshards; i++) {
+            Ns_Cache *cache = cPtr->shards[i];
 
-            if (pattern == NULL || Tcl_StringMatch(key, pattern) == 1) {
-                Tcl_ListObjAppendElement(interp, listObj, Tcl_NewStringObj(key, TCL_INDEX_NONE));
+            Ns_CacheLock(cache);
+            entry = Ns_CacheFirstEntryT(cache, &search, transactionStackPtr);
+            while (entry != NULL) {
+                const char *key = Ns_CacheKey(entry);
+
+                if (pattern == NULL || Tcl_StringMatch(key, pattern) == 1) {
+                    Tcl_ListObjAppendElement(interp, listObj, Tcl_NewStringObj(key, TCL_INDEX_NONE));
+                }
+                entry = Ns_CacheNextEntryT(&search, transactionStackPtr);
             }
-            entry = Ns_CacheNextEntryT(&search, transactionStackPtr);
+            Ns_CacheUnlock(cache);
         }
-        Ns_CacheUnlock(cPtr->cache);
         Tcl_SetObjResult(interp, listObj);
     }
 
@@ -937,71 +1084,86 @@ NsTclCacheFlushObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc
         Ns_Entry  *entry;
         int        nflushed = 0;
         TCL_SIZE_T i;
-        Ns_Cache  *cache;
 
         assert(cPtr != NULL);
-        cache = cPtr->cache;
 
-        Ns_CacheLock(cache);
-        if (npatterns == 0) {
+        if (npatterns > 0 && glob == (int)NS_FALSE) {
             /*
-             * Flush all cache entries.
+             * Flush the provided entries without glob matching. Every key
+             * requires just the lock of its shard.
              */
-            if (transactionStackPtr == NULL || (transactionStackPtr->depth == 0u)) {
-                /*
-                 * No transaction is active.
-                 */
-                nflushed = Ns_CacheFlush(cache);
-            } else {
-                Ns_CacheSearch  search;
-
-                /*
-                 * flush all in transaction.
-                 */
-                entry = Ns_CacheFirstEntryT(cache, &search, transactionStackPtr);
-                while (entry != NULL) {
-                    Ns_CacheFlushEntry(entry);
-                    nflushed++;
-                    entry = Ns_CacheNextEntryT(&search, transactionStackPtr);
-                }
-            }
-
-        } else if (glob == (int)NS_FALSE) {
-            /*
-             * Flush the provided entries without glob matching.
-             */
-
             for (i = npatterns; i > 0; i--) {
-                entry = Ns_CacheFindEntryT(cache, Tcl_GetString(objv[(TCL_SIZE_T)objc-i]), transactionStackPtr);
+                const char *key = Tcl_GetString(objv[(TCL_SIZE_T)objc-i]);
+                Ns_Cache   *cache = TclCacheShard(cPtr, key);
+
+                Ns_CacheLock(cache);
+                entry = Ns_CacheFindEntryT(cache, key, transactionStackPtr);
                 if (entry != NULL && Ns_CacheGetValueT(entry, transactionStackPtr) != NULL) {
                     Ns_CacheFlushEntry(entry);
                     nflushed++;
                 }
+                Ns_CacheUnlock(cache);
             }
 
         } else {
-            Ns_CacheSearch  search;
+            int shard;
 
             /*
-             * Flush the provided entries with glob matching.
+             * Flush all entries or the entries matching the provided glob
+             * patterns, one shard after the other.
              */
-            entry = Ns_CacheFirstEntryT(cache, &search, transactionStackPtr);
-            while (entry != NULL) {
-                const char *key = Ns_CacheKey(entry);
-
-                for (i = npatterns; i > 0; i--) {
-                    const char *pattern = Tcl_GetString(objv[(TCL_SIZE_T)objc-i]);
+            for (shard = 0; shard < cPtr->nshards; shard++) {
+                Ns_Cache *cache = cPtr->shards[shard];
+
+                Ns_CacheLock(cache);
+                if (npatterns == 0) {
+                    /*
+                     * Flush all cache entries.
+                     */
+                    if (transactionStackPtr == NULL || (transactionStackPtr->depth == 0u)) {
+                        /*
+                         * No transaction is active.
+                         */
+                        nflushed += Ns_CacheFlush(cache);
+                    } else {
+                        Ns_CacheSearch  search;
+
+                        /*
+                         * flush all in transaction.
+                         */
+                        entry = Ns_CacheFirstEntryT(cache, &search, transactionStackPtr);
+                        while (entry != NULL) {
+                            Ns_CacheFlushEntry(entry);
+                            nflushed++;
+                            entry = Ns_CacheNextEntryT(&search, transactionStackPtr);
+                        }
+                    }
 
-                    if (Tcl_StringMatch(key, pattern) == 1) {
-                        Ns_CacheFlushEntry(entry);
-                        nflushed++;
-                        break;
+                } else {
+                    Ns_CacheSearch  search;
+
+                    /*
+                     * Flush the provided entries with glob matching.
+                     */
+                    entry = Ns_CacheFirstEntryT(cache, &search, transactionStackPtr);
+                    while (entry != NULL) {
+                        const char *key = Ns_CacheKey(entry);
+
+                        for (i = npatterns; i > 0; i--) {
+                            const char *pattern = Tcl_GetString(objv[(TCL_SIZE_T)objc-i]);
+
+                            if (Tcl_StringMatch(key, pattern) == 1) {
+                                Ns_CacheFlushEntry(entry);
+                                nflushed++;
+                                break;
+                            }
+                        }
+                        entry = Ns_CacheNextEntryT(&search, transactionStackPtr);
                     }
                 }
-                entry = Ns_CacheNextEntryT(&search, transactionStackPtr);
+                Ns_CacheUnlock(cache);
             }
         }
-        Ns_CacheUnlock(cache);
         Tcl_SetObjResult(interp, Tcl_NewIntObj(nflushed));
     }
     return result;
@@ -1051,10 +1213,13 @@ NsTclCacheGetObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc,
         const NsInterp  *itPtr = clientData;
         const Ns_CacheTransactionStack *transactionStackPtr = &itPtr->cacheTransactionStack;
 
+        Ns_Cache        *cache;
+
         assert(cPtr != NULL);
 
-        Ns_CacheLock(cPtr->cache);
-        entry = Ns_CacheFindEntryT(cPtr->cache, key, transactionStackPtr);
+        cache = TclCacheShard(cPtr, key);
+        Ns_CacheLock(cache);
+        entry = Ns_CacheFindEntryT(cache, key, transactionStackPtr);
         if (entry != NULL) {
             void  *value = Ns_CacheGetValueT(entry, transactionStackPtr);
 
@@ -1066,7 +1231,7 @@ NsTclCacheGetObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc,
         } else {
             resultObj = NULL;
         }
-        Ns_CacheUnlock(cPtr->cache);
+        Ns_CacheUnlock(cache);
 
         if (unlikely(varNameObj != NULL)) {
             Tcl_SetObjResult(interp, Tcl_NewBooleanObj(resultObj != NULL));
@@ -1130,49 +1295,64 @@ NsTclCacheStatsObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc
 
     } else {
         Ns_DString      ds;
-        Ns_Cache       *cache;
+        int             i;
 
         assert(cPtr != NULL);
 
-        cache = cPtr->cache;
         Ns_DStringInit(&ds);
 
-        Ns_CacheLock(cache);
         if (contents != 0) {
-            Ns_CacheSearch  search;
-            const Ns_Entry *entry;
+            for (i = 0; i < cPtr->nshards; i++) {
+                Ns_Cache       *cache = cPtr->shards[i];
+                Ns_CacheSearch  search;
+                const Ns_Entry *entry;
 
-            entry = Ns_CacheFirstEntry(cache, &search);
-            while (entry != NULL) {
-                Tcl_DString    entryDs;
-                const char    *key     = Ns_CacheKey(entry);
-                size_t         size    = Ns_CacheGetSize(entry);
-                size_t         reuse   = Ns_CacheGetReuse(entry);
-                const Ns_Time *timePtr = Ns_CacheGetExpirey(entry);
-
-                Ns_DStringInit(&entryDs);
-
-                Tcl_DStringAppendElement(&entryDs, key);
-                if (timePtr->usec == 0) {
-                    Ns_DStringPrintf(&entryDs, " %" PRIdz " %" PRIdz " %" PRId64,
-                                     size, reuse, (int64_t) timePtr->sec);
-                } else {
-                    Ns_DStringPrintf(&entryDs, " %" PRIdz " %" PRIdz " %" PRId64 ":%ld",
-                                     size, reuse, (int64_t) timePtr->sec, timePtr->usec);
-                }
-                Tcl_DStringAppendElement(&ds, entryDs.string);
-                Ns_DStringFree(&entryDs);
+                Ns_CacheLock(cache);
+                entry = Ns_CacheFirstEntry(cache, &search);
+                while (entry != NULL) {
+                    Tcl_DString    entryDs;
+                    const char    *key     = Ns_CacheKey(entry);
+                    size_t         size    = Ns_CacheGetSize(entry);
+                    size_t         reuse   = Ns_CacheGetReuse(entry);
+                    const Ns_Time *timePtr = Ns_CacheGetExpirey(entry);
+
+                    Ns_DStringInit(&entryDs);
+
+                    Tcl_DStringAppendElement(&entryDs, key);
+                    if (timePtr->usec == 0) {
+                        Ns_DStringPrintf(&entryDs, " %" PRIdz " %" PRIdz " %" PRId64,
+                                         size, reuse, (int64_t) timePtr->sec);
+                    } else {
+                        Ns_DStringPrintf(&entryDs, " %" PRIdz " %" PRIdz " %" PRId64 ":%ld",
+                                         size, reuse, (int64_t) timePtr->sec, timePtr->usec);
+                    }
+                    Tcl_DStringAppendElement(&ds, entryDs.string);
+                    Ns_DStringFree(&entryDs);
 
-                entry = Ns_CacheNextEntry(&search);
+                    entry = Ns_CacheNextEntry(&search);
+                }
+                if (reset != 0) {
+                    Ns_CacheResetStats(cache);
+                }
+                Ns_CacheUnlock(cache);
             }
 
         } else {
-            (void) Ns_CacheStats(cache, &ds);
-        }
-        if (reset != 0) {
-            Ns_CacheResetStats(cache);
+            /*
+             * Lock all shards (always in the same order) to obtain a
+             * consistent snapshot of the aggregated statistics.
+             */
+            for (i = 0; i < cPtr->nshards; i++) {
+                Ns_CacheLock(cPtr->shards[i]);
+            }
+            (void) NsCacheStats(cPtr->shards, cPtr->nshards, &ds);
+            for (i = cPtr->nshards - 1; i >= 0; i--) {
+                if (reset != 0) {
+                    Ns_CacheResetStats(cPtr->shards[i]);
+                }
+                Ns_CacheUnlock(cPtr->shards[i]);
+            }
         }
-        Ns_CacheUnlock(cache);
 
         Tcl_DStringResult(interp, &ds);
     }
@@ -1186,7 +1366,7 @@ NsTclCacheStatsObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc
  *
  * CreateEntry --
  *
- *      Lock the cache and create a new entry or return existing entry,
+ *      Lock the cache (shard) and create a new entry or return existing entry,
  *      waiting up to timeout seconds for another thread to complete
  *      an update.
  *
@@ -1200,20 +1380,18 @@ NsTclCacheStatsObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc
  */
 
 static Ns_Entry *
-CreateEntry(const NsInterp *itPtr, TclCache *cPtr, const char *key, int *newPtr,
+CreateEntry(const NsInterp *itPtr, TclCache *cPtr, Ns_Cache *cache, const char *key, int *newPtr,
             Ns_Time *timeoutPtr, const Ns_CacheTransactionStack *transactionStackPtr)
 {
-    Ns_Cache *cache;
     Ns_Entry *entry;
     Ns_Time   t;
 
     NS_NONNULL_ASSERT(itPtr != NULL);
     NS_NONNULL_ASSERT(cPtr != NULL);
+    NS_NONNULL_ASSERT(cache != NULL);
     NS_NONNULL_ASSERT(key != NULL);
     NS_NONNULL_ASSERT(newPtr != NULL);
 
-    cache = cPtr->cache;
-
     if (timeoutPtr == NULL
         && (cPtr->timeout.sec > 0 || cPtr->timeout.usec > 0)) {
         timeoutPtr = Ns_AbsoluteTime(&t, &cPtr->timeout);
@@ -1268,7 +1446,7 @@ SetEntry(NsInterp *itPtr, TclCache *cPtr, Ns_Entry *entry, Tcl_Obj *valObj, Ns_T
         Ns_Log(Notice, "ns_cache %s key '%s': "
                "entry size %" PRIuz " is larger than the configured maxentry %" PRIuz
                " value (entry is not cached)",
-               Ns_CacheName(cPtr->cache),
+               Ns_CacheName(TclCacheShard(cPtr, Ns_CacheKey(entry))),
                Ns_CacheKey(entry),
                valueSize,
                cPtr->maxEntry);
@@ -1304,12 +1482,12 @@ SetEntry(NsInterp *itPtr, TclCache *cPtr, Ns_Entry *entry, Tcl_Obj *valObj, Ns_T
         }
         if (transactionStackPtr->depth > 0) {
             int uncommitted = Ns_CacheSetValueExpires(entry, value, valueSize,
-                                                      expPtr, cost, cPtr->maxSize,
+                                                      expPtr, cost, TclCacheShardSize(cPtr),
                                                       transactionStackPtr->stack[transactionStackPtr->depth - 1]);
             transactionStackPtr->uncommitted[transactionStackPtr->depth - 1] += uncommitted;
         } else {
             (void) Ns_CacheSetValueExpires(entry, value, valueSize,
-                                           expPtr, cost, cPtr->maxSize, 0u);
+                                           expPtr, cost, TclCacheShardSize(cPtr), 0u);
         }
 
     }
@@ -1574,23 +1752,26 @@ CacheTransactionFinish(NsServer *servPtr, const char *cacheName, uintptr_t trans
         result = TCL_ERROR;
 
     } else {
-        TclCache  *cPtr = Tcl_GetHashValue(hPtr);
-        Ns_Cache  *cache;
+        const TclCache *cPtr = Tcl_GetHashValue(hPtr);
+        int             i;
 
         assert(cPtr != NULL);
-        cache = cPtr->cache;
 
-        Ns_CacheLock(cache);
-        if (commit) {
-            *countPtr += Ns_CacheCommitEntries(cache, transactionEpoch);
-        } else {
-            *countPtr += Ns_CacheRollbackEntries(cache, transactionEpoch);
+        for (i = 0; i < cPtr->nshards; i++) {
+            Ns_Cache *cache = cPtr->shards[i];
+
+            Ns_CacheLock(cache);
+            if (commit) {
+                *countPtr += Ns_CacheCommitEntries(cache, transactionEpoch);
+            } else {
+                *countPtr += Ns_CacheRollbackEntries(cache, transactionEpoch);
+            }
+            /*
+             * Make sure to notify potentially waiting threads about the result.
+             */
+            Ns_CacheBroadcast(cache);
+            Ns_CacheUnlock(cache);
         }
-        /*
-         * Make sure to notify potentially waiting threads about the result.
-         */
-        Ns_CacheBroadcast(cPtr->cache);
-        Ns_CacheUnlock(cache);
         result = TCL_OK;
     }
 
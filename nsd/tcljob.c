@@ -42,6 +42,16 @@
  *   The queues are reference counted. Only when a queue is empty and
  *   its reference count is zero can it be deleted.
  *
+ *   Pending jobs are kept per queue in FIFO order. The right to start
+ *   the next job of a queue is represented by a token; a queue never has
+ *   more tokens and running jobs than its "maxThreads". Tokens created
+ *   by "ns_job queue" are added to the thread pool's inject list, tokens
+ *   created by a job thread after finishing a job are pushed to the
+ *   thread's own deque (work stealing): the owner pops from the bottom
+ *   of its deque without touching the queuelock, idle threads steal from
+ *   the top of the deques of other threads. Tokens from the inject list
+ *   are preferred over the local deque to keep queues fair.
+ *
  *   We can no longer use a Tcl_Obj to represent the queue because
  *   queues can now be deleted. Tcl_Objs are deleted when the object
  *   goes out of scope, whereas queues are deleted when delete is
@@ -68,6 +78,16 @@
 
 #define NS_JOB_DEFAULT_MAXTHREADS 4
 
+/*
+ * Relaxed load used for lock-free hints on counters which are modified
+ * under the queuelock.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+# define JobLoadRelaxed(x) __atomic_load_n(&(x), __ATOMIC_RELAXED)
+#else
+# define JobLoadRelaxed(x) (x)
+#endif
+
 /*
  * Enumeration types for the controlling variables.
  */
@@ -140,10 +160,35 @@ typedef struct Queue {
     QueueRequests      req;
     int                maxThreads;
     int                nRunning;
+    int                nPending;    /* Number of jobs in the pending list. */
+    int                nScheduled;  /* Number of tokens for this queue. */
+    Job               *firstPtr;    /* Pending jobs in FIFO order. */
+    Job               *lastPtr;
     Tcl_HashTable      jobs;
     int                refCount;
 } Queue;
 
+/*
+ * A token grants the right to start the next pending job of a queue.
+ */
+
+typedef struct Token {
+    struct Token      *nextPtr;     /* Towards the bottom of the deque. */
+    struct Token      *prevPtr;     /* Towards the top of the deque. */
+    Queue             *queue;
+} Token;
+
+/*
+ * Every job thread owns a deque of tokens.
+ */
+
+typedef struct Worker {
+    struct Worker     *nextPtr;     /* Next worker of the thread pool. */
+    Ns_Mutex           lock;        /* Lock for the deque. */
+    Token             *topPtr;      /* Stealing end of the deque. */
+    Token             *bottomPtr;   /* Owner's end of the deque. */
+} Worker;
+
 
 /*
  * A threadpool manages a global set of threads.
@@ -159,7 +204,11 @@ typedef struct ThreadPool {
     int                nthreads;
     int                nidle;
     int                jobsPerThread;
-    Job               *firstPtr;
+    int                nInject;     /* Number of tokens in the inject list. */
+    unsigned long      nSteals;     /* Number of tokens stolen from deques. */
+    Token             *firstTokenPtr; /* Inject list, FIFO. */
+    Token             *lastTokenPtr;
+    Worker            *firstWorkerPtr;
     Ns_Time            timeout;
     Ns_Time            logminduration;
 } ThreadPool;
@@ -186,7 +235,20 @@ static TCL_OBJCMDPROC_T  JobWaitAnyObjCmd;
 static TCL_OBJCMDPROC_T  JobWaitObjCmd;
 
 static void   JobThread(void *arg);
-static Job*   GetNextJob(void);
+static Token* GetNextToken(Worker *workerPtr)
+    NS_GNUC_NONNULL(1);
+static bool   QueueNeedsToken(const Queue *queue)
+    NS_GNUC_NONNULL(1) NS_GNUC_PURE;
+static void   InjectToken(Queue *queue, bool head)
+    NS_GNUC_NONNULL(1);
+static void   WorkerPush(Worker *workerPtr, Token *tokenPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+static Token* WorkerPop(Worker *workerPtr)
+    NS_GNUC_NONNULL(1);
+static Token* WorkerSteal(Worker *workerPtr)
+    NS_GNUC_NONNULL(1);
+static void   ReleaseWorkerQueue(Queue *queue)
+    NS_GNUC_NONNULL(1);
 
 static Queue* NewQueue(const char* queueName, const char* queueDesc, int maxThreads)
     NS_GNUC_NONNULL(1)  NS_GNUC_NONNULL(2)
@@ -270,7 +332,11 @@ NsTclInitQueueType(void)
     tp.maxThreads = 0;
     tp.nthreads = 0;
     tp.nidle = 0;
-    tp.firstPtr = NULL;
+    tp.nInject = 0;
+    tp.nSteals = 0u;
+    tp.firstTokenPtr = NULL;
+    tp.lastTokenPtr = NULL;
+    tp.firstWorkerPtr = NULL;
     tp.req = THREADPOOL_REQ_NONE;
     tp.jobsPerThread = 0;
     tp.timeout.sec = 0;
@@ -609,20 +675,29 @@ JobQueueObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc, Tcl_O
         }
 
         /*
-         * Add the job to the thread pool's job list, if "-head" is
-         * specified, insert new job at the beginning, otherwise
-         * append new job to the end.
+         * Add the job to the queue's list of pending jobs, if "-head" is
+         * specified, insert new job at the beginning, otherwise append
+         * new job to the end. When the queue has capacity left, hand out
+         * a token for it to the thread pool.
          */
         if (head != 0) {
-            jobPtr->nextPtr = tp.firstPtr;
-            tp.firstPtr = jobPtr;
+            jobPtr->nextPtr = queue->firstPtr;
+            queue->firstPtr = jobPtr;
+            if (queue->lastPtr == NULL) {
+                queue->lastPtr = jobPtr;
+            }
         } else {
-            Job  **nextPtrPtr = &tp.firstPtr;
-
-            while (*nextPtrPtr != NULL) {
-                nextPtrPtr = &((*nextPtrPtr)->nextPtr);
+            jobPtr->nextPtr = NULL;
+            if (queue->lastPtr != NULL) {
+                queue->lastPtr->nextPtr = jobPtr;
+            } else {
+                queue->firstPtr = jobPtr;
             }
-            *nextPtrPtr = jobPtr;
+            queue->lastPtr = jobPtr;
+        }
+        ++queue->nPending;
+        if (QueueNeedsToken(queue)) {
+            InjectToken(queue, (head != 0));
         }
 
         /*
@@ -1253,6 +1328,7 @@ JobQueueListObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp, TCL_OBJC_T
                 || AppendField(interp, queueFieldList, "desc", queue->desc) != TCL_OK
                 || AppendFieldInt(interp, queueFieldList, "maxthreads", queue->maxThreads) != TCL_OK
                 || AppendFieldInt(interp, queueFieldList, "numrunning", queue->nRunning) != TCL_OK
+                || AppendFieldInt(interp, queueFieldList, "numpending", queue->nPending) != TCL_OK
                 || AppendField(interp, queueFieldList, "req", queueReq) != TCL_OK
                 ) {
                 Tcl_DecrRefCount(queueFieldList);
@@ -1353,6 +1429,7 @@ JobThreadListObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp, TCL_OBJC_
         if (AppendFieldInt(interp, tpFieldList, "maxthreads", tp.maxThreads) != TCL_OK
             || AppendFieldInt(interp, tpFieldList, "numthreads", tp.nthreads) != TCL_OK
             || AppendFieldInt(interp, tpFieldList, "numidle", tp.nidle) != TCL_OK
+            || AppendFieldLong(interp, tpFieldList, "numsteals", (long)tp.nSteals) != TCL_OK
             || AppendField(interp, tpFieldList, "req", tpReq) != TCL_OK
             ) {
             result = TCL_ERROR;
@@ -1438,17 +1515,30 @@ JobThread(void *UNUSED(arg))
     Ns_Time           wait;
     int               jpt, njobs;
     uintptr_t         tid;
+    Worker            worker, **workerPtrPtr;
+    Token            *tokenPtr;
 
     (void)Ns_WaitForStartup();
+
+    memset(&worker, 0, sizeof(worker));
+    Ns_MutexInit(&worker.lock);
+
     Ns_MutexLock(&tp.queuelock);
     tid = tp.nextThreadId++;
     Ns_ThreadSetName("-nsjob:%lx-", tid);
+    Ns_MutexSetName2(&worker.lock, "nsjob:worker", Ns_ThreadGetName());
     Ns_Log(Notice, "Starting thread: -ns_job_%" PRIxPTR "-", tid);
 
     async = Tcl_AsyncCreate(JobAbort, NULL);
 
     SetupJobDefaults();
 
+    /*
+     * Make the deque of this thread visible for work stealing.
+     */
+    worker.nextPtr = tp.firstWorkerPtr;
+    tp.firstWorkerPtr = &worker;
+
     /*
      * Setting parameter "jobsperthread" to > 0 will cause the thread
      * to graciously exit after processing that many job requests,
@@ -1456,38 +1546,74 @@ JobThread(void *UNUSED(arg))
      */
 
     jpt = njobs = tp.jobsPerThread;
+    Ns_MutexUnlock(&tp.queuelock);
 
     while (jpt == 0 || njobs > 0) {
         Job          *jobPtr;
         Tcl_Interp   *interp;
         int           code;
-        Ns_ReturnCode status;
-
-        ++tp.nidle;
-        status = NS_OK;
-        if (tp.timeout.sec > 0 || tp.timeout.usec > 0) {
-            Ns_GetTime(&wait);
-            Ns_IncrTime(&wait, tp.timeout.sec, tp.timeout.usec);
-            timePtr = &wait;
-        } else {
-            timePtr = NULL;
-        }
-        jobPtr = NULL;
-        while (status == NS_OK &&
-               !(tp.req == THREADPOOL_REQ_STOP) &&
-               ((jobPtr = GetNextJob()) == NULL)) {
-            status = Ns_CondTimedWait(&tp.cond, &tp.queuelock, timePtr);
+        bool          pushed = NS_FALSE;
+
+        /*
+         * Take the next token from the own deque without locking the
+         * thread pool, unless there are tokens in the inject list, which
+         * are preferred for fairness between the queues.
+         */
+        tokenPtr = NULL;
+        if (JobLoadRelaxed(tp.nInject) == 0) {
+            tokenPtr = WorkerPop(&worker);
         }
-        --tp.nidle;
-        if (tp.req == THREADPOOL_REQ_STOP || jobPtr == NULL) {
-            break;
+        if (tokenPtr == NULL) {
+            Ns_ReturnCode status = NS_OK;
+            bool          stop;
+
+            Ns_MutexLock(&tp.queuelock);
+            ++tp.nidle;
+            if (tp.timeout.sec > 0 || tp.timeout.usec > 0) {
+                Ns_GetTime(&wait);
+                Ns_IncrTime(&wait, tp.timeout.sec, tp.timeout.usec);
+                timePtr = &wait;
+            } else {
+                timePtr = NULL;
+            }
+            while (status == NS_OK &&
+                   !(tp.req == THREADPOOL_REQ_STOP) &&
+                   ((tokenPtr = GetNextToken(&worker)) == NULL)) {
+                status = Ns_CondTimedWait(&tp.cond, &tp.queuelock, timePtr);
+            }
+            --tp.nidle;
+            stop = (tp.req == THREADPOOL_REQ_STOP);
+            Ns_MutexUnlock(&tp.queuelock);
+            if (stop || tokenPtr == NULL) {
+                if (tokenPtr != NULL) {
+                    WorkerPush(&worker, tokenPtr);
+                }
+                break;
+            }
         }
 
-        if (LookupQueue(NULL, jobPtr->queueId, &queue, NS_TRUE) != TCL_OK) {
-            Ns_Log(Fatal, "cannot find queue: %s", jobPtr->queueId);
-            break;
+        /*
+         * The queue cannot vanish while it has tokens, since there is a
+         * pending job for every token.
+         */
+        queue = tokenPtr->queue;
+        ns_free(tokenPtr);
+        tokenPtr = NULL;
+
+        Ns_MutexLock(&queue->lock);
+        ++queue->refCount;
+        --queue->nScheduled;
+        jobPtr = queue->firstPtr;
+        if (jobPtr == NULL) {
+            ReleaseWorkerQueue(queue);
+            continue;
         }
-        assert(queue != NULL);
+        queue->firstPtr = jobPtr->nextPtr;
+        if (queue->firstPtr == NULL) {
+            queue->lastPtr = NULL;
+        }
+        jobPtr->nextPtr = NULL;
+        --queue->nPending;
 
         /*
          * Get an interpreter....
@@ -1519,14 +1645,12 @@ JobThread(void *UNUSED(arg))
         ++queue->nRunning;
 
         Ns_MutexUnlock(&queue->lock);
-        Ns_MutexUnlock(&tp.queuelock);
 
         /*
          * ... and execute the job.
          */
         code = Tcl_EvalEx(interp, jobPtr->script.string, TCL_INDEX_NONE, 0);
 
-        Ns_MutexLock(&tp.queuelock);
         Ns_MutexLock(&queue->lock);
 
         --queue->nRunning;
@@ -1593,8 +1717,32 @@ JobThread(void *UNUSED(arg))
             FreeJob(jobPtr);
         }
 
+        /*
+         * When the queue has more pending jobs and the slot of this job
+         * became free, continue with the queue on this thread by pushing a
+         * token to the own deque.
+         */
+        if (QueueNeedsToken(queue)) {
+            tokenPtr = ns_malloc(sizeof(Token));
+            tokenPtr->queue = queue;
+            ++queue->nScheduled;
+            WorkerPush(&worker, tokenPtr);
+            tokenPtr = NULL;
+            pushed = NS_TRUE;
+        }
+
         Ns_CondBroadcast(&queue->cond);
-        (void)ReleaseQueue(queue, NS_TRUE);
+        ReleaseWorkerQueue(queue);
+
+        if (pushed && JobLoadRelaxed(tp.nidle) > 0) {
+            /*
+             * Let an idle thread steal the token when this thread
+             * proceeds with a different one.
+             */
+            Ns_MutexLock(&tp.queuelock);
+            Ns_CondSignal(&tp.cond);
+            Ns_MutexUnlock(&tp.queuelock);
+        }
 
         if ((jpt != 0) && --njobs <= 0) {
             /*
@@ -1604,6 +1752,31 @@ JobThread(void *UNUSED(arg))
         }
     }
 
+    Ns_MutexLock(&tp.queuelock);
+
+    /*
+     * Unregister the deque and hand remaining tokens over to the inject
+     * list.
+     */
+    for (workerPtrPtr = &tp.firstWorkerPtr; *workerPtrPtr != NULL;
+         workerPtrPtr = &(*workerPtrPtr)->nextPtr) {
+        if (*workerPtrPtr == &worker) {
+            *workerPtrPtr = worker.nextPtr;
+            break;
+        }
+    }
+    while ((tokenPtr = WorkerSteal(&worker)) != NULL) {
+        tokenPtr->nextPtr = NULL;
+        if (tp.lastTokenPtr != NULL) {
+            tp.lastTokenPtr->nextPtr = tokenPtr;
+        } else {
+            tp.firstTokenPtr = tokenPtr;
+        }
+        tp.lastTokenPtr = tokenPtr;
+        ++tp.nInject;
+    }
+    Ns_MutexDestroy(&worker.lock);
+
     --tp.nthreads;
 
     Tcl_AsyncDelete(async);
@@ -1612,7 +1785,7 @@ JobThread(void *UNUSED(arg))
 
     Ns_Log(Notice, "exiting");
 }
-
+
 /*
  *----------------------------------------------------------------------
  +
@@ -1648,64 +1821,209 @@ JobAbort(ClientData UNUSED(clientData), Tcl_Interp *interp, int UNUSED(code))
 /*
  *----------------------------------------------------------------------
  *
- * GetNextJob --
+ * GetNextToken --
  *
- *      Get the next job from the queue.
+ *      Get the next token for a job thread: from the inject list, from
+ *      the own deque, or stolen from the deque of another thread.
  *      The queuelock should be held locked.
  *
  * Results:
- *      The job.
+ *      Token or NULL, when no token is available.
  *
  * Side effects:
- *      Queues have a "maxThreads" so if the queue is already
- *      at "maxThreads", jobs of that queue will be skipped.
+ *      None.
  *
  *----------------------------------------------------------------------
  */
 
-static Job*
-GetNextJob(void)
+static Token*
+GetNextToken(Worker *workerPtr)
 {
-    Queue         *queue;
-    Job           *prevPtr, *jobPtr;
-    bool           done = NS_FALSE;
+    Token *tokenPtr = tp.firstTokenPtr;
 
-    jobPtr = prevPtr = tp.firstPtr;
+    NS_NONNULL_ASSERT(workerPtr != NULL);
 
-    while (!done && jobPtr != NULL) {
-
-        if (LookupQueue(NULL, jobPtr->queueId, &queue, NS_TRUE) != TCL_OK) {
-            Ns_Log(Fatal, "cannot find queue: %s", jobPtr->queueId);
-            break;
+    if (tokenPtr != NULL) {
+        tp.firstTokenPtr = tokenPtr->nextPtr;
+        if (tp.firstTokenPtr == NULL) {
+            tp.lastTokenPtr = NULL;
         }
-        assert(queue != NULL);
+        --tp.nInject;
 
-        if (queue->nRunning < queue->maxThreads) {
-            /*
-             * Job can be serviced; remove it from the pending list.
-             */
-            if (jobPtr == tp.firstPtr) {
-                tp.firstPtr = jobPtr->nextPtr;
-            } else {
-                prevPtr->nextPtr = jobPtr->nextPtr;
+    } else if ((tokenPtr = WorkerPop(workerPtr)) == NULL) {
+        Worker *victimPtr;
+
+        for (victimPtr = tp.firstWorkerPtr; victimPtr != NULL; victimPtr = victimPtr->nextPtr) {
+            if (victimPtr != workerPtr) {
+                tokenPtr = WorkerSteal(victimPtr);
+                if (tokenPtr != NULL) {
+                    tp.nSteals++;
+                    break;
+                }
             }
-            done = NS_TRUE;
+        }
+    }
+
+    return tokenPtr;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * QueueNeedsToken --
+ *
+ *      Check whether the queue has pending jobs without a token and
+ *      capacity for running more jobs. The queue should be locked.
+ *
+ * Results:
+ *      Boolean value.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static bool
+QueueNeedsToken(const Queue *queue)
+{
+    NS_NONNULL_ASSERT(queue != NULL);
+
+    return (queue->nPending > queue->nScheduled
+            && queue->nScheduled + queue->nRunning < queue->maxThreads);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * InjectToken --
+ *
+ *      Add a token for the queue to the inject list of the thread pool.
+ *      The queuelock and the queue should be locked.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
 
+static void
+InjectToken(Queue *queue, bool head)
+{
+    Token *tokenPtr;
+
+    NS_NONNULL_ASSERT(queue != NULL);
+
+    tokenPtr = ns_malloc(sizeof(Token));
+    tokenPtr->queue = queue;
+    tokenPtr->prevPtr = NULL;
+    if (head) {
+        tokenPtr->nextPtr = tp.firstTokenPtr;
+        tp.firstTokenPtr = tokenPtr;
+        if (tp.lastTokenPtr == NULL) {
+            tp.lastTokenPtr = tokenPtr;
+        }
+    } else {
+        tokenPtr->nextPtr = NULL;
+        if (tp.lastTokenPtr != NULL) {
+            tp.lastTokenPtr->nextPtr = tokenPtr;
         } else {
-            /*
-             * Go to next job.
-             */
-            prevPtr = jobPtr;
-            jobPtr = jobPtr->nextPtr;
+            tp.firstTokenPtr = tokenPtr;
         }
+        tp.lastTokenPtr = tokenPtr;
+    }
+    ++tp.nInject;
+    ++queue->nScheduled;
+}
 
-        (void)ReleaseQueue(queue, NS_TRUE);
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * WorkerPush, WorkerPop, WorkerSteal --
+ *
+ *      Operations on the deque of a job thread. The owner pushes and
+ *      pops at the bottom (LIFO, keeping the thread on the queue it
+ *      worked on), other threads steal from the top (oldest token).
+ *
+ * Results:
+ *      WorkerPop and WorkerSteal return a token or NULL when the deque
+ *      is empty.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+WorkerPush(Worker *workerPtr, Token *tokenPtr)
+{
+    NS_NONNULL_ASSERT(workerPtr != NULL);
+    NS_NONNULL_ASSERT(tokenPtr != NULL);
+
+    Ns_MutexLock(&workerPtr->lock);
+    tokenPtr->nextPtr = NULL;
+    tokenPtr->prevPtr = workerPtr->bottomPtr;
+    if (workerPtr->bottomPtr != NULL) {
+        workerPtr->bottomPtr->nextPtr = tokenPtr;
+    } else {
+        workerPtr->topPtr = tokenPtr;
     }
+    workerPtr->bottomPtr = tokenPtr;
+    Ns_MutexUnlock(&workerPtr->lock);
+}
 
-    return jobPtr;
+static Token*
+WorkerPop(Worker *workerPtr)
+{
+    Token *tokenPtr;
+
+    NS_NONNULL_ASSERT(workerPtr != NULL);
+
+    Ns_MutexLock(&workerPtr->lock);
+    tokenPtr = workerPtr->bottomPtr;
+    if (tokenPtr != NULL) {
+        workerPtr->bottomPtr = tokenPtr->prevPtr;
+        if (workerPtr->bottomPtr != NULL) {
+            workerPtr->bottomPtr->nextPtr = NULL;
+        } else {
+            workerPtr->topPtr = NULL;
+        }
+    }
+    Ns_MutexUnlock(&workerPtr->lock);
+
+    return tokenPtr;
 }
 
-
+static Token*
+WorkerSteal(Worker *workerPtr)
+{
+    Token *tokenPtr;
+
+    NS_NONNULL_ASSERT(workerPtr != NULL);
+
+    Ns_MutexLock(&workerPtr->lock);
+    tokenPtr = workerPtr->topPtr;
+    if (tokenPtr != NULL) {
+        workerPtr->topPtr = tokenPtr->nextPtr;
+        if (workerPtr->topPtr != NULL) {
+            workerPtr->topPtr->prevPtr = NULL;
+        } else {
+            workerPtr->bottomPtr = NULL;
+        }
+    }
+    Ns_MutexUnlock(&workerPtr->lock);
+
+    return tokenPtr;
+}
+
+
 /*
  *----------------------------------------------------------------------
  *
@@ -2011,6 +2329,40 @@ ReleaseQueue(Queue *queue, bool locked)
 }
 
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * ReleaseWorkerQueue --
+ *
+ *      Release a queue locked by a job thread without holding the
+ *      queuelock. When the queue might be deleted, the queuelock is
+ *      acquired first to respect the locking order.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      See ReleaseQueue().
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+ReleaseWorkerQueue(Queue *queue)
+{
+    NS_NONNULL_ASSERT(queue != NULL);
+
+    if (queue->req == QUEUE_REQ_DELETE) {
+        Ns_MutexUnlock(&queue->lock);
+        Ns_MutexLock(&tp.queuelock);
+        Ns_MutexLock(&queue->lock);
+        (void)ReleaseQueue(queue, NS_TRUE);
+        Ns_MutexUnlock(&tp.queuelock);
+    } else {
+        (void)ReleaseQueue(queue, NS_FALSE);
+    }
+}
+
+
 /*
  *----------------------------------------------------------------------
  *
@@ -17,6 +17,41 @@
 
 #include "nsd.h"
 
+/*
+ * Read-mostly arrays and native counters require atomic operations for
+ * the lockless paths. Without these, read-mostly arrays behave like plain
+ * arrays and counters are stored as strings. The fallback definitions are
+ * only used for reference counting under the bucket lock.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+# define NSV_READMOSTLY 1
+# define NSV_COUNTERS 1
+# define NsvLoadAcquire(ptr)        __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+# define NsvLoadRelaxed(ptr)        __atomic_load_n((ptr), __ATOMIC_RELAXED)
+# define NsvStoreRelease(ptr, val)  __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+# define NsvAtomicAdd(ptr, val)     __atomic_add_fetch((ptr), (val), __ATOMIC_RELAXED)
+# define NsvRefIncr(ptr)            __atomic_add_fetch((ptr), 1, __ATOMIC_RELAXED)
+# define NsvRefDecr(ptr)            __atomic_sub_fetch((ptr), 1, __ATOMIC_ACQ_REL)
+#else
+# define NsvLoadAcquire(ptr)        (*(ptr))
+# define NsvLoadRelaxed(ptr)        (*(ptr))
+# define NsvStoreRelease(ptr, val)  (*(ptr) = (val))
+# define NsvAtomicAdd(ptr, val)     (*(ptr) += (val))
+# define NsvRefIncr(ptr)            (++(*(ptr)))
+# define NsvRefDecr(ptr)            (--(*(ptr)))
+#endif
+
+/*
+ * Values of native counters are stored in the variable table as tagged
+ * pointers to a Counter structure, all other values are plain strings.
+ */
+#define NSV_COUNTER_TAG             ((uintptr_t)1u)
+#define NSV_COUNTER_MAX_STRIPES     64
+#define NSV_CACHE_LINE_SIZE         64
+#define IsCounterValue(value)       ((((uintptr_t)(value)) & NSV_COUNTER_TAG) != 0u)
+#define CounterFromValue(value)     ((Counter *)(((uintptr_t)(value)) & ~NSV_COUNTER_TAG))
+#define CounterToValue(counterPtr)  ((void *)(((uintptr_t)(counterPtr)) | NSV_COUNTER_TAG))
+
 /*
  * The following structure defines a collection of arrays.
  * Only the arrays within a given bucket share a lock,
@@ -36,12 +71,51 @@ typedef struct Bucket {
  */
 
 typedef struct Array {
-    Bucket        *bucketPtr; /* Array bucket. */
-    Tcl_HashEntry *entryPtr;  /* Entry in bucket array table. */
-    Tcl_HashTable  vars;      /* Table of variables. */
-    long           locks;     /* Number of array locks */
+    Bucket          *bucketPtr;   /* Array bucket. */
+    Tcl_HashEntry   *entryPtr;    /* Entry in bucket array table. */
+    Tcl_HashTable    vars;        /* Table of variables. */
+    long             locks;       /* Number of array locks */
+    struct Snapshot *snapshotPtr; /* Current version of a read-mostly array. */
+    bool             dirty;       /* Read-mostly array was write locked. */
+    int              counterStripes; /* Stripes of native counters, 0 for none. */
 } Array;
 
+/*
+ * The following structure defines an immutable copy of a read-mostly
+ * array. Readers keep a reference to the snapshot in the internal
+ * representation of the Tcl_Obj of the array name and use it without
+ * locking until a writer publishes a newer version.
+ */
+
+typedef struct Snapshot {
+    Tcl_HashTable  vars;          /* Copy of the variables of the array. */
+    Bucket        *bucketPtr;     /* Array bucket. */
+    long           refCount;      /* Array and Tcl_Objs referencing the snapshot. */
+    int            superseded;    /* Newer version is published or array is gone. */
+} Snapshot;
+
+/*
+ * The following structure defines a native counter, as created by
+ * "nsv_incr" in arrays with counters. The counter value is the sum of the
+ * stripes, where every thread increments its own stripe. The key Tcl_Obj
+ * used by "nsv_incr" keeps a reference to the counter, such that further
+ * increments do not require the bucket lock.
+ */
+
+typedef struct CounterStripe {
+    Tcl_WideInt     value;
+    char            pad[NSV_CACHE_LINE_SIZE - sizeof(Tcl_WideInt)];
+} CounterStripe;
+
+typedef struct Counter {
+    const NsServer *servPtr;      /* Server of the array. */
+    char           *arrayName;    /* Name of the array. */
+    long            refCount;     /* Array entry and Tcl_Objs referencing the counter. */
+    int             removed;      /* Counter is not part of the array anymore. */
+    int             nstripes;     /* Number of stripes. */
+    CounterStripe   stripes[1];   /* Partial counts, variable size. */
+} Counter;
+
 
 /*
  * Local functions defined in this file.
@@ -65,7 +139,7 @@ static void Flush(Array *arrayPtr)
 static Array *LockArray(const NsServer *servPtr, const char *arrayName, bool create, NS_RW rw)
     NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
 
-static void UnlockArray(const Array *arrayPtr)
+static void UnlockArray(Array *arrayPtr)
     NS_GNUC_NONNULL(1);
 
 static Array *LockArrayObj(Tcl_Interp *interp, Tcl_Obj *arrayObj, bool create, NS_RW rw)
@@ -81,6 +155,82 @@ static int GetArrayAndKey(Tcl_Interp *interp, Tcl_Obj *arrayObj, const char *key
                           NS_RW rw, Array  **arrayPtrPtr, Tcl_Obj **objPtr)
     NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(3) NS_GNUC_NONNULL(5) NS_GNUC_NONNULL(6);
 
+static void PublishSnapshot(Array *arrayPtr)
+    NS_GNUC_NONNULL(1);
+
+static void RetireSnapshot(Array *arrayPtr)
+    NS_GNUC_NONNULL(1);
+
+static void ReleaseSnapshot(Snapshot *snapshotPtr)
+    NS_GNUC_NONNULL(1);
+
+static Snapshot *GetSnapshotObj(const Tcl_Obj *arrayObj)
+    NS_GNUC_NONNULL(1);
+
+static void SetSnapshotObj(Tcl_Obj *arrayObj, const Array *arrayPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+
+static Tcl_FreeInternalRepProc FreeSnapshotInternalRep;
+static Tcl_DupInternalRepProc  DupSnapshotInternalRep;
+
+static const char *VarValue(const Tcl_HashEntry *hPtr, char *buffer)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_RETURNS_NONNULL;
+
+static void FreeVarValue(void *value);
+
+static Counter *NewCounter(const Array *arrayPtr, Tcl_WideInt value)
+    NS_GNUC_NONNULL(1) NS_GNUC_RETURNS_NONNULL;
+
+static void ReleaseCounter(Counter *counterPtr)
+    NS_GNUC_NONNULL(1);
+
+static Tcl_WideInt CounterValue(const Counter *counterPtr)
+    NS_GNUC_NONNULL(1);
+
+static Tcl_WideInt CounterIncr(Counter *counterPtr, int incr)
+    NS_GNUC_NONNULL(1);
+
+static Counter *GetCounterObj(Tcl_Interp *interp, Tcl_Obj *arrayObj, const Tcl_Obj *keyObj)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(3);
+
+static void SetCounterObj(Tcl_Obj *keyObj, Array *arrayPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+
+static Tcl_FreeInternalRepProc FreeCounterInternalRep;
+static Tcl_DupInternalRepProc  DupCounterInternalRep;
+
+/*
+ * Tcl_Obj type for array names referring to a snapshot of a read-mostly
+ * array. The string representation is always kept.
+ */
+
+static const Tcl_ObjType snapshotType = {
+    "nsv:snapshot",
+    FreeSnapshotInternalRep,
+    DupSnapshotInternalRep,
+    NULL,
+    NULL
+#ifdef TCL_OBJTYPE_V0
+   ,TCL_OBJTYPE_V0
+#endif
+};
+
+/*
+ * Tcl_Obj type for keys referring to a native counter. The string
+ * representation is always kept.
+ */
+
+static const Tcl_ObjType counterType = {
+    "nsv:counter",
+    FreeCounterInternalRep,
+    DupCounterInternalRep,
+    NULL,
+    NULL
+#ifdef TCL_OBJTYPE_V0
+   ,TCL_OBJTYPE_V0
+#endif
+};
+
 
 /*
  *-----------------------------------------------------------------------------
@@ -160,9 +310,14 @@ NsTclNsvGetObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
         result = TCL_ERROR;
 
     } else {
-        Array *arrayPtr = LockArrayObj(interp, objv[1], NS_FALSE, NS_READ);
+        Snapshot       *snapshotPtr = GetSnapshotObj(objv[1]);
+        Array          *arrayPtr = NULL;
 
-        if (unlikely(arrayPtr == NULL)) {
+        if (snapshotPtr == NULL) {
+            arrayPtr = LockArrayObj(interp, objv[1], NS_FALSE, NS_READ);
+        }
+
+        if (unlikely(snapshotPtr == NULL && arrayPtr == NULL)) {
             result = TCL_ERROR;
 
         } else {
@@ -170,9 +325,20 @@ NsTclNsvGetObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
             const Tcl_HashEntry *hPtr;
             const char          *keyString = Tcl_GetString(objv[2]);
 
-            hPtr = Tcl_CreateHashEntry(&arrayPtr->vars, keyString, NULL);
-            resultObj = likely(hPtr != NULL) ? Tcl_NewStringObj(Tcl_GetHashValue(hPtr), TCL_INDEX_NONE) : NULL;
-            UnlockArray(arrayPtr);
+            if (snapshotPtr != NULL) {
+                /*
+                 * Lockless lookup in the snapshot of a read-mostly array.
+                 */
+                hPtr = Tcl_FindHashEntry(&snapshotPtr->vars, keyString);
+                resultObj = likely(hPtr != NULL) ? Tcl_NewStringObj(Tcl_GetHashValue(hPtr), TCL_INDEX_NONE) : NULL;
+            } else {
+                char buffer[TCL_INTEGER_SPACE];
+
+                hPtr = Tcl_CreateHashEntry(&arrayPtr->vars, keyString, NULL);
+                resultObj = likely(hPtr != NULL) ? Tcl_NewStringObj(VarValue(hPtr, buffer), TCL_INDEX_NONE) : NULL;
+                SetSnapshotObj(objv[1], arrayPtr);
+                UnlockArray(arrayPtr);
+            }
 
             if (objc == 3) {
                 if (likely(resultObj != NULL)) {
@@ -222,15 +388,22 @@ NsTclNsvExistsObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
         Tcl_WrongNumArgs(interp, 1, objv, "array key");
         result = TCL_ERROR;
     } else {
-        bool   exists = NS_FALSE;
-        Array *arrayPtr = LockArrayObj(interp, objv[1], NS_FALSE, NS_READ);
+        bool            exists = NS_FALSE;
+        Snapshot       *snapshotPtr = GetSnapshotObj(objv[1]);
 
-        if (likely(arrayPtr != NULL)) {
-            if (Tcl_CreateHashEntry(&arrayPtr->vars,
-                                    Tcl_GetString(objv[2]), NULL) != NULL) {
-                exists = NS_TRUE;
+        if (snapshotPtr != NULL) {
+            exists = (Tcl_FindHashEntry(&snapshotPtr->vars, Tcl_GetString(objv[2])) != NULL);
+        } else {
+            Array *arrayPtr = LockArrayObj(interp, objv[1], NS_FALSE, NS_READ);
+
+            if (likely(arrayPtr != NULL)) {
+                if (Tcl_CreateHashEntry(&arrayPtr->vars,
+                                        Tcl_GetString(objv[2]), NULL) != NULL) {
+                    exists = NS_TRUE;
+                }
+                SetSnapshotObj(objv[1], arrayPtr);
+                UnlockArray(arrayPtr);
             }
-            UnlockArray(arrayPtr);
         }
         Tcl_SetObjResult(interp, Tcl_NewBooleanObj(exists));
         result = TCL_OK;
@@ -250,8 +423,10 @@ SetResultToOldValue(Tcl_Interp *interp, Array *arrayPtr, const char *key)
      */
     hPtr = Tcl_CreateHashEntry(&arrayPtr->vars, key, NULL);
     if (likely(hPtr != NULL)) {
+        char buffer[TCL_INTEGER_SPACE];
+
         result = NS_TRUE;
-        Tcl_SetObjResult(interp, Tcl_NewStringObj(Tcl_GetHashValue(hPtr), TCL_INDEX_NONE));
+        Tcl_SetObjResult(interp, Tcl_NewStringObj(VarValue(hPtr, buffer), TCL_INDEX_NONE));
     } else {
         result = NS_FALSE;
         Tcl_SetObjResult(interp, Tcl_NewStringObj("", 0));
@@ -389,7 +564,9 @@ NsTclNsvSetObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
 
             hPtr = Tcl_FindHashEntry(&arrayPtr->vars, keyString);
             if (likely(hPtr != NULL)) {
-                Tcl_SetObjResult(interp, Tcl_NewStringObj(Tcl_GetHashValue(hPtr), TCL_INDEX_NONE));
+                char buffer[TCL_INTEGER_SPACE];
+
+                Tcl_SetObjResult(interp, Tcl_NewStringObj(VarValue(hPtr, buffer), TCL_INDEX_NONE));
             }
             UnlockArray(arrayPtr);
             if (hPtr == NULL) {
@@ -435,11 +612,24 @@ NsTclNsvIncrObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
 
     } else {
         Tcl_WideInt  current;
-        Array       *arrayPtr = LockArrayObj(interp, objv[1], NS_TRUE, NS_WRITE);
+        Counter     *counterPtr = GetCounterObj(interp, objv[1], objv[2]);
 
-        assert(arrayPtr != NULL);
-        result = IncrVar(arrayPtr, Tcl_GetString(objv[2]), count, &current);
-        UnlockArray(arrayPtr);
+        if (counterPtr != NULL) {
+            /*
+             * Lockless increment of a native counter.
+             */
+            current = CounterIncr(counterPtr, count);
+            result = TCL_OK;
+        } else {
+            Array *arrayPtr = LockArrayObj(interp, objv[1], NS_TRUE, NS_WRITE);
+
+            assert(arrayPtr != NULL);
+            result = IncrVar(arrayPtr, Tcl_GetString(objv[2]), count, &current);
+            if (likely(result == TCL_OK) && arrayPtr->counterStripes > 0) {
+                SetCounterObj(objv[2], arrayPtr);
+            }
+            UnlockArray(arrayPtr);
+        }
 
         if (likely(result == TCL_OK)) {
             Tcl_SetObjResult(interp, Tcl_NewWideIntObj(current));
@@ -490,7 +680,9 @@ NsTclNsvLappendObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
 
         hPtr = Tcl_CreateHashEntry(&arrayPtr->vars, Tcl_GetString(objv[2]), &isNew);
         if (unlikely(isNew == 0)) {
-            Tcl_DStringAppend(&ds, Tcl_GetHashValue(hPtr), TCL_INDEX_NONE);
+            char buffer[TCL_INTEGER_SPACE];
+
+            Tcl_DStringAppend(&ds, VarValue(hPtr, buffer), TCL_INDEX_NONE);
         }
 
         for (i = 3; i < objc; ++i) {
@@ -545,7 +737,9 @@ NsTclNsvAppendObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
 
         hPtr = Tcl_CreateHashEntry(&arrayPtr->vars, Tcl_GetString(objv[2]), &isNew);
         if (unlikely(isNew == 0)) {
-            Tcl_DStringAppend(&ds, Tcl_GetHashValue(hPtr), TCL_INDEX_NONE);
+            char buffer[TCL_INTEGER_SPACE];
+
+            Tcl_DStringAppend(&ds, VarValue(hPtr, buffer), TCL_INDEX_NONE);
         }
 
         for (i = 3; i < objc; ++i) {
@@ -627,6 +821,7 @@ NsTclNsvUnsetObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
                  * Delete the hash-table of this array and the entry in the
                  * table of array names.
                  */
+                RetireSnapshot(arrayPtr);
                 Tcl_DeleteHashTable(&arrayPtr->vars);
                 Tcl_DeleteHashEntry(arrayPtr->entryPtr);
             }
@@ -751,10 +946,10 @@ NsTclNsvArrayObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
 {
     int                      opt, result = TCL_OK;
     static const char *const opts[] = {
-        "set", "reset", "get", "names", "size", "exists", NULL
+        "set", "reset", "get", "names", "size", "exists", "create", NULL
     };
     enum ISubCmdIdx {
-        CSetIdx, CResetIdx, CGetIdx, CNamesIdx, CSizeIdx, CExistsIdx
+        CSetIdx, CResetIdx, CGetIdx, CNamesIdx, CSizeIdx, CExistsIdx, CCreateIdx
     };
 
     if (objc < 2) {
@@ -802,6 +997,63 @@ NsTclNsvArrayObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
             }
             break;
 
+        case CCreateIdx: {
+            int         readmostly = 0, counters = 0, stripes = 1;
+            Tcl_Obj    *arrayObj = NULL;
+            Ns_ObjvValueRange stripesRange = {1, NSV_COUNTER_MAX_STRIPES};
+            Ns_ObjvSpec createOpts[] = {
+                {"-readmostly", Ns_ObjvBool,  &readmostly, INT2PTR(NS_TRUE)},
+                {"-counters",   Ns_ObjvBool,  &counters,   INT2PTR(NS_TRUE)},
+                {"-stripes",    Ns_ObjvInt,   &stripes,    &stripesRange},
+                {"--",          Ns_ObjvBreak, NULL,        NULL},
+                {NULL, NULL, NULL, NULL}
+            };
+            Ns_ObjvSpec createArgs[] = {
+                {"array", Ns_ObjvObj, &arrayObj, NULL},
+                {NULL, NULL, NULL, NULL}
+            };
+
+            if (Ns_ParseObjv(createOpts, createArgs, interp, 2, objc, objv) != NS_OK) {
+                result = TCL_ERROR;
+
+            } else if (readmostly != 0 && counters != 0) {
+                Ns_TclPrintfResult(interp, "options -readmostly and -counters are mutually exclusive");
+                result = TCL_ERROR;
+
+            } else {
+                /*
+                 * Create the array (if necessary). When "-readmostly" is
+                 * specified, publish the first snapshot of the array, such
+                 * that readers can start to use the lockless path.
+                 */
+                arrayPtr = LockArrayObj(interp, arrayObj, NS_TRUE, NS_WRITE);
+                assert(arrayPtr != NULL);
+                if ((readmostly != 0 && arrayPtr->counterStripes > 0)
+                    || (counters != 0 && arrayPtr->snapshotPtr != NULL)) {
+                    Ns_TclPrintfResult(interp, "array \"%s\" was created with %s",
+                                       Tcl_GetString(arrayObj),
+                                       readmostly != 0 ? "-counters" : "-readmostly");
+                    result = TCL_ERROR;
+                }
+#ifdef NSV_READMOSTLY
+                if (result == TCL_OK && readmostly != 0 && arrayPtr->snapshotPtr == NULL) {
+                    PublishSnapshot(arrayPtr);
+                }
+#endif
+#ifdef NSV_COUNTERS
+                if (result == TCL_OK && counters != 0) {
+                    /*
+                     * Values incremented by "nsv_incr" become native
+                     * counters from now on.
+                     */
+                    arrayPtr->counterStripes = stripes;
+                }
+#endif
+                UnlockArray(arrayPtr);
+            }
+            break;
+        }
+
         case CSizeIdx:
             if (objc != 3) {
                 Tcl_WrongNumArgs(interp, 2, objv, "array");
@@ -858,8 +1110,10 @@ NsTclNsvArrayObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
                         if ((pattern == NULL) || (Tcl_StringMatch(keyString, pattern) != 0)) {
                             Tcl_ListObjAppendElement(interp, listObj, Tcl_NewStringObj(keyString, TCL_INDEX_NONE));
                             if (opt == (int)CGetIdx) {
+                                char buffer[TCL_INTEGER_SPACE];
+
                                 Tcl_ListObjAppendElement(interp, listObj,
-                                                         Tcl_NewStringObj(Tcl_GetHashValue(hPtr), TCL_INDEX_NONE));
+                                                         Tcl_NewStringObj(VarValue(hPtr, buffer), TCL_INDEX_NONE));
                             }
                         }
                         hPtr = Tcl_NextHashEntry(&search);
@@ -914,7 +1168,9 @@ GetArrayAndKey(Tcl_Interp *interp, Tcl_Obj *arrayObj, const char *keyString,
             Tcl_SetErrorCode(interp, "TCL", "LOOKUP", "NSV", "KEY", keyString, (char *)0L);
             result = TCL_ERROR;
         } else {
-            obj = Tcl_NewStringObj(Tcl_GetHashValue(hPtr), TCL_INDEX_NONE);
+            char buffer[TCL_INTEGER_SPACE];
+
+            obj = Tcl_NewStringObj(VarValue(hPtr, buffer), TCL_INDEX_NONE);
         }
     } else {
         result = TCL_ERROR;
@@ -1309,7 +1565,9 @@ NsTclNsvDictObjCmd(ClientData UNUSED(clientData), Tcl_Interp *interp,
                 keyString = Tcl_GetString(keyObj);
                 hPtr = Tcl_CreateHashEntry(&arrayPtr->vars, keyString, NULL);
                 if (likely(hPtr != NULL)) {
-                    dictObj = Tcl_NewStringObj(Tcl_GetHashValue(hPtr), TCL_INDEX_NONE);
+                    char buffer[TCL_INTEGER_SPACE];
+
+                    dictObj = Tcl_NewStringObj(VarValue(hPtr, buffer), TCL_INDEX_NONE);
                 } else {
                     dictObj = Tcl_NewDictObj();
                 }
@@ -1437,7 +1695,9 @@ Ns_VarGet(const char *server, const char *array, const char *keyString, Ns_DStri
         if (likely(arrayPtr != NULL)) {
             const Tcl_HashEntry *hPtr = Tcl_CreateHashEntry(&arrayPtr->vars, keyString, NULL);
             if (likely(hPtr != NULL)) {
-                Ns_DStringAppend(dsPtr, Tcl_GetHashValue(hPtr));
+                char buffer[TCL_INTEGER_SPACE];
+
+                Ns_DStringAppend(dsPtr, VarValue(hPtr, buffer));
                 status = NS_OK;
             }
             UnlockArray(arrayPtr);
@@ -1605,6 +1865,15 @@ Ns_VarAppend(const char *server, const char *array, const char *keyString,
             hPtr = Tcl_CreateHashEntry(&arrayPtr->vars, keyString, &isNew);
 
             oldString = Tcl_GetHashValue(hPtr);
+            if (unlikely(IsCounterValue(oldString))) {
+                /*
+                 * Appending to a native counter turns it into a string.
+                 */
+                char buffer[TCL_INTEGER_SPACE];
+
+                oldString = ns_strdup(VarValue(hPtr, buffer));
+                FreeVarValue(Tcl_GetHashValue(hPtr));
+            }
             oldLen = (oldString != NULL) ? strlen(oldString) : 0u;
 
             newLen = oldLen + ((len > -1) ? (size_t)len : strlen(value)) + 1u;
@@ -1734,6 +2003,9 @@ GetArray(Bucket *bucketPtr, const char *arrayName, bool create) {
         } else {
             arrayPtr = ns_malloc(sizeof(Array));
             arrayPtr->locks = 0;
+            arrayPtr->snapshotPtr = NULL;
+            arrayPtr->dirty = NS_FALSE;
+            arrayPtr->counterStripes = 0;
             arrayPtr->bucketPtr = bucketPtr;
             arrayPtr->entryPtr = hPtr;
             Tcl_InitHashTable(&arrayPtr->vars, TCL_STRING_KEYS);
@@ -1756,6 +2028,251 @@ GetArray(Bucket *bucketPtr, const char *arrayName, bool create) {
     return arrayPtr;
 }
 
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * PublishSnapshot --
+ *
+ *      Publish a new snapshot of a read-mostly array containing a copy of
+ *      all its variables. The previous snapshot is marked as superseded,
+ *      such that readers switch to the new version. The function must be
+ *      called while the array is write locked.
+ *
+ *      Since every write operation on a read-mostly array copies the full
+ *      array, read-mostly arrays should only be used for rarely modified
+ *      data.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects;
+ *      Memory allocation, the previous snapshot is freed when it is not
+ *      referenced anymore.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+PublishSnapshot(Array *arrayPtr)
+{
+    Snapshot            *snapshotPtr, *oldSnapshotPtr;
+    const Tcl_HashEntry *hPtr;
+    Tcl_HashSearch       search;
+
+    NS_NONNULL_ASSERT(arrayPtr != NULL);
+
+    snapshotPtr = ns_malloc(sizeof(Snapshot));
+    snapshotPtr->bucketPtr = arrayPtr->bucketPtr;
+    snapshotPtr->refCount = 1;
+    snapshotPtr->superseded = 0;
+    Tcl_InitHashTable(&snapshotPtr->vars, TCL_STRING_KEYS);
+
+    hPtr = Tcl_FirstHashEntry(&arrayPtr->vars, &search);
+    while (hPtr != NULL) {
+        Tcl_HashEntry *newPtr;
+        int            isNew;
+        char           buffer[TCL_INTEGER_SPACE];
+
+        newPtr = Tcl_CreateHashEntry(&snapshotPtr->vars,
+                                     Tcl_GetHashKey(&arrayPtr->vars, hPtr), &isNew);
+        Tcl_SetHashValue(newPtr, ns_strdup(VarValue(hPtr, buffer)));
+        hPtr = Tcl_NextHashEntry(&search);
+    }
+
+    oldSnapshotPtr = arrayPtr->snapshotPtr;
+    arrayPtr->snapshotPtr = snapshotPtr;
+    arrayPtr->dirty = NS_FALSE;
+
+    if (oldSnapshotPtr != NULL) {
+#ifdef NSV_READMOSTLY
+        NsvStoreRelease(&oldSnapshotPtr->superseded, 1);
+#endif
+        ReleaseSnapshot(oldSnapshotPtr);
+    }
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * RetireSnapshot --
+ *
+ *      Invalidate the current snapshot of a read-mostly array, since the
+ *      array is deleted. The function must be called while the array is
+ *      write locked.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects;
+ *      The snapshot is freed when it is not referenced anymore.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+RetireSnapshot(Array *arrayPtr)
+{
+    NS_NONNULL_ASSERT(arrayPtr != NULL);
+
+    if (arrayPtr->snapshotPtr != NULL) {
+        Snapshot *snapshotPtr = arrayPtr->snapshotPtr;
+
+        arrayPtr->snapshotPtr = NULL;
+        arrayPtr->dirty = NS_FALSE;
+#ifdef NSV_READMOSTLY
+        NsvStoreRelease(&snapshotPtr->superseded, 1);
+#endif
+        ReleaseSnapshot(snapshotPtr);
+    }
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * ReleaseSnapshot --
+ *
+ *      Drop a reference to a snapshot and free it, when this was the last
+ *      reference.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects;
+ *      Memory might be freed.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+ReleaseSnapshot(Snapshot *snapshotPtr)
+{
+    NS_NONNULL_ASSERT(snapshotPtr != NULL);
+
+#ifdef NSV_READMOSTLY
+    if (NsvRefDecr(&snapshotPtr->refCount) == 0)
+#else
+    if (--snapshotPtr->refCount == 0)
+#endif
+    {
+        Tcl_HashEntry  *hPtr;
+        Tcl_HashSearch  search;
+
+        hPtr = Tcl_FirstHashEntry(&snapshotPtr->vars, &search);
+        while (hPtr != NULL) {
+            ns_free(Tcl_GetHashValue(hPtr));
+            hPtr = Tcl_NextHashEntry(&search);
+        }
+        Tcl_DeleteHashTable(&snapshotPtr->vars);
+        ns_free(snapshotPtr);
+    }
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * GetSnapshotObj, SetSnapshotObj --
+ *
+ *      GetSnapshotObj() returns the snapshot referenced by the Tcl_Obj of
+ *      an array name, when the snapshot is still the current version of a
+ *      read-mostly array. This is the lockless path for readers.
+ *
+ *      SetSnapshotObj() lets the Tcl_Obj of the array name refer to the
+ *      current snapshot of a read-mostly array. It has to be called while
+ *      the array is locked.
+ *
+ * Results:
+ *      GetSnapshotObj() returns the snapshot or NULL.
+ *
+ * Side effects;
+ *      SetSnapshotObj() changes the internal representation of the Tcl_Obj.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Snapshot *
+GetSnapshotObj(const Tcl_Obj *arrayObj)
+{
+    Snapshot *snapshotPtr = NULL;
+
+    NS_NONNULL_ASSERT(arrayObj != NULL);
+
+#ifdef NSV_READMOSTLY
+    if (arrayObj->typePtr == &snapshotType) {
+        snapshotPtr = arrayObj->internalRep.twoPtrValue.ptr1;
+        if (NsvLoadAcquire(&snapshotPtr->superseded) != 0) {
+            snapshotPtr = NULL;
+        }
+    }
+#endif
+    return snapshotPtr;
+}
+
+static void
+SetSnapshotObj(Tcl_Obj *arrayObj, const Array *arrayPtr)
+{
+    NS_NONNULL_ASSERT(arrayObj != NULL);
+    NS_NONNULL_ASSERT(arrayPtr != NULL);
+
+#ifdef NSV_READMOSTLY
+    if (arrayPtr->snapshotPtr != NULL
+        && (arrayObj->typePtr != &snapshotType
+            || arrayObj->internalRep.twoPtrValue.ptr1 != arrayPtr->snapshotPtr)
+        ) {
+        /*
+         * Make sure, the string rep is kept, since the type has no
+         * updateStringProc.
+         */
+        (void) Tcl_GetString(arrayObj);
+        NsvRefIncr(&arrayPtr->snapshotPtr->refCount);
+        Ns_TclSetTwoPtrValue(arrayObj, &snapshotType, arrayPtr->snapshotPtr, NULL);
+    }
+#endif
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * FreeSnapshotInternalRep, DupSnapshotInternalRep --
+ *
+ *      Free and duplicate the internal representation of an nsv:snapshot
+ *      Tcl_Obj by maintaining the reference count of the snapshot.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects;
+ *      Snapshot might be freed.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+FreeSnapshotInternalRep(Tcl_Obj *objPtr)
+{
+    ReleaseSnapshot(objPtr->internalRep.twoPtrValue.ptr1);
+    objPtr->typePtr = NULL;
+}
+
+static void
+DupSnapshotInternalRep(Tcl_Obj *srcPtr, Tcl_Obj *dupPtr)
+{
+    Snapshot *snapshotPtr = srcPtr->internalRep.twoPtrValue.ptr1;
+
+#ifdef NSV_READMOSTLY
+    NsvRefIncr(&snapshotPtr->refCount);
+#else
+    snapshotPtr->refCount++;
+#endif
+    dupPtr->internalRep.twoPtrValue.ptr1 = snapshotPtr;
+    dupPtr->internalRep.twoPtrValue.ptr2 = NULL;
+    dupPtr->typePtr = &snapshotType;
+}
+
 
 /*
  *-----------------------------------------------------------------------------
@@ -1777,6 +2294,7 @@ static Array *
 LockArray(const NsServer *servPtr, const char *arrayName, bool create, NS_RW rw)
 {
     Bucket        *bucketPtr;
+    Array         *arrayPtr;
     unsigned int   idx;
 
     NS_NONNULL_ASSERT(servPtr != NULL);
@@ -1793,15 +2311,26 @@ LockArray(const NsServer *servPtr, const char *arrayName, bool create, NS_RW rw)
     } else {
         Ns_MutexLock(&bucketPtr->mlock);
     }
+    arrayPtr = GetArray(bucketPtr, arrayName, create);
+    if (arrayPtr != NULL && rw == NS_WRITE && arrayPtr->snapshotPtr != NULL) {
+        arrayPtr->dirty = NS_TRUE;
+    }
 
-    return GetArray(bucketPtr, arrayName, create);
+    return arrayPtr;
 }
 
 static void
-UnlockArray(const Array *arrayPtr)
+UnlockArray(Array *arrayPtr)
 {
     NS_NONNULL_ASSERT(arrayPtr != NULL);
 
+    if (unlikely(arrayPtr->dirty)) {
+        /*
+         * A read-mostly array was locked for writing, publish the new
+         * version before releasing the lock.
+         */
+        PublishSnapshot(arrayPtr);
+    }
     if (arrayPtr->bucketPtr->servPtr->nsv.rwlocks) {
         Ns_RWLockUnlock(&((arrayPtr)->bucketPtr->rwlock));
     } else {
@@ -1835,6 +2364,10 @@ UpdateVar(Tcl_HashEntry *hPtr, const char *value, size_t len)
     NS_NONNULL_ASSERT(value != NULL);
 
     oldString = Tcl_GetHashValue(hPtr);
+    if (unlikely(IsCounterValue(oldString))) {
+        FreeVarValue(oldString);
+        oldString = NULL;
+    }
     newString = ns_realloc(oldString, len + 1u);
     memcpy(newString, value, len + 1u);
     Tcl_SetHashValue(hPtr, newString);
@@ -1894,6 +2427,7 @@ IncrVar(Array *arrayPtr, const char *keyString, int incr, Tcl_WideInt *valuePtr)
 {
     Tcl_HashEntry *hPtr;
     int            isNew, status;
+    bool           isCounter = NS_FALSE;
     Tcl_WideInt    counter = -1;
 
     NS_NONNULL_ASSERT(arrayPtr != NULL);
@@ -1905,6 +2439,13 @@ IncrVar(Array *arrayPtr, const char *keyString, int incr, Tcl_WideInt *valuePtr)
     if (isNew != 0) {
         counter = 0;
         status = TCL_OK;
+    } else if (IsCounterValue(Tcl_GetHashValue(hPtr))) {
+        /*
+         * Native counter, no formatting needed.
+         */
+        counter = CounterIncr(CounterFromValue(Tcl_GetHashValue(hPtr)), incr);
+        isCounter = NS_TRUE;
+        status = TCL_OK;
     } else {
         const char *oldString;
 
@@ -1914,12 +2455,20 @@ IncrVar(Array *arrayPtr, const char *keyString, int incr, Tcl_WideInt *valuePtr)
             : TCL_ERROR;
     }
 
-    if (status == TCL_OK) {
-        char buf[TCL_INTEGER_SPACE+2];
-
+    if (status == TCL_OK && !isCounter) {
         counter += incr;
-        snprintf(buf, sizeof(buf), "%" TCL_LL_MODIFIER "d", counter);
-        UpdateVar(hPtr, buf, strlen(buf));
+        if (arrayPtr->counterStripes > 0) {
+            /*
+             * Store the value as a native counter.
+             */
+            FreeVarValue(Tcl_GetHashValue(hPtr));
+            Tcl_SetHashValue(hPtr, CounterToValue(NewCounter(arrayPtr, counter)));
+        } else {
+            char buf[TCL_INTEGER_SPACE+2];
+
+            snprintf(buf, sizeof(buf), "%" TCL_LL_MODIFIER "d", counter);
+            UpdateVar(hPtr, buf, strlen(buf));
+        }
     }
     *valuePtr = counter;
 
@@ -1954,7 +2503,7 @@ Unset(Array *arrayPtr, const char *keyString)
         Tcl_HashEntry *hPtr = Tcl_CreateHashEntry(&arrayPtr->vars, keyString, NULL);
 
         if (hPtr != NULL) {
-            ns_free(Tcl_GetHashValue(hPtr));
+            FreeVarValue(Tcl_GetHashValue(hPtr));
             Tcl_DeleteHashEntry(hPtr);
             status = NS_OK;
         }
@@ -1993,12 +2542,301 @@ Flush(Array *arrayPtr)
 
     hPtr = Tcl_FirstHashEntry(&arrayPtr->vars, &search);
     while (hPtr != NULL) {
-        ns_free(Tcl_GetHashValue(hPtr));
+        FreeVarValue(Tcl_GetHashValue(hPtr));
         Tcl_DeleteHashEntry(hPtr);
         hPtr = Tcl_NextHashEntry(&search);
     }
 }
 
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * VarValue --
+ *
+ *      Return the string value of a variable entry. Native counters are
+ *      formatted into the provided buffer of size TCL_INTEGER_SPACE. The
+ *      function must be called while the array is locked.
+ *
+ * Results:
+ *      String value.
+ *
+ * Side effects;
+ *      None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static const char *
+VarValue(const Tcl_HashEntry *hPtr, char *buffer)
+{
+    const char *value;
+
+    NS_NONNULL_ASSERT(hPtr != NULL);
+    NS_NONNULL_ASSERT(buffer != NULL);
+
+    value = Tcl_GetHashValue(hPtr);
+    if (IsCounterValue(value)) {
+        snprintf(buffer, TCL_INTEGER_SPACE, "%" TCL_LL_MODIFIER "d",
+                 CounterValue(CounterFromValue(value)));
+        value = buffer;
+    }
+    return value;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * FreeVarValue --
+ *
+ *      Free the value of a variable entry, which is either a string or a
+ *      native counter. Counters are marked as removed, such that Tcl_Objs
+ *      referring to them do not use them anymore.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects;
+ *      Memory might be freed.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+FreeVarValue(void *value)
+{
+    if (IsCounterValue(value)) {
+        Counter *counterPtr = CounterFromValue(value);
+
+        NsvStoreRelease(&counterPtr->removed, 1);
+        ReleaseCounter(counterPtr);
+    } else {
+        ns_free(value);
+    }
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * NewCounter, ReleaseCounter --
+ *
+ *      Create a native counter for the given array with an initial value
+ *      and drop a reference to a counter. The counter is freed when the
+ *      last reference is gone.
+ *
+ * Results:
+ *      NewCounter() returns the counter with a reference count of 1.
+ *
+ * Side effects;
+ *      Memory allocation.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Counter *
+NewCounter(const Array *arrayPtr, Tcl_WideInt value)
+{
+    Counter *counterPtr;
+    int      nstripes;
+
+    NS_NONNULL_ASSERT(arrayPtr != NULL);
+
+    nstripes = MAX(arrayPtr->counterStripes, 1);
+    counterPtr = ns_calloc(1u, sizeof(Counter) + (size_t)(nstripes - 1) * sizeof(CounterStripe));
+    counterPtr->servPtr = arrayPtr->bucketPtr->servPtr;
+    counterPtr->arrayName = ns_strdup(Tcl_GetHashKey(&arrayPtr->bucketPtr->arrays, arrayPtr->entryPtr));
+    counterPtr->refCount = 1;
+    counterPtr->nstripes = nstripes;
+    counterPtr->stripes[0].value = value;
+
+    return counterPtr;
+}
+
+static void
+ReleaseCounter(Counter *counterPtr)
+{
+    NS_NONNULL_ASSERT(counterPtr != NULL);
+
+    if (NsvRefDecr(&counterPtr->refCount) == 0) {
+        ns_free(counterPtr->arrayName);
+        ns_free(counterPtr);
+    }
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * CounterValue, CounterIncr --
+ *
+ *      Return the current value of a native counter and increment it. A
+ *      counter with multiple stripes is incremented in the stripe of the
+ *      current thread, avoiding contention on a single cache line, while
+ *      reading the value has to sum up all stripes.
+ *
+ * Results:
+ *      Counter value (after the increment).
+ *
+ * Side effects;
+ *      CounterIncr() updates the counter.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Tcl_WideInt
+CounterValue(const Counter *counterPtr)
+{
+    Tcl_WideInt value = 0;
+    int         i;
+
+    NS_NONNULL_ASSERT(counterPtr != NULL);
+
+    for (i = 0; i < counterPtr->nstripes; i++) {
+        value += NsvLoadRelaxed(&counterPtr->stripes[i].value);
+    }
+    return value;
+}
+
+static Tcl_WideInt
+CounterIncr(Counter *counterPtr, int incr)
+{
+    Tcl_WideInt value;
+
+    NS_NONNULL_ASSERT(counterPtr != NULL);
+
+    if (counterPtr->nstripes == 1) {
+        value = NsvAtomicAdd(&counterPtr->stripes[0].value, (Tcl_WideInt)incr);
+    } else {
+        static unsigned int nextStripe = 0u;
+        unsigned int        stripe;
+#ifdef NS_THREAD_LOCAL
+        static NS_THREAD_LOCAL unsigned int threadStripe = 0u;
+
+        /*
+         * Assign stripes to threads round robin, 0 means unassigned.
+         */
+        if (threadStripe == 0u) {
+            threadStripe = NsvAtomicAdd(&nextStripe, 1u);
+        }
+        stripe = threadStripe;
+#else
+        (void)nextStripe;
+        stripe = (unsigned int)(Ns_ThreadId() >> 6);
+#endif
+        (void) NsvAtomicAdd(&counterPtr->stripes[stripe % (unsigned int)counterPtr->nstripes].value,
+                            (Tcl_WideInt)incr);
+        value = CounterValue(counterPtr);
+    }
+    return value;
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * GetCounterObj, SetCounterObj --
+ *
+ *      GetCounterObj() returns the native counter referenced by the key
+ *      Tcl_Obj, when the counter belongs to the specified array of the
+ *      current server and is still part of the array. This is the
+ *      lockless path for "nsv_incr". An increment racing with the removal
+ *      of the counter is lost, as if it had happened before the removal.
+ *
+ *      SetCounterObj() lets the key Tcl_Obj refer to the native counter
+ *      of the entry. It has to be called while the array is locked.
+ *
+ * Results:
+ *      GetCounterObj() returns the counter or NULL.
+ *
+ * Side effects;
+ *      SetCounterObj() changes the internal representation of the Tcl_Obj.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Counter *
+GetCounterObj(Tcl_Interp *interp, Tcl_Obj *arrayObj, const Tcl_Obj *keyObj)
+{
+    Counter *counterPtr = NULL;
+
+    NS_NONNULL_ASSERT(interp != NULL);
+    NS_NONNULL_ASSERT(arrayObj != NULL);
+    NS_NONNULL_ASSERT(keyObj != NULL);
+
+#ifdef NSV_COUNTERS
+    if (keyObj->typePtr == &counterType) {
+        const NsInterp *itPtr = NsGetInterpData(interp);
+
+        counterPtr = keyObj->internalRep.twoPtrValue.ptr1;
+        if (NsvLoadAcquire(&counterPtr->removed) != 0
+            || itPtr == NULL
+            || counterPtr->servPtr != itPtr->servPtr
+            || strcmp(counterPtr->arrayName, Tcl_GetString(arrayObj)) != 0) {
+            counterPtr = NULL;
+        }
+    }
+#endif
+    return counterPtr;
+}
+
+static void
+SetCounterObj(Tcl_Obj *keyObj, Array *arrayPtr)
+{
+    const Tcl_HashEntry *hPtr;
+
+    NS_NONNULL_ASSERT(keyObj != NULL);
+    NS_NONNULL_ASSERT(arrayPtr != NULL);
+
+    hPtr = Tcl_FindHashEntry(&arrayPtr->vars, Tcl_GetString(keyObj));
+    if (hPtr != NULL && IsCounterValue(Tcl_GetHashValue(hPtr))) {
+        Counter *counterPtr = CounterFromValue(Tcl_GetHashValue(hPtr));
+
+        if (keyObj->typePtr != &counterType
+            || keyObj->internalRep.twoPtrValue.ptr1 != counterPtr) {
+            NsvRefIncr(&counterPtr->refCount);
+            Ns_TclSetTwoPtrValue(keyObj, &counterType, counterPtr, NULL);
+        }
+    }
+}
+
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * FreeCounterInternalRep, DupCounterInternalRep --
+ *
+ *      Free and duplicate the internal representation of an nsv:counter
+ *      Tcl_Obj by maintaining the reference count of the counter.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects;
+ *      Counter might be freed.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+FreeCounterInternalRep(Tcl_Obj *objPtr)
+{
+    ReleaseCounter(objPtr->internalRep.twoPtrValue.ptr1);
+    objPtr->typePtr = NULL;
+}
+
+static void
+DupCounterInternalRep(Tcl_Obj *srcPtr, Tcl_Obj *dupPtr)
+{
+    Counter *counterPtr = srcPtr->internalRep.twoPtrValue.ptr1;
+
+    NsvRefIncr(&counterPtr->refCount);
+    dupPtr->internalRep.twoPtrValue.ptr1 = counterPtr;
+    dupPtr->internalRep.twoPtrValue.ptr2 = NULL;
+    dupPtr->typePtr = &counterType;
+}
+
 
 /*
  *-----------------------------------------------------------------------------
@@ -2030,8 +2868,18 @@ LockArrayObj(Tcl_Interp *interp, Tcl_Obj *arrayObj, bool create, NS_RW rw)
 
     arrayName = Tcl_GetString(arrayObj);
 
-    if (likely(Ns_TclGetOpaqueFromObj(arrayObj, arrayType, (void **) &bucketPtr) == TCL_OK)
-        && bucketPtr != NULL) {
+    if (arrayObj->typePtr == &snapshotType) {
+        /*
+         * The array name refers to a (potentially outdated) snapshot of a
+         * read-mostly array, which knows the bucket as well. Keep the
+         * snapshot reference, SetSnapshotObj() will update it.
+         */
+        bucketPtr = ((Snapshot *)arrayObj->internalRep.twoPtrValue.ptr1)->bucketPtr;
+    } else if (Ns_TclGetOpaqueFromObj(arrayObj, arrayType, (void **) &bucketPtr) != TCL_OK) {
+        bucketPtr = NULL;
+    }
+
+    if (likely(bucketPtr != NULL)) {
         if (bucketPtr->servPtr->nsv.rwlocks) {
             if (rw == NS_READ) {
                 Ns_RWLockRdLock(&bucketPtr->rwlock);
@@ -2042,6 +2890,9 @@ LockArrayObj(Tcl_Interp *interp, Tcl_Obj *arrayObj, bool create, NS_RW rw)
             Ns_MutexLock(&bucketPtr->mlock);
         }
         arrayPtr = GetArray(bucketPtr, arrayName, create);
+        if (arrayPtr != NULL && rw == NS_WRITE && arrayPtr->snapshotPtr != NULL) {
+            arrayPtr->dirty = NS_TRUE;
+        }
     } else {
         const NsInterp *itPtr = NsGetInterpData(interp);
 
@@ -86,6 +86,28 @@ ReportError(Tcl_Interp *interp, const char *fmt, ...)
 #  include <openssl/ocsp.h>
 # endif
 
+# include <openssl/pem.h>
+# include <openssl/rand.h>
+# ifdef HAVE_OPENSSL_3
+#  include <openssl/core_names.h>
+# endif
+
+/*
+ * Session ticket keys are stored in the format used by other servers as
+ * well: 16 bytes key name, 32 bytes HMAC secret, and 32 bytes AES key.
+ */
+# define NS_TLS_TICKET_KEY_SIZE     80
+# define NS_TLS_TICKET_KEY_NAME     16
+# define NS_TLS_TICKET_KEY_HMAC     16
+# define NS_TLS_TICKET_KEY_AES      48
+# define NS_TLS_TICKET_KEYS_MAX     16
+
+# ifdef HAVE_OPENSSL_PRE_1_1
+#  define NS_TLS_SESSION_ID_CONST
+# else
+#  define NS_TLS_SESSION_ID_CONST const
+# endif
+
 # ifndef OPENSSL_NO_OCSP
 /*
  * Structure passed to cert status callback
@@ -105,6 +127,10 @@ static SSLCertStatusArg sslCertStatusArg;
  * OpenSSL callback functions.
  */
 static int SSL_serverNameCB(SSL *ssl, int *al, void *arg);
+#ifdef TLSEXT_TYPE_application_layer_protocol_negotiation
+static int SSL_alpnSelectCB(SSL *ssl, const unsigned char **out, unsigned char *outlen,
+                            const unsigned char *in, unsigned int inlen, void *arg);
+#endif
 static int SSLPassword(char *buf, int num, int rwflag, void *userdata);
 # ifdef HAVE_OPENSSL_PRE_1_1
 static void SSL_infoCB(const SSL *ssl, int where, int ret);
@@ -135,10 +161,38 @@ static void DrainErrorStack(Ns_LogSeverity severity, const char *errorContext, u
 
 static Ns_ReturnCode WaitFor(NS_SOCKET sock, unsigned int st, Ns_Time *timeoutPtr);
 
+static void ALPNConfig(NsSSLConfig *cfgPtr, const char *path, const char *protocols)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(3);
+
 static void CertTableInit(void);
 static void CertTableReload(void *UNUSED(arg));
 static void CertTableAdd(const NS_TLS_SSL_CTX *ctx, const char *cert)  NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
 
+static void SessionCacheInit(SSL_CTX *ctx, NsSSLConfig *cfgPtr, const char *path)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(3);
+static Ns_SchedProc SessionCacheMaintenance;
+static Ns_ReturnCode TicketKeysLoad(NsSSLConfig *cfgPtr)
+    NS_GNUC_NONNULL(1);
+static void SessionCacheFileName(Tcl_DString *dsPtr, const NsSSLConfig *cfgPtr,
+                                 const unsigned char *id, unsigned int idLength)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(3);
+static void SessionCachePurge(const NsSSLConfig *cfgPtr)
+    NS_GNUC_NONNULL(1);
+static NsSSLConfig *SessionCacheConfig(const SSL *ssl)
+    NS_GNUC_NONNULL(1);
+static bool SessionCacheDirCheck(const char *path, const char *dir)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+
+static int SSL_sessionNewCB(SSL *ssl, SSL_SESSION *session);
+static SSL_SESSION *SSL_sessionGetCB(SSL *ssl, NS_TLS_SESSION_ID_CONST unsigned char *id, int idLength, int *copy);
+# ifndef HAVE_OPENSSL_PRE_1_1
+static void SSL_sessionAlertCB(const SSL *ssl, int where, int ret);
+# endif
+# ifdef HAVE_OPENSSL_3
+static int SSL_ticketKeyCB(SSL *ssl, unsigned char *keyName, unsigned char *iv,
+                           EVP_CIPHER_CTX *ectx, EVP_MAC_CTX *hctx, int enc);
+# endif
+
 
 # ifndef OPENSSL_NO_OCSP
 static int OCSP_FromCacheFile(Tcl_DString *dsPtr, OCSP_CERTID *id, OCSP_RESPONSE **resp)
@@ -392,6 +446,106 @@ SSL_serverNameCB(SSL *ssl, int *al, void *UNUSED(arg))
     return result;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * SSL_alpnSelectCB --
+ *
+ *      OpenSSL callback for server-side application layer protocol
+ *      negotiation (ALPN, RFC 7301). Select the first protocol from the
+ *      configured "alpn" list of the driver, which is offered as well by
+ *      the client. The list contains only HTTP/1.x, since HTTP/2 is not
+ *      implemented; a client offering "h2" and "http/1.1" continues
+ *      with HTTP/1.1.
+ *
+ * Results:
+ *      SSL_TLSEXT_ERR_OK when a protocol was selected, otherwise
+ *      SSL_TLSEXT_ERR_NOACK (continue the handshake without ALPN).
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+#ifdef TLSEXT_TYPE_application_layer_protocol_negotiation
+static int
+SSL_alpnSelectCB(SSL *UNUSED(ssl), const unsigned char **out, unsigned char *outlen,
+                 const unsigned char *in, unsigned int inlen, void *arg)
+{
+    const NsSSLConfig *cfgPtr = arg;
+    unsigned char     *selected;
+    int                result = SSL_TLSEXT_ERR_NOACK;
+
+    if (SSL_select_next_proto(&selected, outlen,
+                              cfgPtr->alpn, cfgPtr->alpnLength,
+                              in, inlen) == OPENSSL_NPN_NEGOTIATED) {
+        *out = selected;
+        result = SSL_TLSEXT_ERR_OK;
+    }
+    Ns_Log(Debug, "SSL_alpnSelectCB: client offered %u bytes, result %d", inlen, result);
+
+    return result;
+}
+#endif
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ALPNConfig --
+ *
+ *      Convert the configured list of application layer protocols into
+ *      the wire format used by ALPN (sequence of length-prefixed
+ *      strings). Only protocols, which are actually implemented by the
+ *      server are accepted, since the selected protocol is binding for
+ *      the client.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Sets the "alpn" and "alpnLength" members of the NsSSLConfig.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+ALPNConfig(NsSSLConfig *cfgPtr, const char *path, const char *protocols)
+{
+    Tcl_DString  ds;
+    const char  *p = protocols;
+
+    NS_NONNULL_ASSERT(cfgPtr != NULL);
+    NS_NONNULL_ASSERT(path != NULL);
+    NS_NONNULL_ASSERT(protocols != NULL);
+
+    Tcl_DStringInit(&ds);
+    while (*p != '\0') {
+        size_t len;
+
+        p += strspn(p, " \t,");
+        len = strcspn(p, " \t,");
+        if (len == 0u) {
+            break;
+        }
+        if ((len == 8u && strncmp(p, "http/1.1", len) == 0)
+            || (len == 8u && strncmp(p, "http/1.0", len) == 0)) {
+            char lenByte = (char)len;
+
+            Tcl_DStringAppend(&ds, &lenByte, 1);
+            Tcl_DStringAppend(&ds, p, (TCL_SIZE_T)len);
+        } else {
+            Ns_Log(Warning, "%s: ignore unsupported application protocol '%.*s' in parameter 'alpn'",
+                   path, (int)len, p);
+        }
+        p += len;
+    }
+    if (ds.length > 0) {
+        cfgPtr->alpnLength = (unsigned int)ds.length;
+        cfgPtr->alpn = ns_malloc((size_t)ds.length);
+        memcpy(cfgPtr->alpn, ds.string, (size_t)ds.length);
+    }
+    Tcl_DStringFree(&ds);
+}
+
 #ifndef OPENSSL_NO_OCSP
 static int SSL_cert_statusCB(SSL *ssl, void *arg)
 {
@@ -1389,7 +1543,8 @@ DrainErrorStack(Ns_LogSeverity severity, const char *errorContext, unsigned long
  * NsSSLConfigNew --
  *
  *      Creates a new NsSSLConfig structure and sets standard
- *      configuration parameters ("deferaccept", "nodelay", and "verify").
+ *      configuration parameters ("deferaccept", "nodelay", "verify", and
+ *      "alpn").
  *
  * Results:
  *      Pointer to a new NsSSLConfig.
@@ -1408,6 +1563,20 @@ NsSSLConfigNew(const char *path)
     cfgPtr->deferaccept = Ns_ConfigBool(path, "deferaccept", NS_FALSE);
     cfgPtr->nodelay = Ns_ConfigBool(path, "nodelay", NS_TRUE);
     cfgPtr->verify = Ns_ConfigBool(path, "verify", 0);
+    cfgPtr->ktls = Ns_ConfigBool(path, "ktls", NS_FALSE);
+    cfgPtr->sessionTickets = Ns_ConfigBool(path, "sessiontickets", NS_TRUE);
+    cfgPtr->ticketKeyFile = ns_strcopy(Ns_ConfigGetValue(path, "ticketkeyfile"));
+    cfgPtr->sessionCacheDir = ns_strcopy(Ns_ConfigGetValue(path, "sessioncachedir"));
+    Ns_ConfigTimeUnitRange(path, "ticketkeyrotate", "1h", 1, 0, LONG_MAX, 0, &cfgPtr->rotateInterval);
+    ALPNConfig(cfgPtr, path, Ns_ConfigString(path, "alpn", "http/1.1"));
+    Ns_MutexSetName2(&cfgPtr->lock, "ns:tls", path);
+#ifndef HAVE_OPENSSL_KTLS
+    if (cfgPtr->ktls) {
+        Ns_Log(Warning, "%s: kernel TLS (ktls) is not supported by this OpenSSL version, ignored",
+               path);
+        cfgPtr->ktls = 0;
+    }
+#endif
     return cfgPtr;
 }
 
@@ -1496,11 +1665,8 @@ Ns_TLS_CtxServerInit(const char *path, Tcl_Interp *interp,
                        (void*) app_data, (void*)*ctxPtr, cert);
                 SSL_CTX_set_app_data(*ctxPtr, app_data);
             }
-#if !defined(OPENSSL_HAVE_DH_AUTO) || !defined(HAVE_OPENSSL_3)
             cfgPtr = (NsSSLConfig *)app_data;
-#endif
-            SSL_CTX_set_session_id_context(*ctxPtr, (const unsigned char *)&nsconf.pid, sizeof(pid_t));
-            SSL_CTX_set_session_cache_mode(*ctxPtr, SSL_SESS_CACHE_SERVER);
+            SessionCacheInit(*ctxPtr, cfgPtr, path);
 
 #ifdef HAVE_OPENSSL_PRE_1_1
             SSL_CTX_set_info_callback(*ctxPtr, SSL_infoCB);
@@ -1549,10 +1715,28 @@ Ns_TLS_CtxServerInit(const char *path, Tcl_Interp *interp,
             SSL_CTX_set_options(*ctxPtr, SSL_OP_TLS_D5_BUG);
             SSL_CTX_set_options(*ctxPtr, SSL_OP_TLS_BLOCK_PADDING_BUG);
 
+#ifdef HAVE_OPENSSL_KTLS
+            if (cfgPtr->ktls) {
+                /*
+                 * Let OpenSSL hand the symmetric crypto to the kernel
+                 * (when the "tls" kernel module supports the negotiated
+                 * cipher). This allows SSL_sendfile() to send file
+                 * content without copying it through user space.
+                 */
+                SSL_CTX_set_options(*ctxPtr, SSL_OP_ENABLE_KTLS);
+                Ns_Log(Notice, "%s: kernel TLS offload requested", path);
+            }
+#endif
+
             if ((flags & NS_DRIVER_SNI) != 0) {
                 SSL_CTX_set_tlsext_servername_callback(*ctxPtr, SSL_serverNameCB);
                 /* SSL_CTX_set_tlsext_servername_arg(cfgPtr->ctx, app_data); // not really needed */
             }
+#ifdef TLSEXT_TYPE_application_layer_protocol_negotiation
+            if (cfgPtr->alpnLength > 0u) {
+                SSL_CTX_set_alpn_select_cb(*ctxPtr, SSL_alpnSelectCB, cfgPtr);
+            }
+#endif
 #ifdef OPENSSL_HAVE_DH_AUTO
             SSL_CTX_set_dh_auto(*ctxPtr, 1);
 #else
@@ -1692,6 +1876,602 @@ static void CertTableReload(void *UNUSED(arg))
     Ns_MasterUnlock();
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * SessionCacheInit --
+ *
+ *      Configure session resumption for a server context. Per default,
+ *      OpenSSL's in-process session cache is used with the process id
+ *      as session id context. When "ticketkeyfile" or
+ *      "sessioncachedir" are configured, the session id context is
+ *      derived from the configuration file (or "sessionidcontext"),
+ *      such that sessions can be resumed across restarts and across
+ *      nsd processes sharing the keys or the cache directory.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Registers OpenSSL callbacks and potentially a scheduled
+ *      procedure for key rotation and cache cleanup.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+SessionCacheInit(SSL_CTX *ctx, NsSSLConfig *cfgPtr, const char *path)
+{
+    const char *sidContext;
+    bool        maintenance = NS_FALSE;
+
+    NS_NONNULL_ASSERT(ctx != NULL);
+    NS_NONNULL_ASSERT(cfgPtr != NULL);
+    NS_NONNULL_ASSERT(path != NULL);
+
+    sidContext = Ns_ConfigGetValue(path, "sessionidcontext");
+    if (sidContext == NULL
+        && (cfgPtr->ticketKeyFile != NULL || cfgPtr->sessionCacheDir != NULL)) {
+        sidContext = nsconf.configFile;
+    }
+    if (sidContext != NULL) {
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int  digestLength = 0u;
+
+        (void) EVP_Digest(sidContext, strlen(sidContext), digest, &digestLength, EVP_sha256(), NULL);
+        SSL_CTX_set_session_id_context(ctx, digest, MIN(digestLength, SSL_MAX_SID_CTX_LENGTH));
+    } else {
+        SSL_CTX_set_session_id_context(ctx, (const unsigned char *)&nsconf.pid, sizeof(pid_t));
+    }
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+
+    if (!cfgPtr->sessionTickets) {
+        SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+    }
+
+    if (cfgPtr->ticketKeyFile != NULL) {
+# ifdef HAVE_OPENSSL_3
+        if (TicketKeysLoad(cfgPtr) == NS_OK) {
+            SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, SSL_ticketKeyCB);
+            maintenance = NS_TRUE;
+        }
+# else
+        Ns_Log(Warning, "%s: ticketkeyfile requires OpenSSL 3.0 or newer, ignored", path);
+# endif
+    }
+
+    if (cfgPtr->sessionCacheDir != NULL
+        && SessionCacheDirCheck(path, cfgPtr->sessionCacheDir)) {
+        /*
+         * The session cache directory is the only server-side store of
+         * the sessions. Without the internal store, OpenSSL never evicts
+         * sessions locally, which would otherwise delete sessions still
+         * used by other processes. Sessions are removed from the
+         * directory when they are invalidated by a fatal alert and by
+         * the periodic purge of expired sessions.
+         */
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(ctx, SSL_sessionNewCB);
+        SSL_CTX_sess_set_get_cb(ctx, SSL_sessionGetCB);
+# ifndef HAVE_OPENSSL_PRE_1_1
+        SSL_CTX_set_info_callback(ctx, SSL_sessionAlertCB);
+# endif
+        Ns_Log(Notice, "%s: using session cache directory '%s'", path, cfgPtr->sessionCacheDir);
+        maintenance = NS_TRUE;
+    }
+
+    if (maintenance) {
+        (void) Ns_ScheduleProcEx(SessionCacheMaintenance, cfgPtr, NS_SCHED_THREAD,
+                                 &cfgPtr->rotateInterval, NULL);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SessionCacheDirCheck --
+ *
+ *      Create the session cache directory with mode 0700, or check
+ *      that an existing directory is owned by the current user and not
+ *      accessible by group or others, since the session files contain
+ *      the master secrets of the TLS sessions.
+ *
+ * Results:
+ *      Boolean value indicating whether the directory can be used.
+ *
+ * Side effects:
+ *      Potentially creates a directory.
+ *
+ *----------------------------------------------------------------------
+ */
+static bool
+SessionCacheDirCheck(const char *path, const char *dir)
+{
+    bool success = NS_TRUE;
+
+    NS_NONNULL_ASSERT(path != NULL);
+    NS_NONNULL_ASSERT(dir != NULL);
+
+#ifdef _WIN32
+    {
+        Tcl_Obj *dirObj = Tcl_NewStringObj(dir, TCL_INDEX_NONE);
+
+        Tcl_IncrRefCount(dirObj);
+        if (Tcl_FSCreateDirectory(dirObj) != TCL_OK && Tcl_GetErrno() != EEXIST) {
+            Ns_Log(Error, "%s: cannot create session cache directory '%s': %s",
+                   path, dir, strerror(Tcl_GetErrno()));
+            success = NS_FALSE;
+        }
+        Tcl_DecrRefCount(dirObj);
+    }
+#else
+    if (mkdir(dir, 0700) != 0) {
+        struct stat st;
+
+        if (errno != EEXIST) {
+            Ns_Log(Error, "%s: cannot create session cache directory '%s': %s",
+                   path, dir, strerror(errno));
+            success = NS_FALSE;
+
+        } else if (lstat(dir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+            Ns_Log(Error, "%s: session cache directory '%s' is not a directory",
+                   path, dir);
+            success = NS_FALSE;
+
+        } else if (st.st_uid != geteuid() || (st.st_mode & 077) != 0) {
+            Ns_Log(Error, "%s: session cache directory '%s' must be owned by the"
+                   " server user and must not be accessible by group or others"
+                   " (mode 0700)", path, dir);
+            success = NS_FALSE;
+        }
+    }
+#endif
+    return success;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SessionCacheMaintenance --
+ *
+ *      Scheduled procedure for rotating the session ticket keys and for
+ *      purging expired entries from the session cache directory. Key
+ *      rotation is performed by replacing the content of the key file:
+ *      the first key is used for issuing new tickets, all keys are
+ *      accepted for resumption.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Potentially updates the ticket keys, deletes files.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+SessionCacheMaintenance(void *arg, int UNUSED(id))
+{
+    NsSSLConfig *cfgPtr = arg;
+
+    if (cfgPtr->ticketKeyFile != NULL) {
+        (void) TicketKeysLoad(cfgPtr);
+    }
+    if (cfgPtr->sessionCacheDir != NULL) {
+        SessionCachePurge(cfgPtr);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TicketKeysLoad --
+ *
+ *      Load the session ticket keys from the configured file. The file
+ *      has to contain one or more keys of 80 bytes each (e.g., created
+ *      via "openssl rand 80 > ticket.key").
+ *
+ * Results:
+ *      NS_OK or NS_ERROR.
+ *
+ * Side effects:
+ *      Replaces the ticket keys in the configuration, when the file
+ *      content has changed.
+ *
+ *----------------------------------------------------------------------
+ */
+static Ns_ReturnCode
+TicketKeysLoad(NsSSLConfig *cfgPtr)
+{
+    unsigned char buffer[NS_TLS_TICKET_KEY_SIZE * NS_TLS_TICKET_KEYS_MAX + 1];
+    Ns_ReturnCode status = NS_OK;
+    BIO          *bio;
+    int           length;
+
+    NS_NONNULL_ASSERT(cfgPtr != NULL);
+
+    bio = BIO_new_file(cfgPtr->ticketKeyFile, "rb");
+    if (bio == NULL) {
+        Ns_Log(Error, "cannot open session ticket key file '%s'", cfgPtr->ticketKeyFile);
+        return NS_ERROR;
+    }
+    length = BIO_read(bio, buffer, (int)sizeof(buffer));
+    BIO_free(bio);
+
+    if (length <= 0
+        || (length % NS_TLS_TICKET_KEY_SIZE) != 0
+        || length > NS_TLS_TICKET_KEY_SIZE * NS_TLS_TICKET_KEYS_MAX) {
+        Ns_Log(Error, "session ticket key file '%s' must contain 1 to %d keys"
+               " of %d bytes each (got %d bytes)",
+               cfgPtr->ticketKeyFile, NS_TLS_TICKET_KEYS_MAX, NS_TLS_TICKET_KEY_SIZE, length);
+        status = NS_ERROR;
+
+    } else {
+        int  nKeys = length / NS_TLS_TICKET_KEY_SIZE;
+        bool changed = NS_FALSE;
+
+        Ns_MutexLock(&cfgPtr->lock);
+        if (nKeys != cfgPtr->nTicketKeys
+            || memcmp(buffer, cfgPtr->ticketKeys, (size_t)length) != 0) {
+            if (cfgPtr->ticketKeys != NULL) {
+                OPENSSL_cleanse(cfgPtr->ticketKeys,
+                                (size_t)cfgPtr->nTicketKeys * NS_TLS_TICKET_KEY_SIZE);
+                ns_free(cfgPtr->ticketKeys);
+            }
+            cfgPtr->ticketKeys = ns_malloc((size_t)length);
+            memcpy(cfgPtr->ticketKeys, buffer, (size_t)length);
+            cfgPtr->nTicketKeys = nKeys;
+            changed = NS_TRUE;
+        }
+        Ns_MutexUnlock(&cfgPtr->lock);
+
+        if (changed) {
+            Ns_Log(Notice, "loaded %d session ticket key(s) from '%s'",
+                   nKeys, cfgPtr->ticketKeyFile);
+        }
+    }
+    OPENSSL_cleanse(buffer, sizeof(buffer));
+
+    return status;
+}
+
+# ifdef HAVE_OPENSSL_3
+/*
+ *----------------------------------------------------------------------
+ *
+ * SSL_ticketKeyCB --
+ *
+ *      OpenSSL callback for encrypting and decrypting session tickets
+ *      with the configured ticket keys (AES-256-CBC, HMAC-SHA256).
+ *
+ * Results:
+ *      For encryption: 1 on success. For decryption: 0 when the key
+ *      is unknown, 1 when the ticket was encrypted with the current
+ *      key, 2 when it was encrypted with an older key (the ticket is
+ *      renewed). -1 on errors.
+ *
+ * Side effects:
+ *      Initializes the cipher and MAC contexts.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+SSL_ticketKeyCB(SSL *ssl, unsigned char *keyName, unsigned char *iv,
+                EVP_CIPHER_CTX *ectx, EVP_MAC_CTX *hctx, int enc)
+{
+    NsSSLConfig  *cfgPtr = SessionCacheConfig(ssl);
+    unsigned char key[NS_TLS_TICKET_KEY_SIZE];
+    OSSL_PARAM    params[3];
+    int           result = 0;
+
+    if (cfgPtr == NULL) {
+        return 0;
+    }
+
+    Ns_MutexLock(&cfgPtr->lock);
+    if (enc == 1) {
+        if (cfgPtr->nTicketKeys > 0) {
+            memcpy(key, cfgPtr->ticketKeys, NS_TLS_TICKET_KEY_SIZE);
+            result = 1;
+        }
+    } else {
+        int i;
+
+        for (i = 0; i < cfgPtr->nTicketKeys; i++) {
+            const unsigned char *keyPtr = cfgPtr->ticketKeys + i * NS_TLS_TICKET_KEY_SIZE;
+
+            if (memcmp(keyName, keyPtr, NS_TLS_TICKET_KEY_NAME) == 0) {
+                memcpy(key, keyPtr, NS_TLS_TICKET_KEY_SIZE);
+                result = (i == 0) ? 1 : 2;
+                break;
+            }
+        }
+    }
+    Ns_MutexUnlock(&cfgPtr->lock);
+
+    if (result != 0) {
+        if (enc == 1) {
+            memcpy(keyName, key, NS_TLS_TICKET_KEY_NAME);
+            if (RAND_bytes(iv, EVP_MAX_IV_LENGTH) <= 0
+                || EVP_EncryptInit_ex(ectx, EVP_aes_256_cbc(), NULL,
+                                      key + NS_TLS_TICKET_KEY_AES, iv) != 1) {
+                result = -1;
+            }
+        } else if (EVP_DecryptInit_ex(ectx, EVP_aes_256_cbc(), NULL,
+                                      key + NS_TLS_TICKET_KEY_AES, iv) != 1) {
+            result = -1;
+        }
+        if (result > 0) {
+            params[0] = OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY,
+                                                          key + NS_TLS_TICKET_KEY_HMAC, 32);
+            params[1] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+                                                         (char *)"sha256", 0);
+            params[2] = OSSL_PARAM_construct_end();
+            if (EVP_MAC_CTX_set_params(hctx, params) != 1) {
+                result = -1;
+            }
+        }
+        OPENSSL_cleanse(key, sizeof(key));
+    }
+
+    return result;
+}
+# endif
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SessionCacheConfig --
+ *
+ *      Return the configuration relevant for session resumption of a
+ *      server-side TLS connection. OpenSSL performs session handling
+ *      via the initial context of the connection, even when the
+ *      context was switched via SNI. Therefore, the configuration of
+ *      the driver is used when available, otherwise the one of the
+ *      current context.
+ *
+ * Results:
+ *      NsSSLConfig or NULL.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+static NsSSLConfig *
+SessionCacheConfig(const SSL *ssl)
+{
+    const Sock  *sockPtr = SSL_get_app_data(ssl);
+    NsSSLConfig *cfgPtr;
+
+    if (sockPtr != NULL
+        && sockPtr->drvPtr != NULL
+        && (sockPtr->drvPtr->opts & NS_DRIVER_SSL_CONFIG) != 0u
+        && sockPtr->drvPtr->arg != NULL) {
+        cfgPtr = sockPtr->drvPtr->arg;
+    } else {
+        cfgPtr = SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+    }
+    return cfgPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SessionCacheFileName --
+ *
+ *      Compute the filename of a session in the session cache
+ *      directory based on the session id.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Filename is appended to dsPtr.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+SessionCacheFileName(Tcl_DString *dsPtr, const NsSSLConfig *cfgPtr,
+                     const unsigned char *id, unsigned int idLength)
+{
+    char hexString[SSL_MAX_SSL_SESSION_ID_LENGTH * 2 + 1];
+
+    NS_NONNULL_ASSERT(dsPtr != NULL);
+    NS_NONNULL_ASSERT(cfgPtr != NULL);
+    NS_NONNULL_ASSERT(id != NULL);
+
+    if (idLength > SSL_MAX_SSL_SESSION_ID_LENGTH) {
+        idLength = SSL_MAX_SSL_SESSION_ID_LENGTH;
+    }
+    Ns_HexString(id, hexString, (TCL_SIZE_T)idLength, NS_FALSE);
+    Ns_DStringPrintf(dsPtr, "%s/%s.pem", cfgPtr->sessionCacheDir, hexString);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SSL_sessionNewCB, SSL_sessionGetCB, SSL_sessionAlertCB --
+ *
+ *      OpenSSL callbacks for the external session cache. Every session
+ *      is stored in a separate file (readable only by the server user)
+ *      in the session cache directory, which might be shared between
+ *      nsd processes (e.g., when placed on a memory based file system
+ *      like /dev/shm). When a fatal alert is sent or received on a
+ *      connection, OpenSSL invalidates its session, so the session is
+ *      removed from the directory as well.
+ *
+ * Results:
+ *      See the OpenSSL documentation of SSL_CTX_sess_set_new_cb().
+ *
+ * Side effects:
+ *      Creates, reads, or deletes files.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+SSL_sessionNewCB(SSL *ssl, SSL_SESSION *session)
+{
+    const NsSSLConfig *cfgPtr = SessionCacheConfig(ssl);
+
+    if (cfgPtr != NULL && cfgPtr->sessionCacheDir != NULL) {
+        const unsigned char *id;
+        unsigned int         idLength;
+        Tcl_DString          fileDs, tmpDs;
+        BIO                 *bio;
+        int                  fd;
+
+        id = SSL_SESSION_get_id(session, &idLength);
+        Tcl_DStringInit(&fileDs);
+        Tcl_DStringInit(&tmpDs);
+        SessionCacheFileName(&fileDs, cfgPtr, id, idLength);
+
+        /*
+         * Write to a temporary file and rename it afterwards to avoid
+         * partially written entries to be seen by other processes.
+         */
+        Ns_DStringPrintf(&tmpDs, "%s.%d.%" PRIxPTR, fileDs.string,
+                         (int)nsconf.pid, Ns_ThreadId());
+        fd = ns_open(tmpDs.string, O_CREAT | O_EXCL | O_WRONLY | O_BINARY | O_CLOEXEC, 0600);
+        bio = (fd == NS_INVALID_FD) ? NULL : BIO_new_fd(fd, BIO_CLOSE);
+        if (bio == NULL) {
+            Ns_Log(Warning, "session cache: cannot write file '%s': %s",
+                   tmpDs.string, strerror(errno));
+            if (fd != NS_INVALID_FD) {
+                (void) ns_close(fd);
+                (void) unlink(tmpDs.string);
+            }
+        } else {
+            int success = PEM_write_bio_SSL_SESSION(bio, session);
+
+            BIO_free(bio);
+            if (success != 1 || rename(tmpDs.string, fileDs.string) != 0) {
+                Ns_Log(Warning, "session cache: cannot store session in '%s'", fileDs.string);
+                (void) unlink(tmpDs.string);
+            }
+        }
+        Tcl_DStringFree(&tmpDs);
+        Tcl_DStringFree(&fileDs);
+    }
+
+    /*
+     * We do not keep a reference to the session.
+     */
+    return 0;
+}
+
+static SSL_SESSION *
+SSL_sessionGetCB(SSL *ssl, NS_TLS_SESSION_ID_CONST unsigned char *id, int idLength, int *copy)
+{
+    const NsSSLConfig *cfgPtr = SessionCacheConfig(ssl);
+    SSL_SESSION       *session = NULL;
+
+    *copy = 0;
+    if (cfgPtr != NULL && cfgPtr->sessionCacheDir != NULL && idLength > 0) {
+        Tcl_DString  ds;
+        BIO         *bio;
+
+        Tcl_DStringInit(&ds);
+        SessionCacheFileName(&ds, cfgPtr, id, (unsigned int)idLength);
+        bio = BIO_new_file(ds.string, "rb");
+        if (bio != NULL) {
+            session = PEM_read_bio_SSL_SESSION(bio, NULL, NULL, NULL);
+            BIO_free(bio);
+            Ns_Log(Debug, "session cache: lookup '%s' -> %p", ds.string, (void *)session);
+        }
+        ERR_clear_error();
+        Tcl_DStringFree(&ds);
+    }
+
+    return session;
+}
+
+# ifndef HAVE_OPENSSL_PRE_1_1
+static void
+SSL_sessionAlertCB(const SSL *ssl, int where, int ret)
+{
+    if ((where & SSL_CB_ALERT) != 0 && (ret >> 8) == SSL3_AL_FATAL) {
+        const NsSSLConfig *cfgPtr = SessionCacheConfig(ssl);
+        const SSL_SESSION *session = SSL_get_session(ssl);
+
+        if (cfgPtr != NULL && cfgPtr->sessionCacheDir != NULL && session != NULL) {
+            const unsigned char *id;
+            unsigned int         idLength;
+
+            id = SSL_SESSION_get_id(session, &idLength);
+            if (idLength > 0u) {
+                Tcl_DString ds;
+
+                Tcl_DStringInit(&ds);
+                SessionCacheFileName(&ds, cfgPtr, id, idLength);
+                if (unlink(ds.string) == 0) {
+                    Ns_Log(Debug, "session cache: invalidated '%s'", ds.string);
+                }
+                Tcl_DStringFree(&ds);
+            }
+        }
+    }
+}
+# endif
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SessionCachePurge --
+ *
+ *      Delete the entries from the session cache directory, which are
+ *      older than the session timeout.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Deletes files.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+SessionCachePurge(const NsSSLConfig *cfgPtr)
+{
+    Tcl_Obj         *dirObj, *matchedObj;
+    Tcl_GlobTypeData types;
+    time_t           expire;
+
+    NS_NONNULL_ASSERT(cfgPtr != NULL);
+
+    expire = time(NULL) - (time_t)SSL_CTX_get_timeout(cfgPtr->ctx);
+
+    dirObj = Tcl_NewStringObj(cfgPtr->sessionCacheDir, TCL_INDEX_NONE);
+    Tcl_IncrRefCount(dirObj);
+    matchedObj = Tcl_NewObj();
+    Tcl_IncrRefCount(matchedObj);
+
+    memset(&types, 0, sizeof(Tcl_GlobTypeData));
+    types.type = TCL_GLOB_TYPE_FILE;
+
+    if (Tcl_FSMatchInDirectory(NULL, matchedObj, dirObj, "*.pem", &types) == TCL_OK) {
+        TCL_SIZE_T  nElems, i;
+        Tcl_Obj   **elems;
+        int         nDeleted = 0;
+
+        (void) Tcl_ListObjGetElements(NULL, matchedObj, &nElems, &elems);
+        for (i = 0; i < nElems; i++) {
+            Tcl_StatBuf st;
+
+            if (Tcl_FSStat(elems[i], &st) == 0
+                && st.st_mtime < expire
+                && Tcl_FSDeleteFile(elems[i]) == 0) {
+                nDeleted++;
+            }
+        }
+        if (nDeleted > 0) {
+            Ns_Log(Notice, "session cache: purged %d expired session(s) from '%s'",
+                   nDeleted, cfgPtr->sessionCacheDir);
+        }
+    }
+
+    Tcl_DecrRefCount(matchedObj);
+    Tcl_DecrRefCount(dirObj);
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -2176,6 +2956,91 @@ Ns_SSLSendBufs2(SSL *ssl, const struct iovec *bufs, int nbufs)
     return sent;
 }
 
+#ifdef HAVE_OPENSSL_KTLS
+/*
+ *----------------------------------------------------------------------
+ *
+ * Ns_SSLSendFile --
+ *
+ *      Send a range of a file on a nonblocking TLS socket via
+ *      SSL_sendfile(). This requires that kernel TLS is active for the
+ *      send direction of the socket (see BIO_get_ktls_send()), since
+ *      the encryption is performed by the kernel.
+ *
+ * Results:
+ *      Number of bytes sent (which might be also 0 on NS_EAGAIN cases)
+ *      or -1 on error.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+ssize_t
+Ns_SSLSendFile(SSL *ssl, int fd, off_t offset, size_t length)
+{
+    ossl_ssize_t sent;
+
+    NS_NONNULL_ASSERT(ssl != NULL);
+
+    ERR_clear_error();
+    sent = SSL_sendfile(ssl, fd, offset, length, 0);
+    if (sent < 0) {
+        int err = SSL_get_error(ssl, (int)sent);
+
+        if (err == SSL_ERROR_WANT_WRITE) {
+            sent = 0;
+        } else {
+            Ns_Log(Debug, "SSL_sendfile: fd %d offset %ld length %" PRIuz " error:%d %s",
+                   fd, (long)offset, length, err, ns_sockstrerror(ns_sockerrno));
+            sent = -1;
+        }
+    }
+
+    return (ssize_t)sent;
+}
+#endif
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsSSLDriverStats --
+ *
+ *      Append the kernel TLS counters of a TLS driver configuration to
+ *      the provided list (used by "ns_driver stats").
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Appends key/value pairs to listObj.
+ *
+ *----------------------------------------------------------------------
+ */
+void
+NsSSLDriverStats(void *arg, Tcl_Obj *listObj)
+{
+    NsSSLConfig *cfgPtr = arg;
+    Tcl_WideInt  ktlsBytes, fallbackBytes;
+
+    NS_NONNULL_ASSERT(arg != NULL);
+    NS_NONNULL_ASSERT(listObj != NULL);
+
+    Ns_MutexLock(&cfgPtr->lock);
+    ktlsBytes = cfgPtr->ktlsBytes;
+    fallbackBytes = cfgPtr->ktlsFallbackBytes;
+    Ns_MutexUnlock(&cfgPtr->lock);
+
+    Tcl_ListObjAppendElement(NULL, listObj, Tcl_NewStringObj("ktls", 4));
+    Tcl_ListObjAppendElement(NULL, listObj, Tcl_NewBooleanObj(cfgPtr->ktls));
+
+    Tcl_ListObjAppendElement(NULL, listObj, Tcl_NewStringObj("ktlsbytes", 9));
+    Tcl_ListObjAppendElement(NULL, listObj, Tcl_NewWideIntObj(ktlsBytes));
+
+    Tcl_ListObjAppendElement(NULL, listObj, Tcl_NewStringObj("ktlsfallbackbytes", 17));
+    Tcl_ListObjAppendElement(NULL, listObj, Tcl_NewWideIntObj(fallbackBytes));
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -2422,6 +3287,12 @@ Ns_TLS_CtxServerInit(const char *UNUSED(path), Tcl_Interp *UNUSED(interp),
     return TCL_OK;
 }
 
+void
+NsSSLDriverStats(void *UNUSED(arg), Tcl_Obj *UNUSED(listObj))
+{
+    /* dummy stub */
+}
+
 #endif
 
 /*
@@ -0,0 +1,459 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+/*
+ * uring.c --
+ *
+ *      Minimal io_uring interface for batching socket send operations of
+ *      the writer threads. The ring is used by a single thread, therefore
+ *      no locking is required. The implementation uses the raw system
+ *      calls and does not depend on liburing.
+ *
+ *      When io_uring is not available at compile time or the kernel
+ *      refuses to set up a ring, NsUringCreate() returns NULL and the
+ *      caller falls back to the classical send operations.
+ */
+
+#include "nsd.h"
+
+#ifdef HAVE_LINUX_IO_URING_H
+# include <linux/io_uring.h>
+# include <sys/mman.h>
+# include <sys/syscall.h>
+#endif
+
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+# define NS_HAVE_IO_URING 1
+#endif
+
+#ifdef NS_HAVE_IO_URING
+
+struct NsUring {
+    int                  fd;
+    unsigned int         pending;    /* Number of prepared, unsubmitted SQEs */
+    unsigned int         inflight;   /* Number of submitted, uncompleted SQEs */
+
+    /*
+     * Submission queue.
+     */
+    void                *sqRing;
+    size_t               sqRingSize;
+    unsigned int        *sqHead;
+    unsigned int        *sqTail;
+    unsigned int        *sqMask;
+    unsigned int        *sqArray;
+    struct io_uring_sqe *sqes;
+    size_t               sqesSize;
+    unsigned int         sqEntries;
+
+    /*
+     * Completion queue.
+     */
+    void                *cqRing;
+    size_t               cqRingSize;
+    unsigned int        *cqHead;
+    unsigned int        *cqTail;
+    unsigned int        *cqMask;
+    struct io_uring_cqe *cqes;
+};
+
+/*
+ * Local functions defined in this file.
+ */
+
+static int UringEnter(const NsUring *ringPtr, unsigned int toSubmit, unsigned int minComplete)
+    NS_GNUC_NONNULL(1);
+static int UringReap(NsUring *ringPtr, NsUringResult *resultsPtr, int maxResults)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+
+/*
+ * Number of retries of a submission refused temporarily by the kernel.
+ */
+#define NS_URING_SUBMIT_RETRIES 5
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsUringCreate --
+ *
+ *      Set up an io_uring instance with the given number of submission
+ *      queue entries.
+ *
+ * Results:
+ *      Ring handle or NULL, when io_uring is not usable.
+ *
+ * Side effects:
+ *      Memory mapping of the ring buffers.
+ *
+ *----------------------------------------------------------------------
+ */
+
+NsUring *
+NsUringCreate(unsigned int entries)
+{
+    struct io_uring_params params;
+    NsUring               *ringPtr;
+    int                    fd;
+
+    memset(&params, 0, sizeof(params));
+    fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0) {
+        Ns_Log(Notice, "io_uring setup failed: %s", strerror(errno));
+        return NULL;
+    }
+
+    ringPtr = ns_calloc(1u, sizeof(NsUring));
+    ringPtr->fd = fd;
+    ringPtr->sqEntries = params.sq_entries;
+
+    ringPtr->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    ringPtr->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0u) {
+        ringPtr->sqRingSize = MAX(ringPtr->sqRingSize, ringPtr->cqRingSize);
+        ringPtr->cqRingSize = ringPtr->sqRingSize;
+    }
+
+    ringPtr->sqRing = mmap(NULL, ringPtr->sqRingSize, PROT_READ|PROT_WRITE,
+                           MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ringPtr->sqRing == MAP_FAILED) {
+        goto fail;
+    }
+    if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0u) {
+        ringPtr->cqRing = ringPtr->sqRing;
+    } else {
+        ringPtr->cqRing = mmap(NULL, ringPtr->cqRingSize, PROT_READ|PROT_WRITE,
+                               MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (ringPtr->cqRing == MAP_FAILED) {
+            ringPtr->cqRing = NULL;
+            goto fail;
+        }
+    }
+    ringPtr->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    ringPtr->sqes = mmap(NULL, ringPtr->sqesSize, PROT_READ|PROT_WRITE,
+                         MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ringPtr->sqes == MAP_FAILED) {
+        ringPtr->sqes = NULL;
+        goto fail;
+    }
+
+    ringPtr->sqHead  = (unsigned int *)((char *)ringPtr->sqRing + params.sq_off.head);
+    ringPtr->sqTail  = (unsigned int *)((char *)ringPtr->sqRing + params.sq_off.tail);
+    ringPtr->sqMask  = (unsigned int *)((char *)ringPtr->sqRing + params.sq_off.ring_mask);
+    ringPtr->sqArray = (unsigned int *)((char *)ringPtr->sqRing + params.sq_off.array);
+    ringPtr->cqHead  = (unsigned int *)((char *)ringPtr->cqRing + params.cq_off.head);
+    ringPtr->cqTail  = (unsigned int *)((char *)ringPtr->cqRing + params.cq_off.tail);
+    ringPtr->cqMask  = (unsigned int *)((char *)ringPtr->cqRing + params.cq_off.ring_mask);
+    ringPtr->cqes    = (struct io_uring_cqe *)((char *)ringPtr->cqRing + params.cq_off.cqes);
+
+    return ringPtr;
+
+ fail:
+    Ns_Log(Notice, "io_uring mmap failed: %s", strerror(errno));
+    if (ringPtr->sqRing == MAP_FAILED) {
+        ringPtr->sqRing = NULL;
+    }
+    NsUringFree(ringPtr);
+    return NULL;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsUringFree --
+ *
+ *      Release the ring.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Unmaps the ring buffers and closes the ring fd.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+NsUringFree(NsUring *ringPtr)
+{
+    NS_NONNULL_ASSERT(ringPtr != NULL);
+
+    if (ringPtr->sqes != NULL) {
+        (void) munmap(ringPtr->sqes, ringPtr->sqesSize);
+    }
+    if (ringPtr->cqRing != NULL && ringPtr->cqRing != ringPtr->sqRing) {
+        (void) munmap(ringPtr->cqRing, ringPtr->cqRingSize);
+    }
+    if (ringPtr->sqRing != NULL) {
+        (void) munmap(ringPtr->sqRing, ringPtr->sqRingSize);
+    }
+    (void) close(ringPtr->fd);
+    ns_free(ringPtr);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsUringPrepSendmsg --
+ *
+ *      Add a sendmsg() operation to the submission queue. The message
+ *      header and the referenced buffers must stay valid until the
+ *      completion was collected via NsUringSubmit().
+ *
+ * Results:
+ *      NS_TRUE when the operation was queued, NS_FALSE when the
+ *      submission queue is full.
+ *
+ * Side effects:
+ *      None until submitted.
+ *
+ *----------------------------------------------------------------------
+ */
+
+bool
+NsUringPrepSendmsg(NsUring *ringPtr, NS_SOCKET sock, const struct msghdr *msgPtr, void *userData)
+{
+    struct io_uring_sqe *sqePtr;
+    unsigned int         tail, idx;
+
+    NS_NONNULL_ASSERT(ringPtr != NULL);
+    NS_NONNULL_ASSERT(msgPtr != NULL);
+
+    if (ringPtr->pending + ringPtr->inflight >= ringPtr->sqEntries) {
+        return NS_FALSE;
+    }
+
+    tail = *ringPtr->sqTail + ringPtr->pending;
+    idx = tail & *ringPtr->sqMask;
+    sqePtr = &ringPtr->sqes[idx];
+
+    memset(sqePtr, 0, sizeof(*sqePtr));
+    sqePtr->opcode = IORING_OP_SENDMSG;
+    sqePtr->fd = sock;
+    sqePtr->addr = (uint64_t)(uintptr_t)msgPtr;
+    sqePtr->len = 1u;
+    sqePtr->msg_flags = (uint32_t)(MSG_NOSIGNAL|MSG_DONTWAIT);
+    sqePtr->user_data = (uint64_t)(uintptr_t)userData;
+
+    ringPtr->sqArray[idx] = idx;
+    ringPtr->pending++;
+
+    return NS_TRUE;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsUringSubmit --
+ *
+ *      Submit all prepared operations with a single system call, wait for
+ *      their completion and return the results.
+ *
+ *      Every prepared operation produces exactly one result. When the
+ *      kernel refuses the submission temporarily (EAGAIN, EBUSY), the
+ *      available completions are collected and the submission is
+ *      retried after a short pause. When the submission still fails,
+ *      the unsubmitted operations are withdrawn from the submission
+ *      queue and completed with the negative errno value, such that the
+ *      caller can fall back to the regular send operations.
+ *
+ * Results:
+ *      Number of results stored in resultsPtr (at most maxResults). The
+ *      result value of each operation is the number of bytes
+ *      transferred or a negative errno value. Withdrawn operations
+ *      are flagged as not submitted.
+ *
+ * Side effects:
+ *      Performs the queued I/O operations.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+NsUringSubmit(NsUring *ringPtr, NsUringResult *resultsPtr, int maxResults)
+{
+    int count = 0;
+
+    NS_NONNULL_ASSERT(ringPtr != NULL);
+    NS_NONNULL_ASSERT(resultsPtr != NULL);
+
+    if (ringPtr->pending > 0u) {
+        unsigned int toSubmit = ringPtr->pending, tail;
+        int          retries = 0;
+
+        tail = *ringPtr->sqTail + toSubmit;
+        __atomic_store_n(ringPtr->sqTail, tail, __ATOMIC_RELEASE);
+        ringPtr->pending = 0u;
+
+        /*
+         * The kernel might consume the submission queue in multiple
+         * steps, therefore repeat until everything is submitted.
+         */
+        while (toSubmit > 0u) {
+            int submitted = UringEnter(ringPtr, toSubmit, 0u);
+
+            if (submitted >= 0) {
+                ringPtr->inflight += (unsigned int)submitted;
+                toSubmit -= (unsigned int)submitted;
+                retries = 0;
+
+            } else if ((errno == EAGAIN || errno == EBUSY)
+                       && retries < NS_URING_SUBMIT_RETRIES) {
+                /*
+                 * Free completion queue entries and back off before
+                 * retrying.
+                 */
+                retries++;
+                count += UringReap(ringPtr, resultsPtr + count, maxResults - count);
+                Ns_ThreadYield();
+                if (retries > 1) {
+                    Tcl_Sleep(retries);
+                }
+
+            } else {
+                int          errorCode = errno;
+                unsigned int head = __atomic_load_n(ringPtr->sqHead, __ATOMIC_ACQUIRE);
+
+                /*
+                 * Withdraw the operations not consumed by the kernel and
+                 * complete them with the error.
+                 */
+                Ns_Log(Warning, "io_uring_enter() failed, withdraw %u send operations: %s",
+                       tail - head, strerror(errorCode));
+                while (head != tail && count < maxResults) {
+                    const struct io_uring_sqe *sqePtr = &ringPtr->sqes[head & *ringPtr->sqMask];
+
+                    resultsPtr[count].userData = (void *)(uintptr_t)sqePtr->user_data;
+                    resultsPtr[count].result = -errorCode;
+                    resultsPtr[count].submitted = NS_FALSE;
+                    count++;
+                    head++;
+                }
+                __atomic_store_n(ringPtr->sqTail, head, __ATOMIC_RELEASE);
+                toSubmit = 0u;
+            }
+        }
+    }
+
+    /*
+     * Collect the completions of all submitted operations. Since the
+     * send operations are non-blocking, all of them complete without
+     * waiting for the peer.
+     */
+    while (ringPtr->inflight > 0u && count < maxResults) {
+        int n = UringReap(ringPtr, resultsPtr + count, maxResults - count);
+
+        if (n > 0) {
+            count += n;
+        } else if (UringEnter(ringPtr, 0u, 1u) < 0) {
+            Ns_Log(Warning, "io_uring_enter() failed while waiting for completions: %s",
+                   strerror(errno));
+            Tcl_Sleep(1);
+        }
+    }
+
+    return count;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * UringReap --
+ *
+ *      Collect the available completions without waiting.
+ *
+ * Results:
+ *      Number of results stored in resultsPtr (at most maxResults).
+ *
+ * Side effects:
+ *      Advances the head of the completion queue.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+UringReap(NsUring *ringPtr, NsUringResult *resultsPtr, int maxResults)
+{
+    int          count = 0;
+    unsigned int head, tail;
+
+    NS_NONNULL_ASSERT(ringPtr != NULL);
+    NS_NONNULL_ASSERT(resultsPtr != NULL);
+
+    head = *ringPtr->cqHead;
+    tail = __atomic_load_n(ringPtr->cqTail, __ATOMIC_ACQUIRE);
+
+    while (head != tail && count < maxResults) {
+        const struct io_uring_cqe *cqePtr = &ringPtr->cqes[head & *ringPtr->cqMask];
+
+        resultsPtr[count].userData = (void *)(uintptr_t)cqePtr->user_data;
+        resultsPtr[count].result = cqePtr->res;
+        resultsPtr[count].submitted = NS_TRUE;
+        count++;
+        head++;
+        ringPtr->inflight--;
+    }
+    __atomic_store_n(ringPtr->cqHead, head, __ATOMIC_RELEASE);
+
+    return count;
+}
+
+static int
+UringEnter(const NsUring *ringPtr, unsigned int toSubmit, unsigned int minComplete)
+{
+    int result;
+
+    NS_NONNULL_ASSERT(ringPtr != NULL);
+
+    do {
+        result = (int)syscall(__NR_io_uring_enter, ringPtr->fd, toSubmit, minComplete,
+                              IORING_ENTER_GETEVENTS, NULL, 0);
+    } while (result < 0 && errno == EINTR);
+
+    return result;
+}
+
+#else
+
+NsUring *
+NsUringCreate(unsigned int UNUSED(entries))
+{
+    return NULL;
+}
+
+void
+NsUringFree(NsUring *UNUSED(ringPtr))
+{
+}
+
+bool
+NsUringPrepSendmsg(NsUring *UNUSED(ringPtr), NS_SOCKET UNUSED(sock),
+                   const struct msghdr *UNUSED(msgPtr), void *UNUSED(userData))
+{
+    return NS_FALSE;
+}
+
+int
+NsUringSubmit(NsUring *UNUSED(ringPtr), NsUringResult *UNUSED(resultsPtr), int UNUSED(maxResults))
+{
+    return 0;
+}
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 4
+ * fill-column: 78
+ * indent-tabs-mode: nil
+ * End:
+ */
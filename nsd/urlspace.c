@@ -112,6 +112,15 @@
 #include "nsd.h"
 
 #define STACK_SIZE      512 /* Max depth of URL hierarchy. */
+#define MAX_SEGMENTS     64 /* Max depth of URLs resolved via compiled junctions. */
+
+#if defined(__GNUC__) || defined(__clang__)
+# define UrlSpaceLoadAcquire(ptr)       __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+# define UrlSpaceStoreRelease(ptr, val) __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+#else
+# define UrlSpaceLoadAcquire(ptr)       (*(ptr))
+# define UrlSpaceStoreRelease(ptr, val) (*(ptr) = (val))
+#endif
 
 /*
 #define DEBUG 1
@@ -135,14 +144,18 @@
  */
 
 /*
- * There is still room for improvements. A simple lookup for
- * "/a/c/a.html" takes 10 strlen operations and 14 strcmp
- * operations. One could alter the static function MkSeq() to produce
- * a more intelligent structure, to calculate strlen operations once,
- * and to make it easier to access the last element.
+ * A simple lookup for "/a/c/a.html" in the trie takes 10 strlen
+ * operations and 14 strcmp operations. Therefore, the lookups with
+ * inheritance (NS_URLSPACE_DEFAULT) are performed on a compiled
+ * representation of a junction, which is built lazily after the
+ * junction was modified. In the compiled representation, the branches
+ * of every trie are sorted by the hash value of their words, the
+ * segments of the looked-up URL are split and hashed once, and the
+ * channel filters are turned into prefix, suffix or exact matches
+ * whenever possible.
  *
- * Currently, the performance of "ns_urlspace get" is about twice the
- * time of "nsv_get".
+ * Without the compiled representation, the performance of
+ * "ns_urlspace get" was about twice the time of "nsv_get".
 
      ns_urlspace unset -recurse /x
      ns_urlspace set /x 1
@@ -250,8 +263,64 @@ typedef struct Junction {
 #ifndef __URLSPACE_OPTIMIZE__
     Ns_Index byuse;
 #endif
+    struct CompiledJunction *compiledPtr; /* Lookup structure, NULL when outdated */
+    Ns_Mutex                 lock;        /* Serializes compilation by readers */
 } Junction;
 
+/*
+ * The following structures define the compiled (frozen) representation
+ * of a junction, used for lookups. The compiled representation refers
+ * to the Nodes and filter strings of the junction, it is discarded
+ * whenever the junction is modified and rebuilt on the next lookup.
+ * As for the junction itself, the caller has to make sure that lookups
+ * and modifications are not performed concurrently.
+ */
+
+typedef struct CompiledBranch {
+    unsigned int          hash;     /* Hash value of the word */
+    size_t                length;   /* Length of the word */
+    const char           *word;     /* Word of the Branch */
+    struct CompiledTrie  *triePtr;  /* Compiled sub-trie */
+} CompiledBranch;
+
+typedef struct CompiledTrie {
+    const Node     *node;           /* Node of the Trie or NULL */
+    size_t          nbranches;      /* Number of branches */
+    CompiledBranch *branches;       /* Branches sorted by hash value */
+} CompiledTrie;
+
+typedef enum {
+    FILTER_ANY,                     /* "*" */
+    FILTER_EXACT,                   /* No wildcard characters */
+    FILTER_SUFFIX,                  /* "*literal" */
+    FILTER_PREFIX,                  /* "literal*" */
+    FILTER_PATTERN                  /* Everything else, use Tcl_StringMatch() */
+} FilterType;
+
+typedef struct CompiledChannel {
+    const char     *filter;         /* Filter of the Channel */
+    const char     *literal;        /* Literal part of the filter */
+    size_t          literalLength;  /* Length of the literal part */
+    FilterType      type;           /* How to match the filter */
+    unsigned int    flags;          /* Flags of the Channel */
+    CompiledTrie   *triePtr;        /* Compiled trie of the Channel */
+} CompiledChannel;
+
+typedef struct CompiledJunction {
+    size_t           nchannels;     /* Number of channels */
+    CompiledChannel *channels;      /* Channels in lookup order */
+} CompiledJunction;
+
+/*
+ * A segment of a URL sequence with precomputed length and hash value.
+ */
+
+typedef struct UrlSegment {
+    const char     *chars;          /* Segment in the sequence */
+    size_t          length;         /* Length of the segment */
+    unsigned int    hash;           /* Hash value of the segment */
+} UrlSegment;
+
 /*
  * UrlSpaceContextSpec must share fields of Ns_IndexContextSpec
  */
@@ -320,6 +389,10 @@ static void WalkTrie(const Trie *triePtr, Ns_ArgProc func,
 static size_t CountNonWildcharChars(const char *chars)
     NS_GNUC_NONNULL(1) NS_GNUC_CONST;
 
+static void *NodeFindData(const Node *nodePtr, bool atEnd,
+                          NsUrlSpaceContextFilterProc proc, void *context)
+    NS_GNUC_NONNULL(1);
+
 #ifdef DEBUG
 static void PrintSeq(const char *seq);
 #endif
@@ -380,10 +453,51 @@ static void *JunctionFind(const Junction *juncPtr, char *seq,
 static void *JunctionFindExact(const Junction *juncPtr, char *seq, unsigned int flags)
     NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
 
-static void *JunctionDeleteNode(const Junction *juncPtr, char *seq, unsigned int flags)
+static void *JunctionDeleteNode(Junction *juncPtr, char *seq, unsigned int flags)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+
+static void JunctionTruncBranch(Junction *juncPtr, char *seq)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+
+static void JunctionInvalidate(Junction *juncPtr)
+    NS_GNUC_NONNULL(1);
+
+/*
+ * Functions for compiled junctions
+ */
+
+static unsigned int SegmentHash(const char *chars, size_t length)
+    NS_GNUC_NONNULL(1) NS_GNUC_PURE;
+
+static CompiledJunction *JunctionCompile(const Junction *juncPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_RETURNS_NONNULL;
+
+static void CompiledJunctionFree(CompiledJunction *cjuncPtr)
+    NS_GNUC_NONNULL(1);
+
+static CompiledTrie *TrieCompile(const Trie *triePtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_RETURNS_NONNULL;
+
+static void CompiledTrieFree(CompiledTrie *ctriePtr)
+    NS_GNUC_NONNULL(1);
+
+static void FilterCompile(CompiledChannel *cchannelPtr, const char *filter)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+
+static bool FilterMatch(const CompiledChannel *cchannelPtr, const UrlSegment *segmentPtr)
     NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
 
-static void JunctionTruncBranch(const Junction *juncPtr, char *seq)
+static int CmpCompiledBranches(const void *left, const void *right)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+
+static void *CompiledTrieFind(const CompiledTrie *ctriePtr, const UrlSegment *segments,
+                              size_t nsegments, NsUrlSpaceContextFilterProc proc, void *context,
+                              int *depthPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(6);
+
+static void *CompiledJunctionFind(Junction *juncPtr, char *seq,
+                                  Ns_UrlSpaceMatchInfo *matchInfoPtr,
+                                  NsUrlSpaceContextFilterProc proc, void *context)
     NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
 
 /*
@@ -793,7 +907,7 @@ NsUrlSpecificGet(NsServer *servPtr, const char *method, const char *url, int id,
 {
     Ns_DString      ds, *dsPtr = &ds;
     void           *data = NULL; /* Just to make compiler silent, we have a complete enumeration of switch values */
-    const Junction *junction;
+    Junction       *junction;
 
     NS_NONNULL_ASSERT(servPtr != NULL);
     NS_NONNULL_ASSERT(method != NULL);
@@ -812,7 +926,7 @@ NsUrlSpecificGet(NsServer *servPtr, const char *method, const char *url, int id,
     switch (op) {
 
     case NS_URLSPACE_DEFAULT:
-        data = JunctionFind(junction, dsPtr->string, matchInfoPtr, proc, context);
+        data = CompiledJunctionFind(junction, dsPtr->string, matchInfoPtr, proc, context);
         break;
 
     case NS_URLSPACE_EXACT:
@@ -823,7 +937,7 @@ NsUrlSpecificGet(NsServer *servPtr, const char *method, const char *url, int id,
         /*
          * Deprecated branch.
          */
-        data = JunctionFind(junction, dsPtr->string, matchInfoPtr, proc, context);
+        data = CompiledJunctionFind(junction, dsPtr->string, matchInfoPtr, proc, context);
         break;
 
     }
@@ -1611,6 +1725,68 @@ TrieDestroy(Trie *triePtr)
     }
 }
 
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NodeFindData --
+ *
+ *      Return the data of a node. When the end of the sequence is
+ *      reached, non-inheriting data has precedence. Otherwise, the
+ *      data of the first matching context filter or the inheriting
+ *      data is returned.
+ *
+ * Results:
+ *      User data or NULL.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void *
+NodeFindData(const Node *nodePtr, bool atEnd, NsUrlSpaceContextFilterProc proc, void *context)
+{
+    void *data;
+
+    NS_NONNULL_ASSERT(nodePtr != NULL);
+
+    if (
+        atEnd /* this makes "set -noinherit /x/ *.html foo" + "get /x/a.html" fail */
+        && (nodePtr->dataNoInherit != NULL)
+        ) {
+        data = nodePtr->dataNoInherit;
+    } else {
+        data = nodePtr->dataInherit;
+#ifdef CONTEXT_FILTER
+        if (nodePtr->data.n != 0 && context != NULL) {
+            size_t i;
+
+            /*
+             * We have context filters
+             */
+            for (i = 0u; i < nodePtr->data.n; i++) {
+                Ns_IndexContextSpec *spec = Ns_IndexEl(&nodePtr->data, i);
+                bool success;
+
+                assert(proc != NULL);
+                success = (proc)(spec, context);
+#ifdef DEBUG
+                fprintf(stderr, ".......[%ld]    NodeFindData nodePtr %p => success %d\n",
+                        i, (void*)nodePtr, success);
+#endif
+                if (success) {
+                    data = spec->data;
+                    break;
+                }
+            }
+        }
+#endif
+    }
+    return data;
+}
+
 
 /*
  *----------------------------------------------------------------------
@@ -1649,43 +1825,7 @@ TrieFind(const Trie *triePtr, char *seq, NsUrlSpaceContextFilterProc proc, void
 #endif
 
     if (nodePtr != NULL) {
-        if (
-            (*seq == '\0') /* this makes "set -noinherit /x/ *.html foo" + "get /x/a.html" fail */
-            && (nodePtr->dataNoInherit != NULL)
-            ) {
-            data = nodePtr->dataNoInherit;
-        } else {
-            data = nodePtr->dataInherit;
-#ifdef CONTEXT_FILTER
-            if (nodePtr->data.n != 0) {
-                /*
-                 * We have context filters
-                 */
-                if (context != NULL) {
-                    size_t i;
-#ifdef DEBUG
-                    fprintf(stderr, "...    TrieFind seq '%s' nodePtr %p context %p context specs %ld\n",
-                            seq, (void*)nodePtr, context, nodePtr->data.n);
-#endif
-                    for (i = 0u; i < nodePtr->data.n; i++) {
-                        Ns_IndexContextSpec *spec = Ns_IndexEl(&nodePtr->data, i);
-                        bool success;
-
-                        assert(proc != NULL);
-                        success = (proc)(spec, context);
-#ifdef DEBUG
-                        fprintf(stderr, ".......[%ld]    TrieFind seq '%s' nodePtr %p => success %d\n",
-                                i, seq, (void*)nodePtr, success);
-#endif
-                        if (success) {
-                            data = spec->data;
-                            break;
-                        }
-                    }
-                }
-            }
-#endif
-        }
+        data = NodeFindData(nodePtr, (*seq == '\0'), proc, context);
 #ifdef DEBUG
         fprintf(stderr, "...    TrieFind seq '%s' nodePtr %p -> data %p\n", seq, (void*)nodePtr, data);
 #endif
@@ -2078,6 +2218,9 @@ JunctionGet(NsServer *servPtr, int id)
 #endif
         Ns_IndexInit(&juncPtr->byname, 5u,
                      CmpChannelsAsStrings, CmpKeyWithChannelAsStrings);
+        juncPtr->compiledPtr = NULL;
+        Ns_MutexInit(&juncPtr->lock);
+        Ns_MutexSetName2(&juncPtr->lock, "ns:urlspace", servPtr->server);
         servPtr->urlspace.junction[id] = juncPtr;
     }
 
@@ -2104,7 +2247,7 @@ JunctionGet(NsServer *servPtr, int id)
  */
 
 static void
-JunctionTruncBranch(const Junction *juncPtr, char *seq)
+JunctionTruncBranch(Junction *juncPtr, char *seq)
 {
     Channel *channelPtr;
     size_t   i, n;
@@ -2112,6 +2255,8 @@ JunctionTruncBranch(const Junction *juncPtr, char *seq)
     NS_NONNULL_ASSERT(juncPtr != NULL);
     NS_NONNULL_ASSERT(seq != NULL);
 
+    JunctionInvalidate(juncPtr);
+
     /*
      * Loop over every channel in a junction and truncate the sequence in
      * each.
@@ -2175,6 +2320,7 @@ JunctionAdd(Junction *juncPtr, char *seq, void *data, unsigned int flags,
     NS_NONNULL_ASSERT(seq != NULL);
 
     //fprintf(stderr, "...   JunctionAdd '%s' contextSpec %p\n", seq, contextSpec);
+    JunctionInvalidate(juncPtr);
 
     depth = 0;
     Ns_DStringInit(&dsFilter);
@@ -2557,7 +2703,7 @@ JunctionFindExact(const Junction *juncPtr, char *seq, unsigned int flags)
  */
 
 static void *
-JunctionDeleteNode(const Junction *juncPtr, char *seq, unsigned int flags)
+JunctionDeleteNode(Junction *juncPtr, char *seq, unsigned int flags)
 {
     const Channel *channelPtr;
     char          *p;
@@ -2568,6 +2714,8 @@ JunctionDeleteNode(const Junction *juncPtr, char *seq, unsigned int flags)
     NS_NONNULL_ASSERT(juncPtr != NULL);
     NS_NONNULL_ASSERT(seq != NULL);
 
+    JunctionInvalidate(juncPtr);
+
     /*
      * Set p to the last element of the sequence, and
      * depth to the number of elements in the sequence.
@@ -2628,6 +2776,538 @@ JunctionDeleteNode(const Junction *juncPtr, char *seq, unsigned int flags)
     return data;
 }
 
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * JunctionInvalidate --
+ *
+ *      Discard the compiled representation of a junction, since the
+ *      junction is modified. The function is called by writers, which
+ *      are not allowed to run concurrently with lookups: callers have to
+ *      modify a junction under a lock, which is held by the readers
+ *      during lookups (e.g. servPtr->urlspace.lock for pool mappings).
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Frees memory, the next lookup rebuilds the compiled junction.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+JunctionInvalidate(Junction *juncPtr)
+{
+    CompiledJunction *cjuncPtr;
+
+    NS_NONNULL_ASSERT(juncPtr != NULL);
+
+    cjuncPtr = juncPtr->compiledPtr;
+    if (cjuncPtr != NULL) {
+        UrlSpaceStoreRelease(&juncPtr->compiledPtr, NULL);
+        CompiledJunctionFree(cjuncPtr);
+    }
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SegmentHash --
+ *
+ *      Compute the hash value (FNV-1a) of a segment of a URL.
+ *
+ * Results:
+ *      Hash value.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static unsigned int
+SegmentHash(const char *chars, size_t length)
+{
+    unsigned int hash = 2166136261u;
+    size_t       i;
+
+    for (i = 0u; i < length; i++) {
+        hash ^= (unsigned char)chars[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * JunctionCompile, CompiledJunctionFree --
+ *
+ *      Build the compiled representation of a junction, containing the
+ *      channels in lookup order with their precompiled filters and
+ *      compiled tries, and free it.
+ *
+ * Results:
+ *      JunctionCompile() returns the compiled junction.
+ *
+ * Side effects:
+ *      Allocates/frees memory.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static CompiledJunction *
+JunctionCompile(const Junction *juncPtr)
+{
+    CompiledJunction *cjuncPtr;
+    size_t            i, n;
+
+    NS_NONNULL_ASSERT(juncPtr != NULL);
+
+    cjuncPtr = ns_malloc(sizeof(CompiledJunction));
+#ifndef __URLSPACE_OPTIMIZE__
+    n = Ns_IndexCount(&juncPtr->byuse);
+#else
+    n = Ns_IndexCount(&juncPtr->byname);
+#endif
+    cjuncPtr->nchannels = n;
+    cjuncPtr->channels = (n > 0u) ? ns_malloc(n * sizeof(CompiledChannel)) : NULL;
+
+    for (i = 0u; i < n; i++) {
+        const Channel   *channelPtr;
+        CompiledChannel *cchannelPtr = &cjuncPtr->channels[i];
+
+#ifndef __URLSPACE_OPTIMIZE__
+        channelPtr = Ns_IndexEl(&juncPtr->byuse, i);
+#else
+        channelPtr = Ns_IndexEl(&juncPtr->byname, n - i - 1u);
+#endif
+        FilterCompile(cchannelPtr, channelPtr->filter);
+        cchannelPtr->flags = channelPtr->flags;
+        cchannelPtr->triePtr = TrieCompile(&channelPtr->trie);
+    }
+
+    return cjuncPtr;
+}
+
+static void
+CompiledJunctionFree(CompiledJunction *cjuncPtr)
+{
+    size_t i;
+
+    NS_NONNULL_ASSERT(cjuncPtr != NULL);
+
+    for (i = 0u; i < cjuncPtr->nchannels; i++) {
+        CompiledTrieFree(cjuncPtr->channels[i].triePtr);
+    }
+    ns_free(cjuncPtr->channels);
+    ns_free(cjuncPtr);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TrieCompile, CompiledTrieFree --
+ *
+ *      Build the compiled representation of a trie, where the branches
+ *      are sorted by the hash values of their words, and free it.
+ *
+ * Results:
+ *      TrieCompile() returns the compiled trie.
+ *
+ * Side effects:
+ *      Allocates/frees memory.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static CompiledTrie *
+TrieCompile(const Trie *triePtr)
+{
+    CompiledTrie *ctriePtr;
+    size_t        i, n;
+
+    NS_NONNULL_ASSERT(triePtr != NULL);
+
+    n = Ns_IndexCount(&triePtr->branches);
+    ctriePtr = ns_malloc(sizeof(CompiledTrie));
+    ctriePtr->node = triePtr->node;
+    ctriePtr->nbranches = n;
+    ctriePtr->branches = (n > 0u) ? ns_malloc(n * sizeof(CompiledBranch)) : NULL;
+
+    for (i = 0u; i < n; i++) {
+        const Branch   *branchPtr = Ns_IndexEl(&triePtr->branches, i);
+        CompiledBranch *cbranchPtr = &ctriePtr->branches[i];
+
+        cbranchPtr->word = branchPtr->word;
+        cbranchPtr->length = strlen(branchPtr->word);
+        cbranchPtr->hash = SegmentHash(branchPtr->word, cbranchPtr->length);
+        cbranchPtr->triePtr = TrieCompile(&branchPtr->trie);
+    }
+    if (n > 1u) {
+        qsort(ctriePtr->branches, n, sizeof(CompiledBranch), CmpCompiledBranches);
+    }
+
+    return ctriePtr;
+}
+
+static void
+CompiledTrieFree(CompiledTrie *ctriePtr)
+{
+    size_t i;
+
+    NS_NONNULL_ASSERT(ctriePtr != NULL);
+
+    for (i = 0u; i < ctriePtr->nbranches; i++) {
+        CompiledTrieFree(ctriePtr->branches[i].triePtr);
+    }
+    ns_free(ctriePtr->branches);
+    ns_free(ctriePtr);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CmpCompiledBranches --
+ *
+ *      qsort() callback to order compiled branches by hash value and
+ *      word.
+ *
+ * Results:
+ *      0 if equal, -1 if left is less than right, 1 if left is
+ *      greater than right.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+CmpCompiledBranches(const void *left, const void *right)
+{
+    const CompiledBranch *leftPtr = left, *rightPtr = right;
+    int                   result;
+
+    if (leftPtr->hash != rightPtr->hash) {
+        result = (leftPtr->hash < rightPtr->hash) ? -1 : 1;
+    } else {
+        result = strcmp(leftPtr->word, rightPtr->word);
+    }
+    return result;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FilterCompile, FilterMatch --
+ *
+ *      Precompile the filter of a channel and match a segment against
+ *      it. Filters with a single leading or trailing "*" and no other
+ *      wildcard characters are matched by a comparison of the literal
+ *      part, all other filters via Tcl_StringMatch().
+ *
+ * Results:
+ *      FilterMatch() returns NS_TRUE, when the segment matches.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+FilterCompile(CompiledChannel *cchannelPtr, const char *filter)
+{
+    size_t      length;
+    const char *wildcards = "*?[\\";
+
+    NS_NONNULL_ASSERT(cchannelPtr != NULL);
+    NS_NONNULL_ASSERT(filter != NULL);
+
+    length = strlen(filter);
+    cchannelPtr->filter = filter;
+    cchannelPtr->literal = filter;
+    cchannelPtr->literalLength = length;
+
+    if (length == 1u && *filter == '*') {
+        cchannelPtr->type = FILTER_ANY;
+
+    } else if (strpbrk(filter, wildcards) == NULL) {
+        cchannelPtr->type = FILTER_EXACT;
+
+    } else if (*filter == '*' && strpbrk(filter + 1, wildcards) == NULL) {
+        cchannelPtr->type = FILTER_SUFFIX;
+        cchannelPtr->literal = filter + 1;
+        cchannelPtr->literalLength = length - 1u;
+
+    } else if (filter[length - 1u] == '*'
+               && strpbrk(filter, wildcards) == filter + length - 1u) {
+        cchannelPtr->type = FILTER_PREFIX;
+        cchannelPtr->literalLength = length - 1u;
+
+    } else {
+        cchannelPtr->type = FILTER_PATTERN;
+    }
+}
+
+static bool
+FilterMatch(const CompiledChannel *cchannelPtr, const UrlSegment *segmentPtr)
+{
+    bool success = NS_FALSE;
+
+    NS_NONNULL_ASSERT(cchannelPtr != NULL);
+    NS_NONNULL_ASSERT(segmentPtr != NULL);
+
+    switch (cchannelPtr->type) {
+    case FILTER_ANY:
+        success = NS_TRUE;
+        break;
+
+    case FILTER_EXACT:
+        success = (segmentPtr->length == cchannelPtr->literalLength
+                   && memcmp(segmentPtr->chars, cchannelPtr->literal, segmentPtr->length) == 0);
+        break;
+
+    case FILTER_SUFFIX:
+        success = (segmentPtr->length >= cchannelPtr->literalLength
+                   && memcmp(segmentPtr->chars + segmentPtr->length - cchannelPtr->literalLength,
+                             cchannelPtr->literal, cchannelPtr->literalLength) == 0);
+        break;
+
+    case FILTER_PREFIX:
+        success = (segmentPtr->length >= cchannelPtr->literalLength
+                   && memcmp(segmentPtr->chars, cchannelPtr->literal, cchannelPtr->literalLength) == 0);
+        break;
+
+    case FILTER_PATTERN:
+        success = (NS_Tcl_StringMatch(segmentPtr->chars, cchannelPtr->filter) == 1);
+        break;
+    }
+
+    return success;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CompiledTrieFind --
+ *
+ *      Find a node in a compiled trie matching a sequence of
+ *      segments. This function implements the same semantics as
+ *      TrieFind(), but the branches are located via the precomputed
+ *      hash values of the segments.
+ *
+ * Results:
+ *      Return the appropriate node's data.
+ *
+ * Side effects:
+ *      The depth variable will be set-by-reference to the depth of
+ *      the returned node. If no node is set, it will not be changed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void *
+CompiledTrieFind(const CompiledTrie *ctriePtr, const UrlSegment *segments, size_t nsegments,
+                 NsUrlSpaceContextFilterProc proc, void *context, int *depthPtr)
+{
+    void *data = NULL;
+    int   ldepth;
+
+    NS_NONNULL_ASSERT(ctriePtr != NULL);
+    NS_NONNULL_ASSERT(segments != NULL);
+    NS_NONNULL_ASSERT(depthPtr != NULL);
+
+    ldepth = *depthPtr;
+
+    if (ctriePtr->node != NULL) {
+        data = NodeFindData(ctriePtr->node, (nsegments == 0u), proc, context);
+    }
+    if (nsegments > 0u && ctriePtr->nbranches > 0u) {
+        const CompiledBranch *branchPtr = NULL;
+        size_t                low = 0u, high = ctriePtr->nbranches;
+        unsigned int          hash = segments->hash;
+
+        /*
+         * Binary search for the first branch with the hash value of the
+         * segment; then compare the words of all branches with this hash
+         * value.
+         */
+        while (low < high) {
+            size_t mid = low + (high - low) / 2u;
+
+            if (ctriePtr->branches[mid].hash < hash) {
+                low = mid + 1u;
+            } else {
+                high = mid;
+            }
+        }
+        for (; low < ctriePtr->nbranches && ctriePtr->branches[low].hash == hash; low++) {
+            const CompiledBranch *candidatePtr = &ctriePtr->branches[low];
+
+            if (candidatePtr->length == segments->length
+                && memcmp(candidatePtr->word, segments->chars, segments->length) == 0) {
+                branchPtr = candidatePtr;
+                break;
+            }
+        }
+
+        ldepth += 1;
+        if (branchPtr != NULL) {
+            void *p = CompiledTrieFind(branchPtr->triePtr, segments + 1, nsegments - 1u,
+                                       proc, context, &ldepth);
+            if (p != NULL) {
+                data = p;
+                *depthPtr = ldepth;
+            }
+        }
+    }
+
+    return data;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CompiledJunctionFind --
+ *
+ *      Locate a node for a given sequence in the compiled representation
+ *      of a junction, which is built when necessary. This function
+ *      implements the same semantics as JunctionFind(), which is used
+ *      for sequences with more than MAX_SEGMENTS elements.
+ *
+ * Results:
+ *      User data.
+ *
+ * Side effects:
+ *      Might build the compiled representation of the junction.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void *
+CompiledJunctionFind(Junction *juncPtr, char *seq,
+                     Ns_UrlSpaceMatchInfo *matchInfoPtr,
+                     NsUrlSpaceContextFilterProc proc, void *context)
+{
+    const CompiledJunction *cjuncPtr;
+    UrlSegment              segments[MAX_SEGMENTS];
+    const UrlSegment       *lastPtr;
+    const char             *p;
+    size_t                  i, nsegments;
+    int                     depth = 0;
+    void                   *data = NULL;
+
+    NS_NONNULL_ASSERT(juncPtr != NULL);
+    NS_NONNULL_ASSERT(seq != NULL);
+
+    /*
+     * Split the sequence into segments, computing lengths and hash values
+     * once. Sequences with an empty method or too many segments are
+     * handled by the trie.
+     */
+    for (p = seq, nsegments = 0u; *p != '\0' && nsegments < MAX_SEGMENTS; nsegments++) {
+        size_t length = strlen(p);
+
+        segments[nsegments].chars = p;
+        segments[nsegments].length = length;
+        segments[nsegments].hash = SegmentHash(p, length);
+        p += length + 1u;
+    }
+    if (nsegments == 0u || *p != '\0') {
+        return JunctionFind(juncPtr, seq, matchInfoPtr, proc, context);
+    }
+
+    cjuncPtr = UrlSpaceLoadAcquire(&juncPtr->compiledPtr);
+    if (unlikely(cjuncPtr == NULL)) {
+        /*
+         * The junction was modified since the last lookup. Concurrent
+         * lookups might try to compile as well, so compile under the
+         * lock of the junction.
+         */
+        Ns_MutexLock(&juncPtr->lock);
+        cjuncPtr = juncPtr->compiledPtr;
+        if (cjuncPtr == NULL) {
+            cjuncPtr = JunctionCompile(juncPtr);
+            UrlSpaceStoreRelease(&juncPtr->compiledPtr, (CompiledJunction *)cjuncPtr);
+        }
+        Ns_MutexUnlock(&juncPtr->lock);
+    }
+
+    lastPtr = &segments[nsegments - 1u];
+
+    /*
+     * Check filters from most restrictive to least restrictive.
+     */
+    for (i = 0u; i < cjuncPtr->nchannels; i++) {
+        const CompiledChannel *cchannelPtr = &cjuncPtr->channels[i];
+        void                  *candidateData = NULL;
+        int                    candidateDepth = 0;
+        ssize_t                candidateOffset = 0;
+        size_t                 candidateSegmentLength = 0u;
+        bool                   candidateIsSegmentMatch = NS_FALSE;
+
+        if (FilterMatch(cchannelPtr, lastPtr)) {
+            /*
+             * The last segment of the URL matches the filter (for
+             * example, "*.adp").
+             */
+            candidateData = CompiledTrieFind(cchannelPtr->triePtr, segments, nsegments,
+                                             proc, context, &candidateDepth);
+
+        } else if (cchannelPtr->type != FILTER_ANY
+                   && (cchannelPtr->flags & NS_OP_SEGMENT_MATCH) != 0u) {
+            size_t n;
+
+            /*
+             * If we have a filter, but it did not match in the last
+             * segment, and NS_OP_SEGMENT_MATCH is set, try a segment
+             * match.
+             */
+            for (n = 0u; n < nsegments - 1u; n++) {
+                if (FilterMatch(cchannelPtr, &segments[n])) {
+                    candidateDepth = 0;
+                    candidateData = CompiledTrieFind(cchannelPtr->triePtr, segments, nsegments,
+                                                     proc, context, &candidateDepth);
+                    candidateOffset = (ssize_t)(segments[n].chars - seq);
+                    candidateSegmentLength = segments[n].length;
+                    candidateIsSegmentMatch = NS_TRUE;
+                }
+            }
+        }
+
+        /*
+         * Take candidate data either
+         * - when no data has been found so far, or
+         * - when data was found on a more specific node (i.e., it has a greater depth
+         *   than the previously found node)
+         */
+        if (candidateData != NULL
+            && (data == NULL || candidateDepth > depth)
+            ) {
+            depth = candidateDepth;
+            data = candidateData;
+            if (matchInfoPtr != NULL) {
+                matchInfoPtr->offset = candidateOffset;
+                matchInfoPtr->isSegmentMatch = candidateIsSegmentMatch;
+                matchInfoPtr->segmentLength = candidateSegmentLength;
+            }
+        }
+    }
+
+    return data;
+}
+
 
 /*
  *----------------------------------------------------------------------
@@ -2805,14 +3485,14 @@ CheckTclUrlSpaceId(Tcl_Interp *interp, NsServer *servPtr, int *idPtr)
 
     if (*idPtr == -1) {
 
-        Ns_MutexLock(&servPtr->urlspace.lock);
+        Ns_RWLockWrLock(&servPtr->urlspace.lock);
         if (defaultTclUrlSpaceId < 0) {
             /*
              * Allocate a default Tcl urlspace id
              */
             result = AllocTclUrlSpaceId(interp, &defaultTclUrlSpaceId);
         }
-        Ns_MutexUnlock(&servPtr->urlspace.lock);
+        Ns_RWLockUnlock(&servPtr->urlspace.lock);
 
         if (result == TCL_OK) {
             *idPtr = defaultTclUrlSpaceId;
@@ -3035,9 +3715,9 @@ UrlSpaceNewObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc, Tc
     } else {
         int id = -1;
 
-        Ns_MutexLock(&servPtr->urlspace.lock);
+        Ns_RWLockWrLock(&servPtr->urlspace.lock);
         result = AllocTclUrlSpaceId(interp, &id);
-        Ns_MutexUnlock(&servPtr->urlspace.lock);
+        Ns_RWLockUnlock(&servPtr->urlspace.lock);
 
         if (likely(result == TCL_OK)) {
             Tcl_SetObjResult(interp, Tcl_NewIntObj(id));
@@ -32,6 +32,37 @@ NS_EXTERN void             NsDbDriverInit(const char *server, const struct DbDri
 NS_EXTERN uintptr_t        NsDbGetSessionId(const Ns_DbHandle *handle) NS_GNUC_PURE
   NS_GNUC_NONNULL(1);
 
+/*
+ * State of an asynchronous query of a handle.
+ */
+typedef enum {
+    NsDbAsyncIdle,      /* No query submitted */
+    NsDbAsyncPending,   /* Query submitted to the driver, result pending */
+    NsDbAsyncDone       /* Query executed, result status available */
+} NsDbAsyncState;
+
+NS_EXTERN void            *NsDbStmtCacheGet(Ns_DbHandle *handle, const char *sql)
+  NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+NS_EXTERN void             NsDbStmtCacheAdd(Ns_DbHandle *handle, const char *sql, void *stmt)
+  NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(3);
+NS_EXTERN void             NsDbStmtCacheFlush(Ns_DbHandle *handle)
+  NS_GNUC_NONNULL(1);
+NS_EXTERN int              NsDbStmtCacheSize(const Ns_DbHandle *handle) NS_GNUC_PURE
+  NS_GNUC_NONNULL(1);
+NS_EXTERN bool             NsDbPrepareSupported(const Ns_DbHandle *handle)
+  NS_GNUC_NONNULL(1);
+NS_EXTERN void             NsDbFreePrepared(Ns_DbHandle *handle, void *stmt)
+  NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+
+NS_EXTERN NsDbAsyncState   NsDbGetAsyncState(const Ns_DbHandle *handle, int *statusPtr)
+  NS_GNUC_NONNULL(1);
+NS_EXTERN void             NsDbAsyncStart(Ns_DbHandle *handle, const char *sql)
+  NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+NS_EXTERN void             NsDbAsyncFinish(Ns_DbHandle *handle, int status)
+  NS_GNUC_NONNULL(1);
+NS_EXTERN void             NsDbAsyncReset(Ns_DbHandle *handle)
+  NS_GNUC_NONNULL(1);
+
 #endif
 
 
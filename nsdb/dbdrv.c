@@ -42,6 +42,14 @@ typedef Ns_ReturnCode  (SpSetParamProc) (Ns_DbHandle *handle, char *args);
 typedef int            (SpExecProc) (Ns_DbHandle *handle);
 typedef Ns_ReturnCode  (SpReturnCodeProc) (Ns_DbHandle *dbhandle, const char *returnCode, int bufsize);
 typedef Ns_Set *       (SpGetParamsProc) (Ns_DbHandle *handle);
+typedef Ns_ReturnCode  (AsyncSubmitProc) (Ns_DbHandle *handle, const char *sql);
+typedef NS_SOCKET      (AsyncSocketProc) (Ns_DbHandle *handle);
+typedef int            (AsyncPollProc) (Ns_DbHandle *handle);
+typedef int            (AsyncFetchProc) (Ns_DbHandle *handle);
+typedef void *         (PrepareProc) (Ns_DbHandle *handle, const char *sql);
+typedef int            (ExecPreparedProc) (Ns_DbHandle *handle, void *stmt,
+                                           int nparams, const char *const* values);
+typedef void           (FreePreparedProc) (Ns_DbHandle *handle, void *stmt);
 
 
 /*
@@ -71,6 +79,13 @@ typedef struct DbDriver {
     SpExecProc       *spexecProc;
     SpReturnCodeProc *spreturncodeProc;
     SpGetParamsProc  *spgetparamsProc;
+    AsyncSubmitProc  *asyncSubmitProc;
+    AsyncSocketProc  *asyncSocketProc;
+    AsyncPollProc    *asyncPollProc;
+    AsyncFetchProc   *asyncFetchProc;
+    PrepareProc      *prepareProc;
+    ExecPreparedProc *execPreparedProc;
+    FreePreparedProc *freePreparedProc;
 } DbDriver;
 
 /*
@@ -80,6 +95,11 @@ typedef struct DbDriver {
 static Tcl_HashTable driversTable;
 
 static void UnsupProcId(const char *name);
+static void AsyncPoll(Ns_DbHandle *handle, const DbDriver *driverPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+static int ExecPrepared(Ns_DbHandle *handle, const DbDriver *driverPtr, const char *sql,
+                        int nparams, const char *const* values)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(3);
 
 
 
@@ -204,6 +224,34 @@ Ns_DbRegisterDriver(const char *driver, const Ns_DbProc *procs)
             driverPtr->spgetparamsProc = (SpGetParamsProc *) procs->func;
             break;
 
+        case DbFn_AsyncSubmit:
+            driverPtr->asyncSubmitProc = (AsyncSubmitProc *) procs->func;
+            break;
+
+        case DbFn_AsyncSocket:
+            driverPtr->asyncSocketProc = (AsyncSocketProc *) procs->func;
+            break;
+
+        case DbFn_AsyncPoll:
+            driverPtr->asyncPollProc = (AsyncPollProc *) procs->func;
+            break;
+
+        case DbFn_AsyncFetch:
+            driverPtr->asyncFetchProc = (AsyncFetchProc *) procs->func;
+            break;
+
+        case DbFn_Prepare:
+            driverPtr->prepareProc = (PrepareProc *) procs->func;
+            break;
+
+        case DbFn_ExecPrepared:
+            driverPtr->execPreparedProc = (ExecPreparedProc *) procs->func;
+            break;
+
+        case DbFn_FreePrepared:
+            driverPtr->freePreparedProc = (FreePreparedProc *) procs->func;
+            break;
+
             /*
              * The following functions are no longer supported.
              */
@@ -417,7 +465,9 @@ Ns_DbSelect(Ns_DbHandle *handle, const char *sql)
  *
  * Ns_DbExec --
  *
- *      Execute an SQL statement.
+ *      Execute an SQL statement. When the pool has a prepared statement
+ *      cache and the driver supports prepared statements, the statement
+ *      is executed via the cache.
  *
  * Results:
  *      NS_DML, NS_ROWS, or NS_ERROR.
@@ -439,19 +489,169 @@ Ns_DbExec(Ns_DbHandle *handle, const char *sql)
 
     driverPtr = NsDbGetDriver(handle);
 
-    if (handle->connected
-        && driverPtr != NULL
-        && driverPtr->execProc != NULL) {
-        Ns_Time startTime;
+    if (handle->connected && driverPtr != NULL) {
 
-        Ns_GetTime(&startTime);
-        status = (*driverPtr->execProc)(handle, sql);
-        NsDbLogSql(&startTime, handle, sql);
+        if (NsDbStmtCacheSize(handle) > 0 && NsDbPrepareSupported(handle)) {
+            status = ExecPrepared(handle, driverPtr, sql, 0, NULL);
+
+        } else if (driverPtr->execProc != NULL) {
+            Ns_Time startTime;
+
+            Ns_GetTime(&startTime);
+            status = (*driverPtr->execProc)(handle, sql);
+            NsDbLogSql(&startTime, handle, sql);
+        }
     }
 
     return status;
 }
 
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Ns_DbExecPrepared --
+ *
+ *      Execute an SQL statement with the given bind parameters as a
+ *      prepared statement. The syntax of the parameter placeholders in
+ *      the SQL statement depends on the driver. Prepared statements are
+ *      kept in the statement cache of the handle, when configured for
+ *      the pool. When the driver does not support prepared statements,
+ *      statements without parameters are executed via Ns_DbExec.
+ *
+ * Results:
+ *      NS_DML, NS_ROWS, or NS_ERROR.
+ *
+ * Side effects:
+ *      SQL is sent to database for evaluation.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+Ns_DbExecPrepared(Ns_DbHandle *handle, const char *sql, int nparams, const char *const* values)
+{
+    const DbDriver *driverPtr;
+    int             status = NS_ERROR;
+
+    NS_NONNULL_ASSERT(handle != NULL);
+    NS_NONNULL_ASSERT(sql != NULL);
+
+    driverPtr = NsDbGetDriver(handle);
+
+    if (handle->connected && driverPtr != NULL) {
+
+        if (NsDbPrepareSupported(handle)) {
+            status = ExecPrepared(handle, driverPtr, sql, nparams, values);
+
+        } else if (nparams == 0) {
+            status = Ns_DbExec(handle, sql);
+
+        } else {
+            Ns_DbSetException(handle, "NSDB",
+                              "driver does not support bind parameters");
+        }
+    }
+
+    return status;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ExecPrepared --
+ *
+ *      Execute an SQL statement as prepared statement. The statement is
+ *      taken from the statement cache of the handle, or prepared and
+ *      added to the cache.
+ *
+ * Results:
+ *      NS_DML, NS_ROWS, or NS_ERROR.
+ *
+ * Side effects:
+ *      Might evict the least recently used statement from the cache.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+ExecPrepared(Ns_DbHandle *handle, const DbDriver *driverPtr, const char *sql,
+             int nparams, const char *const* values)
+{
+    Ns_Time  startTime;
+    void    *stmt;
+    bool     cached = (NsDbStmtCacheSize(handle) > 0);
+    int      status = NS_ERROR;
+
+    NS_NONNULL_ASSERT(handle != NULL);
+    NS_NONNULL_ASSERT(driverPtr != NULL);
+    NS_NONNULL_ASSERT(sql != NULL);
+
+    Ns_GetTime(&startTime);
+    stmt = cached ? NsDbStmtCacheGet(handle, sql) : NULL;
+    if (stmt == NULL) {
+        stmt = (*driverPtr->prepareProc)(handle, sql);
+        if (stmt != NULL && cached) {
+            NsDbStmtCacheAdd(handle, sql, stmt);
+        }
+    }
+    if (stmt != NULL) {
+        status = (*driverPtr->execPreparedProc)(handle, stmt, nparams, values);
+        if (!cached) {
+            NsDbFreePrepared(handle, stmt);
+        }
+    }
+    NsDbLogSql(&startTime, handle, sql);
+
+    return status;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsDbPrepareSupported, NsDbFreePrepared --
+ *
+ *      Check, whether the driver of the handle supports prepared
+ *      statements, and free a prepared statement via the driver.
+ *
+ * Results:
+ *      NsDbPrepareSupported() returns a boolean value.
+ *
+ * Side effects:
+ *      NsDbFreePrepared() releases driver resources.
+ *
+ *----------------------------------------------------------------------
+ */
+
+bool
+NsDbPrepareSupported(const Ns_DbHandle *handle)
+{
+    const DbDriver *driverPtr;
+
+    NS_NONNULL_ASSERT(handle != NULL);
+
+    driverPtr = NsDbGetDriver(handle);
+    return (driverPtr != NULL
+            && driverPtr->prepareProc != NULL
+            && driverPtr->execPreparedProc != NULL);
+}
+
+void
+NsDbFreePrepared(Ns_DbHandle *handle, void *stmt)
+{
+    const DbDriver *driverPtr;
+
+    NS_NONNULL_ASSERT(handle != NULL);
+    NS_NONNULL_ASSERT(stmt != NULL);
+
+    driverPtr = NsDbGetDriver(handle);
+    if (driverPtr != NULL && driverPtr->freePreparedProc != NULL) {
+        (*driverPtr->freePreparedProc)(handle, stmt);
+    }
+}
+
 
 /*
  *----------------------------------------------------------------------
@@ -646,6 +846,7 @@ Ns_DbCancel(Ns_DbHandle *handle)
 
         status = (*driverPtr->cancelProc)(handle);
     }
+    NsDbAsyncReset(handle);
 
     return status;
 }
@@ -687,6 +888,260 @@ Ns_DbResetHandle (Ns_DbHandle *handle)
 }
 
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * Ns_DbAsyncSupported --
+ *
+ *      Check, whether the driver of the handle supports asynchronous
+ *      queries.
+ *
+ * Results:
+ *      Boolean value.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+bool
+Ns_DbAsyncSupported(Ns_DbHandle *handle)
+{
+    const DbDriver *driverPtr;
+
+    NS_NONNULL_ASSERT(handle != NULL);
+
+    driverPtr = NsDbGetDriver(handle);
+    return (driverPtr != NULL
+            && driverPtr->asyncSubmitProc != NULL
+            && driverPtr->asyncPollProc != NULL
+            && driverPtr->asyncFetchProc != NULL);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Ns_DbAsyncSubmit --
+ *
+ *      Submit an SQL statement for execution without waiting for its
+ *      result. The result is collected with Ns_DbAsyncWait. When the
+ *      driver does not support asynchronous queries, the statement is
+ *      executed immediately and its result is kept for Ns_DbAsyncWait.
+ *
+ * Results:
+ *      NS_OK or NS_ERROR.
+ *
+ * Side effects:
+ *      SQL is sent to database for evaluation.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Ns_ReturnCode
+Ns_DbAsyncSubmit(Ns_DbHandle *handle, const char *sql)
+{
+    const DbDriver *driverPtr;
+    Ns_ReturnCode   status = NS_ERROR;
+
+    NS_NONNULL_ASSERT(handle != NULL);
+    NS_NONNULL_ASSERT(sql != NULL);
+
+    driverPtr = NsDbGetDriver(handle);
+    if (NsDbGetAsyncState(handle, NULL) != NsDbAsyncIdle) {
+        Ns_DbSetException(handle, "NSDB", "handle has already a submitted query");
+
+    } else if (handle->connected && driverPtr != NULL) {
+
+        if (Ns_DbAsyncSupported(handle)) {
+            status = (*driverPtr->asyncSubmitProc)(handle, sql);
+            if (status == NS_OK) {
+                NsDbAsyncStart(handle, sql);
+            }
+        } else if (driverPtr->execProc != NULL) {
+            NsDbAsyncFinish(handle, Ns_DbExec(handle, sql));
+            status = NS_OK;
+        }
+    }
+
+    return status;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * AsyncPoll --
+ *
+ *      Check, whether the result of a pending asynchronous query is
+ *      available, and fetch it in this case.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      The asynchronous state of the handle becomes done, when the
+ *      result was fetched or an error occurred.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+AsyncPoll(Ns_DbHandle *handle, const DbDriver *driverPtr)
+{
+    int status;
+
+    NS_NONNULL_ASSERT(handle != NULL);
+    NS_NONNULL_ASSERT(driverPtr != NULL);
+
+    status = (*driverPtr->asyncPollProc)(handle);
+    if (status == NS_OK) {
+        status = (*driverPtr->asyncFetchProc)(handle);
+        if (status == NS_ROWS) {
+            NsDbSetActive("driver async fetch", handle, NS_TRUE);
+        }
+        NsDbAsyncFinish(handle, status);
+    } else if (status != NS_TIMEOUT) {
+        NsDbAsyncFinish(handle, NS_ERROR);
+    }
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Ns_DbAsyncWait --
+ *
+ *      Wait for the results of the queries submitted via
+ *      Ns_DbAsyncSubmit on the given handles. The driver sockets are
+ *      polled when the driver provides these, otherwise the handles are
+ *      checked periodically.
+ *
+ * Results:
+ *      NS_OK when all results are available, NS_TIMEOUT when the
+ *      timeout expired before. The status of every handle (NS_ROWS,
+ *      NS_DML, NS_ERROR, or NS_TIMEOUT for queries still running) is
+ *      returned in statusPtr.
+ *
+ * Side effects:
+ *      Consumed results reset the asynchronous state of the handles, so
+ *      rows can be fetched as after Ns_DbExec.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Ns_ReturnCode
+Ns_DbAsyncWait(Ns_DbHandle **handles, int nhandles, const Ns_Time *timeoutPtr, int *statusPtr)
+{
+    struct pollfd *pfds;
+    Ns_Time        deadline;
+    Ns_ReturnCode  result = NS_OK;
+    int            i;
+
+    NS_NONNULL_ASSERT(handles != NULL);
+    NS_NONNULL_ASSERT(statusPtr != NULL);
+
+    if (timeoutPtr != NULL) {
+        Ns_GetTime(&deadline);
+        Ns_IncrTime(&deadline, timeoutPtr->sec, timeoutPtr->usec);
+    }
+    pfds = ns_calloc((size_t)nhandles, sizeof(struct pollfd));
+
+    for (i = 0; i < nhandles; i++) {
+        if (NsDbGetAsyncState(handles[i], NULL) == NsDbAsyncIdle) {
+            Ns_DbSetException(handles[i], "NSDB", "no query submitted");
+            statusPtr[i] = NS_ERROR;
+        } else {
+            statusPtr[i] = NS_TIMEOUT;
+        }
+    }
+
+    for (;;) {
+        int  npending = 0, nfds = 0;
+        bool pollable = NS_TRUE;
+        long ms = -1;
+
+        for (i = 0; i < nhandles; i++) {
+            Ns_DbHandle    *handle = handles[i];
+            const DbDriver *driverPtr = NsDbGetDriver(handle);
+            int             status;
+
+            if (statusPtr[i] != NS_TIMEOUT) {
+                /*
+                 * Result was already consumed.
+                 */
+                continue;
+            }
+            if (NsDbGetAsyncState(handle, NULL) == NsDbAsyncPending && driverPtr != NULL) {
+                AsyncPoll(handle, driverPtr);
+            }
+
+            switch (NsDbGetAsyncState(handle, &status)) {
+            case NsDbAsyncIdle:
+                /*
+                 * The query was canceled in the meantime.
+                 */
+                statusPtr[i] = NS_ERROR;
+                break;
+
+            case NsDbAsyncDone:
+                statusPtr[i] = status;
+                NsDbAsyncReset(handle);
+                break;
+
+            case NsDbAsyncPending:
+                npending++;
+                if (driverPtr != NULL && driverPtr->asyncSocketProc != NULL) {
+                    NS_SOCKET sock = (*driverPtr->asyncSocketProc)(handle);
+
+                    if (sock != NS_INVALID_SOCKET) {
+                        pfds[nfds].fd = sock;
+                        pfds[nfds].events = POLLIN;
+                        pfds[nfds].revents = 0;
+                        nfds++;
+                        continue;
+                    }
+                }
+                pollable = NS_FALSE;
+                break;
+            }
+        }
+        if (npending == 0) {
+            break;
+        }
+
+        if (timeoutPtr != NULL) {
+            Ns_Time now, diff;
+
+            Ns_GetTime(&now);
+            if (Ns_DiffTime(&deadline, &now, &diff) <= 0) {
+                result = NS_TIMEOUT;
+                break;
+            }
+            ms = (long)Ns_TimeToMilliseconds(&diff);
+            if (ms == 0) {
+                ms = 1;
+            }
+        }
+        if (!pollable && (ms < 0 || ms > 10)) {
+            /*
+             * Not all drivers provide a socket, check periodically.
+             */
+            ms = 10;
+        }
+        if (nfds > 0) {
+            (void) ns_poll(pfds, (NS_POLL_NFDS_TYPE)nfds, ms);
+        } else {
+            Tcl_Sleep((int)ms);
+        }
+    }
+    ns_free(pfds);
+
+    return result;
+}
+
+
 /*
  *----------------------------------------------------------------------
  *
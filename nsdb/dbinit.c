@@ -23,6 +23,23 @@
  * The following structure defines a database pool.
  */
 
+/*
+ * Handle affinity requires atomic operations for the lock-free paths.
+ * Without these, the "affinity" configuration parameter is ignored.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+# define NSDB_AFFINITY 1
+# define DbLoad(ptr)              __atomic_load_n((ptr), __ATOMIC_SEQ_CST)
+# define DbStore(ptr, val)        __atomic_store_n((ptr), (val), __ATOMIC_SEQ_CST)
+# define DbClaim(ptr)             (__atomic_exchange_n((ptr), 0, __ATOMIC_SEQ_CST) == 1)
+# define DbAtomicIncr(ptr)        __atomic_add_fetch((ptr), 1, __ATOMIC_RELAXED)
+#else
+# define DbLoad(ptr)              (*(ptr))
+# define DbStore(ptr, val)        (*(ptr) = (val))
+# define DbClaim(ptr)             ((*(ptr) == 1) ? ((*(ptr) = 0), 1) : 0)
+# define DbAtomicIncr(ptr)        (++(*(ptr)))
+#endif
+
 struct Handle;
 
 typedef struct Pool {
@@ -40,17 +57,36 @@ typedef struct Pool {
     int              nhandles;
     struct Handle   *firstPtr;
     struct Handle   *lastPtr;
+    struct Handle  **handles;         /* All handles of the pool */
     Ns_Time          maxidle;
     Ns_Time          maxopen;
     Tcl_WideInt      statementCount;
     Tcl_WideInt      getHandleCount;
+    Tcl_WideInt      stmtHits;
+    Tcl_WideInt      stmtMisses;
+    Tcl_WideInt      affinityHits;    /* Handles reused by the same thread */
+    Tcl_WideInt      affinityMisses;  /* Affinity lookups falling back to the pool */
     Ns_Time          waitTime;
     Ns_Time          sqlTime;
     Ns_Time          minDuration;
     int              stale_on_close;
+    int              maxStatements;   /* Max. prepared statements per handle */
+    bool             affinity;        /* Keep released handles per thread */
     bool             fVerboseError;
 }  Pool;
 
+/*
+ * The following structure defines an entry in the prepared statement
+ * cache of a handle. The entries are kept in LRU order.
+ */
+
+typedef struct Statement {
+    void             *stmt;           /* Driver specific prepared statement */
+    Tcl_HashEntry    *hPtr;           /* Entry in stmtTable */
+    struct Statement *prevPtr;        /* More recently used statement */
+    struct Statement *nextPtr;        /* Less recently used statement */
+} Statement;
+
 /*
  * The following structure defines the internal
  * state of a database handle.
@@ -83,6 +119,17 @@ typedef struct Handle {
     bool            stale;
     bool            used;
     bool            active;
+    int             parked;          /* Released with affinity, claimed atomically */
+    NsDbAsyncState  asyncState;      /* State of asynchronous query */
+    int             asyncStatus;     /* Result status of asynchronous query */
+    Ns_Time         asyncStartTime;  /* Submit time of asynchronous query */
+    char           *asyncSql;        /* SQL of pending asynchronous query */
+    Tcl_HashTable   stmtTable;       /* Prepared statements, keyed by SQL */
+    Statement      *stmtFirstPtr;    /* Most recently used statement */
+    Statement      *stmtLastPtr;     /* Least recently used statement */
+    int             nStatements;     /* Number of cached statements */
+    Tcl_WideInt     stmtHits;        /* Statement cache hits */
+    Tcl_WideInt     stmtMisses;      /* Statement cache misses */
 } Handle;
 
 /*
@@ -114,20 +161,34 @@ static int IncrCount(const char *context, const Pool *poolPtr, int incr)
     NS_GNUC_NONNULL(1)  NS_GNUC_NONNULL(2);
 static ServData *GetServer(const char *server)
     NS_GNUC_NONNULL(1);
+static void StmtUnlink(Handle *handlePtr, Statement *stmtPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
 static void TransferHandleStats(Handle *handlePtr)
         NS_GNUC_NONNULL(1);
+static Handle *AffinityGet(Pool *poolPtr)
+    NS_GNUC_NONNULL(1);
+static bool AffinityPut(Handle *handlePtr)
+    NS_GNUC_NONNULL(1);
+static void ParkHandle(Handle *handlePtr, bool locked)
+    NS_GNUC_NONNULL(1);
+static Handle *StealHandle(const Pool *poolPtr)
+    NS_GNUC_NONNULL(1);
+static void UnparkHandles(Pool *poolPtr, bool staleOnly)
+    NS_GNUC_NONNULL(1);
 
 /*
  * Static variables defined in this file
  */
 
 static Ns_TlsCleanup FreeTable;
+static Ns_TlsCleanup FreeAffinityTable;
 static Ns_SchedProc CheckPool;
 static Ns_ArgProc CheckArgProc;
 
 static Tcl_HashTable poolsTable;
 static Tcl_HashTable serversTable;
 static Ns_Tls tls;
+static Ns_Tls affinityTls;
 static Ns_Mutex sessionMutex = NULL;
 
 /*
@@ -289,9 +350,13 @@ Ns_DbPoolPutHandle(Ns_DbHandle *handle)
     poolPtr = handlePtr->poolPtr;
 
     /*
-     * Cleanup the handle.
+     * Cleanup the handle. A pending asynchronous query is canceled.
      */
 
+    if (handlePtr->asyncState == NsDbAsyncPending) {
+        (void) Ns_DbCancel(handle);
+    }
+    NsDbAsyncReset(handle);
     (void) Ns_DbFlush(handle);
     (void) Ns_DbResetHandle(handle);
 
@@ -312,6 +377,14 @@ Ns_DbPoolPutHandle(Ns_DbHandle *handle)
     }
     (void) IncrCount("Ns_DbPoolPutHandle", poolPtr, -1);
 
+    /*
+     * With handle affinity, the handle is kept for this thread without
+     * locking the pool.
+     */
+    if (poolPtr->affinity && AffinityPut(handlePtr)) {
+        return;
+    }
+
     Ns_MutexLock(&poolPtr->lock);
     TransferHandleStats(handlePtr);
     ReturnHandle(handlePtr);
@@ -467,6 +540,35 @@ Ns_DbPoolTimedGetMultipleHandles(Ns_DbHandle **handles, const char *pool,
         return NS_ERROR;
     }
 
+    /*
+     * With handle affinity, try to reuse the handle released last by
+     * this thread without locking the pool.
+     */
+    if (poolPtr->affinity && nwant == 1) {
+        handlePtr = AffinityGet(poolPtr);
+        if (handlePtr != NULL) {
+            (void) DbAtomicIncr(&poolPtr->affinityHits);
+            (void) DbAtomicIncr(&poolPtr->getHandleCount);
+            handlePtr->used = NS_TRUE;
+            if (IsStale(handlePtr, time(NULL))) {
+                NsDbDisconnect((Ns_DbHandle *) handlePtr);
+            }
+            if (!handlePtr->connected && Connect(handlePtr) != NS_OK) {
+                Ns_MutexLock(&poolPtr->lock);
+                ReturnHandle(handlePtr);
+                if (poolPtr->waiting != 0) {
+                    Ns_CondSignal(&poolPtr->getCond);
+                }
+                Ns_MutexUnlock(&poolPtr->lock);
+                (void) IncrCount("Ns_DbPoolTimedGetMultipleHandles fail3", poolPtr, -nwant);
+                return NS_ERROR;
+            }
+            handlesPtrPtr[0] = handlePtr;
+            return NS_OK;
+        }
+        (void) DbAtomicIncr(&poolPtr->affinityMisses);
+    }
+
     /*
      * Wait until this thread can be the exclusive thread acquiring
      * handles and then wait until all requested handles are available,
@@ -487,24 +589,33 @@ Ns_DbPoolTimedGetMultipleHandles(Ns_DbHandle **handles, const char *pool,
         status = Ns_CondTimedWait(&poolPtr->waitCond, &poolPtr->lock, timePtr);
     }
     if (status == NS_OK) {
-        poolPtr->waiting = 1;
+        DbStore(&poolPtr->waiting, 1);
         while (status == NS_OK && ngot < nwant) {
-            while (status == NS_OK && poolPtr->firstPtr == NULL) {
+            /*
+             * When the pool is empty, take over handles kept by other
+             * threads before waiting.
+             */
+            handlePtr = NULL;
+            while (status == NS_OK
+                   && poolPtr->firstPtr == NULL
+                   && (handlePtr = StealHandle(poolPtr)) == NULL) {
                 status = Ns_CondTimedWait(&poolPtr->getCond, &poolPtr->lock,
                                           timePtr);
             }
-            if (poolPtr->firstPtr != NULL) {
+            if (handlePtr == NULL && poolPtr->firstPtr != NULL) {
                 handlePtr = poolPtr->firstPtr;
                 poolPtr->firstPtr = handlePtr->nextPtr;
                 handlePtr->nextPtr = NULL;
                 if (poolPtr->lastPtr == handlePtr) {
                     poolPtr->lastPtr = NULL;
                 }
+            }
+            if (handlePtr != NULL) {
                 handlePtr->used = NS_TRUE;
                 handlesPtrPtr[ngot++] = handlePtr;
             }
         }
-        poolPtr->waiting = 0;
+        DbStore(&poolPtr->waiting, 0);
         Ns_CondSignal(&poolPtr->waitCond);
     }
     Ns_MutexUnlock(&poolPtr->lock);
@@ -546,7 +657,7 @@ Ns_DbPoolTimedGetMultipleHandles(Ns_DbHandle **handles, const char *pool,
     }
 
     Ns_IncrTime(&poolPtr->waitTime, diffTime.sec, diffTime.usec);
-    poolPtr->getHandleCount++;
+    (void) DbAtomicIncr(&poolPtr->getHandleCount);
     Ns_MutexUnlock(&poolPtr->lock);
 
     return status;
@@ -585,6 +696,7 @@ Ns_DbBouncePool(const char *pool)
 
     } else {
         Ns_MutexLock(&poolPtr->lock);
+        UnparkHandles(poolPtr, NS_FALSE);
         poolPtr->stale_on_close++;
         handlePtr = poolPtr->firstPtr;
         while (handlePtr != NULL) {
@@ -627,6 +739,7 @@ NsDbInitPools(void)
     size_t        i;
 
     Ns_TlsAlloc(&tls, FreeTable);
+    Ns_TlsAlloc(&affinityTls, FreeAffinityTable);
 
     /*
      * Provide a name for the lock when it is not yet initialized.
@@ -707,7 +820,9 @@ Ns_DbPoolStats(Tcl_Interp *interp)
             int          unused = 0, connected = 0;
             TCL_SIZE_T   len;
             char         buf[100];
-            Tcl_WideInt  statementCount, getHandleCount;
+            Tcl_WideInt  statementCount, getHandleCount, stmtHits, stmtMisses,
+                         affinityHits, affinityMisses;
+            int          i;
             Ns_Time      sqlTime, waitTime;
 
             /*
@@ -726,8 +841,26 @@ Ns_DbPoolStats(Tcl_Interp *interp)
                 }
                 TransferHandleStats(handlePtr);
             }
+            /*
+             * Handles kept by threads with affinity are unused as well.
+             * Claim them temporarily to transfer their statistics.
+             */
+            for (i = 0; poolPtr->affinity && i < poolPtr->nhandles; i++) {
+                handlePtr = poolPtr->handles[i];
+                if (DbClaim(&handlePtr->parked)) {
+                    if (handlePtr->connected) {
+                        connected ++;
+                    }
+                    TransferHandleStats(handlePtr);
+                    ParkHandle(handlePtr, NS_TRUE);
+                }
+            }
             statementCount = poolPtr->statementCount;
-            getHandleCount = poolPtr->getHandleCount;
+            getHandleCount = DbLoad(&poolPtr->getHandleCount);
+            affinityHits = DbLoad(&poolPtr->affinityHits);
+            affinityMisses = DbLoad(&poolPtr->affinityMisses);
+            stmtHits = poolPtr->stmtHits;
+            stmtMisses = poolPtr->stmtMisses;
             sqlTime = poolPtr->sqlTime;
             waitTime = poolPtr->waitTime;
             Ns_MutexUnlock(&poolPtr->lock);
@@ -781,6 +914,30 @@ Ns_DbPoolStats(Tcl_Interp *interp)
                 len = (TCL_SIZE_T)snprintf(buf, sizeof(buf), NS_TIME_FMT, (int64_t)sqlTime.sec, sqlTime.usec);
                 result = Tcl_ListObjAppendElement(interp, valuesObj, Tcl_NewStringObj(buf, len));
             }
+            if (likely(result == TCL_OK)) {
+                result = Tcl_ListObjAppendElement(interp, valuesObj, Tcl_NewStringObj("preparedhits", 12));
+            }
+            if (likely(result == TCL_OK)) {
+                result = Tcl_ListObjAppendElement(interp, valuesObj, Tcl_NewWideIntObj(stmtHits));
+            }
+            if (likely(result == TCL_OK)) {
+                result = Tcl_ListObjAppendElement(interp, valuesObj, Tcl_NewStringObj("preparedmisses", 14));
+            }
+            if (likely(result == TCL_OK)) {
+                result = Tcl_ListObjAppendElement(interp, valuesObj, Tcl_NewWideIntObj(stmtMisses));
+            }
+            if (likely(result == TCL_OK)) {
+                result = Tcl_ListObjAppendElement(interp, valuesObj, Tcl_NewStringObj("affinityhits", 12));
+            }
+            if (likely(result == TCL_OK)) {
+                result = Tcl_ListObjAppendElement(interp, valuesObj, Tcl_NewWideIntObj(affinityHits));
+            }
+            if (likely(result == TCL_OK)) {
+                result = Tcl_ListObjAppendElement(interp, valuesObj, Tcl_NewStringObj("affinitymisses", 14));
+            }
+            if (likely(result == TCL_OK)) {
+                result = Tcl_ListObjAppendElement(interp, valuesObj, Tcl_NewWideIntObj(affinityMisses));
+            }
             if (likely(result == TCL_OK)) {
                 result = Tcl_ListObjAppendElement(interp, resultObj, Tcl_NewStringObj(pool, TCL_INDEX_NONE));
             }
@@ -903,7 +1060,7 @@ NsDbInitServer(const char *server)
  *      None.
  *
  * Side effects:
- *      None.
+ *      Prepared statements of the handle are freed.
  *
  *----------------------------------------------------------------------
  */
@@ -916,6 +1073,7 @@ NsDbDisconnect(Ns_DbHandle *handle)
     NS_NONNULL_ASSERT(handle != NULL);
 
     handlePtr = (Handle *) handle;
+    NsDbStmtCacheFlush(handle);
     (void)NsDbClose(handle);
 
     handlePtr->connected = NS_FALSE;
@@ -964,6 +1122,287 @@ NsDbSetActive(const char *UNUSED(context), Ns_DbHandle *handle, bool active)
 }
 
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsDbGetAsyncState, NsDbAsyncStart, NsDbAsyncFinish, NsDbAsyncReset --
+ *
+ *      Query or modify the state of an asynchronous query of a
+ *      handle. A query is pending between its submission to the driver
+ *      and the fetch of its result, and done when the result status is
+ *      available but not yet consumed.
+ *
+ * Results:
+ *      NsDbGetAsyncState() returns the state and the result status (in
+ *      statusPtr, when given).
+ *
+ * Side effects:
+ *      NsDbAsyncFinish() logs the SQL statement of a pending query.
+ *
+ *----------------------------------------------------------------------
+ */
+NsDbAsyncState
+NsDbGetAsyncState(const Ns_DbHandle *handle, int *statusPtr)
+{
+    const Handle *handlePtr = (const Handle *) handle;
+
+    NS_NONNULL_ASSERT(handle != NULL);
+
+    if (statusPtr != NULL) {
+        *statusPtr = handlePtr->asyncStatus;
+    }
+    return handlePtr->asyncState;
+}
+
+void
+NsDbAsyncStart(Ns_DbHandle *handle, const char *sql)
+{
+    Handle *handlePtr = (Handle *) handle;
+
+    NS_NONNULL_ASSERT(handle != NULL);
+    NS_NONNULL_ASSERT(sql != NULL);
+
+    ns_free(handlePtr->asyncSql);
+    handlePtr->asyncSql = ns_strdup(sql);
+    Ns_GetTime(&handlePtr->asyncStartTime);
+    handlePtr->asyncState = NsDbAsyncPending;
+}
+
+void
+NsDbAsyncFinish(Ns_DbHandle *handle, int status)
+{
+    Handle *handlePtr = (Handle *) handle;
+
+    NS_NONNULL_ASSERT(handle != NULL);
+
+    if (handlePtr->asyncSql != NULL) {
+        NsDbLogSql(&handlePtr->asyncStartTime, handle, handlePtr->asyncSql);
+        ns_free(handlePtr->asyncSql);
+        handlePtr->asyncSql = NULL;
+    }
+    handlePtr->asyncStatus = status;
+    handlePtr->asyncState = NsDbAsyncDone;
+}
+
+void
+NsDbAsyncReset(Ns_DbHandle *handle)
+{
+    Handle *handlePtr = (Handle *) handle;
+
+    NS_NONNULL_ASSERT(handle != NULL);
+
+    ns_free(handlePtr->asyncSql);
+    handlePtr->asyncSql = NULL;
+    handlePtr->asyncStatus = NS_OK;
+    handlePtr->asyncState = NsDbAsyncIdle;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsDbStmtCacheSize --
+ *
+ *      Return the maximum number of prepared statements cached per
+ *      handle as configured for the pool of the handle.
+ *
+ * Results:
+ *      Maximum number of cached statements, 0 means no caching.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+NsDbStmtCacheSize(const Ns_DbHandle *handle)
+{
+    NS_NONNULL_ASSERT(handle != NULL);
+
+    return ((const Handle *) handle)->poolPtr->maxStatements;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsDbStmtCacheGet --
+ *
+ *      Lookup a prepared statement in the statement cache of the
+ *      handle.
+ *
+ * Results:
+ *      Driver specific statement or NULL when not cached.
+ *
+ * Side effects:
+ *      A found statement becomes the most recently used one. Updates
+ *      hit/miss statistics.
+ *
+ *----------------------------------------------------------------------
+ */
+void *
+NsDbStmtCacheGet(Ns_DbHandle *handle, const char *sql)
+{
+    Handle              *handlePtr = (Handle *) handle;
+    const Tcl_HashEntry *hPtr;
+    void                *result = NULL;
+
+    NS_NONNULL_ASSERT(handle != NULL);
+    NS_NONNULL_ASSERT(sql != NULL);
+
+    hPtr = Tcl_FindHashEntry(&handlePtr->stmtTable, sql);
+    if (hPtr != NULL) {
+        Statement *stmtPtr = Tcl_GetHashValue(hPtr);
+
+        if (stmtPtr != handlePtr->stmtFirstPtr) {
+            StmtUnlink(handlePtr, stmtPtr);
+            stmtPtr->nextPtr = handlePtr->stmtFirstPtr;
+            handlePtr->stmtFirstPtr->prevPtr = stmtPtr;
+            handlePtr->stmtFirstPtr = stmtPtr;
+        }
+        handlePtr->stmtHits++;
+        result = stmtPtr->stmt;
+    } else {
+        handlePtr->stmtMisses++;
+    }
+    return result;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsDbStmtCacheAdd --
+ *
+ *      Add a prepared statement to the statement cache of the handle.
+ *      When the cache is full, the least recently used statement is
+ *      evicted.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Might free a prepared statement via the driver.
+ *
+ *----------------------------------------------------------------------
+ */
+void
+NsDbStmtCacheAdd(Ns_DbHandle *handle, const char *sql, void *stmt)
+{
+    Handle    *handlePtr = (Handle *) handle;
+    Statement *stmtPtr;
+    int        isNew;
+
+    NS_NONNULL_ASSERT(handle != NULL);
+    NS_NONNULL_ASSERT(sql != NULL);
+    NS_NONNULL_ASSERT(stmt != NULL);
+
+    while (handlePtr->nStatements >= handlePtr->poolPtr->maxStatements
+           && handlePtr->stmtLastPtr != NULL) {
+        stmtPtr = handlePtr->stmtLastPtr;
+        StmtUnlink(handlePtr, stmtPtr);
+        Tcl_DeleteHashEntry(stmtPtr->hPtr);
+        NsDbFreePrepared(handle, stmtPtr->stmt);
+        ns_free(stmtPtr);
+        handlePtr->nStatements--;
+    }
+
+    stmtPtr = ns_calloc(1u, sizeof(Statement));
+    stmtPtr->stmt = stmt;
+    stmtPtr->hPtr = Tcl_CreateHashEntry(&handlePtr->stmtTable, sql, &isNew);
+    if (!isNew) {
+        /*
+         * The caller has looked up the statement before, so this should
+         * not happen. Replace the old entry.
+         */
+        Statement *oldPtr = Tcl_GetHashValue(stmtPtr->hPtr);
+
+        StmtUnlink(handlePtr, oldPtr);
+        NsDbFreePrepared(handle, oldPtr->stmt);
+        ns_free(oldPtr);
+        handlePtr->nStatements--;
+    }
+    Tcl_SetHashValue(stmtPtr->hPtr, stmtPtr);
+
+    stmtPtr->nextPtr = handlePtr->stmtFirstPtr;
+    if (handlePtr->stmtFirstPtr != NULL) {
+        handlePtr->stmtFirstPtr->prevPtr = stmtPtr;
+    } else {
+        handlePtr->stmtLastPtr = stmtPtr;
+    }
+    handlePtr->stmtFirstPtr = stmtPtr;
+    handlePtr->nStatements++;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NsDbStmtCacheFlush --
+ *
+ *      Free all prepared statements of the handle. This is necessary
+ *      whenever the underlying database connection is closed.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Frees prepared statements via the driver.
+ *
+ *----------------------------------------------------------------------
+ */
+void
+NsDbStmtCacheFlush(Ns_DbHandle *handle)
+{
+    Handle    *handlePtr = (Handle *) handle;
+    Statement *stmtPtr;
+
+    NS_NONNULL_ASSERT(handle != NULL);
+
+    while ((stmtPtr = handlePtr->stmtFirstPtr) != NULL) {
+        StmtUnlink(handlePtr, stmtPtr);
+        Tcl_DeleteHashEntry(stmtPtr->hPtr);
+        NsDbFreePrepared(handle, stmtPtr->stmt);
+        ns_free(stmtPtr);
+    }
+    handlePtr->nStatements = 0;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * StmtUnlink --
+ *
+ *      Remove a statement from the LRU list of the handle.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+StmtUnlink(Handle *handlePtr, Statement *stmtPtr)
+{
+    NS_NONNULL_ASSERT(handlePtr != NULL);
+    NS_NONNULL_ASSERT(stmtPtr != NULL);
+
+    if (stmtPtr->prevPtr != NULL) {
+        stmtPtr->prevPtr->nextPtr = stmtPtr->nextPtr;
+    } else {
+        handlePtr->stmtFirstPtr = stmtPtr->nextPtr;
+    }
+    if (stmtPtr->nextPtr != NULL) {
+        stmtPtr->nextPtr->prevPtr = stmtPtr->prevPtr;
+    } else {
+        handlePtr->stmtLastPtr = stmtPtr->prevPtr;
+    }
+    stmtPtr->prevPtr = stmtPtr->nextPtr = NULL;
+}
+
 
 /*
  *----------------------------------------------------------------------
@@ -1227,7 +1666,8 @@ CheckArgProc(Tcl_DString *dsPtr, const void *arg)
  * TransferHandleStats --
  *
  *      Transfer the cached statistics values kept per handle into the
- *      pool statistics (sqlTime and statementCount). The purpose of per
+ *      pool statistics (sqlTime, statementCount and the statement cache
+ *      hits and misses). The purpose of per
  *      handle caching is to avoid frequent locking on the pool mutex.
  *
  *      It is assumed that the pool data is mutex protected by the caller.
@@ -1236,7 +1676,8 @@ CheckArgProc(Tcl_DString *dsPtr, const void *arg)
  *      None.
  *
  * Side effects:
- *      Updates poolPtr->statementCount and poolPtr->sqlTime.
+ *      Updates poolPtr->statementCount, poolPtr->sqlTime and the
+ *      statement cache statistics of the pool.
  *
  *----------------------------------------------------------------------
  */
@@ -1254,6 +1695,223 @@ TransferHandleStats(Handle *handlePtr)
         handlePtr->poolPtr->statementCount += handlePtr->statementCount;
         handlePtr->statementCount = 0;
     }
+    if (handlePtr->stmtHits > 0 || handlePtr->stmtMisses > 0) {
+        handlePtr->poolPtr->stmtHits += handlePtr->stmtHits;
+        handlePtr->poolPtr->stmtMisses += handlePtr->stmtMisses;
+        handlePtr->stmtHits = 0;
+        handlePtr->stmtMisses = 0;
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * AffinityGet --
+ *
+ *      Claim the handle kept by the current thread for the pool when
+ *      it was released last time, unless it was taken over by another
+ *      thread in the meantime.
+ *
+ * Results:
+ *      Handle or NULL.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+static Handle *
+AffinityGet(Pool *poolPtr)
+{
+    Tcl_HashTable *tablePtr;
+    Handle        *result = NULL;
+
+    NS_NONNULL_ASSERT(poolPtr != NULL);
+
+    tablePtr = Ns_TlsGet(&affinityTls);
+    if (tablePtr != NULL) {
+        Tcl_HashEntry *hPtr = Tcl_FindHashEntry(tablePtr, (const char *) poolPtr);
+
+        if (hPtr != NULL) {
+            Handle *handlePtr = Tcl_GetHashValue(hPtr);
+
+            Tcl_DeleteHashEntry(hPtr);
+            if (DbClaim(&handlePtr->parked)) {
+                result = handlePtr;
+            }
+        }
+    }
+    return result;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * AffinityPut --
+ *
+ *      Keep a released handle for the current thread. This is not done
+ *      when other threads are waiting for handles or when the thread
+ *      keeps already a handle of this pool.
+ *
+ * Results:
+ *      NS_TRUE when the handle is kept, NS_FALSE when it has to be
+ *      returned to the pool.
+ *
+ * Side effects:
+ *      Handle is parked.
+ *
+ *----------------------------------------------------------------------
+ */
+static bool
+AffinityPut(Handle *handlePtr)
+{
+    Pool          *poolPtr;
+    Tcl_HashTable *tablePtr;
+    Tcl_HashEntry *hPtr;
+    int            isNew;
+
+    NS_NONNULL_ASSERT(handlePtr != NULL);
+
+    poolPtr = handlePtr->poolPtr;
+    if (DbLoad(&poolPtr->waiting) != 0) {
+        return NS_FALSE;
+    }
+
+    tablePtr = Ns_TlsGet(&affinityTls);
+    if (tablePtr == NULL) {
+        tablePtr = ns_malloc(sizeof(Tcl_HashTable));
+        Tcl_InitHashTable(tablePtr, TCL_ONE_WORD_KEYS);
+        Ns_TlsSet(&affinityTls, tablePtr);
+    }
+    hPtr = Tcl_CreateHashEntry(tablePtr, (const char *) poolPtr, &isNew);
+    if (isNew == 0) {
+        const Handle *otherPtr = Tcl_GetHashValue(hPtr);
+
+        if (DbLoad(&otherPtr->parked) == 1) {
+            return NS_FALSE;
+        }
+    }
+    Tcl_SetHashValue(hPtr, handlePtr);
+    ParkHandle(handlePtr, NS_FALSE);
+
+    return NS_TRUE;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ParkHandle --
+ *
+ *      Mark a handle as parked, such it can be claimed again by its
+ *      owner or taken over by other threads. Since parking does not
+ *      lock the pool, a thread waiting for handles might have missed
+ *      the parked handle, so it is woken up.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Might signal a waiting thread.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+ParkHandle(Handle *handlePtr, bool locked)
+{
+    Pool *poolPtr;
+
+    NS_NONNULL_ASSERT(handlePtr != NULL);
+
+    poolPtr = handlePtr->poolPtr;
+    DbStore(&handlePtr->parked, 1);
+    if (DbLoad(&poolPtr->waiting) != 0) {
+        if (!locked) {
+            Ns_MutexLock(&poolPtr->lock);
+        }
+        Ns_CondSignal(&poolPtr->getCond);
+        if (!locked) {
+            Ns_MutexUnlock(&poolPtr->lock);
+        }
+    }
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * StealHandle --
+ *
+ *      Claim a handle parked by some thread.
+ *
+ * Results:
+ *      Handle or NULL.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+static Handle *
+StealHandle(const Pool *poolPtr)
+{
+    Handle *result = NULL;
+    int     i;
+
+    NS_NONNULL_ASSERT(poolPtr != NULL);
+
+    for (i = 0; poolPtr->affinity && i < poolPtr->nhandles; i++) {
+        Handle *handlePtr = poolPtr->handles[i];
+
+        if (DbLoad(&handlePtr->parked) == 1 && DbClaim(&handlePtr->parked)) {
+            result = handlePtr;
+            break;
+        }
+    }
+    return result;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * UnparkHandles --
+ *
+ *      Return parked handles to the pool. When staleOnly is set, only
+ *      stale handles are returned.
+ *
+ *      It is assumed that the pool data is mutex protected by the caller.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Handles are returned to the pool.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+UnparkHandles(Pool *poolPtr, bool staleOnly)
+{
+    time_t now;
+    int    i;
+
+    NS_NONNULL_ASSERT(poolPtr != NULL);
+
+    time(&now);
+    for (i = 0; poolPtr->affinity && i < poolPtr->nhandles; i++) {
+        Handle *handlePtr = poolPtr->handles[i];
+
+        if (DbClaim(&handlePtr->parked)) {
+            if (!staleOnly || IsStale(handlePtr, now)) {
+                TransferHandleStats(handlePtr);
+                ReturnHandle(handlePtr);
+            } else {
+                ParkHandle(handlePtr, NS_TRUE);
+            }
+        }
+    }
 }
 
 /*
@@ -1278,9 +1936,11 @@ CheckPool(void *arg, int UNUSED(id))
     Handle       *handlePtr;
 
     /*
-     * Grab the entire list of handles from the pool.
+     * Grab the entire list of handles from the pool, including stale
+     * handles kept by threads with affinity.
      */
     Ns_MutexLock(&poolPtr->lock);
+    UnparkHandles(poolPtr, NS_TRUE);
     handlePtr = poolPtr->firstPtr;
     poolPtr->firstPtr = poolPtr->lastPtr = NULL;
     Ns_MutexUnlock(&poolPtr->lock);
@@ -1391,6 +2051,14 @@ CreatePool(const char *pool, const char *path, const char *driver)
         poolPtr->stale_on_close = 0;
         poolPtr->fVerboseError = Ns_ConfigBool(path, "logsqlerrors", NS_FALSE);
         poolPtr->nhandles = Ns_ConfigIntRange(path, "connections", 2, 0, INT_MAX);
+        poolPtr->maxStatements = Ns_ConfigIntRange(path, "maxpreparedstatements", 0, 0, INT_MAX);
+        poolPtr->affinity = Ns_ConfigBool(path, "affinity", NS_FALSE);
+#ifndef NSDB_AFFINITY
+        if (poolPtr->affinity) {
+            Ns_Log(Warning, "dbinit: handle affinity is not supported on this platform");
+            poolPtr->affinity = NS_FALSE;
+        }
+#endif
 
         Ns_ConfigTimeUnitRange(path, "maxidle",
                                "5m", 0, 0, INT_MAX, 0, &poolPtr->maxidle);
@@ -1417,9 +2085,11 @@ CreatePool(const char *pool, const char *path, const char *driver)
          * Allocate the handles in the pool
          */
         poolPtr->firstPtr = poolPtr->lastPtr = NULL;
+        poolPtr->handles = ns_calloc((size_t)poolPtr->nhandles + 1u, sizeof(Handle *));
         for (i = 0; i < poolPtr->nhandles; ++i) {
             Handle *handlePtr = ns_malloc(sizeof(Handle));
 
+            poolPtr->handles[i] = handlePtr;
             Ns_DStringInit(&handlePtr->dsExceptionMsg);
             handlePtr->poolPtr = poolPtr;
             handlePtr->connection = NULL;
@@ -1436,6 +2106,14 @@ CreatePool(const char *pool, const char *path, const char *driver)
             handlePtr->statementCount = 0;
             handlePtr->sqlTime.sec = 0;
             handlePtr->sqlTime.usec = 0;
+            handlePtr->asyncState = NsDbAsyncIdle;
+            handlePtr->asyncStatus = NS_OK;
+            handlePtr->asyncSql = NULL;
+            Tcl_InitHashTable(&handlePtr->stmtTable, TCL_STRING_KEYS);
+            handlePtr->stmtFirstPtr = handlePtr->stmtLastPtr = NULL;
+            handlePtr->nStatements = 0;
+            handlePtr->stmtHits = handlePtr->stmtMisses = 0;
+            handlePtr->parked = 0;
 
             /*
              * The following elements of the Handle structure could be
@@ -1615,6 +2293,52 @@ FreeTable(void *arg)
     ns_free(tablePtr);
 }
 
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FreeAffinityTable --
+ *
+ *      Return the handles parked by the exiting thread to their pools
+ *      and free the per-thread affinity table.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Handles are returned to the pool.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+FreeAffinityTable(void *arg)
+{
+    Tcl_HashTable       *tablePtr = arg;
+    const Tcl_HashEntry *hPtr;
+    Tcl_HashSearch       search;
+
+    for (hPtr = Tcl_FirstHashEntry(tablePtr, &search);
+         hPtr != NULL;
+         hPtr = Tcl_NextHashEntry(&search)) {
+        Handle *handlePtr = Tcl_GetHashValue(hPtr);
+
+        if (DbClaim(&handlePtr->parked)) {
+            Pool *poolPtr = handlePtr->poolPtr;
+
+            Ns_MutexLock(&poolPtr->lock);
+            TransferHandleStats(handlePtr);
+            ReturnHandle(handlePtr);
+            if (poolPtr->waiting != 0) {
+                Ns_CondSignal(&poolPtr->getCond);
+            }
+            Ns_MutexUnlock(&poolPtr->lock);
+        }
+    }
+    Tcl_DeleteHashTable(tablePtr);
+    ns_free(tablePtr);
+}
+
 
 /*
  *----------------------------------------------------------------------
@@ -40,6 +40,9 @@ Ns_LogSeverity Ns_LogSqlDebug;
 static int DbFail(Tcl_Interp *interp, Ns_DbHandle *handle, const char *cmd)
     NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(3);
 
+static int DbGetRows(Ns_DbHandle *handle, int maxRows, Tcl_Obj **listObjPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(3);
+
 static void EnterDbHandle(InterpData *idataPtr, Tcl_Interp *interp, Ns_DbHandle *handle, Tcl_Obj *listObj)
     NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(3) NS_GNUC_NONNULL(4);
 
@@ -310,9 +313,11 @@ DbObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc, Tcl_Obj *co
         DRIVER,
         EXCEPTION,
         EXEC,
+        EXECPREPARED,
         FLUSH,
         GETHANDLE,
         GETROW,
+        GETROWS,
         INTERPRETSQLFILE,
         LOGMINDURATION,
         PASSWORD,
@@ -330,8 +335,10 @@ DbObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc, Tcl_Obj *co
         SP_SETPARAM,
         SP_START,
         STATS,
+        SUBMIT,
         USER,
-        VERBOSE
+        VERBOSE,
+        WAIT
     };
 
     static const char *const subcmd[] = {
@@ -351,9 +358,11 @@ DbObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc, Tcl_Obj *co
         "driver",
         "exception",
         "exec",
+        "execprepared",
         "flush",
         "gethandle",
         "getrow",
+        "getrows",
         "interpretsqlfile",
         "logminduration",
         "password",
@@ -371,8 +380,10 @@ DbObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc, Tcl_Obj *co
         "sp_setparam",
         "sp_start",
         "stats",
+        "submit",
         "user",
         "verbose",
+        "wait",
         NULL
     };
 
@@ -749,6 +760,7 @@ DbObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc, Tcl_Obj *co
     case ONE_ROW:           NS_FALL_THROUGH; /* fall through */
     case ZERO_OR_ONE_ROW:   NS_FALL_THROUGH; /* fall through */
     case EXEC:              NS_FALL_THROUGH; /* fall through */
+    case SUBMIT:            NS_FALL_THROUGH; /* fall through */
     case SELECT:            NS_FALL_THROUGH; /* fall through */
     case SP_START:          NS_FALL_THROUGH; /* fall through */
     case INTERPRETSQLFILE:
@@ -838,6 +850,12 @@ DbObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc, Tcl_Obj *co
                 }
                 break;
 
+            case SUBMIT:
+                if (Ns_DbAsyncSubmit(handlePtr, value) != NS_OK) {
+                    result = DbFail(interp, handlePtr, Tcl_GetString(objv[1]));
+                }
+                break;
+
             case SELECT:
                 rowPtr = Ns_DbSelect(handlePtr, value);
                 if (rowPtr == NULL) {
@@ -889,6 +907,147 @@ DbObjCmd(ClientData clientData, Tcl_Interp *interp, TCL_OBJC_T objc, Tcl_Obj *co
         }
         break;
 
+    case GETROWS:
+        {
+            char       *idString;
+            int         maxRows = 0;
+            Ns_ObjvValueRange maxRange = {1, INT_MAX};
+            Ns_ObjvSpec opts[] = {
+                {"-max", Ns_ObjvInt,   &maxRows, &maxRange},
+                {"--",   Ns_ObjvBreak, NULL,     NULL},
+                {NULL, NULL, NULL, NULL}
+            };
+            Ns_ObjvSpec args[] = {
+                {"dbId", Ns_ObjvString, &idString, NULL},
+                {NULL, NULL, NULL, NULL}
+            };
+
+            if (Ns_ParseObjv(opts, args, interp, 2, objc, objv) != NS_OK
+                || DbGetHandle(idataPtr, interp, idString, &handlePtr, NULL) != TCL_OK) {
+                result = TCL_ERROR;
+            } else {
+                Tcl_Obj *listObj;
+
+                assert(handlePtr != NULL);
+                Ns_DStringFree(&handlePtr->dsExceptionMsg);
+                handlePtr->cExceptionCode[0] = '\0';
+
+                result = DbGetRows(handlePtr, maxRows, &listObj);
+                if (result == TCL_OK) {
+                    Tcl_SetObjResult(interp, listObj);
+                } else {
+                    result = DbFail(interp, handlePtr, Tcl_GetString(objv[1]));
+                }
+            }
+        }
+        break;
+
+    case EXECPREPARED:
+        {
+            char       *idString, *sql;
+            Tcl_Obj    *valuesObj = NULL, **valueObjs = NULL;
+            TCL_SIZE_T  nvalues = 0;
+            Ns_ObjvSpec args[] = {
+                {"dbId",    Ns_ObjvString, &idString,  NULL},
+                {"sql",     Ns_ObjvString, &sql,       NULL},
+                {"?values", Ns_ObjvObj,    &valuesObj, NULL},
+                {NULL, NULL, NULL, NULL}
+            };
+
+            if (Ns_ParseObjv(NULL, args, interp, 2, objc, objv) != NS_OK
+                || (valuesObj != NULL
+                    && Tcl_ListObjGetElements(interp, valuesObj, &nvalues, &valueObjs) != TCL_OK)
+                || DbGetHandle(idataPtr, interp, idString, &handlePtr, NULL) != TCL_OK) {
+                result = TCL_ERROR;
+
+            } else {
+                const char **values = NULL;
+                Tcl_DString  ds;
+                TCL_SIZE_T   i;
+
+                assert(handlePtr != NULL);
+                Ns_DStringFree(&handlePtr->dsExceptionMsg);
+                handlePtr->cExceptionCode[0] = '\0';
+
+                if (nvalues > 0) {
+                    values = ns_calloc((size_t)nvalues, sizeof(char *));
+                    for (i = 0; i < nvalues; i++) {
+                        values[i] = Tcl_GetString(valueObjs[i]);
+                    }
+                }
+                (void)Tcl_UtfToExternalDString(NULL, sql, TCL_INDEX_NONE, &ds);
+
+                switch (Ns_DbExecPrepared(handlePtr, ds.string, (int)nvalues, values)) {
+                case NS_DML:
+                    Tcl_SetObjResult(interp, Tcl_NewStringObj("NS_DML", 6));
+                    break;
+                case NS_ROWS:
+                    Tcl_SetObjResult(interp, Tcl_NewStringObj("NS_ROWS", 7));
+                    break;
+                default:
+                    result = DbFail(interp, handlePtr, Tcl_GetString(objv[1]));
+                }
+                Tcl_DStringFree(&ds);
+                ns_free((void *)values);
+            }
+        }
+        break;
+
+    case WAIT:
+        {
+            Ns_Time    *timeoutPtr = NULL;
+            Tcl_Obj    *handlesObj = NULL, **handleObjs;
+            TCL_SIZE_T  nhandles = 0;
+            Ns_ObjvSpec opts[] = {
+                {"-timeout", Ns_ObjvTime,  &timeoutPtr, NULL},
+                {"--",       Ns_ObjvBreak,  NULL,       NULL},
+                {NULL, NULL, NULL, NULL}
+            };
+            Ns_ObjvSpec args[] = {
+                {"dbIds", Ns_ObjvObj, &handlesObj, NULL},
+                {NULL, NULL, NULL, NULL}
+            };
+
+            if (Ns_ParseObjv(opts, args, interp, 2, objc, objv) != NS_OK
+                || Tcl_ListObjGetElements(interp, handlesObj, &nhandles, &handleObjs) != TCL_OK) {
+                result = TCL_ERROR;
+
+            } else if (nhandles > 0) {
+                Ns_DbHandle **handles = ns_calloc((size_t)nhandles, sizeof(Ns_DbHandle *));
+                int          *statuses = ns_calloc((size_t)nhandles, sizeof(int));
+                TCL_SIZE_T    i;
+
+                for (i = 0; i < nhandles; i++) {
+                    if (DbGetHandle(idataPtr, interp, Tcl_GetString(handleObjs[i]),
+                                    &handles[i], NULL) != TCL_OK) {
+                        result = TCL_ERROR;
+                        break;
+                    }
+                }
+                if (result == TCL_OK) {
+                    Tcl_Obj *listObj = Tcl_NewListObj(0, NULL);
+
+                    (void) Ns_DbAsyncWait(handles, (int)nhandles, timeoutPtr, statuses);
+                    for (i = 0; i < nhandles; i++) {
+                        const char *statusString;
+
+                        switch (statuses[i]) {
+                        case NS_ROWS:    statusString = "NS_ROWS"; break;
+                        case NS_DML:     statusString = "NS_DML"; break;
+                        case NS_TIMEOUT: statusString = "NS_TIMEOUT"; break;
+                        default:         statusString = "NS_ERROR"; break;
+                        }
+                        Tcl_ListObjAppendElement(interp, listObj,
+                                                 Tcl_NewStringObj(statusString, TCL_INDEX_NONE));
+                    }
+                    Tcl_SetObjResult(interp, listObj);
+                }
+                ns_free(statuses);
+                ns_free(handles);
+            }
+        }
+        break;
+
     case VERBOSE:
         {
             int         verbose = 0;
@@ -1617,6 +1776,74 @@ EnterDbHandle(InterpData *idataPtr, Tcl_Interp *interp, Ns_DbHandle *handle, Tcl
 }
 
 
+/*
+ *----------------------------------------------------------------------
+ * DbGetRows --
+ *
+ *      Fetch up to maxRows rows (all rows, when maxRows is 0) of the
+ *      current result set into a list of rows, where every row is a
+ *      list of column values. The values are taken directly from the
+ *      row set of the handle, which is refilled by the driver for every
+ *      row, without creating intermediate Ns_Sets.
+ *
+ * Results:
+ *      TCL_OK or TCL_ERROR. On success, the list is returned in
+ *      listObjPtr.
+ *
+ * Side effects:
+ *      Rows are consumed from the result set.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+DbGetRows(Ns_DbHandle *handle, int maxRows, Tcl_Obj **listObjPtr)
+{
+    Ns_Set  *row;
+    Tcl_Obj *listObj;
+    int      nrows = 0, result = TCL_OK;
+
+    NS_NONNULL_ASSERT(handle != NULL);
+    NS_NONNULL_ASSERT(listObjPtr != NULL);
+
+    row = handle->row;
+    listObj = Tcl_NewListObj(0, NULL);
+
+    while (maxRows == 0 || nrows < maxRows) {
+        int status = Ns_DbGetRow(handle, row);
+
+        if (status == (int)NS_OK) {
+            Tcl_Obj *rowObj = Tcl_NewListObj(0, NULL);
+            size_t   i;
+
+            for (i = 0u; i < Ns_SetSize(row); i++) {
+                const char *value = Ns_SetValue(row, i);
+
+                (void) Tcl_ListObjAppendElement(NULL, rowObj,
+                                                value != NULL
+                                                ? Tcl_NewStringObj(value, TCL_INDEX_NONE)
+                                                : Tcl_NewObj());
+            }
+            (void) Tcl_ListObjAppendElement(NULL, listObj, rowObj);
+            nrows++;
+
+        } else {
+            if (status != (int)NS_END_DATA) {
+                result = TCL_ERROR;
+            }
+            break;
+        }
+    }
+
+    if (result == TCL_OK) {
+        *listObjPtr = listObj;
+    } else {
+        Tcl_DecrRefCount(listObj);
+    }
+    return result;
+}
+
+
 /*
  *----------------------------------------------------------------------
  * DbFail --
@@ -60,7 +60,21 @@ typedef enum {
     DbFn_SpReturnCode,
     DbFn_SpGetParams,
     DbFn_GetRowCount,
-    DbFn_End
+    DbFn_End,
+    /*
+     * Optional procs for asynchronous queries. These are added after
+     * DbFn_End to keep the ids of the existing procs stable.
+     */
+    DbFn_AsyncSubmit,
+    DbFn_AsyncSocket,
+    DbFn_AsyncPoll,
+    DbFn_AsyncFetch,
+    /*
+     * Optional procs for prepared statements.
+     */
+    DbFn_Prepare,
+    DbFn_ExecPrepared,
+    DbFn_FreePrepared
 } Ns_DbProcId;
 
 /*
@@ -139,6 +153,15 @@ NS_EXTERN int           Ns_DbSpExec(Ns_DbHandle *handle)                 NS_GNUC
 NS_EXTERN Ns_ReturnCode Ns_DbSpReturnCode(Ns_DbHandle *handle, const char *returnCode, int bufsize)
     NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
 NS_EXTERN Ns_Set       *Ns_DbSpGetParams(Ns_DbHandle *handle)            NS_GNUC_NONNULL(1);
+NS_EXTERN int           Ns_DbExecPrepared(Ns_DbHandle *handle, const char *sql,
+                                          int nparams, const char *const* values)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+NS_EXTERN bool          Ns_DbAsyncSupported(Ns_DbHandle *handle)         NS_GNUC_NONNULL(1);
+NS_EXTERN Ns_ReturnCode Ns_DbAsyncSubmit(Ns_DbHandle *handle, const char *sql)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+NS_EXTERN Ns_ReturnCode Ns_DbAsyncWait(Ns_DbHandle **handles, int nhandles,
+                                       const Ns_Time *timeoutPtr, int *statusPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(4);
 
 /*
  * dbinit.c:
@@ -21,6 +21,30 @@ NS_EXPORT const int Ns_ModuleVersion = 1;
 
 NS_EXPORT NsDb_DriverInitProc Ns_DbDriverInit;
 
+/*
+ * The following structure keeps the state of a connection, which is
+ * used for asynchronous queries and for the rows of the current
+ * result set.
+ */
+
+typedef struct Connection {
+    bool    pending;     /* Query was submitted, result not fetched */
+    int     status;      /* Result status of the submitted query */
+    Ns_Time ready;       /* Time when the result is available */
+    int     nrows;       /* Rows of the result set, -1 for a single "ok" row */
+    int     nextRow;     /* Index of the next row to be fetched */
+} Connection;
+
+/*
+ * The following structure keeps a prepared statement. Bind parameters
+ * are denoted by "?" following the query.
+ */
+
+typedef struct Statement {
+    char   *sql;         /* Query without parameter placeholders */
+    int     nparams;     /* Number of expected bind parameters */
+} Statement;
+
 /*
  * Local functions defined in this file.
  */
@@ -33,6 +57,16 @@ static int            Exec(const Ns_DbHandle *handle, char *sql) NS_GNUC_NONNULL
 static int            GetRow(Ns_DbHandle *handle, Ns_Set *row) NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
 static Ns_ReturnCode  Flush(Ns_DbHandle *handle) NS_GNUC_NONNULL(1);
 static Ns_ReturnCode  ResetHandle(Ns_DbHandle *handle) NS_GNUC_NONNULL(1);
+static Ns_ReturnCode  Cancel(Ns_DbHandle *handle) NS_GNUC_NONNULL(1);
+static Ns_ReturnCode  AsyncSubmit(Ns_DbHandle *handle, const char *sql) NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+static int            AsyncPoll(Ns_DbHandle *handle) NS_GNUC_NONNULL(1);
+static int            AsyncFetch(Ns_DbHandle *handle) NS_GNUC_NONNULL(1);
+static void          *Prepare(Ns_DbHandle *handle, const char *sql) NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+static int            ExecPrepared(Ns_DbHandle *handle, void *stmt, int nparams, const char *const* values)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+static void           FreePrepared(Ns_DbHandle *handle, void *stmt) NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+static int            ParseQuery(const char *sql, Ns_Time *delayPtr, int *nrowsPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(3);
 
 /*
  * Local variables defined in this file.
@@ -47,8 +81,14 @@ static const Ns_DbProc procs[] = {
     {DbFn_Exec,         (ns_funcptr_t)Exec},
     {DbFn_GetRow,       (ns_funcptr_t)GetRow},
     {DbFn_Flush,        (ns_funcptr_t)Flush},
-    {DbFn_Cancel,       (ns_funcptr_t)Flush},
+    {DbFn_Cancel,       (ns_funcptr_t)Cancel},
     {DbFn_ResetHandle,  (ns_funcptr_t)ResetHandle},
+    {DbFn_AsyncSubmit,  (ns_funcptr_t)AsyncSubmit},
+    {DbFn_AsyncPoll,    (ns_funcptr_t)AsyncPoll},
+    {DbFn_AsyncFetch,   (ns_funcptr_t)AsyncFetch},
+    {DbFn_Prepare,      (ns_funcptr_t)Prepare},
+    {DbFn_ExecPrepared, (ns_funcptr_t)ExecPrepared},
+    {DbFn_FreePrepared, (ns_funcptr_t)FreePrepared},
     {(Ns_DbProcId)0, NULL}
 };
 
@@ -118,8 +158,9 @@ DbType(Ns_DbHandle *UNUSED(handle))
  */
 
 static Ns_ReturnCode
-OpenDb(Ns_DbHandle *UNUSED(handle))
+OpenDb(Ns_DbHandle *handle)
 {
+    handle->connection = ns_calloc(1u, sizeof(Connection));
     return NS_OK;
 }
 
@@ -141,8 +182,10 @@ OpenDb(Ns_DbHandle *UNUSED(handle))
  */
 
 static Ns_ReturnCode
-CloseDb(Ns_DbHandle *UNUSED(handle))
+CloseDb(Ns_DbHandle *handle)
 {
+    ns_free(handle->connection);
+    handle->connection = NULL;
     return NS_OK;
 }
 
@@ -176,30 +219,56 @@ BindRow(Ns_DbHandle *handle)
 /*
  *----------------------------------------------------------------------
  *
- * Exec --
+ * ParseQuery --
  *
- *      Execute an SQL statement.
+ *      Parse a test query. Valid queries are "rows", "rows N" and
+ *      "dml", optionally preceded by "delay MS", which delays the
+ *      result by the given number of milliseconds. The query "rows"
+ *      returns a single row with the value "ok", "rows N" returns N
+ *      rows with the values 1 to N.
  *
  * Results:
  *      NS_ROWS, NS_DML or NS_ERROR.
  *
  * Side effects:
- *      None.
+ *      The delay is returned in delayPtr, the number of rows in
+ *      nrowsPtr.
  *
  *----------------------------------------------------------------------
  */
 
 static int
-Exec(const Ns_DbHandle *handle, char *sql)
+ParseQuery(const char *sql, Ns_Time *delayPtr, int *nrowsPtr)
 {
     int result;
 
-    if (handle->verbose) {
-        Ns_Log(Notice, "nsdbtest(%s): Querying '%s'", handle->driver, sql);
+    delayPtr->sec = 0;
+    delayPtr->usec = 0;
+    *nrowsPtr = 0;
+    if (strncasecmp(sql, "delay ", 6u) == 0) {
+        char *end;
+        long  ms = strtol(sql + 6, &end, 10);
+
+        if (ms >= 0 && *end == ' ') {
+            delayPtr->sec = ms / 1000;
+            delayPtr->usec = (ms % 1000) * 1000;
+            sql = end + 1;
+        }
     }
 
     if (STRIEQ(sql, "rows")) {
+        *nrowsPtr = -1;
         result = (int)NS_ROWS;
+    } else if (strncasecmp(sql, "rows ", 5u) == 0) {
+        char *end;
+        long  n = strtol(sql + 5, &end, 10);
+
+        if (n >= 0 && n <= INT_MAX && *end == '\0') {
+            *nrowsPtr = (int)n;
+            result = (int)NS_ROWS;
+        } else {
+            result = (int)NS_ERROR;
+        }
     } else if (STRIEQ(sql, "dml")) {
         result = (int)NS_DML;
     } else {
@@ -208,6 +277,266 @@ Exec(const Ns_DbHandle *handle, char *sql)
     return result;
 }
 
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Exec --
+ *
+ *      Execute an SQL statement.
+ *
+ * Results:
+ *      NS_ROWS, NS_DML or NS_ERROR.
+ *
+ * Side effects:
+ *      Might sleep for the delay specified in the query.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+Exec(const Ns_DbHandle *handle, char *sql)
+{
+    Connection *connPtr = handle->connection;
+    int         result;
+    Ns_Time     delay;
+
+    if (handle->verbose) {
+        Ns_Log(Notice, "nsdbtest(%s): Querying '%s'", handle->driver, sql);
+    }
+
+    result = ParseQuery(sql, &delay, &connPtr->nrows);
+    connPtr->nextRow = 0;
+    if (delay.sec > 0 || delay.usec > 0) {
+        Tcl_Sleep((int)Ns_TimeToMilliseconds(&delay));
+    }
+    return result;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Prepare --
+ *
+ *      Prepare an SQL statement. The query might be followed by "?"
+ *      placeholders for bind parameters, e.g. "dml ? ?".
+ *
+ * Results:
+ *      Prepared statement or NULL on error.
+ *
+ * Side effects:
+ *      Sets the exception of the handle on invalid queries.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void *
+Prepare(Ns_DbHandle *handle, const char *sql)
+{
+    Statement  *stmtPtr = NULL;
+    const char *p;
+    char       *query;
+    int         nparams = 0, nrows;
+    Ns_Time     delay;
+
+    if (handle->verbose) {
+        Ns_Log(Notice, "nsdbtest(%s): Preparing '%s'", handle->driver, sql);
+    }
+
+    query = ns_strdup(sql);
+    p = strchr(sql, INTCHAR('?'));
+    if (p != NULL) {
+        /*
+         * Strip the placeholders and the blanks before the first one.
+         */
+        size_t len = (size_t)(p - sql);
+
+        query[len] = '\0';
+
+        while (len > 0u && query[len - 1u] == ' ') {
+            query[--len] = '\0';
+        }
+        for (; *p != '\0'; p++) {
+            if (*p == '?') {
+                nparams++;
+            }
+        }
+    }
+
+    if (ParseQuery(query, &delay, &nrows) == (int)NS_ERROR) {
+        Ns_DbSetException(handle, "NSDB", "invalid query");
+        ns_free(query);
+    } else {
+        stmtPtr = ns_malloc(sizeof(Statement));
+        stmtPtr->sql = query;
+        stmtPtr->nparams = nparams;
+    }
+    return stmtPtr;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ExecPrepared --
+ *
+ *      Execute a prepared statement with the given bind parameters.
+ *
+ * Results:
+ *      NS_ROWS, NS_DML or NS_ERROR.
+ *
+ * Side effects:
+ *      Might sleep for the delay specified in the query.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+ExecPrepared(Ns_DbHandle *handle, void *stmt, int nparams, const char *const* UNUSED(values))
+{
+    const Statement *stmtPtr = stmt;
+    int              result;
+
+    if (nparams != stmtPtr->nparams) {
+        Ns_DString ds;
+
+        Ns_DStringInit(&ds);
+        Ns_DStringPrintf(&ds, "expected %d bind parameters, got %d",
+                         stmtPtr->nparams, nparams);
+        Ns_DbSetException(handle, "NSDB", ds.string);
+        Ns_DStringFree(&ds);
+        result = (int)NS_ERROR;
+    } else {
+        result = Exec(handle, stmtPtr->sql);
+    }
+    return result;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FreePrepared --
+ *
+ *      Free a prepared statement.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+FreePrepared(Ns_DbHandle *UNUSED(handle), void *stmt)
+{
+    Statement *stmtPtr = stmt;
+
+    ns_free(stmtPtr->sql);
+    ns_free(stmtPtr);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * AsyncSubmit --
+ *
+ *      Submit an SQL statement without waiting for its result.
+ *
+ * Results:
+ *      NS_OK or NS_ERROR.
+ *
+ * Side effects:
+ *      The result becomes available after the delay specified in the
+ *      query.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Ns_ReturnCode
+AsyncSubmit(Ns_DbHandle *handle, const char *sql)
+{
+    Connection *connPtr = handle->connection;
+    Ns_Time     delay;
+
+    if (handle->verbose) {
+        Ns_Log(Notice, "nsdbtest(%s): Submitting '%s'", handle->driver, sql);
+    }
+
+    connPtr->status = ParseQuery(sql, &delay, &connPtr->nrows);
+    connPtr->nextRow = 0;
+    Ns_GetTime(&connPtr->ready);
+    Ns_IncrTime(&connPtr->ready, delay.sec, delay.usec);
+    connPtr->pending = NS_TRUE;
+
+    return NS_OK;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * AsyncPoll --
+ *
+ *      Check, whether the result of the submitted query is available.
+ *
+ * Results:
+ *      NS_OK, NS_TIMEOUT (when the result is not available yet) or
+ *      NS_ERROR.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+AsyncPoll(Ns_DbHandle *handle)
+{
+    const Connection *connPtr = handle->connection;
+    int               result;
+
+    if (!connPtr->pending) {
+        result = (int)NS_ERROR;
+    } else {
+        Ns_Time now;
+
+        Ns_GetTime(&now);
+        result = (Ns_DiffTime(&connPtr->ready, &now, NULL) > 0) ? (int)NS_TIMEOUT : (int)NS_OK;
+    }
+    return result;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * AsyncFetch --
+ *
+ *      Fetch the result of the submitted query.
+ *
+ * Results:
+ *      NS_ROWS, NS_DML or NS_ERROR.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+AsyncFetch(Ns_DbHandle *handle)
+{
+    Connection *connPtr = handle->connection;
+
+    connPtr->pending = NS_FALSE;
+    return connPtr->status;
+}
+
 
 /*
  *----------------------------------------------------------------------
@@ -227,13 +556,23 @@ Exec(const Ns_DbHandle *handle, char *sql)
  */
 
 static int
-GetRow(Ns_DbHandle *UNUSED(handle), Ns_Set *row)
+GetRow(Ns_DbHandle *handle, Ns_Set *row)
 {
-    int result;
+    Connection *connPtr = handle->connection;
+    int         result;
 
-    if (Ns_SetValue(row, 0) == NULL) {
+    if (connPtr->nrows < 0 && connPtr->nextRow == 0) {
         Ns_SetPutValueSz(row, 0u, "ok", 2);
+        connPtr->nextRow++;
         result = (int)NS_OK;
+
+    } else if (connPtr->nextRow < connPtr->nrows) {
+        char buffer[TCL_INTEGER_SPACE];
+        int  len = snprintf(buffer, sizeof(buffer), "%d", ++connPtr->nextRow);
+
+        Ns_SetPutValueSz(row, 0u, buffer, (TCL_SIZE_T)len);
+        result = (int)NS_OK;
+
     } else {
         result = (int)NS_END_DATA;
     }
@@ -259,8 +598,13 @@ GetRow(Ns_DbHandle *UNUSED(handle), Ns_Set *row)
  */
 
 static Ns_ReturnCode
-Flush(Ns_DbHandle *UNUSED(handle))
+Flush(Ns_DbHandle *handle)
 {
+    Connection *connPtr = handle->connection;
+
+    connPtr->nextRow = 0;
+    connPtr->nrows = 0;
+
     return NS_OK;
 }
 
@@ -287,6 +631,34 @@ ResetHandle(Ns_DbHandle *UNUSED(handle))
     return NS_OK;
 }
 
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Cancel --
+ *
+ *      Cancel the current (asynchronous) query.
+ *
+ * Results:
+ *      NS_OK.
+ *
+ * Side effects:
+ *      A submitted query is discarded.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Ns_ReturnCode
+Cancel(Ns_DbHandle *handle)
+{
+    Connection *connPtr = handle->connection;
+
+    if (connPtr != NULL) {
+        connPtr->pending = NS_FALSE;
+    }
+    return NS_OK;
+}
+
 /*
  * Local Variables:
  * mode: c
@@ -90,6 +90,8 @@ ssize_t readv(int fildes, const struct iovec *iov, int iovcnt)
 #else
 # include <grp.h>
 # include <poll.h>
+# include <sys/mman.h>
+# define NS_PROXY_SHM 1
 #endif
 
 /*
@@ -105,7 +107,20 @@ typedef unsigned int   uint32;
 typedef unsigned short uint16;
 
 #define MAJOR_VERSION 1
-#define MINOR_VERSION 1
+#define MINOR_VERSION 2
+
+/*
+ * Flags of requests and responses. Payloads of at least SHM_THRESHOLD
+ * bytes are transferred via the shared memory segment of the worker,
+ * when one is configured and the payload fits.
+ */
+#define REQ_SHM        0x01u  /* Script is in the shared memory segment */
+#define RES_BINARY     0x01u  /* Result is a byte array */
+#define RES_SHM        0x02u  /* Result is in the shared memory segment */
+#define RES_SHM_ATTACHED 0x04u /* Worker has mapped the shared memory segment */
+
+#define SHM_ARG_PREFIX "-shm="
+#define SHM_THRESHOLD  (32 * 1024)
 
 /*
  * The following structure defines a running proxy worker process.
@@ -121,6 +136,10 @@ typedef struct Worker {
     Ns_Time       expire;
     struct Pool  *poolPtr;
     struct Worker *nextPtr;
+    char         *shmPath;   /* Shared memory segment for bulk payloads */
+    char         *shmAddr;
+    size_t        shmSize;
+    bool          shmAttached; /* Both sides have mapped the segment */
 } Worker;
 
 /*
@@ -133,6 +152,7 @@ typedef struct Req {
     uint32 len;         /* Length of the message */
     uint16 major;       /* Major version number */
     uint16 minor;       /* Minor version number */
+    uint32 flags;       /* REQ_* flags */
 } Req;
 
 typedef struct Res {
@@ -140,6 +160,7 @@ typedef struct Res {
     uint32 ecodeLength;
     uint32 einfoLength;
     uint32 resultLength;
+    uint32 flags;       /* RES_* flags */
 } Res;
 
 /*
@@ -162,6 +183,7 @@ typedef struct ProxyConf {
     Ns_Time        tidle;    /* Timeout for worker to be idle */
     Ns_Time        logminduration;  /* Log commands taking longer than this duration */
     int            maxruns;  /* Max number of proxy uses */
+    size_t         shmsize;  /* Size of the shared memory segment per worker */
 } ProxyConf;
 
 typedef struct Proxy {
@@ -285,6 +307,8 @@ static Ns_LogSeverity Ns_LogNsProxyDebug = 0;
 static TCL_OBJCMDPROC_T ClearObjCmd;
 static TCL_OBJCMDPROC_T ConfigureObjCmd;
 static TCL_OBJCMDPROC_T GetObjCmd;
+static TCL_OBJCMDPROC_T MapObjCmd;
+static Tcl_Obj *MapResult(Tcl_Interp *interp, int code) NS_GNUC_NONNULL(1);
 static TCL_OBJCMDPROC_T PidsObjCmd;
 static TCL_OBJCMDPROC_T ProxyObjCmd;
 static TCL_OBJCMDPROC_T RunProxyObjCmd;
@@ -345,10 +369,22 @@ static bool   RecvBuf(const Worker *workerPtr, const Ns_Time *timePtr, Tcl_DStri
     NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(3);
 static bool   WaitFd(int fd, short events, long ms);
 
-static int    Import(Tcl_Interp *interp, const Tcl_DString *dsPtr, int *resultPtr)
-    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(3);
-static void   Export(Tcl_Interp *interp, int code, Tcl_DString *dsPtr)
-    NS_GNUC_NONNULL(3);
+static int    Import(Tcl_Interp *interp, Worker *workerPtr, const Tcl_DString *dsPtr, int *resultPtr)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(3) NS_GNUC_NONNULL(4);
+static void   Export(Tcl_Interp *interp, int code, const Worker *workerPtr, Tcl_DString *dsPtr)
+    NS_GNUC_NONNULL(3) NS_GNUC_NONNULL(4);
+static bool   IsByteArray(const Tcl_Obj *objPtr)
+    NS_GNUC_NONNULL(1);
+static bool   ShmUsable(const Worker *workerPtr, size_t length)
+    NS_GNUC_NONNULL(1);
+#ifdef NS_PROXY_SHM
+static char  *ShmCreate(size_t size, char **addrPtr)
+    NS_GNUC_NONNULL(2);
+static void   ShmAttach(Worker *workerPtr, const char *path)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2);
+static void   ShmFree(Worker *workerPtr)
+    NS_GNUC_NONNULL(1);
+#endif
 
 static void   UpdateIov(struct iovec *iov, size_t n)
     NS_GNUC_NONNULL(1);
@@ -379,6 +415,8 @@ static Worker    *firstClosePtr = NULL; /* Processes which are being closed. */
 
 static Tcl_DString defexec;             /* Stores full path of the proxy executable */
 
+static const Tcl_ObjType *byteArrayTypePtr = NULL;
+
 
 /*
  *----------------------------------------------------------------------
@@ -413,6 +451,7 @@ Nsproxy_LibInit(void)
         Ns_BinPath(&defexec, NSPROXY_HELPER, (char *)0L);
 
         Tcl_InitHashTable(&pools, TCL_STRING_KEYS);
+        byteArrayTypePtr = Tcl_GetObjType("bytearray");
         Ns_RegisterAtShutdown(Shutdown, NULL);
         Ns_RegisterProcInfo((ns_funcptr_t)Shutdown, "nsproxy:shutdown", NULL);
 
@@ -477,7 +516,7 @@ Ns_ProxyMain(int argc, char *const*argv, Tcl_AppInitProc *init)
     Worker        proc;
     int          result, max;
     Tcl_DString  in, out;
-    const char  *script, *dots, *uarg = NULL, *user;
+    const char  *script, *dots, *uarg = NULL, *user, *shmPath = NULL;
     char        *group = NULL, *active;
     uint16       major, minor;
     size_t       activeSize;
@@ -490,9 +529,19 @@ Ns_ProxyMain(int argc, char *const*argv, Tcl_AppInitProc *init)
 
     Nsproxy_LibInit();
 
+    /*
+     * The name of the shared memory segment is passed as last argument.
+     * It is identified by its prefix, since the (blank) command argument
+     * might be dropped by wrapper scripts.
+     */
+    if (argc > 3 && strncmp(argv[argc-1], SHM_ARG_PREFIX, sizeof(SHM_ARG_PREFIX) - 1u) == 0) {
+        shmPath = argv[argc-1] + sizeof(SHM_ARG_PREFIX) - 1u;
+        argc--;
+    }
     if (argc > 4 || argc < 3) {
         char *pgm = strrchr(argv[0], INTCHAR('/'));
-        Ns_Fatal("usage: %s pool id ?command?", (pgm != NULL) ? (pgm+1) : argv[0]);
+        Ns_Fatal("usage: %s pool id ?command? ?%spath?", (pgm != NULL) ? (pgm+1) : argv[0],
+                 SHM_ARG_PREFIX);
     }
     if (argc < 4) {
         active = NULL;
@@ -549,6 +598,15 @@ Ns_ProxyMain(int argc, char *const*argv, Tcl_AppInitProc *init)
 
     (void)Ns_CloseOnExec(proc.wfd);
 
+#ifdef NS_PROXY_SHM
+    /*
+     * Attach to the shared memory segment, if one was passed.
+     */
+    if (shmPath != NULL) {
+        ShmAttach(&proc, shmPath);
+    }
+#endif
+
     /*
      * Create the interp, initialize with user init proc, if any.
      */
@@ -614,9 +672,24 @@ Ns_ProxyMain(int argc, char *const*argv, Tcl_AppInitProc *init)
         }
         len = ntohl(reqPtr->len);
         if (len == 0) {
-            Export(NULL, TCL_OK, &out);
+            Export(NULL, TCL_OK, &proc, &out);
+        } else if ((ntohl(reqPtr->flags) & REQ_SHM) != 0u && !ShmUsable(&proc, (size_t)len)) {
+            /*
+             * The server sends such requests only after the mapping was
+             * acknowledged, so this should not happen. Report an error
+             * instead of terminating the worker.
+             */
+            Ns_Log(Warning, "nsproxy: invalid shared memory request");
+            Tcl_ResetResult(interp);
+            Ns_TclPrintfResult(interp, "nsproxy: shared memory segment not available");
+            Tcl_SetErrorCode(interp, "NSPROXY", "SHM", (char *)0L);
+            Export(interp, TCL_ERROR, &proc, &out);
         } else if (len > 0) {
-            script = Tcl_DStringValue(&in) + sizeof(Req);
+            if ((ntohl(reqPtr->flags) & REQ_SHM) != 0u) {
+                script = proc.shmAddr;
+            } else {
+                script = Tcl_DStringValue(&in) + sizeof(Req);
+            }
             if (active != NULL) {
                 int n = (int)len;
 
@@ -629,7 +702,7 @@ Ns_ProxyMain(int argc, char *const*argv, Tcl_AppInitProc *init)
                 snprintf(active, activeSize, "{%.*s%s}", n, script, dots);
             }
             result = Tcl_EvalEx(interp, script, (TCL_SIZE_T)len, 0);
-            Export(interp, result, &out);
+            Export(interp, result, &proc, &out);
             if (active != NULL) {
                 assert(max > 0);
                 memset(active, ' ', (size_t)max);
@@ -903,8 +976,9 @@ static Worker *
 ExecWorker(Tcl_Interp *interp, const Proxy *proxyPtr)
 {
     Pool  *poolPtr;
-    char  *argv[5];
+    char  *argv[6];
     char   active[100];
+    char  *shmPath = NULL, *shmAddr = NULL;
     Worker *workerPtr;
     int    rpipe[2], wpipe[2];
     size_t len;
@@ -926,6 +1000,7 @@ ExecWorker(Tcl_Interp *interp, const Proxy *proxyPtr)
     argv[2] = proxyPtr->id;
     argv[3] = active;
     argv[4] = NULL;
+    argv[5] = NULL;
 
     if (ns_pipe(rpipe) != 0) {
         Ns_TclPrintfResult(interp, "pipe failed: %s", Tcl_PosixError(interp));
@@ -938,6 +1013,21 @@ ExecWorker(Tcl_Interp *interp, const Proxy *proxyPtr)
         return NULL;
     }
 
+#ifdef NS_PROXY_SHM
+    /*
+     * The shared memory segment is created and mapped here and passed by
+     * name to the worker, which maps the same segment.
+     */
+    if (proxyPtr->conf.shmsize > 0u) {
+        shmPath = ShmCreate(proxyPtr->conf.shmsize, &shmAddr);
+        if (shmPath != NULL) {
+            argv[4] = ns_malloc(strlen(shmPath) + sizeof(SHM_ARG_PREFIX));
+            memcpy(argv[4], SHM_ARG_PREFIX, sizeof(SHM_ARG_PREFIX) - 1u);
+            memcpy(argv[4] + sizeof(SHM_ARG_PREFIX) - 1u, shmPath, strlen(shmPath) + 1u);
+        }
+    }
+#endif
+
     pid = Ns_ExecArgv(poolPtr->exec, NULL, rpipe[0], wpipe[1], argv, poolPtr->env);
 
     ns_close(rpipe[0]);
@@ -945,20 +1035,30 @@ ExecWorker(Tcl_Interp *interp, const Proxy *proxyPtr)
 
     ns_free(argv[0]);
     ns_free(argv[1]);
+    ns_free(argv[4]);
+
+    workerPtr = ns_calloc(1u, sizeof(Worker));
+    workerPtr->poolPtr = proxyPtr->poolPtr;
+    workerPtr->pid = pid;
+    workerPtr->rfd = wpipe[0];
+    workerPtr->wfd = rpipe[1];
+    if (shmPath != NULL) {
+        workerPtr->shmPath = shmPath;
+        workerPtr->shmAddr = shmAddr;
+        workerPtr->shmSize = proxyPtr->conf.shmsize;
+    }
 
     if (pid == NS_INVALID_PID) {
         Ns_TclPrintfResult(interp, "exec failed: %s", Tcl_PosixError(interp));
         ns_close(wpipe[0]);
         ns_close(rpipe[1]);
+#ifdef NS_PROXY_SHM
+        ShmFree(workerPtr);
+#endif
+        ns_free(workerPtr);
         return NULL;
     }
 
-    workerPtr = ns_calloc(1u, sizeof(Worker));
-    workerPtr->poolPtr = proxyPtr->poolPtr;
-    workerPtr->pid = pid;
-    workerPtr->rfd = wpipe[0];
-    workerPtr->wfd = rpipe[1];
-
     SetExpire(workerPtr, &proxyPtr->conf.tidle);
 
     Ns_Log(Ns_LogNsProxyDebug, "nsproxy: worker process %ld started", (long) workerPtr->pid);
@@ -1129,13 +1229,24 @@ Send(Tcl_Interp *interp, Proxy *proxyPtr, const char *script)
         }
         if (err == ENone) {
             TCL_SIZE_T len = script == NULL ? 0 : (TCL_SIZE_T)strlen(script);
+            Worker    *workerPtr = proxyPtr->workerPtr;
 
             req.len   = htonl((uint32_t)len);
             req.major = htons(MAJOR_VERSION);
             req.minor = htons(MINOR_VERSION);
+            req.flags = 0u;
             Tcl_DStringSetLength(&proxyPtr->in, 0);
-            Tcl_DStringAppend(&proxyPtr->in, (char *) &req, sizeof(req));
-            Tcl_DStringAppend(&proxyPtr->in, script, len);
+            if (ShmUsable(workerPtr, (size_t)len)) {
+                /*
+                 * Large script, pass it via shared memory.
+                 */
+                memcpy(workerPtr->shmAddr, script, (size_t)len);
+                req.flags = htonl(REQ_SHM);
+                Tcl_DStringAppend(&proxyPtr->in, (char *) &req, sizeof(req));
+            } else {
+                Tcl_DStringAppend(&proxyPtr->in, (char *) &req, sizeof(req));
+                Tcl_DStringAppend(&proxyPtr->in, script, len);
+            }
             proxyPtr->state = Busy;
 
             /*
@@ -1267,7 +1378,7 @@ Recv(Tcl_Interp *interp, Proxy *proxyPtr, int *resultPtr)
         if (RecvBuf(proxyPtr->workerPtr, &proxyPtr->conf.trecv,
                     &proxyPtr->out) == NS_FALSE) {
             err = ERecv;
-        } else if (Import(interp, &proxyPtr->out, resultPtr) != TCL_OK) {
+        } else if (Import(interp, proxyPtr->workerPtr, &proxyPtr->out, resultPtr) != TCL_OK) {
             err = EImport;
         } else {
             proxyPtr->state = Idle;
@@ -1559,7 +1670,9 @@ UpdateIov(struct iovec *iov, size_t n)
  *
  * Export --
  *
- *      Export result of Tcl, include error, to given dstring.
+ *      Export result of Tcl, include error, to given dstring. Byte
+ *      array results are exported as such, large results are placed in
+ *      the shared memory segment of the worker, when possible.
  *
  * Results:
  *      None.
@@ -1571,12 +1684,13 @@ UpdateIov(struct iovec *iov, size_t n)
  */
 
 static void
-Export(Tcl_Interp *interp, int code, Tcl_DString *dsPtr)
+Export(Tcl_Interp *interp, int code, const Worker *workerPtr, Tcl_DString *dsPtr)
 {
     Res          hdr;
     const char  *einfo = NULL, *ecode = NULL, *result = NULL;
-    unsigned int ecodeLength = 0u, einfoLength = 0u, resultLength = 0u;
+    unsigned int ecodeLength = 0u, einfoLength = 0u, resultLength = 0u, flags = 0u;
 
+    NS_NONNULL_ASSERT(workerPtr != NULL);
     NS_NONNULL_ASSERT(dsPtr != NULL);
 
     if (interp != NULL) {
@@ -1589,13 +1703,35 @@ Export(Tcl_Interp *interp, int code, Tcl_DString *dsPtr)
         }
         ecodeLength = (ecode != NULL) ? ((unsigned int)strlen(ecode) + 1) : 0u;
         einfoLength = (einfo != NULL) ? ((unsigned int)strlen(einfo) + 1) : 0u;
-        result = Tcl_GetStringResult(interp);
-        resultLength = (unsigned int)strlen(result);
+        {
+            Tcl_Obj   *resultObj = Tcl_GetObjResult(interp);
+            TCL_SIZE_T length;
+
+            if (IsByteArray(resultObj)) {
+                result = (const char *)Tcl_GetByteArrayFromObj(resultObj, &length);
+                flags |= RES_BINARY;
+            } else {
+                result = Tcl_GetStringFromObj(resultObj, &length);
+            }
+            resultLength = (unsigned int)length;
+        }
+        if (ShmUsable(workerPtr, (size_t)resultLength)) {
+            memcpy(workerPtr->shmAddr, result, (size_t)resultLength);
+            flags |= RES_SHM;
+        }
+    }
+    if (workerPtr->shmAttached) {
+        /*
+         * Acknowledge the mapping of the segment. The server uses shared
+         * memory for requests only after it has seen this flag.
+         */
+        flags |= RES_SHM_ATTACHED;
     }
     hdr.code = htonl((unsigned int)code);
     hdr.ecodeLength = htonl(ecodeLength);
     hdr.einfoLength = htonl(einfoLength);
     hdr.resultLength = htonl(resultLength);
+    hdr.flags = htonl(flags);
     Tcl_DStringAppend(dsPtr, (char *) &hdr, sizeof(hdr));
     if (ecodeLength > 0) {
         Tcl_DStringAppend(dsPtr, ecode, (TCL_SIZE_T)ecodeLength);
@@ -1603,7 +1739,7 @@ Export(Tcl_Interp *interp, int code, Tcl_DString *dsPtr)
     if (einfoLength > 0) {
         Tcl_DStringAppend(dsPtr, einfo, (TCL_SIZE_T)einfoLength);
     }
-    if (resultLength > 0) {
+    if (resultLength > 0 && (flags & RES_SHM) == 0u) {
         Tcl_DStringAppend(dsPtr, result, (TCL_SIZE_T)resultLength);
     }
 }
@@ -1626,11 +1762,12 @@ Export(Tcl_Interp *interp, int code, Tcl_DString *dsPtr)
  */
 
 static int
-Import(Tcl_Interp *interp, const Tcl_DString *dsPtr, int *resultPtr)
+Import(Tcl_Interp *interp, Worker *workerPtr, const Tcl_DString *dsPtr, int *resultPtr)
 {
     int result = TCL_OK;
 
     NS_NONNULL_ASSERT(interp != NULL);
+    NS_NONNULL_ASSERT(workerPtr != NULL);
     NS_NONNULL_ASSERT(dsPtr != NULL);
     NS_NONNULL_ASSERT(resultPtr != NULL);
 
@@ -1641,12 +1778,17 @@ Import(Tcl_Interp *interp, const Tcl_DString *dsPtr, int *resultPtr)
         Res         res, *resPtr = &res;
         const char *str    = dsPtr->string + sizeof(Res);
         size_t      resultLength, ecodeLength, einfoLength;
+        unsigned int flags;
 
         memcpy(&res, dsPtr->string, sizeof(Res));
 
         ecodeLength = ntohl(resPtr->ecodeLength);
         einfoLength = ntohl(resPtr->einfoLength);
         resultLength = ntohl(resPtr->resultLength);
+        flags = ntohl(resPtr->flags);
+        if ((flags & RES_SHM_ATTACHED) != 0u && workerPtr->shmAddr != NULL) {
+            workerPtr->shmAttached = NS_TRUE;
+        }
         if (ecodeLength > 0) {
             Tcl_Obj *err = Tcl_NewStringObj(str, TCL_INDEX_NONE);
 
@@ -1657,8 +1799,23 @@ Import(Tcl_Interp *interp, const Tcl_DString *dsPtr, int *resultPtr)
             Tcl_AddErrorInfo(interp, str);
             str += einfoLength;
         }
+        if ((flags & RES_SHM) != 0u) {
+            if (ShmUsable(workerPtr, resultLength)) {
+                str = workerPtr->shmAddr;
+            } else {
+                resultLength = 0u;
+                result = TCL_ERROR;
+            }
+        }
         if (resultLength > 0) {
-            Tcl_SetObjResult(interp, Tcl_NewStringObj(str, TCL_INDEX_NONE));
+            Tcl_Obj *resultObj;
+
+            if ((flags & RES_BINARY) != 0u) {
+                resultObj = Tcl_NewByteArrayObj((const unsigned char *)str, (TCL_SIZE_T)resultLength);
+            } else {
+                resultObj = Tcl_NewStringObj(str, (TCL_SIZE_T)resultLength);
+            }
+            Tcl_SetObjResult(interp, resultObj);
         }
         *resultPtr = (int)ntohl(resPtr->code);
     }
@@ -1667,6 +1824,209 @@ Import(Tcl_Interp *interp, const Tcl_DString *dsPtr, int *resultPtr)
 
 
 
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * IsByteArray --
+ *
+ *      Check, whether the Tcl_Obj is a pure byte array (a byte array
+ *      without string representation).
+ *
+ * Results:
+ *      Boolean value.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static bool
+IsByteArray(const Tcl_Obj *objPtr)
+{
+    NS_NONNULL_ASSERT(objPtr != NULL);
+
+    return (byteArrayTypePtr != NULL
+            && objPtr->typePtr == byteArrayTypePtr
+            && objPtr->bytes == NULL);
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ShmUsable --
+ *
+ *      Check, whether a payload of the given length should be
+ *      transferred via the shared memory segment of the worker. On the
+ *      server side, the segment is only used after the worker has
+ *      acknowledged its mapping.
+ *
+ * Results:
+ *      Boolean value.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static bool
+ShmUsable(const Worker *workerPtr, size_t length)
+{
+    NS_NONNULL_ASSERT(workerPtr != NULL);
+
+    return (workerPtr->shmAttached
+            && length >= SHM_THRESHOLD
+            && length <= workerPtr->shmSize);
+}
+
+#ifdef NS_PROXY_SHM
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ShmCreate --
+ *
+ *      Create and map a shared memory segment of the given size. The
+ *      segment is a file in /dev/shm (when available) or in the
+ *      temporary directory.
+ *
+ * Results:
+ *      Path of the segment (to be freed by the caller) or NULL on
+ *      error.
+ *
+ * Side effects:
+ *      Creates a file, the address of the mapping is returned in
+ *      addrPtr.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static char *
+ShmCreate(size_t size, char **addrPtr)
+{
+    Tcl_DString ds;
+    char       *path = NULL;
+    int         fd;
+
+    NS_NONNULL_ASSERT(addrPtr != NULL);
+
+    Tcl_DStringInit(&ds);
+    Tcl_DStringAppend(&ds, (access("/dev/shm", W_OK) == 0) ? "/dev/shm" : P_tmpdir, TCL_INDEX_NONE);
+    Tcl_DStringAppend(&ds, "/nsproxy-XXXXXX", TCL_INDEX_NONE);
+
+    fd = mkstemp(ds.string);
+    if (fd == NS_INVALID_FD) {
+        Ns_Log(Error, "nsproxy: cannot create shared memory segment %s: %s",
+               ds.string, strerror(errno));
+    } else {
+        void *addr = MAP_FAILED;
+
+        if (ftruncate(fd, (off_t)size) == 0) {
+            addr = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        if (addr == MAP_FAILED) {
+            Ns_Log(Error, "nsproxy: cannot map shared memory segment %s: %s",
+                   ds.string, strerror(errno));
+            (void) unlink(ds.string);
+        } else {
+            *addrPtr = addr;
+            path = ns_strdup(ds.string);
+        }
+        (void) ns_close(fd);
+    }
+    Tcl_DStringFree(&ds);
+
+    return path;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ShmAttach --
+ *
+ *      Map the shared memory segment created by the server in the
+ *      worker process. The segment is unlinked afterwards, such it
+ *      disappears with the last mapping.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      Updates the worker structure, when successful.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ShmAttach(Worker *workerPtr, const char *path)
+{
+    struct stat st;
+    int         fd;
+
+    NS_NONNULL_ASSERT(workerPtr != NULL);
+    NS_NONNULL_ASSERT(path != NULL);
+
+    fd = ns_open(path, O_RDWR | O_CLOEXEC, 0);
+    if (fd == NS_INVALID_FD) {
+        Ns_Log(Warning, "nsproxy: cannot open shared memory segment %s: %s",
+               path, strerror(errno));
+    } else {
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void *addr = mmap(NULL, (size_t)st.st_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+
+            if (addr != MAP_FAILED) {
+                workerPtr->shmAddr = addr;
+                workerPtr->shmSize = (size_t)st.st_size;
+                workerPtr->shmAttached = NS_TRUE;
+            } else {
+                Ns_Log(Warning, "nsproxy: cannot map shared memory segment %s: %s",
+                       path, strerror(errno));
+            }
+        }
+        (void) ns_close(fd);
+        (void) unlink(path);
+    }
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ShmFree --
+ *
+ *      Unmap and remove the shared memory segment of the worker.
+ *
+ * Results:
+ *      None.
+ *
+ * Side effects:
+ *      None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ShmFree(Worker *workerPtr)
+{
+    NS_NONNULL_ASSERT(workerPtr != NULL);
+
+    if (workerPtr->shmAddr != NULL) {
+        (void) munmap(workerPtr->shmAddr, workerPtr->shmSize);
+        workerPtr->shmAddr = NULL;
+        workerPtr->shmAttached = NS_FALSE;
+    }
+    if (workerPtr->shmPath != NULL) {
+        (void) unlink(workerPtr->shmPath);
+        ns_free(workerPtr->shmPath);
+        workerPtr->shmPath = NULL;
+    }
+}
+#endif
+
 /*
  *----------------------------------------------------------------------
  *
@@ -2014,13 +2374,13 @@ ProxyObjCmd(ClientData data, Tcl_Interp *interp, TCL_OBJC_T objc, Tcl_Obj *const
 
     static const char *opts[] = {
         "active", "cleanup", "clear", "configure", "eval",
-        "free", "get", "handles", "pids", "ping", "pools", "put",
+        "free", "get", "handles", "map", "pids", "ping", "pools", "put",
         "recv", "release", "send", "stats", "stop", "wait", "workers",
         NULL
     };
     enum {
         PActiveIdx, PCleanupIdx, PClearIdx, PConfigureIdx, PEvalIdx,
-        PFreeIdx, PGetIdx, PHandlesIdx, PPidsIdx, PPingIdx, PPoolsIdx, PPutIdx,
+        PFreeIdx, PGetIdx, PHandlesIdx, PMapIdx, PPidsIdx, PPingIdx, PPoolsIdx, PPutIdx,
         PRecvIdx, PReleaseIdx, PSendIdx, PStatsIdx, PStopIdx, PWaitIdx, PWorkersIdx,
     };
 
@@ -2071,6 +2431,10 @@ ProxyObjCmd(ClientData data, Tcl_Interp *interp, TCL_OBJC_T objc, Tcl_Obj *const
         result = GetObjCmd(data, interp, objc, objv);
         break;
 
+    case PMapIdx:
+        result = MapObjCmd(data, interp, objc, objv);
+        break;
+
     case PSendIdx:
         if (objc != 4) {
             Tcl_WrongNumArgs(interp, 2, objv, "handle script");
@@ -2274,13 +2638,13 @@ ConfigureObjCmd(ClientData data, Tcl_Interp *interp, TCL_OBJC_T objc, Tcl_Obj *c
         "-init", "-reinit", "-maxslaves", "-exec", "-env",
         "-gettimeout", "-evaltimeout", "-sendtimeout", "-recvtimeout",
         "-waittimeout", "-idletimeout", "-logminduration", "-maxruns",
-        "-maxworkers",  NULL
+        "-maxworkers", "-shmsize", NULL
     };
     enum {
         CInitIdx, CReinitIdx, CMaxslaveIdx, CExecIdx, CEnvIdx,
         CGetIdx, CEvalIdx, CSendIdx, CRecvIdx,
         CWaitIdx, CIdleIdx, CLogmindurationIdx, CMaxrunsIdx,
-        CMaxworkerIdx
+        CMaxworkerIdx, CShmsizeIdx
     };
 
     if (objc < 3) {
@@ -2387,6 +2751,22 @@ ConfigureObjCmd(ClientData data, Tcl_Interp *interp, TCL_OBJC_T objc, Tcl_Obj *c
                     break;
                 }
                 break;
+            case CShmsizeIdx: {
+                Tcl_WideInt size;
+
+                if (Ns_TclGetMemUnitFromObj(interp, objv[i], &size) != TCL_OK) {
+                    result = TCL_ERROR;
+                    goto err;
+                }
+                if (size < 0 || size > INT_MAX) {
+                    Ns_TclPrintfResult(interp, "invalid %s: %s",
+                                       flags[flag], str);
+                    result = TCL_ERROR;
+                    goto err;
+                }
+                poolPtr->conf.shmsize = (size_t)size;
+                break;
+            }
             case CInitIdx:
                 SetOpt(str, &poolPtr->init);
                 break;
@@ -2444,6 +2824,7 @@ ConfigureObjCmd(ClientData data, Tcl_Interp *interp, TCL_OBJC_T objc, Tcl_Obj *c
             AppendObj(listObj, flags[CReinitIdx],   StringObj(poolPtr->reinit));
             AppendObj(listObj, flags[CMaxworkerIdx], Tcl_NewIntObj(poolPtr->maxworker));
             AppendObj(listObj, flags[CMaxrunsIdx],  Tcl_NewIntObj(poolPtr->conf.maxruns));
+            AppendObj(listObj, flags[CShmsizeIdx],  Tcl_NewWideIntObj((Tcl_WideInt)poolPtr->conf.shmsize));
             AppendObj(listObj, flags[CGetIdx],      Ns_TclNewTimeObj(&poolPtr->conf.tget));
             AppendObj(listObj, flags[CEvalIdx],     Ns_TclNewTimeObj(&poolPtr->conf.teval));
             AppendObj(listObj, flags[CSendIdx],     Ns_TclNewTimeObj(&poolPtr->conf.tsend));
@@ -2467,6 +2848,8 @@ ConfigureObjCmd(ClientData data, Tcl_Interp *interp, TCL_OBJC_T objc, Tcl_Obj *c
             break;
         case CMaxrunsIdx:  Tcl_SetObjResult(interp, Tcl_NewIntObj(poolPtr->conf.maxruns));
             break;
+        case CShmsizeIdx:  Tcl_SetObjResult(interp, Tcl_NewWideIntObj((Tcl_WideInt)poolPtr->conf.shmsize));
+            break;
         case CGetIdx:      Tcl_SetObjResult(interp, Ns_TclNewTimeObj(&poolPtr->conf.tget));
             break;
         case CEvalIdx:     Tcl_SetObjResult(interp, Ns_TclNewTimeObj(&poolPtr->conf.teval));
@@ -2690,6 +3073,295 @@ GetObjCmd(ClientData data, Tcl_Interp *interp, TCL_OBJC_T objc, Tcl_Obj *const*
 }
 
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * MapObjCmd --
+ *
+ *      Implements "ns_proxy map". Evaluates a list of scripts using
+ *      several proxies of a pool in parallel. The scripts are sent to
+ *      the proxies as they become available, the results are collected
+ *      as they arrive.
+ *
+ * Results:
+ *      Standard Tcl result. The interp result is a list containing for
+ *      every script a list of its Tcl return code and its result.
+ *
+ * Side effects:
+ *      Proxies are allocated from the pool and returned at the end.
+ *      Workers exceeding the eval timeout are restarted.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+MapObjCmd(ClientData data, Tcl_Interp *interp, TCL_OBJC_T objc, Tcl_Obj *const* objv)
+{
+    InterpData    *idataPtr = data;
+    Proxy         *proxyPtr, *firstPtr = NULL, **proxies = NULL;
+    Tcl_HashEntry *cntPtr;
+    Tcl_Obj       *scriptsObj = NULL, **scriptObjs, **resultObjs = NULL, *listObj;
+    struct pollfd *pfds = NULL;
+    Ns_Time       *timeoutPtr = NULL, *evalTimeoutPtr = NULL, *deadlines = NULL;
+    TCL_SIZE_T    *scriptIdx = NULL, nscripts, next = 0, ndone = 0;
+    int            isNew, nwant = 0, nproxies = 0, i, result = TCL_OK;
+    char          *poolName = NULL;
+    Err            err;
+    Pool          *poolPtr;
+    Ns_ObjvSpec    lopts[] = {
+        {"-evaltimeout", Ns_ObjvTime, &evalTimeoutPtr, NULL},
+        {"-handles",     Ns_ObjvInt,  &nwant,          NULL},
+        {"-timeout",     Ns_ObjvTime, &timeoutPtr,     NULL},
+        {"--",           Ns_ObjvBreak, NULL,           NULL},
+        {NULL, NULL, NULL, NULL}
+    };
+    Ns_ObjvSpec    largs[] = {
+        {"pool",    Ns_ObjvString, &poolName,   NULL},
+        {"scripts", Ns_ObjvObj,    &scriptsObj, NULL},
+        {NULL, NULL, NULL, NULL}
+    };
+
+    if (Ns_ParseObjv(lopts, largs, interp, 2, objc, objv) != NS_OK) {
+        return TCL_ERROR;
+    }
+    if (Tcl_ListObjGetElements(interp, scriptsObj, &nscripts, &scriptObjs) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    if (nwant < 0) {
+        Ns_TclPrintfResult(interp, "invalid value for -handles: %d", nwant);
+        return TCL_ERROR;
+    }
+    if (nscripts == 0) {
+        Tcl_SetObjResult(interp, Tcl_NewListObj(0, NULL));
+        return TCL_OK;
+    }
+
+    assert(idataPtr != NULL);
+    poolPtr = GetPool(poolName, idataPtr);
+    assert(poolPtr != NULL);
+
+    /*
+     * Like with "ns_proxy get", an interp already owning handles of the
+     * pool might wait for itself.
+     */
+    cntPtr = Tcl_CreateHashEntry(&idataPtr->cnts, (char *) poolPtr, &isNew);
+    if ((intptr_t) Tcl_GetHashValue(cntPtr) > 0) {
+        err = EDeadlock;
+        goto errout;
+    }
+
+    /*
+     * Use by default as many proxies as scripts, limited by the size of
+     * the pool.
+     */
+    Ns_MutexLock(&poolPtr->lock);
+    if (nwant == 0) {
+        nwant = poolPtr->maxworker;
+    }
+    if (timeoutPtr == NULL) {
+        timeoutPtr = &poolPtr->conf.tget;
+    }
+    Ns_MutexUnlock(&poolPtr->lock);
+    if ((TCL_SIZE_T)nwant > nscripts) {
+        nwant = (int)nscripts;
+    }
+
+    err = PopProxy(poolPtr, &firstPtr, nwant, timeoutPtr);
+    if (err != ENone) {
+    errout:
+        Ns_TclPrintfResult(interp, "could not allocate from pool \"%s\": %s",
+                           poolPtr->name, errMsg[err]);
+        ProxyError(interp, err);
+        return TCL_ERROR;
+    }
+
+    proxies    = ns_calloc((size_t)nwant, sizeof(Proxy *));
+    pfds       = ns_calloc((size_t)nwant, sizeof(struct pollfd));
+    deadlines  = ns_calloc((size_t)nwant, sizeof(Ns_Time));
+    scriptIdx  = ns_calloc((size_t)nwant, sizeof(TCL_SIZE_T));
+    resultObjs = ns_calloc((size_t)nscripts, sizeof(Tcl_Obj *));
+
+    for (proxyPtr = firstPtr; proxyPtr != NULL; proxyPtr = proxyPtr->nextPtr) {
+        proxies[nproxies] = proxyPtr;
+        scriptIdx[nproxies] = -1;
+        nproxies++;
+    }
+
+    while (ndone < nscripts) {
+        int  nbusy = 0;
+        long ms = -1;
+
+        /*
+         * Send the next scripts to all idle proxies.
+         */
+        for (i = 0; i < nproxies; i++) {
+            proxyPtr = proxies[i];
+            while (scriptIdx[i] == -1 && next < nscripts) {
+                TCL_SIZE_T idx = next++;
+
+                err = ENone;
+                if (proxyPtr->workerPtr == NULL) {
+                    err = CheckProxy(interp, proxyPtr);
+                }
+                if (err == ENone) {
+                    err = Send(interp, proxyPtr, Tcl_GetString(scriptObjs[idx]));
+                }
+                if (err != ENone) {
+                    resultObjs[idx] = MapResult(interp, TCL_ERROR);
+                    ResetProxy(proxyPtr);
+                    ndone++;
+                } else {
+                    const Ns_Time *tPtr = (evalTimeoutPtr != NULL)
+                        ? evalTimeoutPtr : &proxyPtr->conf.teval;
+
+                    scriptIdx[i] = idx;
+                    if (tPtr->sec > 0 || tPtr->usec > 0) {
+                        Ns_GetTime(&deadlines[i]);
+                        Ns_IncrTime(&deadlines[i], tPtr->sec, tPtr->usec);
+                    } else {
+                        deadlines[i].sec = 0;
+                        deadlines[i].usec = 0;
+                    }
+                }
+            }
+        }
+
+        /*
+         * Compute the poll set and the time until the next deadline.
+         */
+        for (i = 0; i < nproxies; i++) {
+            if (scriptIdx[i] != -1) {
+                pfds[i].fd = proxies[i]->workerPtr->rfd;
+                pfds[i].events = POLLIN | POLLPRI | POLLERR;
+                nbusy++;
+                if (deadlines[i].sec > 0 || deadlines[i].usec > 0) {
+                    long remain = GetTimeDiff(&deadlines[i]);
+
+                    if (remain < 0) {
+                        remain = 0;
+                    }
+                    if (ms < 0 || remain < ms) {
+                        ms = remain;
+                    }
+                }
+            } else {
+                pfds[i].fd = NS_INVALID_FD;
+                pfds[i].events = 0;
+            }
+            pfds[i].revents = 0;
+        }
+        if (nbusy == 0) {
+            continue;
+        }
+
+        {
+            int n;
+
+            do {
+                n = ns_poll(pfds, (NS_POLL_NFDS_TYPE)nproxies, ms);
+            } while (n == -1 && errno == NS_EINTR);
+            if (n == -1) {
+                Ns_TclPrintfResult(interp, "poll failed: %s", strerror(errno));
+                result = TCL_ERROR;
+                break;
+            }
+        }
+
+        /*
+         * Collect the results of finished proxies and handle timeouts.
+         */
+        for (i = 0; i < nproxies; i++) {
+            TCL_SIZE_T idx = scriptIdx[i];
+
+            if (idx == -1) {
+                continue;
+            }
+            proxyPtr = proxies[i];
+            if (pfds[i].revents != 0) {
+                int status = TCL_ERROR;
+
+                proxyPtr->state = Done;
+                err = Recv(interp, proxyPtr, &status);
+                GetStats(proxyPtr);
+                resultObjs[idx] = MapResult(interp, (err == ENone) ? status : TCL_ERROR);
+
+            } else if ((deadlines[i].sec > 0 || deadlines[i].usec > 0)
+                       && GetTimeDiff(&deadlines[i]) <= 0) {
+                Ns_TclPrintfResult(interp, "could not wait for proxy \"%s\": %s",
+                                   proxyPtr->id, errMsg[EEvalTimeout]);
+                resultObjs[idx] = MapResult(interp, TCL_ERROR);
+                /*
+                 * The worker is still busy, close it.
+                 */
+                ResetProxy(proxyPtr);
+            } else {
+                continue;
+            }
+            scriptIdx[i] = -1;
+            ndone++;
+        }
+    }
+
+    if (result == TCL_OK) {
+        listObj = Tcl_NewListObj(nscripts, resultObjs);
+        Tcl_SetObjResult(interp, listObj);
+    }
+
+    /*
+     * Return the proxies to the pool. Busy proxies are closed.
+     */
+    for (i = 0; i < nproxies; i++) {
+        PushProxy(proxies[i]);
+    }
+    for (next = 0; next < nscripts; next++) {
+        if (resultObjs[next] != NULL) {
+            Tcl_DecrRefCount(resultObjs[next]);
+        }
+    }
+    ns_free(resultObjs);
+    ns_free(scriptIdx);
+    ns_free(deadlines);
+    ns_free(pfds);
+    ns_free(proxies);
+
+    return result;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * MapResult --
+ *
+ *      Build the result element of "ns_proxy map" for one script from
+ *      the given return code and the interp result.
+ *
+ * Results:
+ *      Tcl_Obj with incremented reference count.
+ *
+ * Side effects:
+ *      Resets the interp result.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Tcl_Obj *
+MapResult(Tcl_Interp *interp, int code)
+{
+    Tcl_Obj *elems[2], *resultObj;
+
+    NS_NONNULL_ASSERT(interp != NULL);
+
+    elems[0] = Tcl_NewIntObj(code);
+    elems[1] = Tcl_GetObjResult(interp);
+    resultObj = Tcl_NewListObj(2, elems);
+    Tcl_IncrRefCount(resultObj);
+    Tcl_ResetResult(interp);
+
+    return resultObj;
+}
+
+
 /*
  *----------------------------------------------------------------------
  *
@@ -2916,6 +3588,9 @@ GetPool(const char *poolName, const InterpData *idataPtr)
             Ns_ConfigTimeUnitRange(path, "logminduration",
                                    "1s", 0, 0, INT_MAX, 0,
                                    &poolPtr->conf.logminduration);
+
+            poolPtr->conf.shmsize = (size_t)Ns_ConfigMemUnitRange(path, "shmsize",
+                                                                  "0", 0, 0, INT_MAX);
         }
 
         {
@@ -3504,6 +4179,9 @@ ReaperThread(void *UNUSED(arg))
                 if (workerPtr->rfd != NS_INVALID_FD) {
                     ns_close(workerPtr->rfd);
                 }
+#ifdef NS_PROXY_SHM
+                ShmFree(workerPtr);
+#endif
                 ns_free(workerPtr);
                 workerPtr = tmpWorkerPtr;
 
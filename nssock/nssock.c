@@ -85,7 +85,12 @@ Ns_ModuleInit(const char *server, const char *module)
     init.connInfoProc = ConnInfo;
     init.requestProc  = NULL;
     init.closeProc    = SockClose;
-    init.opts         = NS_DRIVER_ASYNC;
+    /*
+     * Writer threads may replace SockSend() by batched io_uring send
+     * operations, since corking a single sendmsg() call has no effect
+     * on the segments sent. All other sends use SockSend().
+     */
+    init.opts         = NS_DRIVER_ASYNC|NS_DRIVER_WRITER_URING;
     init.arg          = drvCfgPtr;
     init.path         = (char*)path;
     init.protocol     = "http";
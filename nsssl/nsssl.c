@@ -53,6 +53,7 @@ static Ns_DriverListenProc Listen;
 static Ns_DriverAcceptProc Accept;
 static Ns_DriverRecvProc Recv;
 static Ns_DriverSendProc Send;
+static Ns_DriverSendFileProc SendFile;
 static Ns_DriverKeepProc Keep;
 static Ns_DriverConnInfoProc ConnInfo;
 static Ns_DriverCloseProc Close;
@@ -62,6 +63,10 @@ static Ns_DriverClientInitProc ClientInit;
 static void SSLLock(int mode, int n, const char *file, int line);
 static unsigned long SSLThreadId(void);
 #endif
+#ifdef HAVE_OPENSSL_KTLS
+static ssize_t SendFileKtls(Ns_Sock *sock, SSL *ssl, const Ns_FileVec *bufs, int nbufs)
+    NS_GNUC_NONNULL(1) NS_GNUC_NONNULL(2) NS_GNUC_NONNULL(3);
+#endif
 
 /*
  * Static variables defined in this file.
@@ -94,13 +99,20 @@ Ns_ModuleInit(const char *server, const char *module)
     init.acceptProc = Accept;
     init.recvProc = Recv;
     init.sendProc = Send;
-    init.sendFileProc = NULL;
+    init.sendFileProc = SendFile;
     init.keepProc = Keep;
     init.connInfoProc = ConnInfo;
     init.requestProc = NULL;
     init.closeProc = Close;
     init.clientInitProc = ClientInit;
-    init.opts = NS_DRIVER_SSL|NS_DRIVER_ASYNC;
+    init.opts = NS_DRIVER_SSL|NS_DRIVER_ASYNC|NS_DRIVER_SSL_CONFIG;
+    if (drvCfgPtr->ktls) {
+        /*
+         * With kernel TLS, the writer threads should pass file content
+         * to SendFile() to benefit from SSL_sendfile().
+         */
+        init.opts |= NS_DRIVER_WRITER_SENDFILE;
+    }
     init.arg = drvCfgPtr;
     init.path = path;
     init.protocol = "https";
@@ -437,6 +449,131 @@ Send(Ns_Sock *sock, const struct iovec *bufs, int nbufs,
 }
 
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * SendFile --
+ *
+ *      Send a vector of file ranges and memory buffers. When kernel TLS
+ *      is active for the send direction of the socket, file ranges are
+ *      sent via SSL_sendfile() without copying the content through user
+ *      space, otherwise the content is read and sent via Send().
+ *
+ * Results:
+ *      Total number of bytes sent, -1 on error.
+ *      May return 0 (zero) if socket is not writable.
+ *
+ * Side effects:
+ *      May block on disk IO. Updates the kernel TLS counters.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static ssize_t
+SendFile(Ns_Sock *sock, Ns_FileVec *bufs, int nbufs,
+         Ns_Time *UNUSED(timeoutPtr), unsigned int flags)
+{
+    NsSSLConfig *drvCfgPtr = sock->driver->arg;
+    ssize_t      sent;
+
+#ifdef HAVE_OPENSSL_KTLS
+    SSLContext  *sslCtx = sock->arg;
+
+    if (drvCfgPtr->ktls
+        && sslCtx != NULL
+        && BIO_get_ktls_send(SSL_get_wbio(sslCtx->ssl))) {
+        sent = SendFileKtls(sock, sslCtx->ssl, bufs, nbufs);
+    } else
+#endif
+    {
+        /*
+         * The generic code uses the sendfile() emulation, which sends
+         * via the Send() callback of this driver.
+         */
+        sent = Ns_SockSendFileBufs(sock, bufs, nbufs, flags);
+
+        if (sent > 0 && drvCfgPtr->ktls) {
+            Ns_MutexLock(&drvCfgPtr->lock);
+            drvCfgPtr->ktlsFallbackBytes += (Tcl_WideInt)sent;
+            Ns_MutexUnlock(&drvCfgPtr->lock);
+        }
+    }
+
+    return sent;
+}
+
+#ifdef HAVE_OPENSSL_KTLS
+/*
+ *----------------------------------------------------------------------
+ *
+ * SendFileKtls --
+ *
+ *      Helper of SendFile() for sockets with kernel TLS in the send
+ *      direction: send file ranges via SSL_sendfile() and memory
+ *      buffers via Send(). Stop on the first partial send.
+ *
+ * Results:
+ *      Total number of bytes sent, -1 on error.
+ *
+ * Side effects:
+ *      Updates the kernel TLS counters.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static ssize_t
+SendFileKtls(Ns_Sock *sock, SSL *ssl, const Ns_FileVec *bufs, int nbufs)
+{
+    NsSSLConfig *drvCfgPtr = sock->driver->arg;
+    ssize_t      nwrote = 0;
+    Tcl_WideInt  fileBytes = 0;
+    bool         decork;
+    int          i;
+
+    decork = Ns_SockCork(sock, NS_TRUE);
+
+    for (i = 0; i < nbufs; i++) {
+        size_t  length = bufs[i].length;
+        ssize_t sent;
+
+        if (length == 0u) {
+            continue;
+        }
+        if (bufs[i].fd == NS_INVALID_FD) {
+            struct iovec iov;
+
+            (void) Ns_SetVec(&iov, 0, (char *)bufs[i].buffer + bufs[i].offset, length);
+            sent = Send(sock, &iov, 1, NULL, 0u);
+        } else {
+            sent = Ns_SSLSendFile(ssl, bufs[i].fd, bufs[i].offset, length);
+            if (sent > 0) {
+                fileBytes += (Tcl_WideInt)sent;
+            }
+        }
+        if (sent == -1) {
+            nwrote = -1;
+            break;
+        }
+        nwrote += sent;
+        if ((size_t)sent < length) {
+            break;
+        }
+    }
+
+    if (decork) {
+        (void) Ns_SockCork(sock, NS_FALSE);
+    }
+
+    if (fileBytes > 0) {
+        Ns_MutexLock(&drvCfgPtr->lock);
+        drvCfgPtr->ktlsBytes += fileBytes;
+        Ns_MutexUnlock(&drvCfgPtr->lock);
+    }
+
+    return nwrote;
+}
+#endif
+
 /*
  *----------------------------------------------------------------------
  *
@@ -521,6 +658,22 @@ ConnInfo(Ns_Sock *sock)
     Tcl_DictObjPut(NULL, resultObj,
                    Tcl_NewStringObj("servername", 10),
                    Tcl_NewStringObj(SSL_get_servername(sslCtx->ssl, TLSEXT_NAMETYPE_host_name), TCL_INDEX_NONE));
+#ifdef TLSEXT_TYPE_application_layer_protocol_negotiation
+    {
+        const unsigned char *alpn;
+        unsigned int         alpnLength;
+
+        SSL_get0_alpn_selected(sslCtx->ssl, &alpn, &alpnLength);
+        Tcl_DictObjPut(NULL, resultObj,
+                       Tcl_NewStringObj("alpn", 4),
+                       Tcl_NewStringObj((const char *)alpn, (TCL_SIZE_T)alpnLength));
+    }
+#endif
+#ifdef HAVE_OPENSSL_KTLS
+    Tcl_DictObjPut(NULL, resultObj,
+                   Tcl_NewStringObj("ktls", 4),
+                   Tcl_NewBooleanObj(BIO_get_ktls_send(SSL_get_wbio(sslCtx->ssl))));
+#endif
 
     return resultObj;
 }
@@ -453,6 +453,9 @@ if {[info exists httpsport] && $httpsport ne ""} {
                                          # receives more than this threshold number of sockets
         # ns_param deferaccept	true    ;# false, Performance optimization
         # ns_param nodelay	false   ;# true; deactivate TCP_NODELAY if Nagle algorithm is wanted
+        # ns_param ktls		true    ;# false; kernel TLS offload, file delivery via SSL_sendfile()
+        # ns_param ticketkeyfile	$serverroot/etc/ticket.key ;# session ticket keys for resumption across restarts
+        # ns_param sessioncachedir	/dev/shm/ns-tls-sessions ;# external session cache, shared between processes
         ns_param maxinput	$max_file_upload_size   ;# Maximum file size for uploads in bytes
         ns_param recvwait	$max_file_upload_duration  ;# 30s, timeout for receive operations
         ns_param extraheaders	$https_extraheaders
@@ -519,6 +522,9 @@ ns_section ns/fastpath {
     #ns_param        brotli_static       true       ;# check for static brotli files; default: false
     #ns_param        brotli_refresh      true       ;# refresh stale .br files on the fly using ::ns_brotlifile
     #ns_param        brotli_cmd          "/usr/bin/brotli -f -Z"  ;# use for re-compressing
+    #ns_param        refresh_async       true       ;# refresh stale files in the background; default: false
+    #ns_param        compress_queuesize  100        ;# max. files waiting for background compression; default: 100
+    #ns_param        compress_threads    2          ;# max. background compression threads; default: 2
 }
 
 #---------------------------------------------------------------------
@@ -567,6 +573,10 @@ ns_section ns/server/$server {
     # ns_param	compresslevel	4        ;# 4, 1-9 where 9 is high compression, high overhead
     # ns_param	compressminsize	512      ;# Compress responses larger than this
     # ns_param	compresspreinit true     ;# false, if true then initialize and allocate buffers at startup
+    # ns_param	compressformats	{br zstd gzip} ;# gzip, formats in order of preference, when accepted by the client and compiled in
+    # ns_param	compressbrotlilevel 4    ;# 4, 1-11 brotli quality for on-the-fly compression
+    # ns_param	compresszstdlevel 3      ;# 3, 1-19 zstd level for on-the-fly compression
+    # ns_param	compresscachesize 10MB   ;# 0, cache compressed variants of responses with strong ETag or "ns_conn compress -cachekey"
 
     # Enable nicer directory listing (as handled by the OpenACS request processor)
     # ns_param	directorylisting	fancy	;# Can be simple or fancy
@@ -735,6 +745,11 @@ ns_section ns/server/$server/fastpath {
     #                                   ;# "fancy" or "none"; parameter for _ns_dirlist
     # ns_param	hidedotfiles      true  ;# default false; parameter for _ns_dirlist
     #
+    # Compress files of the pagedir at startup (for gzip_static and brotli_static)
+    #
+    # ns_param	precompress       true  ;# default false
+    # ns_param	precompress_extensions ".html .htm .css .js .mjs .json .svg .txt .xml"
+    #
 }
 
 #---------------------------------------------------------------------
@@ -26,6 +26,28 @@ if {[info exists ::env(QUERY_STRING)]} {
         set done 1
     }
 
+    if {[dict exists $query size]} {
+        #
+        # Return "size" bytes of content with a Content-Length
+        # header. With "short" the CGI delivers fewer bytes than
+        # announced.
+        #
+        set size [dict get $query size]
+        fconfigure stdout -translation binary
+        puts -nonewline "Content-type: text/plain\r\n"
+        puts -nonewline "Content-Length: $size\r\n\r\n"
+        if {[dict exists $query short]} {
+            incr size -[dict get $query short]
+        }
+        set line [string repeat x 99]\n
+        for {set i 0} {$i < $size / 100} {incr i} {
+            puts -nonewline $line
+        }
+        puts -nonewline [string repeat y [expr {$size % 100}]]
+        flush stdout
+        set done 1
+    }
+
     if {[dict exists $query status]} {
         lappend header "Status: [dict get $query status]"
     }